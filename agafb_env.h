@@ -0,0 +1,80 @@
+#ifndef AGAFB_ENV_H
+#define AGAFB_ENV_H
+
+/*
+ * Reinforcement learning environment
+ *
+ * A plain C interface over the game rules, built as a shared library
+ * (libagafb_env.so / agafb_env.dll) for training code to load through its FFI.
+ *
+ * Observations are never allocated by the library. Every call that produces
+ * one writes it straight into memory the caller hands in - an array it owns,
+ * or a block of shared memory from agafb_shm_open - and nothing is allocated
+ * or copied per step beyond writing those observations.
+ *
+ * One step is one game tick with the action held as the tick's input.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32)
+#define AGAFB_API __declspec(dllexport)
+#else
+#define AGAFB_API __attribute__((visibility("default")))
+#endif
+
+#define AGAFB_ROWS 20
+#define AGAFB_COLS 10
+
+//Actions are a bitmask, so moves can be combined on one tick
+#define AGAFB_ACTION_NONE   0
+#define AGAFB_ACTION_LEFT   1
+#define AGAFB_ACTION_RIGHT  2
+#define AGAFB_ACTION_ROTATE 4
+#define AGAFB_ACTION_DOWN   8
+#define AGAFB_ACTION_COUNT  16
+
+typedef struct AgafbObservation{
+    unsigned char Board[AGAFB_ROWS][AGAFB_COLS];    //1 for each locked block
+    unsigned char Piece[AGAFB_ROWS][AGAFB_COLS];    //1 for each block of the falling piece
+    int CurrentPiece;                               //TetrominoType, 0-6
+    int NextPiece;
+    int ScoreDelta;                                 //Score gained on this step
+    int Score;
+    int LinesRemoved;                               //Lines cleared on this step
+    int Done;                                       //The game ended on this step
+} AgafbObservation;
+
+typedef struct AgafbEnv AgafbEnv;
+typedef struct AgafbVecEnv AgafbVecEnv;
+
+AGAFB_API unsigned int  agafb_observation_size(void);
+
+//Single environment. Stepping returns 1 once the game has ended, 0 while it's
+//running, and -1, writing no observation, if the environment was never reset.
+AGAFB_API AgafbEnv*     agafb_env_create(void);
+AGAFB_API void          agafb_env_destroy(AgafbEnv* Env);
+AGAFB_API void          agafb_env_reset(AgafbEnv* Env, unsigned int Seed, AgafbObservation* Obs);
+AGAFB_API int           agafb_env_step(AgafbEnv* Env, unsigned int Action, AgafbObservation* Obs);
+AGAFB_API void          agafb_env_step_many(AgafbEnv** Envs, const unsigned int* Actions, AgafbObservation* Obs, unsigned int Count);
+
+//Many environments stepped across worker threads. Environment I is seeded
+//with Seed + I on reset, and environments that finish are restarted on their
+//next step, so a step never needs a separate reset call.
+AGAFB_API AgafbVecEnv*  agafb_vec_create(unsigned int Count, unsigned int Threads);
+AGAFB_API void          agafb_vec_destroy(AgafbVecEnv* VecEnv);
+AGAFB_API void          agafb_vec_reset(AgafbVecEnv* VecEnv, unsigned int Seed, AgafbObservation* Obs);
+AGAFB_API void          agafb_vec_step(AgafbVecEnv* VecEnv, const unsigned int* Actions, AgafbObservation* Obs);
+
+//Observation arrays in named shared memory, so another process can read them
+//without a copy. Returns NULL on failure or where shared memory isn't supported.
+AGAFB_API AgafbObservation* agafb_shm_open(const char* Name, unsigned int Count, int Create);
+AGAFB_API void              agafb_shm_close(AgafbObservation* Obs, unsigned int Count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
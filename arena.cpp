@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "arena.h"
+
+MemoryArena GenerateArena(size_t Size)
+{
+    MemoryArena Result;
+
+    Result.Base = (unsigned char*)HeapAllocate(Size);
+    Result.Size = Result.Base ? Size : 0;
+    Result.Used = 0;
+
+    return Result;
+}
+
+void DestroyArena(MemoryArena Arena)
+{
+    HeapFree(Arena.Base);
+}
+
+void ResetArena(MemoryArena* Arena)
+{
+    Arena->Used = 0;
+}
+
+//Returns NULL if the arena is full, the callers treat that like a failed malloc
+void* PushSize(MemoryArena* Arena, size_t Size)
+{
+    size_t Start = (Arena->Used + (ARENA_ALIGNMENT - 1)) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+    if(Start + Size > Arena->Size)
+    {
+        printf("Arena full! Wanted %u bytes, %u of %u used.\n",
+                (unsigned int)Size, (unsigned int)Arena->Used, (unsigned int)Arena->Size);
+        return NULL;
+    }
+
+    Arena->Used = Start + Size;
+
+    return Arena->Base + Start;
+}
+
+/*
+ * Heap Accounting
+ */
+
+//The calling thread's, so counting costs no more than an add
+thread_local HeapCounters ThreadHeapCounters;
+
+void* HeapAllocate(size_t Size)
+{
+    ThreadHeapCounters.Allocations++;
+    ThreadHeapCounters.Bytes += Size;
+
+    return malloc(Size);
+}
+
+void* HeapReallocate(void* Memory, size_t Size)
+{
+    ThreadHeapCounters.Allocations++;
+    ThreadHeapCounters.Bytes += Size;
+
+    return realloc(Memory, Size);
+}
+
+void HeapFree(void* Memory)
+{
+    if(Memory)
+    {
+        ThreadHeapCounters.Frees++;
+    }
+
+    free(Memory);
+}
+
+HeapCounters GetHeapCounters()
+{
+    return ThreadHeapCounters;
+}
+
+HeapCounters GetHeapCountersSince(HeapCounters Start)
+{
+    HeapCounters Result;
+
+    Result.Allocations = ThreadHeapCounters.Allocations - Start.Allocations;
+    Result.Frees = ThreadHeapCounters.Frees - Start.Frees;
+    Result.Bytes = ThreadHeapCounters.Bytes - Start.Bytes;
+
+    return Result;
+}
@@ -0,0 +1,55 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+ * Memory Arenas
+ *
+ * One block of memory allocated up front and handed out by bumping a pointer.
+ * Nothing pushed onto an arena is freed on its own: the whole arena is reset
+ * in one go when everything in it is finished with (a game restarting, a
+ * frame ending), which makes allocation a pointer add and freeing free.
+ */
+
+enum ArenaConstants{
+    ARENA_ALIGNMENT = 16
+};
+
+struct MemoryArena{
+    unsigned char* Base;
+    size_t Size;
+    size_t Used;
+};
+
+MemoryArena GenerateArena(size_t Size);
+void        DestroyArena(MemoryArena Arena);
+void        ResetArena(MemoryArena* Arena);
+void*       PushSize(MemoryArena* Arena, size_t Size);
+
+#define PushArray(Arena, Type, Count) ((Type*)PushSize((Arena), sizeof(Type)*(Count)))
+#define PushStruct(Arena, Type) ((Type*)PushSize((Arena), sizeof(Type)))
+
+/*
+ * Heap Accounting
+ *
+ * The game and the platform layer take memory from the heap through these
+ * rather than malloc and free, so every call is counted. Counts are kept per
+ * thread: take them before and after a frame or a tick to see what it
+ * allocated, which once a game is running should be nothing.
+ */
+
+struct HeapCounters{
+    unsigned long long Allocations;     //Reallocations included
+    unsigned long long Frees;
+    unsigned long long Bytes;           //Asked for, not counting frees
+};
+
+void*           HeapAllocate(size_t Size);
+void*           HeapReallocate(void* Memory, size_t Size);
+void            HeapFree(void* Memory);
+
+HeapCounters    GetHeapCounters();
+HeapCounters    GetHeapCountersSince(HeapCounters Start);
+
+#endif
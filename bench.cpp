@@ -0,0 +1,669 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "arena.cpp"
+#include "game.cpp"
+#include "pieces.cpp"
+#include "lockstep.cpp"
+#include "snapshot.cpp"
+#include "broadcast.cpp"
+
+/*
+ * Headless microbenchmarks for the rule functions.
+ *
+ * Each benchmark runs the runtime sized (generic) path and the fixed dimension
+ * instantiation over the same set of boards and pieces, checks they agree and
+ * reports nanoseconds per call.
+ */
+
+enum BenchConstants{
+    BENCH_BOARDS     = 256,
+    BENCH_ITERATIONS = 2000,
+
+    //Simulation throughput
+    BENCH_SIM_TICKS  = 4000000,
+    BENCH_INPUTS     = 4096,
+
+    //Snapshots
+    BENCH_SNAPSHOTS  = 1024,
+    BENCH_SNAPSHOT_ITERATIONS = 200,
+
+    //Spectator broadcast, consecutive ticks
+    BENCH_BROADCAST_TICKS = 65536,
+
+    //Ticks checked for heap allocations
+    BENCH_STEADY_TICKS = 200000
+};
+
+struct BenchCase{
+    BlockGrid Board;
+    Tetromino Tetro;
+};
+
+typedef unsigned int (*CollisionFunction)(BlockGrid Grid, Tetromino Tetro);
+typedef void         (*StoreFunction)(BlockGrid Grid, Tetromino Tetro);
+typedef unsigned int (*RemoveLinesFunction)(BlockGrid Grid, unsigned int* ClearedRows);
+
+double GetSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void CopyGrid(BlockGrid Dest, BlockGrid Source)
+{
+    memcpy(Dest.Blocks, Source.Blocks, sizeof(Block)*Source.Rows*Source.Cols);
+}
+
+//A half filled board with ragged columns and the odd complete line
+BlockGrid GenerateBenchBoard()
+{
+    BlockGrid Result = GenerateGrid(GRID_ROWS, GRID_COLS);
+
+    unsigned int StackHeight = rand()%(GRID_ROWS - 4);
+
+    for(unsigned int Row = GRID_ROWS - StackHeight; Row < GRID_ROWS; ++Row)
+    {
+        bool FullLine = (rand()%4) == 0;
+
+        for(unsigned int Col = 0; Col < GRID_COLS; ++Col)
+        {
+            if(FullLine || (rand()%3))
+            {
+                Block* CurrentBlock = GetBlock(Result, Row, Col);
+                CurrentBlock->Occupied = 1;
+                CurrentBlock->Colour = rand()%PALETTE_SIZE;
+            }
+        }
+    }
+
+    return Result;
+}
+
+double BenchCollisions(BenchCase* Cases, CollisionFunction Function, unsigned int* Checksum)
+{
+    double Start = GetSeconds();
+
+    unsigned int Total = 0;
+    for(unsigned int Iteration = 0; Iteration < BENCH_ITERATIONS; ++Iteration)
+    {
+        for(unsigned int Index = 0; Index < BENCH_BOARDS; ++Index)
+        {
+            Total += Function(Cases[Index].Board, Cases[Index].Tetro);
+        }
+    }
+
+    double Elapsed = GetSeconds() - Start;
+    *Checksum = Total;
+
+    return Elapsed*1e9/((double)BENCH_ITERATIONS*BENCH_BOARDS);
+}
+
+double BenchStore(BenchCase* Cases, BlockGrid Scratch, StoreFunction Function, unsigned int* Checksum)
+{
+    double Start = GetSeconds();
+
+    unsigned int Total = 0;
+    for(unsigned int Iteration = 0; Iteration < BENCH_ITERATIONS; ++Iteration)
+    {
+        for(unsigned int Index = 0; Index < BENCH_BOARDS; ++Index)
+        {
+            CopyGrid(Scratch, Cases[Index].Board);
+            Function(Scratch, Cases[Index].Tetro);
+            Total += Scratch.Blocks[(Index*7)%(GRID_ROWS*GRID_COLS)].Occupied;
+        }
+    }
+
+    double Elapsed = GetSeconds() - Start;
+    *Checksum = Total;
+
+    return Elapsed*1e9/((double)BENCH_ITERATIONS*BENCH_BOARDS);
+}
+
+double BenchRemoveLines(BenchCase* Cases, BlockGrid Scratch, RemoveLinesFunction Function, unsigned int* Checksum)
+{
+    double Start = GetSeconds();
+
+    unsigned int Total = 0;
+    unsigned int ClearedRows[TETROMINO_MAX_SIZE];
+
+    for(unsigned int Iteration = 0; Iteration < BENCH_ITERATIONS; ++Iteration)
+    {
+        for(unsigned int Index = 0; Index < BENCH_BOARDS; ++Index)
+        {
+            CopyGrid(Scratch, Cases[Index].Board);
+            Total += Function(Scratch, ClearedRows);
+            Total += Scratch.Blocks[(Index*7)%(GRID_ROWS*GRID_COLS)].Occupied;
+        }
+    }
+
+    double Elapsed = GetSeconds() - Start;
+    *Checksum = Total;
+
+    return Elapsed*1e9/((double)BENCH_ITERATIONS*BENCH_BOARDS);
+}
+
+//Cost of resetting the scratch board, which the mutating benchmarks subtract
+double BenchCopy(BenchCase* Cases, BlockGrid Scratch, unsigned int* Checksum)
+{
+    double Start = GetSeconds();
+
+    unsigned int Total = 0;
+    for(unsigned int Iteration = 0; Iteration < BENCH_ITERATIONS; ++Iteration)
+    {
+        for(unsigned int Index = 0; Index < BENCH_BOARDS; ++Index)
+        {
+            CopyGrid(Scratch, Cases[Index].Board);
+            Total += Scratch.Blocks[(Index*7)%(GRID_ROWS*GRID_COLS)].Occupied;
+        }
+    }
+
+    double Elapsed = GetSeconds() - Start;
+    *Checksum = Total;
+
+    return Elapsed*1e9/((double)BENCH_ITERATIONS*BENCH_BOARDS);
+}
+
+void ReportBench(const char* Name, double Generic, unsigned int GenericChecksum, double Fixed, unsigned int FixedChecksum)
+{
+    printf("%-16s generic %7.2f ns  fixed %7.2f ns  speedup %5.2fx%s\n",
+            Name, Generic, Fixed, Generic/Fixed,
+            (GenericChecksum == FixedChecksum) ? "" : "  MISMATCH!");
+}
+
+//Random per tick inputs, with down pressed often enough that games end
+void GenerateBenchInputs(unsigned int* Inputs, RandomSeries* Series)
+{
+    for(unsigned int Index = 0; Index < BENCH_INPUTS; ++Index)
+    {
+        unsigned int Rand = RandomNext(Series);
+        Inputs[Index] = (Rand & (LOCKSTEP_LEFT | LOCKSTEP_RIGHT | LOCKSTEP_ROTATE)) & (Rand >> 8);
+
+        if((Rand >> 16)%3 == 0)
+        {
+            Inputs[Index] |= LOCKSTEP_DOWN;
+        }
+    }
+}
+
+//Ticks per second for one GameData driven through HandleInputGame/UpdateGame,
+//allocating from the heap or from its own session memory
+double BenchUpdateGame(const unsigned int* Inputs, GameMemory* Memory, unsigned int* GamesPlayed, HeapCounters* Heap)
+{
+    GameData Game = {};
+    Game.Random = SeedRandomSeries(1);
+    Game.Memory = Memory;
+    Game = InitialiseGame(Game);
+
+    unsigned int Games = 0;
+    HeapCounters HeapStart = GetHeapCounters();
+    double Start = GetSeconds();
+
+    for(unsigned int Tick = 0; Tick < BENCH_SIM_TICKS; ++Tick)
+    {
+        unsigned int Input = Inputs[Tick%BENCH_INPUTS];
+
+        InputState Inputs = {};
+        Inputs.Left  = (Input & LOCKSTEP_LEFT) != 0;
+        Inputs.Right = (Input & LOCKSTEP_RIGHT) != 0;
+        Inputs.Up    = (Input & LOCKSTEP_ROTATE) != 0;
+        Inputs.Down  = (Input & LOCKSTEP_DOWN) != 0;
+
+        Game = HandleInputGame(Inputs, Game);
+        Game = UpdateGame(Game);
+
+        if(Game.State == GAMEOVER)
+        {
+            Game.Restart = 1;
+            Game = UpdateGameOver(Game);
+            Game = InitialiseGame(Game);
+            ++Games;
+        }
+    }
+
+    double Elapsed = GetSeconds() - Start;
+    *GamesPlayed = Games;
+    *Heap = GetHeapCountersSince(HeapStart);
+
+    DestroyGame(Game);
+
+    return BENCH_SIM_TICKS/Elapsed;
+}
+
+//Game ticks per second (ticks x lanes) for K games in lockstep
+template<unsigned int K>
+double BenchLockstep(const unsigned int* Inputs, unsigned int* GamesPlayed)
+{
+    LockstepGames<K>* Games = (LockstepGames<K>*)malloc(sizeof(LockstepGames<K>));
+
+    for(unsigned int Lane = 0; Lane < K; ++Lane)
+    {
+        SeedLockstepLane(Games, Lane, Lane + 1);
+    }
+
+    unsigned int Played = 0;
+    unsigned int Steps = BENCH_SIM_TICKS/K;
+    double Start = GetSeconds();
+
+    for(unsigned int Step = 0; Step < Steps; ++Step)
+    {
+        //Each lane reads a different stretch of the input table
+        unsigned int LaneInputs[K];
+        for(unsigned int Lane = 0; Lane < K; ++Lane)
+        {
+            LaneInputs[Lane] = Inputs[(Step + Lane*397)%BENCH_INPUTS];
+        }
+
+        unsigned int GameOver = StepLockstepGames(Games, LaneInputs);
+
+        while(GameOver)
+        {
+            unsigned int Lane = CountTrailingZeros(GameOver);
+            InitialiseLockstepLane(Games, Lane);
+            GameOver &= GameOver - 1;
+            ++Played;
+        }
+    }
+
+    double Elapsed = GetSeconds() - Start;
+    *GamesPlayed = Played;
+
+    free(Games);
+
+    return (double)Steps*K/Elapsed;
+}
+
+//Deep copy the way a caller would without snapshots: fresh allocations for
+//the grid and both tetrominoes, copied block by block
+GameData CloneGame(const GameData* Game)
+{
+    GameData Result = *Game;
+
+    Result.MainGrid = GenerateGrid(Game->MainGrid.Rows, Game->MainGrid.Cols);
+    Result.FallingTetro.Grid = GenerateTetrominoGrid(NULL, Game->FallingTetro.GridSize);
+    Result.NextTetro.Grid = GenerateTetrominoGrid(NULL, Game->NextTetro.GridSize);
+
+    CopyGrid(Result.MainGrid, Game->MainGrid);
+    CopyGrid(Result.FallingTetro.Grid, Game->FallingTetro.Grid);
+    CopyGrid(Result.NextTetro.Grid, Game->NextTetro.Grid);
+
+    return Result;
+}
+
+//Plays a game with the bench inputs, keeping a snapshot of every few ticks
+void GenerateBenchSnapshots(const unsigned int* Inputs, GameSnapshot* Snapshots)
+{
+    GameData Game = {};
+    Game.Random = SeedRandomSeries(7);
+    Game = InitialiseGame(Game);
+
+    unsigned int Tick = 0;
+
+    for(unsigned int Index = 0; Index < BENCH_SNAPSHOTS; ++Index)
+    {
+        for(unsigned int Skip = 0; Skip < 13; ++Skip, ++Tick)
+        {
+            unsigned int Input = Inputs[Tick%BENCH_INPUTS];
+
+            InputState TickInputs = {};
+            TickInputs.Left  = (Input & LOCKSTEP_LEFT) != 0;
+            TickInputs.Right = (Input & LOCKSTEP_RIGHT) != 0;
+            TickInputs.Up    = (Input & LOCKSTEP_ROTATE) != 0;
+            TickInputs.Down  = (Input & LOCKSTEP_DOWN) != 0;
+
+            Game = HandleInputGame(TickInputs, Game);
+            Game = UpdateGame(Game);
+
+            if(Game.State == GAMEOVER)
+            {
+                Game.Restart = 1;
+                Game = UpdateGameOver(Game);
+                Game = InitialiseGame(Game);
+            }
+        }
+
+        SaveGameSnapshot(&Game, Snapshots + Index);
+    }
+
+    DestroyGame(Game);
+}
+
+//Nanoseconds per save, load, hash and (for comparison) allocating deep copy
+void BenchSnapshots(const unsigned int* Inputs)
+{
+    GameSnapshot* Snapshots = (GameSnapshot*)malloc(sizeof(GameSnapshot)*BENCH_SNAPSHOTS);
+    GenerateBenchSnapshots(Inputs, Snapshots);
+
+    GameData Game = GenerateGameFromSnapshot(Snapshots);
+    GameSnapshot Saved;
+    unsigned long long Total = 0;
+    double Calls = (double)BENCH_SNAPSHOT_ITERATIONS*BENCH_SNAPSHOTS;
+
+    double Start = GetSeconds();
+    for(unsigned int Iteration = 0; Iteration < BENCH_SNAPSHOT_ITERATIONS; ++Iteration)
+    {
+        for(unsigned int Index = 0; Index < BENCH_SNAPSHOTS; ++Index)
+        {
+            LoadGameSnapshot(Snapshots + Index, &Game);
+            Total += Game.MainGrid.Blocks[(Index*7)%(GRID_ROWS*GRID_COLS)].Occupied;
+        }
+    }
+    double Load = (GetSeconds() - Start)*1e9/Calls;
+
+    Start = GetSeconds();
+    for(unsigned int Iteration = 0; Iteration < BENCH_SNAPSHOT_ITERATIONS; ++Iteration)
+    {
+        for(unsigned int Index = 0; Index < BENCH_SNAPSHOTS; ++Index)
+        {
+            //Alternate which game gets saved so the work can't be hoisted
+            Game.Score = Index;
+            SaveGameSnapshot(&Game, &Saved);
+            Total += Saved.Grid[(Index*7)%(GRID_ROWS*GRID_COLS)].Occupied;
+        }
+    }
+    double Save = (GetSeconds() - Start)*1e9/Calls;
+
+    Start = GetSeconds();
+    for(unsigned int Iteration = 0; Iteration < BENCH_SNAPSHOT_ITERATIONS; ++Iteration)
+    {
+        for(unsigned int Index = 0; Index < BENCH_SNAPSHOTS; ++Index)
+        {
+            Total += HashGameSnapshot(Snapshots + Index);
+        }
+    }
+    double Hash = (GetSeconds() - Start)*1e9/Calls;
+
+    Start = GetSeconds();
+    for(unsigned int Iteration = 0; Iteration < BENCH_SNAPSHOT_ITERATIONS; ++Iteration)
+    {
+        for(unsigned int Index = 0; Index < BENCH_SNAPSHOTS; ++Index)
+        {
+            GameData Clone = CloneGame(&Game);
+            Total += Clone.MainGrid.Blocks[(Index*7)%(GRID_ROWS*GRID_COLS)].Occupied;
+            DestroyGame(Clone);
+        }
+    }
+    double Clone = (GetSeconds() - Start)*1e9/Calls;
+
+    //Every saved snapshot must load and save back to the same bytes
+    unsigned int Mismatches = 0;
+    for(unsigned int Index = 0; Index < BENCH_SNAPSHOTS; ++Index)
+    {
+        LoadGameSnapshot(Snapshots + Index, &Game);
+        SaveGameSnapshot(&Game, &Saved);
+        Mismatches += !GameSnapshotsEqual(Snapshots + Index, &Saved);
+    }
+
+    printf("\nSnapshots: %u bytes each, %d states x %d iterations\n",
+            (unsigned int)sizeof(GameSnapshot), BENCH_SNAPSHOTS, BENCH_SNAPSHOT_ITERATIONS);
+    printf("SaveGameSnapshot %7.2f ns\n", Save);
+    printf("LoadGameSnapshot %7.2f ns\n", Load);
+    printf("HashGameSnapshot %7.2f ns\n", Hash);
+    printf("Deep copy        %7.2f ns  (malloc + copy + free)\n", Clone);
+    printf("(checksum %llu)%s\n", Total, Mismatches ? "  ROUND TRIP MISMATCH!" : "");
+
+    DestroyGame(Game);
+    free(Snapshots);
+}
+
+//Nanoseconds to encode and decode one tick's spectator delta, and its size
+void BenchBroadcast(const unsigned int* Inputs)
+{
+    BroadcastView* Views = (BroadcastView*)malloc(sizeof(BroadcastView)*BENCH_BROADCAST_TICKS);
+
+    GameData Game = {};
+    Game.Random = SeedRandomSeries(11);
+    Game = InitialiseGame(Game);
+
+    for(unsigned int Tick = 0; Tick < BENCH_BROADCAST_TICKS; ++Tick)
+    {
+        unsigned int Input = Inputs[Tick%BENCH_INPUTS];
+
+        InputState TickInputs = {};
+        TickInputs.Left  = (Input & LOCKSTEP_LEFT) != 0;
+        TickInputs.Right = (Input & LOCKSTEP_RIGHT) != 0;
+        TickInputs.Up    = (Input & LOCKSTEP_ROTATE) != 0;
+        TickInputs.Down  = (Input & LOCKSTEP_DOWN) != 0;
+        TickInputs.Space = (Game.State == GAMEOVER);
+
+        Game = SimulateTick(Game, TickInputs);
+
+        GameSnapshot Snapshot;
+        SaveGameSnapshot(&Game, &Snapshot);
+        Views[Tick] = GetBroadcastView(&Snapshot, Tick);
+    }
+
+    DestroyGame(Game);
+
+    unsigned char Ops[BROADCAST_MAX_RECORD];
+    unsigned long long Bytes = 0;
+    unsigned int Deltas = 0;
+    unsigned int Keyframes = 0;
+    unsigned int Mismatches = 0;
+    double Encode = 0.0;
+    double Decode = 0.0;
+
+    for(unsigned int Tick = 1; Tick < BENCH_BROADCAST_TICKS; ++Tick)
+    {
+        unsigned int Size = 0;
+
+        double Start = GetSeconds();
+        bool Encoded = EncodeBroadcastDelta(Views + Tick - 1, Views + Tick, Ops, &Size);
+        Encode += GetSeconds() - Start;
+
+        if(!Encoded)
+        {
+            Keyframes++;
+            continue;
+        }
+
+        if(Size == 0)
+        {
+            continue;
+        }
+
+        BroadcastView Decoded = Views[Tick - 1];
+
+        Start = GetSeconds();
+        Mismatches += !ApplyBroadcastDelta(&Decoded, Ops, Size);
+        Decode += GetSeconds() - Start;
+
+        Decoded.Tick = Tick;
+        Mismatches += !BroadcastViewsEqual(&Decoded, Views + Tick);
+
+        Deltas++;
+        Bytes += AlignRecord(sizeof(BroadcastRecordHeader) + Size);
+    }
+
+    printf("\nBroadcast: %d ticks, %u deltas, %u keyframes (restarts)\n", BENCH_BROADCAST_TICKS, Deltas, Keyframes);
+    printf("Encode           %7.2f ns per tick\n", Encode*1e9/(BENCH_BROADCAST_TICKS - 1));
+    printf("Decode           %7.2f ns per delta\n", Decode*1e9/(Deltas ? Deltas : 1));
+    printf("Delta record     %7.2f bytes  (keyframe %u, snapshot %u)%s\n", (double)Bytes/(Deltas ? Deltas : 1),
+            AlignRecord(sizeof(BroadcastRecordHeader) + sizeof(BroadcastView)), (unsigned int)sizeof(GameSnapshot),
+            Mismatches ? "  DECODE MISMATCH!" : "");
+
+    free(Views);
+}
+
+//Everything a running game does each tick and each frame, none of which
+//should touch the heap once the game has its memory. Returns false if any of
+//it did.
+bool CheckSteadyStateAllocations(const unsigned int* Inputs)
+{
+    GameMemory Memory = GenerateGameMemory();
+
+    GameData Game = {};
+    Game.Memory = &Memory;
+    Game.Random = SeedRandomSeries(13);
+    Game = InitialiseGame(Game);
+
+    GameSnapshot Snapshot;
+    SaveGameSnapshot(&Game, &Snapshot);
+
+    GameData Render = GenerateGameFromSnapshot(&Snapshot);
+    BroadcastView Previous = GetBroadcastView(&Snapshot, 0);
+    unsigned char Ops[BROADCAST_MAX_RECORD];
+
+    HeapCounters Tick = {};
+    HeapCounters Snapshots = {};
+    HeapCounters Broadcast = {};
+    unsigned int Games = 0;
+
+    for(unsigned int Index = 1; Index < BENCH_STEADY_TICKS; ++Index)
+    {
+        unsigned int Input = Inputs[Index%BENCH_INPUTS];
+
+        InputState TickInputs = {};
+        TickInputs.Left  = (Input & LOCKSTEP_LEFT) != 0;
+        TickInputs.Right = (Input & LOCKSTEP_RIGHT) != 0;
+        TickInputs.Up    = (Input & LOCKSTEP_ROTATE) != 0;
+        TickInputs.Down  = (Input & LOCKSTEP_DOWN) != 0;
+        TickInputs.Space = (Game.State == GAMEOVER);
+
+        Games += (Game.State == GAMEOVER);
+
+        HeapCounters Start = GetHeapCounters();
+        Game = SimulateTick(Game, TickInputs);
+        Tick.Allocations += GetHeapCountersSince(Start).Allocations;
+
+        Start = GetHeapCounters();
+        SaveGameSnapshot(&Game, &Snapshot);
+        LoadGameSnapshot(&Snapshot, &Render);
+        Snapshots.Allocations += GetHeapCountersSince(Start).Allocations;
+
+        Start = GetHeapCounters();
+        BroadcastView Current = GetBroadcastView(&Snapshot, Index);
+        unsigned int Size = 0;
+
+        if( EncodeBroadcastDelta(&Previous, &Current, Ops, &Size) && Size )
+        {
+            ApplyBroadcastDelta(&Previous, Ops, Size);
+        }
+
+        Previous = Current;
+        Broadcast.Allocations += GetHeapCountersSince(Start).Allocations;
+    }
+
+    DestroyGame(Render);
+    DestroyGameMemory(Memory);
+
+    printf("\nSteady state heap allocations: %d ticks, %u restarts\n", BENCH_STEADY_TICKS, Games);
+    printf("SimulateTick     %7llu\n", Tick.Allocations);
+    printf("Snapshot round trip %4llu\n", Snapshots.Allocations);
+    printf("Broadcast delta  %7llu\n", Broadcast.Allocations);
+
+    return (Tick.Allocations + Snapshots.Allocations + Broadcast.Allocations) == 0;
+}
+
+int main( int argc, char* args[] )
+{
+    unsigned int Seed = (argc > 1) ? atoi(args[1]) : 1;
+    srand(Seed);
+    RandomSeries Series = SeedRandomSeries(Seed);
+
+    BenchCase* Cases = (BenchCase*)malloc(sizeof(BenchCase)*BENCH_BOARDS);
+
+    for(unsigned int Index = 0; Index < BENCH_BOARDS; ++Index)
+    {
+        Cases[Index].Board = GenerateBenchBoard();
+        Cases[Index].Tetro = GenerateTetromino(&Series, NULL);
+
+        //Mostly legal positions, with a few hanging off the edges
+        Cases[Index].Tetro.Row = rand()%(GRID_ROWS - 2);
+        Cases[Index].Tetro.Col = (rand()%(GRID_COLS + 2)) - 1;
+
+        for(unsigned int Rotations = rand()%4; Rotations > 0; --Rotations)
+        {
+            Tetromino Rotated = RotateTetroClockwise(Cases[Index].Tetro);
+
+            if(Rotated.Grid.Blocks != Cases[Index].Tetro.Grid.Blocks)
+            {
+                DestroyTetromino(Cases[Index].Tetro);
+            }
+
+            Cases[Index].Tetro = Rotated;
+        }
+    }
+
+    //Only store pieces where they actually fit
+    BenchCase* StoreCases = (BenchCase*)malloc(sizeof(BenchCase)*BENCH_BOARDS);
+
+    for(unsigned int Index = 0; Index < BENCH_BOARDS; ++Index)
+    {
+        StoreCases[Index] = Cases[Index];
+
+        while(CheckCollisionsGeneric(StoreCases[Index].Board, StoreCases[Index].Tetro))
+        {
+            StoreCases[Index].Tetro.Row = rand()%(GRID_ROWS - 3);
+            StoreCases[Index].Tetro.Col = rand()%(GRID_COLS - 3);
+
+            //Give up and use an empty board
+            if((rand()%8) == 0)
+            {
+                memset(StoreCases[Index].Board.Blocks, 0, sizeof(Block)*GRID_ROWS*GRID_COLS);
+            }
+        }
+    }
+
+    BlockGrid Scratch = GenerateGrid(GRID_ROWS, GRID_COLS);
+
+    printf("Rule benchmarks: %dx%d board, %d cases x %d iterations, seed %u\n",
+            GRID_COLS, GRID_ROWS, BENCH_BOARDS, BENCH_ITERATIONS, Seed);
+
+    unsigned int GenericChecksum = 0;
+    unsigned int FixedChecksum = 0;
+
+    double Generic = BenchCollisions(Cases, CheckCollisionsGeneric, &GenericChecksum);
+    double Fixed   = BenchCollisions(Cases, CheckCollisionsFixed<GRID_ROWS, GRID_COLS>, &FixedChecksum);
+    ReportBench("CheckCollisions", Generic, GenericChecksum, Fixed, FixedChecksum);
+
+    unsigned int CopyChecksum = 0;
+    double Copy = BenchCopy(Cases, Scratch, &CopyChecksum);
+    printf("(board reset baseline %.2f ns, subtracted below)\n", Copy);
+
+    Generic = BenchStore(StoreCases, Scratch, StoreTetrominoGeneric, &GenericChecksum) - Copy;
+    Fixed   = BenchStore(StoreCases, Scratch, StoreTetrominoFixed<GRID_ROWS, GRID_COLS>, &FixedChecksum) - Copy;
+    ReportBench("StoreTetromino", Generic, GenericChecksum, Fixed, FixedChecksum);
+
+    Generic = BenchRemoveLines(Cases, Scratch, RemoveGridLinesGeneric, &GenericChecksum) - Copy;
+    Fixed   = BenchRemoveLines(Cases, Scratch, RemoveGridLinesFixed<GRID_ROWS, GRID_COLS>, &FixedChecksum) - Copy;
+    ReportBench("RemoveGridLines", Generic, GenericChecksum, Fixed, FixedChecksum);
+
+    //Whole game ticks, one game at a time against lockstep lanes
+    BuildLockstepShapes();
+
+    unsigned int* SimInputs = (unsigned int*)malloc(sizeof(unsigned int)*BENCH_INPUTS);
+    GenerateBenchInputs(SimInputs, &Series);
+
+    printf("\nSimulation throughput: %d game ticks each\n", BENCH_SIM_TICKS);
+
+    unsigned int GamesPlayed = 0;
+    HeapCounters Heap;
+    double Reference = BenchUpdateGame(SimInputs, NULL, &GamesPlayed, &Heap);
+    printf("UpdateGame       %8.2f M ticks/s  (%u games)  %llu heap allocations\n", Reference/1e6, GamesPlayed,
+            Heap.Allocations);
+
+    GameMemory Memory = GenerateGameMemory();
+    double Arena = BenchUpdateGame(SimInputs, &Memory, &GamesPlayed, &Heap);
+    printf("UpdateGame arena %8.2f M ticks/s  (%u games)  %5.2fx  (%u bytes of session memory, %llu heap allocations)\n",
+            Arena/1e6, GamesPlayed, Arena/Reference, (unsigned int)Memory.Session.Used, Heap.Allocations);
+    DestroyGameMemory(Memory);
+
+    double Lockstep = BenchLockstep<8>(SimInputs, &GamesPlayed);
+    printf("Lockstep x8      %8.2f M ticks/s  (%u games)  %5.2fx\n", Lockstep/1e6, GamesPlayed, Lockstep/Reference);
+
+    Lockstep = BenchLockstep<16>(SimInputs, &GamesPlayed);
+    printf("Lockstep x16     %8.2f M ticks/s  (%u games)  %5.2fx\n", Lockstep/1e6, GamesPlayed, Lockstep/Reference);
+
+    BenchSnapshots(SimInputs);
+    BenchBroadcast(SimInputs);
+
+    if( !CheckSteadyStateAllocations(SimInputs) )
+    {
+        printf("STEADY STATE HEAP ALLOCATIONS!\n");
+        return 1;
+    }
+
+    return 0;
+}
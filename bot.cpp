@@ -0,0 +1,303 @@
+#include <string.h>
+
+#include "bot.h"
+
+/*
+ * Board Features
+ */
+
+inline unsigned int PopCount(unsigned int Value)
+{
+#if defined(_MSC_VER)
+    return __popcnt(Value);
+#else
+    return __builtin_popcount(Value);
+#endif
+}
+
+//Clears full rows in place, returns how many there were
+unsigned int ClearBotRows(unsigned int* RowMasks)
+{
+    unsigned int FullRowCount = 0;
+
+    for(unsigned int Row = (GRID_ROWS-1); Row < GRID_ROWS; --Row)
+    {
+        if(RowMasks[Row] == LOCKSTEP_SOLID_ROW)
+        {
+            FullRowCount++;
+        }
+        else if(FullRowCount)
+        {
+            RowMasks[Row + FullRowCount] = RowMasks[Row];
+        }
+    }
+
+    for(unsigned int Row = 0; Row < FullRowCount; ++Row)
+    {
+        RowMasks[Row] = LOCKSTEP_EMPTY_ROW;
+    }
+
+    return FullRowCount;
+}
+
+float ScoreBotBoard(const unsigned int* RowMasks, unsigned int Lines, BotWeights Weights)
+{
+    const unsigned int Columns = (1u << GRID_COLS) - 1;
+
+    unsigned int Heights[GRID_COLS] = {0};
+    unsigned int Seen = 0;
+    unsigned int Holes = 0;
+    unsigned int TotalHeight = 0;
+
+    //Top down: a column's height is set by the first block in it, and every
+    //gap under that is a hole
+    for(unsigned int Row = 0; Row < GRID_ROWS; ++Row)
+    {
+        unsigned int Cells = (RowMasks[Row] >> LOCKSTEP_WALL) & Columns;
+        unsigned int Tops = Cells & ~Seen;
+
+        Holes += PopCount(~Cells & Seen & Columns);
+        TotalHeight += PopCount(Tops)*(GRID_ROWS - Row);
+
+        while(Tops)
+        {
+            unsigned int Col = CountTrailingZeros(Tops);
+            Heights[Col] = GRID_ROWS - Row;
+            Tops &= Tops - 1;
+        }
+
+        Seen |= Cells;
+    }
+
+    unsigned int Bumpiness = 0;
+
+    for(unsigned int Col = 1; Col < GRID_COLS; ++Col)
+    {
+        Bumpiness += (Heights[Col] > Heights[Col-1]) ? Heights[Col] - Heights[Col-1] : Heights[Col-1] - Heights[Col];
+    }
+
+    return Weights.Height*TotalHeight + Weights.Lines*Lines + Weights.Holes*Holes + Weights.Bumpiness*Bumpiness;
+}
+
+/*
+ * Planning
+ */
+
+//Tuned by hand for this ruleset, a good starting point for anything smarter
+BotWeights DefaultBotWeights()
+{
+    BotWeights Result;
+
+    Result.Height       = -0.51f;
+    Result.Lines        =  0.76f;
+    Result.Holes        = -0.36f;
+    Result.Bumpiness    = -0.18f;
+
+    return Result;
+}
+
+inline bool BotCollides(const unsigned int* RowMasks, const unsigned int* Shape, int Row, int Col)
+{
+    unsigned int Shift = Col + LOCKSTEP_WALL;
+    unsigned int Hit = 0;
+
+    for(int Row2 = 0; Row2 < TETROMINO_MAX_SIZE; ++Row2)
+    {
+        Hit |= RowMasks[Row + Row2] & (Shape[Row2] << Shift);
+    }
+
+    return Hit != 0;
+}
+
+//Every placement reachable from where the piece is now: rotate in place,
+//slide across, then drop. RowMasks is a LOCKSTEP_ROWS board as LockstepGames
+//holds one lane. Returns how many were written to Placements.
+unsigned int ListBotPlacements(const unsigned int* RowMasks, unsigned int Type, unsigned int Rotation, int Row, int Col,
+                               BotPlacement* Placements)
+{
+    BuildLockstepShapes();
+
+    unsigned int Count = 0;
+
+    //The O shape never rotates
+    unsigned int Rotations = (Type == O_SHAPE) ? 1 : (unsigned int)LOCKSTEP_ROTATIONS;
+
+    for(unsigned int Turns = 0; Turns < Rotations; ++Turns)
+    {
+        unsigned int Target = (Rotation + Turns) & (LOCKSTEP_ROTATIONS-1);
+        const unsigned int* Shape = LockstepShapes.Rows[Type][Target];
+
+        //Every rotation on the way has to fit where the piece is
+        bool Blocked = false;
+
+        for(unsigned int Turn = 1; (Turn <= Turns) && !Blocked; ++Turn)
+        {
+            unsigned int Step = (Rotation + Turn) & (LOCKSTEP_ROTATIONS-1);
+            Blocked = BotCollides(RowMasks, LockstepShapes.Rows[Type][Step], Row, Col);
+        }
+
+        if(Blocked)
+        {
+            continue;
+        }
+
+        //Then slide out each way until something's in the way
+        for(int Direction = -1; Direction <= 1; Direction += 2)
+        {
+            for(int TargetCol = (Direction < 0) ? Col : Col + 1; ; TargetCol += Direction)
+            {
+                if( (TargetCol < -(int)LOCKSTEP_WALL) || BotCollides(RowMasks, Shape, Row, TargetCol) )
+                {
+                    break;
+                }
+
+                int LandingRow = Row;
+
+                while(!BotCollides(RowMasks, Shape, LandingRow + 1, TargetCol))
+                {
+                    ++LandingRow;
+                }
+
+                Placements[Count].Rotation = Target;
+                Placements[Count].Col = TargetCol;
+                Placements[Count].Row = LandingRow;
+                ++Count;
+            }
+        }
+    }
+
+    return Count;
+}
+
+BotMove PlanBotMoveMasks(const unsigned int* RowMasks, unsigned int Type, unsigned int Rotation, int Row, int Col,
+                         BotWeights Weights)
+{
+    BotMove Result;
+    memset(&Result, 0, sizeof(Result));
+
+    BotPlacement Placements[BOT_MAX_PLACEMENTS];
+    unsigned int Count = ListBotPlacements(RowMasks, Type, Rotation, Row, Col, Placements);
+
+    unsigned int Scratch[LOCKSTEP_ROWS];
+
+    for(unsigned int Index = 0; Index < Count; ++Index)
+    {
+        const BotPlacement* Placement = Placements + Index;
+        const unsigned int* Shape = LockstepShapes.Rows[Type][Placement->Rotation];
+
+        memcpy(Scratch, RowMasks, sizeof(Scratch));
+
+        for(unsigned int Row2 = 0; Row2 < TETROMINO_MAX_SIZE; ++Row2)
+        {
+            Scratch[Placement->Row + Row2] |= Shape[Row2] << (Placement->Col + LOCKSTEP_WALL);
+        }
+
+        unsigned int Lines = ClearBotRows(Scratch);
+        float Score = ScoreBotBoard(Scratch, Lines, Weights);
+
+        if( !Result.Valid || (Score > Result.Score) )
+        {
+            Result.Valid = true;
+            Result.Rotation = Placement->Rotation;
+            Result.Col = Placement->Col;
+            Result.Score = Score;
+        }
+    }
+
+    return Result;
+}
+
+//LockstepInput bits that take a piece one tick closer to a planned move:
+//rotate first, then slide, then drop
+unsigned int SteerBotMove(BotMove Move, unsigned int Rotation, int Col)
+{
+    if(!Move.Valid)
+    {
+        return LOCKSTEP_DOWN;
+    }
+
+    if(Move.Rotation != Rotation)
+    {
+        return LOCKSTEP_ROTATE;
+    }
+
+    if(Move.Col < Col)
+    {
+        return LOCKSTEP_LEFT;
+    }
+
+    if(Move.Col > Col)
+    {
+        return LOCKSTEP_RIGHT;
+    }
+
+    return LOCKSTEP_DOWN;
+}
+
+unsigned int GetBotInputMasks(const unsigned int* RowMasks, unsigned int Type, unsigned int Rotation, int Row, int Col,
+                              BotWeights Weights)
+{
+    return SteerBotMove(PlanBotMoveMasks(RowMasks, Type, Rotation, Row, Col, Weights), Rotation, Col);
+}
+
+/*
+ * GameData
+ */
+
+//Converts the main grid to row masks and says which rotation of its shape
+//the falling piece is in
+void GetBotBoard(GameData Game, unsigned int* RowMasks, unsigned int* Rotation)
+{
+    BuildLockstepShapes();
+
+    for(unsigned int Row = 0; Row < LOCKSTEP_ROWS; ++Row)
+    {
+        unsigned int Mask = (Row < GRID_ROWS) ? LOCKSTEP_EMPTY_ROW : LOCKSTEP_SOLID_ROW;
+
+        for(unsigned int Col = 0; (Row < GRID_ROWS) && (Col < GRID_COLS); ++Col)
+        {
+            if(GetBlock(Game.MainGrid, Row, Col)->Occupied)
+            {
+                Mask |= 1u << (Col + LOCKSTEP_WALL);
+            }
+        }
+
+        RowMasks[Row] = Mask;
+    }
+
+    //The piece table numbers the tetrominoes' rotations as the lockstep
+    //shapes do
+    *Rotation = Game.FallingTetro.Rotation;
+}
+
+//Only meaningful while the game is RUNNING on a standard sized grid
+BotMove PlanBotMove(GameData Game, BotWeights Weights)
+{
+    unsigned int RowMasks[LOCKSTEP_ROWS];
+    unsigned int Rotation = 0;
+
+    GetBotBoard(Game, RowMasks, &Rotation);
+
+    return PlanBotMoveMasks(RowMasks, Game.FallingTetro.Type, Rotation, Game.FallingTetro.Row, Game.FallingTetro.Col, Weights);
+}
+
+InputState GetBotInputs(GameData Game, BotWeights Weights)
+{
+    unsigned int RowMasks[LOCKSTEP_ROWS];
+    unsigned int Rotation = 0;
+
+    GetBotBoard(Game, RowMasks, &Rotation);
+
+    unsigned int Input = GetBotInputMasks(RowMasks, Game.FallingTetro.Type, Rotation,
+                                          Game.FallingTetro.Row, Game.FallingTetro.Col, Weights);
+
+    InputState Result;
+    memset(&Result, 0, sizeof(Result));
+
+    Result.Up       = (Input & LOCKSTEP_ROTATE) != 0;
+    Result.Down     = (Input & LOCKSTEP_DOWN) != 0;
+    Result.Left     = (Input & LOCKSTEP_LEFT) != 0;
+    Result.Right    = (Input & LOCKSTEP_RIGHT) != 0;
+
+    return Result;
+}
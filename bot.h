@@ -0,0 +1,63 @@
+#ifndef BOT_H
+#define BOT_H
+
+#include "lockstep.h"
+
+/*
+ * Bot
+ *
+ * A one piece lookahead player. Every placement of the falling piece that can
+ * be reached from where it is now (rotate in place, slide across, drop) is
+ * scored on the board it would leave behind, and the bot steers towards the
+ * best one a key per tick. It plans again every tick, so gravity or a blocked
+ * move just means picking from what's still reachable.
+ *
+ * Boards are worked on as lockstep style row masks (walls either side, solid
+ * floor), using the same shape table, so it can drive a GameData or a lane of
+ * LockstepGames alike.
+ */
+
+//Multiplied with each feature of the board left behind, higher totals win
+struct BotWeights{
+    float Height;       //Sum of column heights
+    float Lines;        //Lines cleared by the placement
+    float Holes;        //Empty cells with a block somewhere above them
+    float Bumpiness;    //Sum of height differences between neighbouring columns
+};
+
+struct BotMove{
+    bool Valid;
+    unsigned int Rotation;  //Absolute, as in LockstepShapes
+    int Col;
+    float Score;
+};
+
+//Where a piece can come to rest
+struct BotPlacement{
+    unsigned int Rotation;  //Absolute, as in LockstepShapes
+    int Col;
+    int Row;
+};
+
+enum BotConstants{
+    //Four rotations of a piece fitting at most a few more than GRID_COLS ways
+    BOT_MAX_PLACEMENTS = 64
+};
+
+BotWeights  DefaultBotWeights();
+
+unsigned int ClearBotRows(unsigned int* RowMasks);
+unsigned int ListBotPlacements(const unsigned int* RowMasks, unsigned int Type, unsigned int Rotation, int Row, int Col,
+                               BotPlacement* Placements);
+
+BotMove     PlanBotMoveMasks(const unsigned int* RowMasks, unsigned int Type, unsigned int Rotation, int Row, int Col,
+                             BotWeights Weights);
+unsigned int SteerBotMove(BotMove Move, unsigned int Rotation, int Col);
+unsigned int GetBotInputMasks(const unsigned int* RowMasks, unsigned int Type, unsigned int Rotation, int Row, int Col,
+                              BotWeights Weights);
+
+void        GetBotBoard(GameData Game, unsigned int* RowMasks, unsigned int* Rotation);
+BotMove     PlanBotMove(GameData Game, BotWeights Weights);
+InputState  GetBotInputs(GameData Game, BotWeights Weights);
+
+#endif
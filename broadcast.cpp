@@ -0,0 +1,874 @@
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "broadcast.h"
+
+/*
+ * View Encoding
+ */
+
+unsigned short GetShapeMask(const Block* Blocks, unsigned int GridSize, unsigned char* Colour)
+{
+    unsigned short Result = 0;
+
+    for(unsigned int Row = 0; Row < GridSize; ++Row)
+    {
+        for(unsigned int Col = 0; Col < GridSize; ++Col)
+        {
+            const Block* CurrentBlock = Blocks + Row*GridSize + Col;
+
+            if(CurrentBlock->Occupied)
+            {
+                Result |= (unsigned short)(1 << (Row*TETROMINO_MAX_SIZE + Col));
+                *Colour = CurrentBlock->Colour;
+            }
+        }
+    }
+
+    return Result;
+}
+
+BroadcastView GetBroadcastView(const GameSnapshot* Snapshot, unsigned int Tick)
+{
+    BroadcastView Result;
+    memset(&Result, 0, sizeof(Result));
+
+    Result.Tick     = Tick;
+    Result.Score    = Snapshot->Score;
+    Result.State    = Snapshot->State;
+
+    const SnapshotTetromino* Falling = &Snapshot->FallingTetro;
+    const SnapshotTetromino* Next = &Snapshot->NextTetro;
+
+    Result.Piece        = Falling->Type;
+    Result.PieceSize    = Falling->GridSize;
+    Result.PieceRow     = (signed char)Falling->Row;
+    Result.PieceCol     = (signed char)Falling->Col;
+    Result.PieceShape   = GetShapeMask(Falling->Blocks, Falling->GridSize, &Result.PieceColour);
+
+    Result.NextPiece    = Next->Type;
+    Result.NextSize     = Next->GridSize;
+    Result.NextShape    = GetShapeMask(Next->Blocks, Next->GridSize, &Result.NextColour);
+
+    const Block* CurrentBlock = Snapshot->Grid;
+
+    for(unsigned int Row = 0; Row < GRID_ROWS; ++Row)
+    {
+        unsigned short Mask = 0;
+
+        for(unsigned int Col = 0; Col < GRID_COLS; ++Col)
+        {
+            if(CurrentBlock->Occupied)
+            {
+                Mask |= (unsigned short)(1 << Col);
+                Result.Colours[Row*GRID_COLS + Col] = CurrentBlock->Colour;
+            }
+
+            ++CurrentBlock;
+        }
+
+        Result.Rows[Row] = Mask;
+    }
+
+    return Result;
+}
+
+bool BroadcastViewsEqual(const BroadcastView* A, const BroadcastView* B)
+{
+    return memcmp(A, B, sizeof(BroadcastView)) == 0;
+}
+
+bool BroadcastGridsEqual(const BroadcastView* A, const BroadcastView* B)
+{
+    return (memcmp(A->Rows, B->Rows, sizeof(A->Rows)) == 0) &&
+           (memcmp(A->Colours, B->Colours, sizeof(A->Colours)) == 0);
+}
+
+//Stores the falling piece at Row, Col and removes any full rows, the way
+//UpdateGame does when the piece lands. False if the piece doesn't fit there.
+bool LockBroadcastPiece(BroadcastView* View, int Row, int Col, unsigned int* ClearedRows)
+{
+    for(unsigned int Bit = 0; Bit < TETROMINO_MAX_SIZE*TETROMINO_MAX_SIZE; ++Bit)
+    {
+        if( !(View->PieceShape & (1 << Bit)) )
+        {
+            continue;
+        }
+
+        int BlockRow = Row + (int)(Bit/TETROMINO_MAX_SIZE);
+        int BlockCol = Col + (int)(Bit%TETROMINO_MAX_SIZE);
+
+        if( (BlockRow < 0) || (BlockRow >= GRID_ROWS) || (BlockCol < 0) || (BlockCol >= GRID_COLS) ||
+            (View->Rows[BlockRow] & (1 << BlockCol)) )
+        {
+            return false;
+        }
+
+        View->Rows[BlockRow] |= (unsigned short)(1 << BlockCol);
+        View->Colours[BlockRow*GRID_COLS + BlockCol] = View->PieceColour;
+    }
+
+    //Same as RemoveGridLines: everything above a full row drops down
+    unsigned int Cleared = 0;
+    unsigned int FullRowCount = 0;
+
+    for(int CurrentRow = GRID_ROWS - 1; CurrentRow >= 0; --CurrentRow)
+    {
+        if(View->Rows[CurrentRow] == (1 << GRID_COLS) - 1)
+        {
+            Cleared |= 1u << CurrentRow;
+            FullRowCount++;
+        }
+        else if(FullRowCount)
+        {
+            View->Rows[CurrentRow + FullRowCount] = View->Rows[CurrentRow];
+            memcpy(View->Colours + (CurrentRow + FullRowCount)*GRID_COLS, View->Colours + CurrentRow*GRID_COLS, GRID_COLS);
+        }
+    }
+
+    memset(View->Rows, 0, sizeof(View->Rows[0])*FullRowCount);
+    memset(View->Colours, 0, GRID_COLS*FullRowCount);
+
+    *ClearedRows = Cleared;
+
+    return true;
+}
+
+//The next piece becomes the falling one at Row, Col
+void SpawnBroadcastPiece(BroadcastView* View, int Row, int Col, unsigned int NextPiece, unsigned int NextColour,
+                         unsigned int NextSize, unsigned int NextShape)
+{
+    View->Piece         = View->NextPiece;
+    View->PieceColour   = View->NextColour;
+    View->PieceSize     = View->NextSize;
+    View->PieceShape    = View->NextShape;
+    View->PieceRow      = (signed char)Row;
+    View->PieceCol      = (signed char)Col;
+
+    View->NextPiece     = (unsigned char)NextPiece;
+    View->NextColour    = (unsigned char)NextColour;
+    View->NextSize      = (unsigned char)NextSize;
+    View->NextShape     = (unsigned short)NextShape;
+}
+
+/*
+ * Delta Ops
+ *
+ * The encoder builds the ops by applying each one to a copy of the previous
+ * view as it goes, with the same functions the decoder uses, and only sends a
+ * delta if that copy ends up identical to the current view. Anything it
+ * doesn't recognise becomes a keyframe rather than a delta that decodes wrong.
+ */
+
+unsigned char* PutByte(unsigned char* Out, unsigned int Value)
+{
+    *Out = (unsigned char)Value;
+    return Out + 1;
+}
+
+unsigned char* PutShort(unsigned char* Out, unsigned int Value)
+{
+    unsigned short Short = (unsigned short)Value;
+    memcpy(Out, &Short, sizeof(Short));
+    return Out + sizeof(Short);
+}
+
+unsigned char* PutInt(unsigned char* Out, unsigned int Value)
+{
+    memcpy(Out, &Value, sizeof(Value));
+    return Out + sizeof(Value);
+}
+
+//False if Current can't be reached from Previous with ops, and needs a
+//keyframe. Size is 0 when nothing visible changed.
+bool EncodeBroadcastDelta(const BroadcastView* Previous, const BroadcastView* Current, unsigned char* Ops, unsigned int* Size)
+{
+    BroadcastView Working = *Previous;
+    Working.Tick = Current->Tick;
+
+    unsigned char* Out = Ops;
+
+    bool NewPiece = (Working.NextPiece != Current->NextPiece) || (Working.NextColour != Current->NextColour) ||
+                    (Working.NextShape != Current->NextShape) || (Working.Piece != Current->Piece) ||
+                    (Working.PieceColour != Current->PieceColour);
+
+    if( NewPiece || !BroadcastGridsEqual(&Working, Current) )
+    {
+        //The piece landed. It can only have moved sideways on the tick
+        //it locked, as the rotation comes after the new piece spawns.
+        static const int Slides[] = {0, -1, 1};
+        bool Locked = false;
+
+        for(unsigned int Slide = 0; !Locked && (Slide < 3); ++Slide)
+        {
+            BroadcastView Landed = Working;
+            int Row = Working.PieceRow;
+            int Col = Working.PieceCol + Slides[Slide];
+            unsigned int ClearedRows;
+
+            if( LockBroadcastPiece(&Landed, Row, Col, &ClearedRows) && BroadcastGridsEqual(&Landed, Current) )
+            {
+                Out = PutByte(Out, BROADCAST_OP_LOCK);
+                Out = PutByte(Out, (unsigned char)Row);
+                Out = PutByte(Out, (unsigned char)Col);
+                Out = PutInt(Out, ClearedRows);
+
+                Working = Landed;
+                Locked = true;
+            }
+        }
+
+        if(!Locked)
+        {
+            return false;
+        }
+
+        SpawnBroadcastPiece(&Working, Current->PieceRow, Current->PieceCol, Current->NextPiece,
+                            Current->NextColour, Current->NextSize, Current->NextShape);
+
+        Out = PutByte(Out, BROADCAST_OP_SPAWN);
+        Out = PutByte(Out, (unsigned char)Current->PieceRow);
+        Out = PutByte(Out, (unsigned char)Current->PieceCol);
+        Out = PutByte(Out, Current->NextPiece);
+        Out = PutByte(Out, Current->NextColour);
+        Out = PutByte(Out, Current->NextSize);
+        Out = PutShort(Out, Current->NextShape);
+    }
+
+    if( (Working.PieceRow != Current->PieceRow) || (Working.PieceCol != Current->PieceCol) )
+    {
+        Working.PieceRow = Current->PieceRow;
+        Working.PieceCol = Current->PieceCol;
+
+        Out = PutByte(Out, BROADCAST_OP_MOVE);
+        Out = PutByte(Out, (unsigned char)Current->PieceRow);
+        Out = PutByte(Out, (unsigned char)Current->PieceCol);
+    }
+
+    if(Working.PieceShape != Current->PieceShape)
+    {
+        Working.PieceShape = Current->PieceShape;
+
+        Out = PutByte(Out, BROADCAST_OP_ROTATE);
+        Out = PutShort(Out, Current->PieceShape);
+    }
+
+    if(Working.Score != Current->Score)
+    {
+        Working.Score = Current->Score;
+
+        Out = PutByte(Out, BROADCAST_OP_SCORE);
+        Out = PutInt(Out, Current->Score);
+    }
+
+    if(Working.State != Current->State)
+    {
+        Working.State = Current->State;
+
+        Out = PutByte(Out, BROADCAST_OP_STATE);
+        Out = PutByte(Out, Current->State);
+    }
+
+    *Size = (unsigned int)(Out - Ops);
+
+    return BroadcastViewsEqual(&Working, Current);
+}
+
+//False if the ops are malformed or don't apply, View is then undefined
+bool ApplyBroadcastDelta(BroadcastView* View, const unsigned char* Ops, unsigned int Size)
+{
+    const unsigned char* End = Ops + Size;
+
+    while(Ops < End)
+    {
+        unsigned int Op = *Ops++;
+        unsigned int Remaining = (unsigned int)(End - Ops);
+
+        switch(Op)
+        {
+            case BROADCAST_OP_MOVE:
+                {
+                    if(Remaining < 2)
+                    {
+                        return false;
+                    }
+
+                    View->PieceRow = (signed char)Ops[0];
+                    View->PieceCol = (signed char)Ops[1];
+                    Ops += 2;
+                }
+                break;
+            case BROADCAST_OP_ROTATE:
+                {
+                    if(Remaining < 2)
+                    {
+                        return false;
+                    }
+
+                    memcpy(&View->PieceShape, Ops, sizeof(View->PieceShape));
+                    Ops += 2;
+                }
+                break;
+            case BROADCAST_OP_LOCK:
+                {
+                    if(Remaining < 6)
+                    {
+                        return false;
+                    }
+
+                    unsigned int Expected;
+                    unsigned int ClearedRows;
+                    memcpy(&Expected, Ops + 2, sizeof(Expected));
+
+                    if( !LockBroadcastPiece(View, (signed char)Ops[0], (signed char)Ops[1], &ClearedRows) ||
+                        (ClearedRows != Expected) )
+                    {
+                        return false;
+                    }
+
+                    Ops += 6;
+                }
+                break;
+            case BROADCAST_OP_SPAWN:
+                {
+                    if(Remaining < 7)
+                    {
+                        return false;
+                    }
+
+                    unsigned short NextShape;
+                    memcpy(&NextShape, Ops + 5, sizeof(NextShape));
+
+                    SpawnBroadcastPiece(View, (signed char)Ops[0], (signed char)Ops[1], Ops[2], Ops[3], Ops[4], NextShape);
+                    Ops += 7;
+                }
+                break;
+            case BROADCAST_OP_SCORE:
+                {
+                    if(Remaining < 4)
+                    {
+                        return false;
+                    }
+
+                    memcpy(&View->Score, Ops, sizeof(View->Score));
+                    Ops += 4;
+                }
+                break;
+            case BROADCAST_OP_STATE:
+                {
+                    if(Remaining < 1)
+                    {
+                        return false;
+                    }
+
+                    View->State = Ops[0];
+                    Ops += 1;
+                }
+                break;
+            default:
+                return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Shared Memory
+ *
+ * One mapping per broadcast name: a POSIX shared memory object, or a named
+ * file mapping on Windows. The publisher creates it, replacing any left
+ * behind by one that crashed, and removes it when it closes.
+ */
+
+bool CreateBroadcastMapping(const char* Name, size_t Size, BroadcastMapping* Mapping)
+{
+    memset(Mapping, 0, sizeof(*Mapping));
+
+#if defined(_WIN32)
+    snprintf(Mapping->Name, sizeof(Mapping->Name), "Local\\agafb-%s", Name);
+
+    HANDLE Handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)Size, Mapping->Name);
+
+    if(Handle == NULL)
+    {
+        return false;
+    }
+
+    void* Memory = MapViewOfFile(Handle, FILE_MAP_ALL_ACCESS, 0, 0, Size);
+
+    if(Memory == NULL)
+    {
+        CloseHandle(Handle);
+        return false;
+    }
+
+    Mapping->Handle = Handle;
+#else
+    snprintf(Mapping->Name, sizeof(Mapping->Name), "/agafb-%s", Name);
+
+    shm_unlink(Mapping->Name);
+
+    int File = shm_open(Mapping->Name, O_RDWR | O_CREAT | O_EXCL, 0644);
+
+    if(File < 0)
+    {
+        return false;
+    }
+
+    void* Memory = MAP_FAILED;
+
+    if(ftruncate(File, (off_t)Size) == 0)
+    {
+        Memory = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_SHARED, File, 0);
+    }
+
+    close(File);
+
+    if(Memory == MAP_FAILED)
+    {
+        shm_unlink(Mapping->Name);
+        return false;
+    }
+#endif
+
+    Mapping->Ring = (BroadcastRing*)Memory;
+    Mapping->Size = Size;
+
+    return true;
+}
+
+//Read only
+bool OpenBroadcastMapping(const char* Name, BroadcastMapping* Mapping)
+{
+    memset(Mapping, 0, sizeof(*Mapping));
+
+#if defined(_WIN32)
+    snprintf(Mapping->Name, sizeof(Mapping->Name), "Local\\agafb-%s", Name);
+
+    HANDLE Handle = OpenFileMappingA(FILE_MAP_READ, FALSE, Mapping->Name);
+
+    if(Handle == NULL)
+    {
+        return false;
+    }
+
+    void* Memory = MapViewOfFile(Handle, FILE_MAP_READ, 0, 0, 0);
+    MEMORY_BASIC_INFORMATION Info;
+
+    if( (Memory == NULL) || (VirtualQuery(Memory, &Info, sizeof(Info)) == 0) )
+    {
+        if(Memory)
+        {
+            UnmapViewOfFile(Memory);
+        }
+
+        CloseHandle(Handle);
+        return false;
+    }
+
+    Mapping->Handle = Handle;
+    Mapping->Size = Info.RegionSize;
+#else
+    snprintf(Mapping->Name, sizeof(Mapping->Name), "/agafb-%s", Name);
+
+    int File = shm_open(Mapping->Name, O_RDONLY, 0);
+
+    if(File < 0)
+    {
+        return false;
+    }
+
+    struct stat Info;
+    void* Memory = MAP_FAILED;
+
+    if(fstat(File, &Info) == 0)
+    {
+        Memory = mmap(NULL, Info.st_size, PROT_READ, MAP_SHARED, File, 0);
+    }
+
+    close(File);
+
+    if(Memory == MAP_FAILED)
+    {
+        return false;
+    }
+
+    Mapping->Size = Info.st_size;
+#endif
+
+    Mapping->Ring = (BroadcastRing*)Memory;
+
+    return true;
+}
+
+void CloseBroadcastMapping(BroadcastMapping* Mapping, bool Owner)
+{
+    if(Mapping->Ring == NULL)
+    {
+        return;
+    }
+
+#if defined(_WIN32)
+    UnmapViewOfFile(Mapping->Ring);
+    CloseHandle((HANDLE)Mapping->Handle);
+#else
+    munmap(Mapping->Ring, Mapping->Size);
+
+    if(Owner)
+    {
+        shm_unlink(Mapping->Name);
+    }
+#endif
+
+    Mapping->Ring = NULL;
+}
+
+/*
+ * Publishing
+ *
+ * A record is written as a seqlock: Reclaim moves forward before any byte is
+ * overwritten, and Head after the record is complete. A reader that copies a
+ * record and then finds Reclaim has passed it knows the copy may be torn.
+ */
+
+inline unsigned int AlignRecord(unsigned int Size)
+{
+    return (Size + BROADCAST_RECORD_ALIGNMENT - 1) & ~(BROADCAST_RECORD_ALIGNMENT - 1);
+}
+
+inline unsigned char* GetRingData(BroadcastRing* Ring)
+{
+    return (unsigned char*)(Ring + 1);
+}
+
+//Returns where the record starts
+unsigned long long WriteBroadcastRecord(BroadcastRing* Ring, unsigned int Kind, unsigned int Flags, unsigned int Tick,
+                                        const void* Payload, unsigned int PayloadSize)
+{
+    unsigned long long Head = Ring->Head.load(std::memory_order_relaxed);
+    unsigned int Size = sizeof(BroadcastRecordHeader) + PayloadSize;
+    unsigned int Padded = AlignRecord(Size);
+    unsigned int Position = (unsigned int)(Head & (Ring->Capacity - 1));
+
+    BroadcastRecordHeader Header;
+    Header.Flags = 0;
+    Header.Tick = Tick;
+
+    //Records never wrap, pad out the end of the ring instead
+    if(Position + Padded > Ring->Capacity)
+    {
+        unsigned int Rest = Ring->Capacity - Position;
+
+        Header.Size = 0;
+        Header.Kind = BROADCAST_PADDING;
+
+        Ring->Reclaim.store(Head + Rest, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        memcpy(GetRingData(Ring) + Position, &Header, sizeof(Header));
+
+        Head += Rest;
+        Position = 0;
+        Ring->Head.store(Head, std::memory_order_release);
+    }
+
+    Header.Size = (unsigned short)Size;
+    Header.Kind = (unsigned char)Kind;
+    Header.Flags = (unsigned char)Flags;
+
+    Ring->Reclaim.store(Head + Padded, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    memcpy(GetRingData(Ring) + Position, &Header, sizeof(Header));
+    memcpy(GetRingData(Ring) + Position + sizeof(Header), Payload, PayloadSize);
+
+    Ring->Head.store(Head + Padded, std::memory_order_release);
+
+    return Head;
+}
+
+//Capacity is rounded up to a power of two
+BroadcastPublisher OpenBroadcastPublisher(const char* Name, unsigned int Capacity)
+{
+    BroadcastPublisher Result;
+    memset(&Result, 0, sizeof(Result));
+
+    unsigned int RingCapacity = 4*BROADCAST_MAX_RECORD;
+
+    while(RingCapacity < Capacity)
+    {
+        RingCapacity *= 2;
+    }
+
+    if( !CreateBroadcastMapping(Name, sizeof(BroadcastRing) + RingCapacity, &Result.Mapping) )
+    {
+        printf("Could not create broadcast %s!\n", Name);
+        return Result;
+    }
+
+    BroadcastRing* Ring = Result.Mapping.Ring;
+
+    Ring->Capacity = RingCapacity;
+    Ring->Head.store(0, std::memory_order_relaxed);
+    Ring->Reclaim.store(0, std::memory_order_relaxed);
+    Ring->Keyframe.store(~0ull, std::memory_order_relaxed);
+    Ring->Closed.store(0, std::memory_order_relaxed);
+    Ring->Version = BROADCAST_VERSION;
+
+    //Subscribers check the magic last
+    std::atomic_thread_fence(std::memory_order_release);
+    Ring->Magic = BROADCAST_MAGIC;
+
+    Result.Valid = true;
+
+    return Result;
+}
+
+void PublishBroadcast(BroadcastPublisher* Publisher, const GameSnapshot* Snapshot, unsigned int Tick)
+{
+    if(!Publisher->Valid)
+    {
+        return;
+    }
+
+    BroadcastRing* Ring = Publisher->Mapping.Ring;
+    BroadcastView Current = GetBroadcastView(Snapshot, Tick);
+
+    unsigned char Ops[BROADCAST_MAX_RECORD];
+    unsigned int Size = 0;
+
+    bool Encoded = Publisher->HasLast && EncodeBroadcastDelta(&Publisher->Last, &Current, Ops, &Size);
+
+    //Keyframes are due on a timer, and before the last one could be
+    //overwritten, so a late joiner always has one to start from
+    unsigned long long SinceKeyframe = Ring->Head.load(std::memory_order_relaxed) - Publisher->KeyframeOffset;
+
+    bool KeyframeDue = !Publisher->HasLast ||
+                       (Tick - Publisher->KeyframeTick >= BROADCAST_KEYFRAME_TICKS) ||
+                       (SinceKeyframe > Ring->Capacity/2);
+
+    if( Encoded && (Size == 0) && !KeyframeDue )
+    {
+        return;
+    }
+
+    if( Encoded && Size )
+    {
+        WriteBroadcastRecord(Ring, BROADCAST_DELTA, 0, Tick, Ops, Size);
+
+        Publisher->Records++;
+        Publisher->Bytes += AlignRecord(sizeof(BroadcastRecordHeader) + Size);
+    }
+
+    //A timed keyframe follows the delta rather than replacing it, so
+    //subscribers can check what they decoded against it
+    if( !Encoded || KeyframeDue )
+    {
+        unsigned long long Offset = WriteBroadcastRecord(Ring, BROADCAST_KEYFRAME, Encoded ? BROADCAST_RESTATE : 0,
+                                                         Tick, &Current, sizeof(Current));
+        Ring->Keyframe.store(Offset, std::memory_order_release);
+
+        Publisher->KeyframeTick = Tick;
+        Publisher->KeyframeOffset = Offset;
+        Publisher->Keyframes++;
+        Publisher->Records++;
+        Publisher->Bytes += AlignRecord(sizeof(BroadcastRecordHeader) + sizeof(Current));
+    }
+
+    Publisher->Last = Current;
+    Publisher->HasLast = true;
+}
+
+void CloseBroadcastPublisher(BroadcastPublisher* Publisher)
+{
+    if(!Publisher->Valid)
+    {
+        return;
+    }
+
+    Publisher->Mapping.Ring->Closed.store(1, std::memory_order_release);
+    CloseBroadcastMapping(&Publisher->Mapping, true);
+
+    Publisher->Valid = false;
+}
+
+/*
+ * Subscribing
+ */
+
+BroadcastSubscriber OpenBroadcastSubscriber(const char* Name)
+{
+    BroadcastSubscriber Result;
+    memset(&Result, 0, sizeof(Result));
+
+    if( !OpenBroadcastMapping(Name, &Result.Mapping) )
+    {
+        return Result;
+    }
+
+    const BroadcastRing* Ring = Result.Mapping.Ring;
+
+    bool Valid = (Result.Mapping.Size >= sizeof(BroadcastRing)) && (Ring->Magic == BROADCAST_MAGIC);
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    Valid = Valid && (Ring->Version == BROADCAST_VERSION) &&
+            (Ring->Capacity >= BROADCAST_MAX_RECORD) && ((Ring->Capacity & (Ring->Capacity - 1)) == 0) &&
+            (Result.Mapping.Size >= sizeof(BroadcastRing) + Ring->Capacity);
+
+    if(!Valid)
+    {
+        CloseBroadcastMapping(&Result.Mapping, false);
+        return Result;
+    }
+
+    Result.Valid = true;
+
+    return Result;
+}
+
+//Reads everything the publisher has written since the last call
+BroadcastReadResult ReadBroadcast(BroadcastSubscriber* Subscriber)
+{
+    if(!Subscriber->Valid)
+    {
+        return BROADCAST_READ_CLOSED;
+    }
+
+    BroadcastRing* Ring = Subscriber->Mapping.Ring;
+    unsigned int Capacity = Ring->Capacity;
+    bool Updated = false;
+    bool Closed = false;
+
+    //A subscriber that keeps getting lapped tries again next call rather
+    //than spinning here
+    for(unsigned int Resyncs = 0; Resyncs < 4; )
+    {
+        Closed = Ring->Closed.load(std::memory_order_acquire) != 0;
+
+        if(!Subscriber->Synced)
+        {
+            unsigned long long Keyframe = Ring->Keyframe.load(std::memory_order_acquire);
+
+            if(Keyframe == ~0ull)
+            {
+                break;
+            }
+
+            Subscriber->Cursor = Keyframe;
+        }
+
+        unsigned long long Head = Ring->Head.load(std::memory_order_acquire);
+        unsigned long long Cursor = Subscriber->Cursor;
+
+        if(Cursor == Head)
+        {
+            break;
+        }
+
+        unsigned int Position = (unsigned int)(Cursor & (Capacity - 1));
+        const unsigned char* Record = GetRingData(Ring) + Position;
+
+        BroadcastRecordHeader Header;
+        unsigned char Payload[BROADCAST_MAX_RECORD];
+        unsigned int PayloadSize = 0;
+
+        bool Lapped = (Head - Cursor > Capacity);
+
+        if(!Lapped)
+        {
+            memcpy(&Header, Record, sizeof(Header));
+
+            if( (Header.Kind != BROADCAST_PADDING) && (Header.Size >= sizeof(Header)) &&
+                (Header.Size <= BROADCAST_MAX_RECORD) && (Position + Header.Size <= Capacity) )
+            {
+                PayloadSize = Header.Size - sizeof(Header);
+                memcpy(Payload, Record + sizeof(Header), PayloadSize);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            Lapped = (Ring->Reclaim.load(std::memory_order_relaxed) > Cursor + Capacity);
+        }
+
+        if(Lapped)
+        {
+            Subscriber->Synced = false;
+            Subscriber->Resyncs++;
+            ++Resyncs;
+            continue;
+        }
+
+        if(Header.Kind == BROADCAST_PADDING)
+        {
+            Subscriber->Cursor = Cursor + (Capacity - Position);
+            continue;
+        }
+
+        bool Applied = false;
+
+        if( (Header.Kind == BROADCAST_KEYFRAME) && (PayloadSize == sizeof(BroadcastView)) )
+        {
+            BroadcastView Keyframe;
+            memcpy(&Keyframe, Payload, sizeof(Keyframe));
+
+            //Deltas applied up to here should have built exactly this
+            if( Subscriber->Synced && (Header.Flags & BROADCAST_RESTATE) )
+            {
+                Subscriber->View.Tick = Keyframe.Tick;
+                Subscriber->KeyframeMismatches += !BroadcastViewsEqual(&Subscriber->View, &Keyframe);
+            }
+
+            Subscriber->View = Keyframe;
+            Subscriber->Keyframes++;
+            Applied = true;
+        }
+        else if( (Header.Kind == BROADCAST_DELTA) && Subscriber->Synced )
+        {
+            Applied = ApplyBroadcastDelta(&Subscriber->View, Payload, PayloadSize);
+            Subscriber->View.Tick = Header.Tick;
+        }
+
+        if(!Applied)
+        {
+            //Not something this version understands, start again from the
+            //next keyframe
+            Subscriber->Synced = false;
+            Subscriber->Resyncs++;
+            ++Resyncs;
+            continue;
+        }
+
+        Subscriber->Synced = true;
+        Subscriber->Cursor = Cursor + AlignRecord(Header.Size);
+        Subscriber->Records++;
+        Updated = true;
+    }
+
+    if(Updated)
+    {
+        return BROADCAST_READ_UPDATED;
+    }
+
+    return Closed ? BROADCAST_READ_CLOSED : BROADCAST_READ_NONE;
+}
+
+void CloseBroadcastSubscriber(BroadcastSubscriber* Subscriber)
+{
+    if(!Subscriber->Valid)
+    {
+        return;
+    }
+
+    CloseBroadcastMapping(&Subscriber->Mapping, false);
+    Subscriber->Valid = false;
+}
@@ -0,0 +1,179 @@
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include <stddef.h>
+#include <atomic>
+
+#include "game.h"
+#include "snapshot.h"
+
+/*
+ * Spectator Broadcast
+ *
+ * Lets any number of local viewers watch a game without the game doing any
+ * work per viewer. The publisher encodes each tick's change once, as a delta
+ * against the last state it sent, and appends it to a ring buffer in shared
+ * memory. Every subscriber maps the same ring read only and follows it at its
+ * own pace, so a hundred viewers cost the game exactly what one does.
+ *
+ * A delta is a handful of ops: the piece moved or rotated, the piece locked
+ * (with the rows that cleared), the next piece spawned, the score or state
+ * changed. A typical tick is one 16 byte record. Anything the ops can't
+ * express, such as a restart, goes out as a keyframe holding the whole
+ * BroadcastView, and keyframes are also sent every BROADCAST_KEYFRAME_TICKS so
+ * a viewer joining late starts from the newest keyframe.
+ *
+ * The publisher never waits for subscribers. A subscriber that falls a whole
+ * ring behind, or catches the publisher overwriting the record it's reading,
+ * skips ahead to the newest keyframe and carries on from there.
+ *
+ * Fields are in host byte order, both ends being on the same machine.
+ */
+
+enum BroadcastConstants{
+    BROADCAST_MAGIC     = 0x42414741, //"AGAB"
+    BROADCAST_VERSION   = 1,
+
+    BROADCAST_DEFAULT_CAPACITY  = 64*1024,  //Bytes, a power of two
+    BROADCAST_KEYFRAME_TICKS    = 90,       //3s at 30 ticks/s
+    BROADCAST_NAME_MAX          = 64,
+
+    //Records start on 8 byte boundaries so a padding record always fits
+    //in the space left at the end of the ring
+    BROADCAST_RECORD_ALIGNMENT  = 8,
+    BROADCAST_MAX_RECORD        = 512
+};
+
+#define DEFAULT_BROADCAST_NAME "agafb"
+
+enum BroadcastRecordKind{
+    BROADCAST_PADDING,  //Skip to the start of the ring
+    BROADCAST_KEYFRAME, //A whole BroadcastView
+    BROADCAST_DELTA     //Ops against the previous record's view
+};
+
+//Delta ops, each a one byte code followed by its operands, unaligned
+enum BroadcastOp{
+    BROADCAST_OP_MOVE = 1,  //signed char Row, Col
+    BROADCAST_OP_ROTATE,    //unsigned short Shape
+    BROADCAST_OP_LOCK,      //signed char Row, Col, unsigned int ClearedRows
+    BROADCAST_OP_SPAWN,     //signed char Row, Col, unsigned char NextPiece, NextColour, NextSize, unsigned short NextShape
+    BROADCAST_OP_SCORE,     //unsigned int Score
+    BROADCAST_OP_STATE      //unsigned char State
+};
+
+//Everything a spectator sees of a game. Shapes have bit Row*4 + Col set for
+//each block of the piece's GridSize x GridSize grid, Rows bit N for an
+//occupied block in column N. Empty blocks always have colour 0.
+struct BroadcastView{
+    unsigned int Tick;
+    unsigned int Score;
+
+    unsigned char State;        //GameState
+    unsigned char Piece;        //TetrominoType
+    unsigned char PieceColour;  //Palette index
+    unsigned char PieceSize;
+    signed char PieceRow;
+    signed char PieceCol;
+    unsigned short PieceShape;
+
+    unsigned char NextPiece;
+    unsigned char NextColour;
+    unsigned char NextSize;
+    unsigned char Reserved;
+    unsigned short NextShape;
+
+    unsigned short Rows[GRID_ROWS];
+    unsigned char Colours[GRID_ROWS*GRID_COLS];
+};
+
+//Bits in BroadcastRecordHeader::Flags
+enum BroadcastRecordFlags{
+    //A keyframe of the state the delta before it already reached. Sent on the
+    //keyframe timer, as opposed to a keyframe sent because a delta couldn't be.
+    BROADCAST_RESTATE = 1 << 0
+};
+
+struct BroadcastRecordHeader{
+    unsigned short Size;    //Including the header, before padding to BROADCAST_RECORD_ALIGNMENT
+    unsigned char Kind;     //BroadcastRecordKind
+    unsigned char Flags;    //BroadcastRecordFlags
+    unsigned int Tick;
+};
+
+//Shared memory layout: this header, then Capacity bytes of records. Offsets
+//count every byte ever written, the ring position being Offset % Capacity.
+struct BroadcastRing{
+    unsigned int Magic;
+    unsigned int Version;
+    unsigned int Capacity;
+    unsigned int Reserved;
+
+    std::atomic<unsigned long long> Head;       //End of the last complete record
+    std::atomic<unsigned long long> Reclaim;    //Bytes before Reclaim - Capacity may be overwritten
+    std::atomic<unsigned long long> Keyframe;   //Start of the newest keyframe, ~0 before the first
+    std::atomic<unsigned int> Closed;           //The publisher has gone
+    unsigned int Reserved2;
+};
+
+typedef char BroadcastViewSizeCheck[(sizeof(BroadcastView) == 264) ? 1 : -1];
+
+//Shared memory for a ring. The handle is only used on Windows.
+struct BroadcastMapping{
+    BroadcastRing* Ring;
+    size_t Size;
+    void* Handle;
+    char Name[BROADCAST_NAME_MAX];
+};
+
+struct BroadcastPublisher{
+    bool Valid;
+    BroadcastMapping Mapping;
+
+    BroadcastView Last;         //As the subscribers will have decoded it
+    bool HasLast;
+    unsigned int KeyframeTick;
+    unsigned long long KeyframeOffset;
+
+    //Totals, for reporting
+    unsigned long long Records;
+    unsigned long long Keyframes;
+    unsigned long long Bytes;
+};
+
+struct BroadcastSubscriber{
+    bool Valid;
+    BroadcastMapping Mapping;
+
+    BroadcastView View;
+    bool Synced;                //View is valid
+    unsigned long long Cursor;  //Next record to read
+
+    //Totals, for reporting
+    unsigned long long Records;
+    unsigned long long Keyframes;
+    unsigned long long Resyncs;
+    unsigned long long KeyframeMismatches;  //Restating keyframes that disagreed with the view the deltas built
+};
+
+enum BroadcastReadResult{
+    BROADCAST_READ_NONE,    //Nothing new
+    BROADCAST_READ_UPDATED, //View has changed
+    BROADCAST_READ_CLOSED   //The publisher has gone and everything has been read
+};
+
+//Encoding, no shared memory involved
+BroadcastView   GetBroadcastView(const GameSnapshot* Snapshot, unsigned int Tick);
+bool            EncodeBroadcastDelta(const BroadcastView* Previous, const BroadcastView* Current, unsigned char* Ops, unsigned int* Size);
+bool            ApplyBroadcastDelta(BroadcastView* View, const unsigned char* Ops, unsigned int Size);
+bool            BroadcastViewsEqual(const BroadcastView* A, const BroadcastView* B);
+
+BroadcastPublisher  OpenBroadcastPublisher(const char* Name, unsigned int Capacity);
+void                PublishBroadcast(BroadcastPublisher* Publisher, const GameSnapshot* Snapshot, unsigned int Tick);
+void                CloseBroadcastPublisher(BroadcastPublisher* Publisher);
+
+BroadcastSubscriber OpenBroadcastSubscriber(const char* Name);
+BroadcastReadResult ReadBroadcast(BroadcastSubscriber* Subscriber);
+void                CloseBroadcastSubscriber(BroadcastSubscriber* Subscriber);
+
+#endif
@@ -4,3 +4,30 @@ set libPath="..\..\resources\SDL2-2.0.5\lib\x86"
 set incPath="..\..\resources\SDL2-2.0.5\include"
 
 cl /Zi /Feagafb.exe /I%incPath% main.cpp /link /LIBPATH:%libPath% SDL2main.lib SDL2.lib /SUBSYSTEM:CONSOLE
+
+REM Headless tools, these don't link against SDL. Add /arch:AVX2 for the vectorised lockstep engine.
+cl /O2 /EHsc /Feagafb_bench.exe bench.cpp
+
+REM Terminal spectator for agafb --broadcast
+cl /O2 /EHsc /Feagafb_watch.exe watch.cpp
+
+REM Replay corpus generator and analytics
+cl /O2 /EHsc /Feagafb_corpus.exe corpus.cpp
+
+REM Bot weight tuner
+cl /O2 /EHsc /Feagafb_tune.exe tune.cpp
+
+REM Perfect clear solver and benchmark
+cl /O2 /EHsc /Feagafb_solve.exe solve.cpp
+
+REM Surface table generator and benchmark, see surface.h
+cl /O2 /EHsc /Feagafb_surfaces.exe surfaces.cpp
+
+REM Differential fuzzer, lockstep engine against the reference one
+cl /O2 /EHsc /Feagafb_fuzz.exe fuzz.cpp
+
+REM High score and game stats queries
+cl /O2 /EHsc /Feagafb_scores.exe scores.cpp
+
+REM Reinforcement learning environment, see agafb_env.h
+cl /O2 /LD /EHsc /Feagafb_env.dll env.cpp
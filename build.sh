@@ -9,6 +9,39 @@ incPath=/usr/include
 objectName=agafb
 
 compilerFlags="-Wall -Wextra -w -o $objectName"
-linkerFlags="-lSDL2 -lSDL2_ttf"
+linkerFlags="-lSDL2 -lSDL2_ttf -lpthread -lrt"
 
 $compiler $objects $compilerFlags $linkerFlags
+
+#Headless tools, these don't link against SDL
+toolFlags="-O2 -march=native -w"
+
+$compiler bench.cpp $toolFlags -o agafb_bench -lrt
+
+#Terminal spectator for agafb --broadcast
+$compiler watch.cpp $toolFlags -o agafb_watch -lpthread -lrt
+
+#Reinforcement learning environment, see agafb_env.h
+$compiler env.cpp $toolFlags -shared -fPIC -o libagafb_env.so -lpthread -lrt
+
+#Multi-session game server and its load generator, Linux only (epoll)
+$compiler server.cpp $toolFlags -o agafb_server -lpthread
+$compiler loadclient.cpp $toolFlags -o agafb_loadclient
+
+#Replay corpus generator and analytics
+$compiler corpus.cpp $toolFlags -o agafb_corpus -lpthread
+
+#Bot weight tuner
+$compiler tune.cpp $toolFlags -o agafb_tune -lpthread
+
+#Perfect clear solver and benchmark
+$compiler solve.cpp $toolFlags -o agafb_solve -lpthread
+
+#Surface table generator and benchmark, see surface.h
+$compiler surfaces.cpp $toolFlags -o agafb_surfaces -lpthread
+
+#Differential fuzzer, lockstep engine against the reference one
+$compiler fuzz.cpp $toolFlags -o agafb_fuzz -lpthread
+
+#High score and game stats queries
+$compiler scores.cpp $toolFlags -o agafb_scores -lpthread
@@ -0,0 +1,697 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "capture.h"
+
+/*
+ * PNG Encoding
+ */
+
+struct DeflateTables{
+    //Fixed Huffman codes, bit reversed since deflate streams are LSB first
+    unsigned short LiteralCodes[288];
+    unsigned char LiteralLengths[288];
+    unsigned char DistanceCodes[30];
+
+    unsigned char LengthSymbols[259];   //Length code index (0-28) by match length
+    unsigned char DistanceSymbols[512]; //By distance - 1 up to 256, then (distance - 1) >> 7
+
+    unsigned int Crc[256];
+};
+
+static const unsigned short LengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                              35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const unsigned char LengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                              3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const unsigned short DistanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+                                                513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const unsigned char DistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7,
+                                                8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+unsigned int ReverseBits(unsigned int Value, unsigned int Count)
+{
+    unsigned int Result = 0;
+
+    for(unsigned int Bit = 0; Bit < Count; ++Bit)
+    {
+        Result = (Result << 1) | ((Value >> Bit) & 1);
+    }
+
+    return Result;
+}
+
+DeflateTables BuildDeflateTables()
+{
+    DeflateTables Result;
+
+    for(unsigned int Symbol = 0; Symbol < 288; ++Symbol)
+    {
+        unsigned int Code;
+        unsigned int Length;
+
+        if(Symbol < 144)        { Code = 0x30 + Symbol;         Length = 8; }
+        else if(Symbol < 256)   { Code = 0x190 + Symbol - 144;  Length = 9; }
+        else if(Symbol < 280)   { Code = Symbol - 256;          Length = 7; }
+        else                    { Code = 0xC0 + Symbol - 280;   Length = 8; }
+
+        Result.LiteralCodes[Symbol] = (unsigned short)ReverseBits(Code, Length);
+        Result.LiteralLengths[Symbol] = (unsigned char)Length;
+    }
+
+    for(unsigned int Symbol = 0; Symbol < 30; ++Symbol)
+    {
+        Result.DistanceCodes[Symbol] = (unsigned char)ReverseBits(Symbol, 5);
+    }
+
+    //258 fits code 27's range too, but has its own code, which comes last
+    for(unsigned int Symbol = 0; Symbol < 29; ++Symbol)
+    {
+        for(unsigned int Length = LengthBase[Symbol]; (Length < LengthBase[Symbol] + (1u << LengthExtra[Symbol])) && (Length <= 258); ++Length)
+        {
+            Result.LengthSymbols[Length] = (unsigned char)Symbol;
+        }
+    }
+
+    for(unsigned int Symbol = 0; Symbol < 30; ++Symbol)
+    {
+        for(unsigned int Distance = DistanceBase[Symbol]; Distance < DistanceBase[Symbol] + (1u << DistanceExtra[Symbol]); ++Distance)
+        {
+            unsigned int Index = (Distance <= 256) ? Distance - 1 : 256 + ((Distance - 1) >> 7);
+            Result.DistanceSymbols[Index] = (unsigned char)Symbol;
+        }
+    }
+
+    for(unsigned int Byte = 0; Byte < 256; ++Byte)
+    {
+        unsigned int Crc = Byte;
+
+        for(unsigned int Bit = 0; Bit < 8; ++Bit)
+        {
+            Crc = (Crc & 1) ? 0xEDB88320u ^ (Crc >> 1) : (Crc >> 1);
+        }
+
+        Result.Crc[Byte] = Crc;
+    }
+
+    return Result;
+}
+
+//Built the first time any thread asks
+const DeflateTables* GetDeflateTables()
+{
+    static const DeflateTables Tables = BuildDeflateTables();
+
+    return &Tables;
+}
+
+struct DeflateBits{
+    unsigned char* Output;
+    size_t Used;
+    unsigned long long Bits;
+    unsigned int Count;
+};
+
+inline void PutBits(DeflateBits* Writer, unsigned int Value, unsigned int Count)
+{
+    Writer->Bits |= (unsigned long long)Value << Writer->Count;
+    Writer->Count += Count;
+
+    while(Writer->Count >= 8)
+    {
+        Writer->Output[Writer->Used++] = (unsigned char)Writer->Bits;
+        Writer->Bits >>= 8;
+        Writer->Count -= 8;
+    }
+}
+
+inline unsigned int HashDeflateBytes(const unsigned char* Bytes)
+{
+    unsigned int Key = ((unsigned int)Bytes[0] << 16) | ((unsigned int)Bytes[1] << 8) | Bytes[2];
+
+    return (Key*2654435761u) >> (32 - CAPTURE_HASH_BITS);
+}
+
+//One fixed Huffman block, matching each position against the last one with
+//the same three bytes. Output has to hold Size*9/8 plus a few bytes.
+size_t Deflate(const unsigned char* Input, size_t Size, unsigned char* Output, int* Head)
+{
+    const DeflateTables* Tables = GetDeflateTables();
+
+    DeflateBits Writer = {Output, 0, 0, 0};
+
+    for(unsigned int Index = 0; Index < (1u << CAPTURE_HASH_BITS); ++Index)
+    {
+        Head[Index] = -1;
+    }
+
+    //Final block, fixed codes
+    PutBits(&Writer, 1, 1);
+    PutBits(&Writer, 1, 2);
+
+    size_t Position = 0;
+
+    while(Position < Size)
+    {
+        unsigned int MatchLength = 0;
+        unsigned int Distance = 0;
+
+        if(Position + 3 <= Size)
+        {
+            unsigned int Hash = HashDeflateBytes(Input + Position);
+            int Candidate = Head[Hash];
+            Head[Hash] = (int)Position;
+
+            if( (Candidate >= 0) && (Position - Candidate <= 32768) )
+            {
+                size_t Limit = (Size - Position < 258) ? Size - Position : 258;
+                const unsigned char* A = Input + Candidate;
+                const unsigned char* B = Input + Position;
+
+                //Eight bytes at a time while they're all there to compare
+                while( (MatchLength + 8 <= Limit) && (memcmp(A + MatchLength, B + MatchLength, 8) == 0) )
+                {
+                    MatchLength += 8;
+                }
+
+                while( (MatchLength < Limit) && (A[MatchLength] == B[MatchLength]) )
+                {
+                    MatchLength++;
+                }
+
+                Distance = (unsigned int)(Position - Candidate);
+            }
+        }
+
+        if(MatchLength >= 3)
+        {
+            unsigned int LengthSymbol = Tables->LengthSymbols[MatchLength];
+            unsigned int Symbol = 257 + LengthSymbol;
+
+            PutBits(&Writer, Tables->LiteralCodes[Symbol], Tables->LiteralLengths[Symbol]);
+            PutBits(&Writer, MatchLength - LengthBase[LengthSymbol], LengthExtra[LengthSymbol]);
+
+            unsigned int DistanceSymbol = Tables->DistanceSymbols[(Distance <= 256) ? Distance - 1 : 256 + ((Distance - 1) >> 7)];
+
+            PutBits(&Writer, Tables->DistanceCodes[DistanceSymbol], 5);
+            PutBits(&Writer, Distance - DistanceBase[DistanceSymbol], DistanceExtra[DistanceSymbol]);
+
+            //Short matches remember the positions inside them too. Long ones
+            //are runs of flat colour, where the end of the run is all that's
+            //worth finding again.
+            size_t End = Position + MatchLength;
+            Position = (MatchLength <= CAPTURE_MAX_INSERT) ? Position + 1 : End - 1;
+
+            for(; (Position < End) && (Position + 3 <= Size); ++Position)
+            {
+                Head[HashDeflateBytes(Input + Position)] = (int)Position;
+            }
+
+            Position = End;
+        }
+        else
+        {
+            PutBits(&Writer, Tables->LiteralCodes[Input[Position]], Tables->LiteralLengths[Input[Position]]);
+            Position++;
+        }
+    }
+
+    PutBits(&Writer, Tables->LiteralCodes[256], Tables->LiteralLengths[256]);
+    PutBits(&Writer, 0, 7);
+
+    return Writer.Used;
+}
+
+unsigned int UpdateCrc(unsigned int Crc, const unsigned char* Bytes, size_t Size)
+{
+    const DeflateTables* Tables = GetDeflateTables();
+
+    for(size_t Index = 0; Index < Size; ++Index)
+    {
+        Crc = Tables->Crc[(Crc ^ Bytes[Index]) & 0xFF] ^ (Crc >> 8);
+    }
+
+    return Crc;
+}
+
+unsigned int Adler32(const unsigned char* Bytes, size_t Size)
+{
+    unsigned int A = 1;
+    unsigned int B = 0;
+
+    while(Size)
+    {
+        //Largest run that can't overflow before the modulo
+        size_t Run = (Size < 5552) ? Size : 5552;
+        Size -= Run;
+
+        //Sixteen bytes at a time: each adds its value to A, and to B once for
+        //every byte from it to the end of the group
+        for(; Run >= 16; Run -= 16, Bytes += 16)
+        {
+            unsigned int Sum = 0;
+            unsigned int Weighted = 0;
+
+            for(unsigned int Byte = 0; Byte < 16; ++Byte)
+            {
+                Sum += Bytes[Byte];
+                Weighted += (16 - Byte)*Bytes[Byte];
+            }
+
+            B += 16*A + Weighted;
+            A += Sum;
+        }
+
+        while(Run--)
+        {
+            A += *Bytes++;
+            B += A;
+        }
+
+        A %= 65521;
+        B %= 65521;
+    }
+
+    return (B << 16) | A;
+}
+
+inline void PutBigEndian(unsigned char* Bytes, unsigned int Value)
+{
+    Bytes[0] = (unsigned char)(Value >> 24);
+    Bytes[1] = (unsigned char)(Value >> 16);
+    Bytes[2] = (unsigned char)(Value >> 8);
+    Bytes[3] = (unsigned char)Value;
+}
+
+//Fills in the length before Type and the CRC after the Length bytes that follow
+//it, returning the size of the whole chunk
+size_t FinishPNGChunk(unsigned char* Chunk, const char* Type, unsigned int Length)
+{
+    PutBigEndian(Chunk, Length);
+    memcpy(Chunk + 4, Type, 4);
+    PutBigEndian(Chunk + 8 + Length, UpdateCrc(0xFFFFFFFFu, Chunk + 4, Length + 4) ^ 0xFFFFFFFFu);
+
+    return 12 + Length;
+}
+
+bool PrepareCaptureEncoder(CaptureEncoder* Encoder, unsigned int Width, unsigned int Height)
+{
+    size_t Filtered = (size_t)Height*(1 + 3*(size_t)Width);
+
+    Encoder->Filtered = (unsigned char*)malloc(Filtered);
+    Encoder->OutputCapacity = Filtered + Filtered/8 + 1024;
+    Encoder->Output = (unsigned char*)malloc(Encoder->OutputCapacity);
+    Encoder->Head = (int*)malloc(sizeof(int) << CAPTURE_HASH_BITS);
+
+    return Encoder->Filtered && Encoder->Output && Encoder->Head;
+}
+
+void FreeCaptureEncoder(CaptureEncoder* Encoder)
+{
+    free(Encoder->Filtered);
+    free(Encoder->Output);
+    free(Encoder->Head);
+
+    memset(Encoder, 0, sizeof(*Encoder));
+}
+
+//An 8 bit RGB PNG of the pixels, in Encoder->Output. Returns its size.
+size_t EncodePNG(CaptureEncoder* Encoder, const unsigned char* Pixels, unsigned int Width, unsigned int Height,
+                 unsigned int Pitch)
+{
+    static const unsigned char Signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+    //Up filter: each row as the difference from the one above
+    unsigned int RowSize = 3*Width;
+    unsigned char* Filtered = Encoder->Filtered;
+
+    for(unsigned int Row = 0; Row < Height; ++Row)
+    {
+        const unsigned char* Current = Pixels + (size_t)Row*Pitch;
+        unsigned char* Out = Filtered + (size_t)Row*(RowSize + 1);
+
+        Out[0] = 2;
+
+        if(Row == 0)
+        {
+            memcpy(Out + 1, Current, RowSize);
+        }
+        else
+        {
+            const unsigned char* Above = Current - Pitch;
+            unsigned int Byte = 0;
+
+            //Eight bytes at a time, subtracting each without borrowing from
+            //the next
+            for(; Byte + 8 <= RowSize; Byte += 8)
+            {
+                const unsigned long long High = 0x8080808080808080ull;
+                unsigned long long X;
+                unsigned long long Y;
+
+                memcpy(&X, Current + Byte, 8);
+                memcpy(&Y, Above + Byte, 8);
+
+                unsigned long long Difference = ((X | High) - (Y & ~High)) ^ ((X ^ ~Y) & High);
+                memcpy(Out + 1 + Byte, &Difference, 8);
+            }
+
+            for(; Byte < RowSize; ++Byte)
+            {
+                Out[Byte + 1] = (unsigned char)(Current[Byte] - Above[Byte]);
+            }
+        }
+    }
+
+    size_t FilteredSize = (size_t)Height*(RowSize + 1);
+    unsigned char* Output = Encoder->Output;
+    size_t Used = 0;
+
+    memcpy(Output, Signature, sizeof(Signature));
+    Used += sizeof(Signature);
+
+    unsigned char* Header = Output + Used + 8;
+    PutBigEndian(Header, Width);
+    PutBigEndian(Header + 4, Height);
+    Header[8] = 8;      //Bit depth
+    Header[9] = 2;      //RGB
+    Header[10] = 0;     //Deflate
+    Header[11] = 0;     //Adaptive filtering
+    Header[12] = 0;     //Not interlaced
+    Used += FinishPNGChunk(Output + Used, "IHDR", 13);
+
+    //zlib stream: header, deflate, Adler-32 of the uncompressed data
+    unsigned char* Data = Output + Used + 8;
+    Data[0] = 0x78;
+    Data[1] = 0x01;
+
+    size_t DataSize = 2 + Deflate(Filtered, FilteredSize, Data + 2, Encoder->Head);
+    PutBigEndian(Data + DataSize, Adler32(Filtered, FilteredSize));
+    DataSize += 4;
+
+    Used += FinishPNGChunk(Output + Used, "IDAT", (unsigned int)DataSize);
+    Used += FinishPNGChunk(Output + Used, "IEND", 0);
+
+    return Used;
+}
+
+/*
+ * Capture Threads
+ */
+
+unsigned long long GetCaptureNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void ReportCaptureFailure(FrameCapture* Capture, const char* Path)
+{
+    bool Expected = false;
+
+    //Only the first, the rest are almost certainly the same problem
+    if(Capture->Failed.compare_exchange_strong(Expected, true))
+    {
+        printf("Could not write frames to %s\n", Path);
+    }
+}
+
+void WriteCaptureFrame(FrameCapture* Capture, CaptureEncoder* Encoder, const CaptureFrame* Frame)
+{
+    if(Capture->Failed.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    if(Capture->Format == CAPTURE_RAW)
+    {
+        size_t Size = (size_t)Capture->Pitch*Capture->Height;
+
+        if(fwrite(Frame->Pixels, 1, Size, Capture->Raw) != Size)
+        {
+            ReportCaptureFailure(Capture, Capture->Prefix);
+            return;
+        }
+
+        Capture->Bytes += Size;
+    }
+    else
+    {
+        size_t Size = EncodePNG(Encoder, Frame->Pixels, Capture->Width, Capture->Height, Capture->Pitch);
+
+        char Path[CAPTURE_PATH_MAX + 16];
+        snprintf(Path, sizeof(Path), "%s%06u.png", Capture->Prefix, Frame->Number);
+
+        FILE* File = fopen(Path, "wb");
+        bool Written = File && (fwrite(Encoder->Output, 1, Size, File) == Size);
+
+        if(File && (fclose(File) != 0))
+        {
+            Written = false;
+        }
+
+        if(!Written)
+        {
+            ReportCaptureFailure(Capture, Path);
+            return;
+        }
+
+        Capture->Bytes += Size;
+    }
+
+    Capture->Written++;
+}
+
+void RunCaptureWorker(FrameCapture* Capture, unsigned int Worker)
+{
+    for(;;)
+    {
+        CaptureFrame* Frame;
+
+        {
+            std::unique_lock<std::mutex> Guard(Capture->Lock);
+            Capture->FrameQueued.wait(Guard, [Capture]{ return Capture->QueueCount || Capture->Stop; });
+
+            //Stopping, with everything submitted written
+            if(!Capture->QueueCount)
+            {
+                return;
+            }
+
+            Frame = Capture->Slots + Capture->Queue[Capture->QueueHead];
+            Frame->State = CAPTURE_WRITING;
+            Capture->QueueHead = (Capture->QueueHead + 1) % Capture->SlotCount;
+            Capture->QueueCount--;
+        }
+
+        unsigned long long Start = GetCaptureNanoseconds();
+        WriteCaptureFrame(Capture, Capture->Encoders + Worker, Frame);
+        Capture->EncodeNanoseconds += GetCaptureNanoseconds() - Start;
+
+        {
+            std::lock_guard<std::mutex> Guard(Capture->Lock);
+            Frame->State = CAPTURE_FREE;
+        }
+
+        Capture->SlotFreed.notify_one();
+    }
+}
+
+bool OpenFrameCapture(FrameCapture* Capture, const char* Output, unsigned int Width, unsigned int Height,
+                      unsigned int ThreadCount)
+{
+    size_t OutputLength = strlen(Output);
+
+    Capture->Valid = false;
+    Capture->Format = ( (OutputLength > 4) && (strcmp(Output + OutputLength - 4, ".raw") == 0) ) ? CAPTURE_RAW : CAPTURE_PNG;
+    Capture->Raw = NULL;
+    Capture->Width = Width;
+    Capture->Height = Height;
+    Capture->Pitch = 3*Width;
+    Capture->QueueHead = 0;
+    Capture->QueueCount = 0;
+    Capture->Submitted = 0;
+    Capture->Stop = false;
+    Capture->Bytes.store(0);
+    Capture->EncodeNanoseconds.store(0);
+    Capture->Written.store(0);
+    Capture->Failed.store(false);
+    Capture->Stalls = 0;
+    Capture->StallNanoseconds = 0;
+
+    if(OutputLength >= CAPTURE_PATH_MAX)
+    {
+        printf("Capture path %s is too long\n", Output);
+        return false;
+    }
+
+    memcpy(Capture->Prefix, Output, OutputLength + 1);
+
+    //Raw frames are written in order, so by one thread, and there's nothing
+    //for more to do anyway
+    ThreadCount = (Capture->Format == CAPTURE_RAW) ? 1 : ThreadCount;
+    ThreadCount = (ThreadCount < 1) ? 1 : (ThreadCount > CAPTURE_MAX_THREADS) ? (unsigned int)CAPTURE_MAX_THREADS : ThreadCount;
+    Capture->ThreadCount = ThreadCount;
+
+    if(Capture->Format == CAPTURE_RAW)
+    {
+        Capture->Raw = fopen(Output, "wb");
+
+        if(Capture->Raw == NULL)
+        {
+            printf("Could not open %s\n", Output);
+            return false;
+        }
+    }
+
+    //Enough for every thread to be writing one while the renderer fills the rest
+    Capture->SlotCount = CAPTURE_SLOTS_PER_THREAD*ThreadCount + 1;
+    Capture->Slots = (CaptureFrame*)calloc(Capture->SlotCount, sizeof(CaptureFrame));
+    Capture->Queue = (unsigned int*)calloc(Capture->SlotCount, sizeof(unsigned int));
+
+    bool Allocated = Capture->Slots && Capture->Queue;
+
+    for(unsigned int Slot = 0; Allocated && (Slot < Capture->SlotCount); ++Slot)
+    {
+        Capture->Slots[Slot].Pixels = (unsigned char*)malloc((size_t)Capture->Pitch*Height);
+        Allocated = (Capture->Slots[Slot].Pixels != NULL);
+    }
+
+    for(unsigned int Worker = 0; Worker < CAPTURE_MAX_THREADS; ++Worker)
+    {
+        memset(Capture->Encoders + Worker, 0, sizeof(CaptureEncoder));
+
+        if( Allocated && (Worker < ThreadCount) && (Capture->Format == CAPTURE_PNG) )
+        {
+            Allocated = PrepareCaptureEncoder(Capture->Encoders + Worker, Width, Height);
+        }
+    }
+
+    if(!Allocated)
+    {
+        printf("Could not allocate %u capture frames\n", Capture->SlotCount);
+
+        for(unsigned int Slot = 0; Capture->Slots && (Slot < Capture->SlotCount); ++Slot)
+        {
+            free(Capture->Slots[Slot].Pixels);
+        }
+
+        for(unsigned int Worker = 0; Worker < ThreadCount; ++Worker)
+        {
+            FreeCaptureEncoder(Capture->Encoders + Worker);
+        }
+
+        free(Capture->Slots);
+        free(Capture->Queue);
+
+        if(Capture->Raw)
+        {
+            fclose(Capture->Raw);
+        }
+
+        Capture->Slots = NULL;
+        Capture->Queue = NULL;
+        Capture->Raw = NULL;
+
+        return false;
+    }
+
+    for(unsigned int Worker = 0; Worker < ThreadCount; ++Worker)
+    {
+        Capture->Threads[Worker] = std::thread(RunCaptureWorker, Capture, Worker);
+    }
+
+    Capture->Valid = true;
+
+    return true;
+}
+
+//A slot to draw the next frame into, waiting for one to be written out if
+//they're all in use
+CaptureFrame* AcquireCaptureFrame(FrameCapture* Capture)
+{
+    std::unique_lock<std::mutex> Guard(Capture->Lock);
+
+    for(bool Waited = false; ; Waited = true)
+    {
+        for(unsigned int Slot = 0; Slot < Capture->SlotCount; ++Slot)
+        {
+            if(Capture->Slots[Slot].State == CAPTURE_FREE)
+            {
+                Capture->Slots[Slot].State = CAPTURE_DRAWING;
+                return Capture->Slots + Slot;
+            }
+        }
+
+        unsigned long long Start = GetCaptureNanoseconds();
+        Capture->SlotFreed.wait(Guard);
+        Capture->StallNanoseconds += GetCaptureNanoseconds() - Start;
+        Capture->Stalls += Waited ? 0 : 1;
+    }
+}
+
+void SubmitCaptureFrame(FrameCapture* Capture, CaptureFrame* Frame)
+{
+    {
+        std::lock_guard<std::mutex> Guard(Capture->Lock);
+
+        Frame->Number = Capture->Submitted++;
+        Frame->State = CAPTURE_QUEUED;
+        Capture->Queue[(Capture->QueueHead + Capture->QueueCount) % Capture->SlotCount] = (unsigned int)(Frame - Capture->Slots);
+        Capture->QueueCount++;
+    }
+
+    Capture->FrameQueued.notify_one();
+}
+
+void AbandonCaptureFrame(FrameCapture* Capture, CaptureFrame* Frame)
+{
+    {
+        std::lock_guard<std::mutex> Guard(Capture->Lock);
+        Frame->State = CAPTURE_FREE;
+    }
+
+    Capture->Failed.store(true);
+    Capture->SlotFreed.notify_one();
+}
+
+bool CloseFrameCapture(FrameCapture* Capture)
+{
+    if(!Capture->Valid)
+    {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> Guard(Capture->Lock);
+        Capture->Stop = true;
+    }
+
+    Capture->FrameQueued.notify_all();
+
+    for(unsigned int Worker = 0; Worker < Capture->ThreadCount; ++Worker)
+    {
+        Capture->Threads[Worker].join();
+        FreeCaptureEncoder(Capture->Encoders + Worker);
+    }
+
+    if( Capture->Raw && (fclose(Capture->Raw) != 0) )
+    {
+        ReportCaptureFailure(Capture, Capture->Prefix);
+    }
+
+    for(unsigned int Slot = 0; Slot < Capture->SlotCount; ++Slot)
+    {
+        free(Capture->Slots[Slot].Pixels);
+    }
+
+    free(Capture->Slots);
+    free(Capture->Queue);
+
+    Capture->Slots = NULL;
+    Capture->Queue = NULL;
+    Capture->Raw = NULL;
+    Capture->Valid = false;
+
+    return !Capture->Failed.load();
+}
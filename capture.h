@@ -0,0 +1,121 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/*
+ * Frame Capture
+ *
+ * Takes rendered frames, as tightly packed 8 bit RGB rows, and writes them out
+ * on worker threads: as numbered PNG files (<prefix>000000.png, ...) or
+ * back to back into one raw RGB24 file, which video encoders read as is, e.g.
+ *
+ *   ffmpeg -f rawvideo -pixel_format rgb24 -video_size 640x480 -framerate 30 -i game.raw out.mp4
+ *
+ * The raw file can be a named pipe to encode the video while it's rendered.
+ *
+ * Frames are drawn straight into one of a fixed pool of slots, handed over,
+ * and the slot comes back once the frame is written, so nothing is allocated
+ * or copied per frame. The renderer only waits when every slot is still
+ * queued or being written, and that wait is counted as Stalls.
+ *
+ * PNGs are encoded with the Up filter and a single pass, fixed Huffman
+ * deflate: game frames are mostly flat colour, which that gets nearly all of
+ * at a fraction of the cost of a full deflate. Raw frames have to stay in
+ * order, so they're written by one thread.
+ */
+
+enum CaptureConstants{
+    CAPTURE_MAX_THREADS     = 32,
+    CAPTURE_SLOTS_PER_THREAD = 2,
+
+    CAPTURE_HASH_BITS       = 15,
+    CAPTURE_MAX_INSERT      = 16,   //Longest match whose every position is hashed
+    CAPTURE_PATH_MAX        = 512
+};
+
+enum CaptureFormat{
+    CAPTURE_PNG,
+    CAPTURE_RAW
+};
+
+enum CaptureSlotState{
+    CAPTURE_FREE,
+    CAPTURE_DRAWING,    //Handed to the renderer
+    CAPTURE_QUEUED,
+    CAPTURE_WRITING
+};
+
+struct CaptureFrame{
+    unsigned char* Pixels;
+    unsigned int Number;
+    CaptureSlotState State;
+};
+
+//Scratch for one worker's PNG encoding
+struct CaptureEncoder{
+    unsigned char* Filtered;
+    unsigned char* Output;
+    size_t OutputCapacity;
+    int* Head;          //Last position each 3 byte hash was seen at
+};
+
+struct FrameCapture{
+    bool Valid;
+    CaptureFormat Format;
+    char Prefix[CAPTURE_PATH_MAX];
+    FILE* Raw;
+
+    unsigned int Width;
+    unsigned int Height;
+    unsigned int Pitch;
+
+    CaptureFrame* Slots;
+    unsigned int SlotCount;
+    unsigned int* Queue;    //Queued slots in the order they were submitted
+    unsigned int QueueHead;
+    unsigned int QueueCount;
+    unsigned int Submitted;
+    bool Stop;
+
+    std::mutex Lock;
+    std::condition_variable FrameQueued;
+    std::condition_variable SlotFreed;
+
+    std::thread Threads[CAPTURE_MAX_THREADS];
+    CaptureEncoder Encoders[CAPTURE_MAX_THREADS];
+    unsigned int ThreadCount;
+
+    //Written by the workers
+    std::atomic<unsigned long long> Bytes;
+    std::atomic<unsigned long long> EncodeNanoseconds;
+    std::atomic<unsigned int> Written;
+    std::atomic<bool> Failed;
+
+    //Renderer only
+    unsigned int Stalls;
+    unsigned long long StallNanoseconds;
+};
+
+//Output ending in .raw is a raw stream, anything else is the prefix for PNG
+//files
+bool            OpenFrameCapture(FrameCapture* Capture, const char* Output, unsigned int Width, unsigned int Height,
+                                 unsigned int ThreadCount);
+CaptureFrame*   AcquireCaptureFrame(FrameCapture* Capture);
+void            SubmitCaptureFrame(FrameCapture* Capture, CaptureFrame* Frame);
+
+//Hands a slot back unwritten, for a frame that couldn't be drawn. The output
+//is then missing a frame, so the capture counts as failed.
+void            AbandonCaptureFrame(FrameCapture* Capture, CaptureFrame* Frame);
+
+//Writes out everything submitted. False if anything failed to write.
+bool            CloseFrameCapture(FrameCapture* Capture);
+
+size_t          EncodePNG(CaptureEncoder* Encoder, const unsigned char* Pixels, unsigned int Width, unsigned int Height,
+                          unsigned int Pitch);
+
+#endif
@@ -0,0 +1,647 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "arena.cpp"
+#include "jobs.cpp"
+#include "game.cpp"
+#include "pieces.cpp"
+#include "snapshot.cpp"
+#include "lockstep.cpp"
+#include "bot.cpp"
+#include "replay.cpp"
+#include "scorelog.cpp"
+
+/*
+ * Replay Corpus Tool
+ *
+ *   agafb_corpus generate <file> [--games n] [--seed s] [--noise percent] [--max-ticks n] [--keyframe-pieces n] [--scores log]
+ *   agafb_corpus info <file>
+ *   agafb_corpus seek <file> <game> <tick>
+ *   agafb_corpus stats <file> [--threads n] [--pin]
+ *
+ * generate fills an archive with bot games, the noise being the chance each
+ * tick of a random key instead of the bot's, so games end, and can add every
+ * finished game to a score log for agafb_scores as it goes. stats re-runs the
+ * whole corpus through the engine, split at keyframes across job workers, and
+ * checks every stretch ends on exactly the state the next keyframe recorded.
+ */
+
+enum CorpusConstants{
+    CORPUS_DEFAULT_GAMES        = 1000,
+    CORPUS_DEFAULT_NOISE        = 10,
+    CORPUS_DEFAULT_MAX_TICKS    = 100000,
+
+    //Keyframe stretches to a stats job
+    CORPUS_BATCH                = 32
+};
+
+double GetSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ * Generate
+ */
+
+int GenerateCorpus(const char* Path, unsigned int GameCount, unsigned int Seed, unsigned int Noise,
+                   unsigned int MaxTicks, unsigned int KeyframePieces, const char* ScoresPath)
+{
+    ReplayWriter Writer = OpenReplayWriter(Path, KeyframePieces);
+
+    if(!Writer.Valid)
+    {
+        return 1;
+    }
+
+    ScoreLogWriter* Scores = NULL;
+
+    if(ScoresPath)
+    {
+        Scores = new ScoreLogWriter;
+
+        if( !OpenScoreLogWriter(Scores, ScoresPath) )
+        {
+            delete Scores;
+            CloseReplayWriter(&Writer);
+            return 1;
+        }
+    }
+
+    ScoreTracker Tracker;
+    GameEventPair<ReplayWriter, ScoreTracker> Events = {&Writer, &Tracker};
+
+    GameMemory Memory = GenerateGameMemory();
+    BotWeights Weights = DefaultBotWeights();
+    RandomSeries Keys = SeedRandomSeries(Seed ^ 0x9E3779B9);
+    unsigned long long Ticks = 0;
+    double Start = GetSeconds();
+
+    for(unsigned int Index = 0; (Index < GameCount) && Writer.Valid; ++Index)
+    {
+        GameData Game = {};
+        Game.Memory = &Memory;
+        Game.State = INITIALISING;
+        Game.Random = SeedRandomSeries(Seed + Index);
+
+        InputState None = {};
+        Game = SimulateTick(Game, None);
+
+        BeginReplayGame(&Writer, &Game);
+        BeginScoreTracking(&Tracker, Seed + Index);
+
+        for(unsigned int Tick = 0; (Tick < MaxTicks) && (Game.State == RUNNING); ++Tick)
+        {
+            InputState Inputs = GetBotInputs(Game, Weights);
+
+            if(RandomNext(&Keys)%100 < Noise)
+            {
+                static const unsigned int RandomKeys[] = {REPLAY_UP, REPLAY_DOWN, REPLAY_LEFT, REPLAY_RIGHT};
+                Inputs = UnpackReplayInputs(RandomKeys[RandomNext(&Keys)%4]);
+            }
+
+            Game = SimulateTick(Game, Inputs, &Events);
+            RecordReplayTick(&Writer, &Game, PackReplayInputs(Inputs));
+            TrackScoreTicks(&Tracker, &Game, 1);
+        }
+
+        //A game that couldn't be written has no index entry to count
+        if( !EndReplayGame(&Writer) || (Writer.GameCount == 0) )
+        {
+            break;
+        }
+
+        //Only games played to the end have a final score
+        if( Scores && (Game.State == GAMEOVER) )
+        {
+            ScoreRecord Record = FinishScoreTracking(&Tracker, &Game);
+
+            //A tool can afford to wait for the disk
+            while( !SubmitScoreRecord(Scores, &Record) )
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        Ticks += Writer.Index[Writer.GameCount - 1].TickCount;
+    }
+
+    DestroyGameMemory(Memory);
+
+    if( Scores && !CloseScoreLogWriter(Scores) )
+    {
+        printf("Writing %s failed!\n", ScoresPath);
+    }
+
+    delete Scores;
+
+    unsigned int Written = Writer.GameCount;
+
+    if( !CloseReplayWriter(&Writer) )
+    {
+        printf("Writing %s failed!\n", Path);
+        return 1;
+    }
+
+    printf("%u games, %llu ticks in %.1fs\n", Written, Ticks, GetSeconds() - Start);
+
+    return 0;
+}
+
+/*
+ * Info and Seek
+ */
+
+int CompareScores(const void* A, const void* B)
+{
+    unsigned int ScoreA = *(const unsigned int*)A;
+    unsigned int ScoreB = *(const unsigned int*)B;
+
+    return (ScoreA > ScoreB) - (ScoreA < ScoreB);
+}
+
+int PrintCorpusInfo(const ReplayArchive* Archive)
+{
+    unsigned int GameCount = Archive->Header->GameCount;
+    unsigned long long Ticks = 0;
+    unsigned long long Pieces = 0;
+    unsigned long long Keyframes = 0;
+    unsigned long long Lines = 0;
+    unsigned int Finished = 0;
+
+    unsigned int* Scores = (unsigned int*)malloc(sizeof(unsigned int)*(GameCount ? GameCount : 1));
+
+    for(unsigned int Index = 0; Index < GameCount; ++Index)
+    {
+        const ReplayGame* Game = Archive->Games + Index;
+
+        Ticks += Game->TickCount;
+        Pieces += Game->PieceCount;
+        Keyframes += Game->KeyframeCount;
+        Lines += Game->Lines;
+        Finished += (Game->Flags & REPLAY_FINISHED) != 0;
+        Scores[Index] = Game->Score;
+    }
+
+    qsort(Scores, GameCount, sizeof(unsigned int), CompareScores);
+
+    printf("%u games (%u finished) of %s, %llu ticks, %llu pieces, %llu lines, %.1f MB\n",
+           GameCount, Finished, GetPieceSet(Archive->Header->PieceSet)->Name, Ticks, Pieces, Lines,
+           Archive->Size/(1024.0*1024.0));
+    printf("%llu keyframes, one every %u pieces: %.1f%% of the file\n", Keyframes, Archive->Header->KeyframePieces,
+           100.0*Keyframes*sizeof(ReplayKeyframe)/Archive->Size);
+
+    if(GameCount)
+    {
+        printf("Score: min %u, median %u, p90 %u, max %u\n", Scores[0], Scores[GameCount/2],
+               Scores[(GameCount*9)/10], Scores[GameCount - 1]);
+    }
+
+    free(Scores);
+
+    return 0;
+}
+
+int SeekCorpus(const ReplayArchive* Archive, unsigned int GameIndex, unsigned int Tick)
+{
+    if(GameIndex >= Archive->Header->GameCount)
+    {
+        printf("There are only %u games\n", Archive->Header->GameCount);
+        return 1;
+    }
+
+    const ReplayKeyframe* First = GetReplayKeyframes(Archive, GameIndex);
+    GameData Game = GenerateGameFromSnapshot(&First->Snapshot);
+
+    double Start = GetSeconds();
+    bool Found = SeekReplay(Archive, GameIndex, Tick, &Game);
+    double Seek = GetSeconds() - Start;
+
+    if(!Found)
+    {
+        printf("Game %u is only %u ticks long\n", GameIndex, Archive->Games[GameIndex].TickCount);
+        DestroyGame(Game);
+        return 1;
+    }
+
+    //The same tick the slow way, for comparison and as a check
+    GameData Slow = GenerateGameFromSnapshot(&First->Snapshot);
+
+    Start = GetSeconds();
+    Slow = SimulateReplay(Slow, GetReplayInputs(Archive, GameIndex), 0, Tick);
+    double Replay = GetSeconds() - Start;
+
+    GameSnapshot Sought;
+    GameSnapshot Replayed;
+    SaveReplaySnapshot(&Game, &Sought);
+    SaveReplaySnapshot(&Slow, &Replayed);
+
+    printf("Game %u tick %u: score %u, from keyframe at tick %u in %.1fus (replaying from the start %.1fus)%s\n",
+           GameIndex, Tick, Game.Score, FindReplayKeyframe(Archive, GameIndex, Tick)->Tick, Seek*1e6, Replay*1e6,
+           GameSnapshotsEqual(&Sought, &Replayed) ? "" : "  MISMATCH!");
+
+    for(unsigned int Row = 0; Row < GRID_ROWS; ++Row)
+    {
+        char Line[GRID_COLS + 3];
+        Line[0] = '|';
+
+        for(unsigned int Col = 0; Col < GRID_COLS; ++Col)
+        {
+            int PieceRow = (int)Row - Game.FallingTetro.Row;
+            int PieceCol = (int)Col - Game.FallingTetro.Col;
+
+            bool Piece = (PieceRow >= 0) && (PieceRow < (int)Game.FallingTetro.GridSize) &&
+                         (PieceCol >= 0) && (PieceCol < (int)Game.FallingTetro.GridSize) &&
+                         GetBlock(Game.FallingTetro.Grid, PieceRow, PieceCol)->Occupied;
+
+            Line[Col + 1] = Piece ? '@' : GetBlock(Game.MainGrid, Row, Col)->Occupied ? '#' : '.';
+        }
+
+        Line[GRID_COLS + 1] = '|';
+        Line[GRID_COLS + 2] = '\0';
+        printf("%s\n", Line);
+    }
+
+    DestroyGame(Slow);
+    DestroyGame(Game);
+
+    return 0;
+}
+
+/*
+ * Stats
+ *
+ * The corpus is cut into stretches, one per keyframe, running up to the next
+ * keyframe or the end of the game. The stretches are a ParallelFor in batches
+ * over the job workers, each of which re-runs them into its own game and adds
+ * to its own totals, which are summed at the end.
+ */
+
+struct CorpusStats{
+    unsigned long long Stretches;
+    unsigned long long Ticks;
+    unsigned long long Pieces;
+    unsigned long long ScoreGained;
+    unsigned long long Clears[TETROMINO_MAX_SIZE + 1];  //By lines at once
+    unsigned long long Mismatches;                      //Stretches that didn't end on the next keyframe
+
+    //Sampled each time a piece locks
+    unsigned long long Samples;
+    unsigned long long StackHeight;
+    unsigned long long Holes;
+    unsigned long long Bumpiness;
+    unsigned long long StackHeights[GRID_ROWS + 1];
+};
+
+struct CorpusJob{
+    const ReplayArchive* Archive;
+    const unsigned long long* FirstStretch;    //Per game, plus the total at the end
+    unsigned long long StretchCount;
+
+    //Per job worker, every stretch it runs is loaded into its game
+    GameData* Games;
+    CorpusStats* Stats;
+};
+
+void SampleBoard(const GameData* Game, CorpusStats* Stats)
+{
+    unsigned int Heights[GRID_COLS];
+    unsigned int Highest = 0;
+
+    for(unsigned int Col = 0; Col < GRID_COLS; ++Col)
+    {
+        unsigned int Height = 0;
+
+        for(unsigned int Row = 0; Row < GRID_ROWS; ++Row)
+        {
+            bool Occupied = Game->MainGrid.Blocks[Row*GRID_COLS + Col].Occupied != 0;
+
+            if( Occupied && (Height == 0) )
+            {
+                Height = GRID_ROWS - Row;
+            }
+            else if( !Occupied && Height )
+            {
+                Stats->Holes++;
+            }
+        }
+
+        Heights[Col] = Height;
+        Highest = (Height > Highest) ? Height : Highest;
+
+        if(Col)
+        {
+            Stats->Bumpiness += (Height > Heights[Col - 1]) ? Height - Heights[Col - 1] : Heights[Col - 1] - Height;
+        }
+    }
+
+    Stats->Samples++;
+    Stats->StackHeight += Highest;
+    Stats->StackHeights[Highest]++;
+}
+
+//Keyframes from archives written before snapshots held rotations are an
+//older snapshot version, so they're loaded into Game and saved again to
+//compare them the way the re-run state was saved
+bool MatchesKeyframe(const GameSnapshot* Reached, const GameSnapshot* Keyframe, GameData* Game)
+{
+    if(Keyframe->Version == SNAPSHOT_VERSION)
+    {
+        return GameSnapshotsEqual(Reached, Keyframe);
+    }
+
+    GameSnapshot Resaved;
+    LoadGameSnapshot(Keyframe, Game);
+    SaveReplaySnapshot(Game, &Resaved);
+
+    return GameSnapshotsEqual(Reached, &Resaved);
+}
+
+void RunStretch(const ReplayArchive* Archive, unsigned int GameIndex, unsigned int KeyframeIndex, GameData* Game,
+                CorpusStats* Stats)
+{
+    const ReplayGame* Replay = Archive->Games + GameIndex;
+    const ReplayKeyframe* Keyframes = GetReplayKeyframes(Archive, GameIndex);
+    const unsigned char* Inputs = GetReplayInputs(Archive, GameIndex);
+
+    bool Last = (KeyframeIndex + 1 == Replay->KeyframeCount);
+    unsigned int From = Keyframes[KeyframeIndex].Tick;
+    unsigned int To = Last ? Replay->TickCount : Keyframes[KeyframeIndex + 1].Tick;
+
+    LoadGameSnapshot(&Keyframes[KeyframeIndex].Snapshot, Game);
+
+    unsigned int StartScore = Game->Score;
+    unsigned int RandomState = Game->Random.State;
+
+    for(unsigned int Tick = From; Tick < To; ++Tick)
+    {
+        *Game = SimulateTick(*Game, UnpackReplayInputs(Inputs[Tick]));
+
+        if( Game->LinesRemoved && (Game->LinesRemoved <= TETROMINO_MAX_SIZE) )
+        {
+            Stats->Clears[Game->LinesRemoved]++;
+        }
+
+        if(Game->Random.State != RandomState)
+        {
+            RandomState = Game->Random.State;
+            Stats->Pieces++;
+            SampleBoard(Game, Stats);
+        }
+    }
+
+    Stats->Stretches++;
+    Stats->Ticks += To - From;
+    Stats->ScoreGained += Game->Score - StartScore;
+
+    if(!Last)
+    {
+        GameSnapshot Reached;
+        SaveReplaySnapshot(Game, &Reached);
+        Stats->Mismatches += !MatchesKeyframe(&Reached, &Keyframes[KeyframeIndex + 1].Snapshot, Game);
+    }
+}
+
+void RunStatsBatch(void* Data, unsigned long long Begin, unsigned long long End, unsigned int Worker)
+{
+    CorpusJob* Job = (CorpusJob*)Data;
+
+    //The game holding stretch Begin
+    unsigned int Low = 0;
+    unsigned int High = Job->Archive->Header->GameCount;
+
+    while(High - Low > 1)
+    {
+        unsigned int Middle = (Low + High)/2;
+
+        if(Job->FirstStretch[Middle] <= Begin)
+        {
+            Low = Middle;
+        }
+        else
+        {
+            High = Middle;
+        }
+    }
+
+    unsigned int GameIndex = Low;
+
+    for(unsigned long long Stretch = Begin; Stretch < End; ++Stretch)
+    {
+        while(Stretch >= Job->FirstStretch[GameIndex + 1])
+        {
+            ++GameIndex;
+        }
+
+        RunStretch(Job->Archive, GameIndex, (unsigned int)(Stretch - Job->FirstStretch[GameIndex]), Job->Games + Worker,
+                   Job->Stats + Worker);
+    }
+}
+
+int CorpusStatistics(const ReplayArchive* Archive, JobSystem* System)
+{
+    unsigned int GameCount = Archive->Header->GameCount;
+    unsigned int WorkerCount = System->WorkerCount;
+
+    CorpusJob Job;
+    Job.Archive = Archive;
+
+    unsigned long long* FirstStretch = (unsigned long long*)malloc(sizeof(unsigned long long)*(GameCount + 1));
+    FirstStretch[0] = 0;
+
+    for(unsigned int Index = 0; Index < GameCount; ++Index)
+    {
+        FirstStretch[Index + 1] = FirstStretch[Index] + Archive->Games[Index].KeyframeCount;
+    }
+
+    Job.FirstStretch = FirstStretch;
+    Job.StretchCount = FirstStretch[GameCount];
+
+    Job.Stats = (CorpusStats*)calloc(WorkerCount, sizeof(CorpusStats));
+    Job.Games = (GameData*)calloc(WorkerCount, sizeof(GameData));
+
+    for(unsigned int Worker = 0; (Worker < WorkerCount) && GameCount; ++Worker)
+    {
+        Job.Games[Worker] = GenerateGameFromSnapshot(&GetReplayKeyframes(Archive, 0)->Snapshot);
+    }
+
+    ResetJobStats(System);
+
+    double Start = GetSeconds();
+
+    ParallelFor(System, Job.StretchCount, CORPUS_BATCH, RunStatsBatch, &Job);
+
+    double Elapsed = GetSeconds() - Start;
+
+    CorpusStats Total;
+    memset(&Total, 0, sizeof(Total));
+
+    for(unsigned int Index = 0; Index < WorkerCount; ++Index)
+    {
+        const unsigned long long* From = (const unsigned long long*)(Job.Stats + Index);
+        unsigned long long* To = (unsigned long long*)&Total;
+
+        //Every field is a counter
+        for(unsigned int Field = 0; Field < sizeof(CorpusStats)/sizeof(unsigned long long); ++Field)
+        {
+            To[Field] += From[Field];
+        }
+    }
+
+    unsigned long long IndexScore = 0;
+
+    for(unsigned int Index = 0; Index < GameCount; ++Index)
+    {
+        IndexScore += Archive->Games[Index].Score;
+    }
+
+    double Samples = Total.Samples ? (double)Total.Samples : 1.0;
+    unsigned long long Lines = Total.Clears[1] + 2*Total.Clears[2] + 3*Total.Clears[3] + 4*Total.Clears[4];
+
+    printf("Re-ran %llu stretches, %llu ticks on %u threads in %.2fs: %.1f M ticks/s\n",
+           Total.Stretches, Total.Ticks, WorkerCount, Elapsed, Total.Ticks/Elapsed/1e6);
+    PrintJobStats(System);
+    printf("%u games, %llu pieces, %llu lines, score %llu (%.1f per game)\n", GameCount, Total.Pieces, Lines,
+           Total.ScoreGained, GameCount ? (double)Total.ScoreGained/GameCount : 0.0);
+    printf("Clears: %llu single, %llu double, %llu triple, %llu four line\n",
+           Total.Clears[1], Total.Clears[2], Total.Clears[3], Total.Clears[4]);
+    printf("At each lock: stack height %.2f, holes %.2f, bumpiness %.2f\n",
+           Total.StackHeight/Samples, Total.Holes/Samples, Total.Bumpiness/Samples);
+
+    printf("Stack height:");
+    for(unsigned int Height = 0; Height <= GRID_ROWS; ++Height)
+    {
+        printf(" %.1f%%", 100.0*Total.StackHeights[Height]/Samples);
+    }
+    printf("\n");
+
+    bool Consistent = (Total.Mismatches == 0) && (Total.ScoreGained == IndexScore);
+
+    printf("%llu stretches disagreed with their next keyframe, index score %s\n", Total.Mismatches,
+           (Total.ScoreGained == IndexScore) ? "matches" : "DIFFERS");
+
+    for(unsigned int Worker = 0; (Worker < WorkerCount) && GameCount; ++Worker)
+    {
+        DestroyGame(Job.Games[Worker]);
+    }
+
+    free(Job.Games);
+    free(Job.Stats);
+    free(FirstStretch);
+
+    return Consistent ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 3)
+    {
+        printf("Usage: %s generate <file> [--games n] [--seed s] [--noise percent] [--max-ticks n] [--keyframe-pieces n] [--scores log]\n"
+               "       %s info <file>\n"
+               "       %s seek <file> <game> <tick>\n"
+               "       %s stats <file> [--threads n] [--pin]\n", argv[0], argv[0], argv[0], argv[0]);
+        return 1;
+    }
+
+    const char* Command = argv[1];
+    const char* Path = argv[2];
+
+    unsigned int GameCount = CORPUS_DEFAULT_GAMES;
+    unsigned int Seed = 1;
+    unsigned int Noise = CORPUS_DEFAULT_NOISE;
+    unsigned int MaxTicks = CORPUS_DEFAULT_MAX_TICKS;
+    unsigned int KeyframePieces = REPLAY_DEFAULT_KEYFRAME_PIECES;
+    unsigned int ThreadCount = std::thread::hardware_concurrency();
+    bool Pin = false;
+    const char* ScoresPath = NULL;
+    unsigned int Positional[2] = {0, 0};
+    unsigned int PositionalCount = 0;
+
+    for(int Arg = 3; Arg < argc; ++Arg)
+    {
+        bool HasValue = (Arg + 1 < argc);
+
+        if( HasValue && (strcmp(argv[Arg], "--games") == 0) )
+        {
+            GameCount = atoi(argv[++Arg]);
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--seed") == 0) )
+        {
+            Seed = atoi(argv[++Arg]);
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--noise") == 0) )
+        {
+            Noise = atoi(argv[++Arg]);
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--max-ticks") == 0) )
+        {
+            MaxTicks = atoi(argv[++Arg]);
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--keyframe-pieces") == 0) )
+        {
+            KeyframePieces = atoi(argv[++Arg]);
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--scores") == 0) )
+        {
+            ScoresPath = argv[++Arg];
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--threads") == 0) )
+        {
+            ThreadCount = atoi(argv[++Arg]);
+        }
+        else if(strcmp(argv[Arg], "--pin") == 0)
+        {
+            Pin = true;
+        }
+        else if(PositionalCount < 2)
+        {
+            Positional[PositionalCount++] = atoi(argv[Arg]);
+        }
+    }
+
+    ThreadCount = ThreadCount ? ThreadCount : 1;
+
+    if(strcmp(Command, "generate") == 0)
+    {
+        return GenerateCorpus(Path, GameCount, Seed, Noise, MaxTicks, KeyframePieces, ScoresPath);
+    }
+
+    ReplayArchive Archive = OpenReplayArchive(Path);
+
+    if(!Archive.Valid)
+    {
+        return 1;
+    }
+
+    int Result = 1;
+
+    if(strcmp(Command, "info") == 0)
+    {
+        Result = PrintCorpusInfo(&Archive);
+    }
+    else if( (strcmp(Command, "seek") == 0) && (PositionalCount == 2) )
+    {
+        Result = SeekCorpus(&Archive, Positional[0], Positional[1]);
+    }
+    else if(strcmp(Command, "stats") == 0)
+    {
+        JobSystem* System = CreateJobSystem(ThreadCount, Pin);
+
+        if(System)
+        {
+            Result = CorpusStatistics(&Archive, System);
+            DestroyJobSystem(System);
+        }
+    }
+    else
+    {
+        printf("Unknown command %s\n", Command);
+    }
+
+    CloseReplayArchive(&Archive);
+
+    return Result;
+}
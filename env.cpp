@@ -0,0 +1,481 @@
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "arena.cpp"
+#include "game.cpp"
+#include "pieces.cpp"
+#include "lockstep.cpp"
+
+#include "agafb_env.h"
+
+static_assert(AGAFB_ROWS == GRID_ROWS && AGAFB_COLS == GRID_COLS, "Environment board size out of step with the game");
+static_assert(AGAFB_ACTION_LEFT == LOCKSTEP_LEFT && AGAFB_ACTION_RIGHT == LOCKSTEP_RIGHT &&
+        AGAFB_ACTION_ROTATE == LOCKSTEP_ROTATE && AGAFB_ACTION_DOWN == LOCKSTEP_DOWN, "Environment actions out of step with the lockstep inputs");
+
+/*
+ * Single environment, a GameData driven through the normal update functions
+ */
+
+//Each environment allocates only from its own session memory, so
+//environments on different threads never meet in malloc, and a reset
+//reclaims the last game's memory wholesale
+struct AgafbEnv{
+    GameData Game;
+    GameMemory Memory;
+};
+
+void WriteGameObservation(GameData* Game, unsigned int ScoreDelta, AgafbObservation* Obs)
+{
+    for(unsigned int Row = 0; Row < GRID_ROWS; ++Row)
+    {
+        for(unsigned int Col = 0; Col < GRID_COLS; ++Col)
+        {
+            Obs->Board[Row][Col] = GetBlock(Game->MainGrid, Row, Col)->Occupied;
+        }
+    }
+
+    memset(Obs->Piece, 0, sizeof(Obs->Piece));
+
+    Tetromino* Tetro = &Game->FallingTetro;
+
+    for(unsigned int Row = 0; Row < Tetro->Grid.Rows; ++Row)
+    {
+        for(unsigned int Col = 0; Col < Tetro->Grid.Cols; ++Col)
+        {
+            unsigned int GridRow = Tetro->Row + Row;
+            unsigned int GridCol = Tetro->Col + Col;
+
+            if( GetBlock(Tetro->Grid, Row, Col)->Occupied && (GridRow < GRID_ROWS) && (GridCol < GRID_COLS) )
+            {
+                Obs->Piece[GridRow][GridCol] = 1;
+            }
+        }
+    }
+
+    Obs->CurrentPiece = Tetro->Type;
+    Obs->NextPiece = Game->NextTetro.Type;
+    Obs->ScoreDelta = ScoreDelta;
+    Obs->Score = Game->Score;
+    Obs->LinesRemoved = Game->LinesRemoved;
+    Obs->Done = (Game->State == GAMEOVER);
+}
+
+unsigned int agafb_observation_size(void)
+{
+    return sizeof(AgafbObservation);
+}
+
+AgafbEnv* agafb_env_create(void)
+{
+    AgafbEnv* Result = (AgafbEnv*)calloc(1, sizeof(AgafbEnv));
+
+    if(Result)
+    {
+        Result->Memory = GenerateGameMemory();
+
+        if(Result->Memory.Session.Base == NULL)
+        {
+            free(Result);
+            Result = NULL;
+        }
+    }
+
+    return Result;
+}
+
+void agafb_env_destroy(AgafbEnv* Env)
+{
+    if(Env)
+    {
+        DestroyGameMemory(Env->Memory);
+        free(Env);
+    }
+}
+
+void agafb_env_reset(AgafbEnv* Env, unsigned int Seed, AgafbObservation* Obs)
+{
+    memset(&Env->Game, 0, sizeof(Env->Game));
+    Env->Game.State = INITIALISING;
+    Env->Game.Random = SeedRandomSeries(Seed);
+    Env->Game.Memory = &Env->Memory;
+    Env->Game = InitialiseGame(Env->Game);
+
+    if(Obs)
+    {
+        WriteGameObservation(&Env->Game, 0, Obs);
+    }
+}
+
+int agafb_env_step(AgafbEnv* Env, unsigned int Action, AgafbObservation* Obs)
+{
+    //There's no game, or even a board, until the first reset
+    if(Env->Game.MainGrid.Blocks == NULL)
+    {
+        return -1;
+    }
+
+    if(Env->Game.State != RUNNING)
+    {
+        if(Obs)
+        {
+            WriteGameObservation(&Env->Game, 0, Obs);
+        }
+
+        return 1;
+    }
+
+    InputState Inputs = {};
+    Inputs.Left  = (Action & AGAFB_ACTION_LEFT) != 0;
+    Inputs.Right = (Action & AGAFB_ACTION_RIGHT) != 0;
+    Inputs.Up    = (Action & AGAFB_ACTION_ROTATE) != 0;
+    Inputs.Down  = (Action & AGAFB_ACTION_DOWN) != 0;
+
+    unsigned int PreviousScore = Env->Game.Score;
+
+    Env->Game = HandleInputGame(Inputs, Env->Game);
+    Env->Game = UpdateGame(Env->Game);
+
+    if(Obs)
+    {
+        WriteGameObservation(&Env->Game, Env->Game.Score - PreviousScore, Obs);
+    }
+
+    return Env->Game.State == GAMEOVER;
+}
+
+void agafb_env_step_many(AgafbEnv** Envs, const unsigned int* Actions, AgafbObservation* Obs, unsigned int Count)
+{
+    for(unsigned int Index = 0; Index < Count; ++Index)
+    {
+        agafb_env_step(Envs[Index], Actions[Index], Obs ? Obs + Index : NULL);
+    }
+}
+
+/*
+ * Vectorised environments
+ *
+ * Environments are grouped into blocks of lockstep lanes, which are tick for
+ * tick identical to the single environment's GameData, and each worker thread
+ * owns a contiguous run of blocks. The calling thread works through the first
+ * run itself while the workers do the rest.
+ */
+
+enum VecEnvConstants{
+    VEC_ENV_LANES = 8
+};
+
+typedef LockstepGames<VEC_ENV_LANES> VecEnvBlock;
+
+struct VecEnvWorker{
+    std::thread Thread;
+    unsigned int FirstBlock;
+    unsigned int BlockCount;
+};
+
+struct AgafbVecEnv{
+    unsigned int Count;
+    unsigned int BlockCount;
+    VecEnvBlock* Blocks;
+    unsigned int* PreviousScore;
+
+    //Caller's own share of the blocks
+    unsigned int FirstBlock;
+    unsigned int OwnBlockCount;
+
+    unsigned int WorkerCount;
+    VecEnvWorker* Workers;
+
+    //Work handed out to the workers for the current generation
+    std::mutex Lock;
+    std::condition_variable WorkReady;
+    std::condition_variable WorkDone;
+    unsigned int Generation;
+    unsigned int Remaining;
+    bool Quit;
+
+    const unsigned int* Actions;
+    AgafbObservation* Obs;
+};
+
+void WriteLaneObservation(VecEnvBlock* Block, unsigned int Lane, unsigned int ScoreDelta, AgafbObservation* Obs)
+{
+    for(unsigned int Row = 0; Row < GRID_ROWS; ++Row)
+    {
+        unsigned int Mask = Block->RowMasks[Row][Lane] >> LOCKSTEP_WALL;
+
+        for(unsigned int Col = 0; Col < GRID_COLS; ++Col)
+        {
+            Obs->Board[Row][Col] = (Mask >> Col) & 1;
+        }
+    }
+
+    memset(Obs->Piece, 0, sizeof(Obs->Piece));
+
+    const unsigned int* Shape = LockstepShapes.Rows[Block->Type[Lane]][Block->Rotation[Lane]];
+
+    for(unsigned int Row = 0; Row < TETROMINO_MAX_SIZE; ++Row)
+    {
+        for(unsigned int Col = 0; Col < TETROMINO_MAX_SIZE; ++Col)
+        {
+            unsigned int GridRow = Block->Row[Lane] + Row;
+            unsigned int GridCol = Block->Col[Lane] + Col;
+
+            if( ((Shape[Row] >> Col) & 1) && (GridRow < GRID_ROWS) && (GridCol < GRID_COLS) )
+            {
+                Obs->Piece[GridRow][GridCol] = 1;
+            }
+        }
+    }
+
+    Obs->CurrentPiece = Block->Type[Lane];
+    Obs->NextPiece = Block->NextType[Lane];
+    Obs->ScoreDelta = ScoreDelta;
+    Obs->Score = Block->Score[Lane];
+    Obs->LinesRemoved = Block->LinesRemoved[Lane];
+    Obs->Done = (Block->State[Lane] == GAMEOVER);
+}
+
+void StepVecEnvBlocks(AgafbVecEnv* VecEnv, unsigned int FirstBlock, unsigned int BlockCount)
+{
+    for(unsigned int BlockIndex = FirstBlock; BlockIndex < FirstBlock + BlockCount; ++BlockIndex)
+    {
+        VecEnvBlock* Block = VecEnv->Blocks + BlockIndex;
+        unsigned int First = BlockIndex*VEC_ENV_LANES;
+
+        //The last block can be partly filled, spare lanes stay in GAMEOVER
+        unsigned int Inputs[VEC_ENV_LANES] = {};
+        unsigned int Lanes = VecEnv->Count - First;
+        Lanes = (Lanes < VEC_ENV_LANES) ? Lanes : (unsigned int)VEC_ENV_LANES;
+
+        for(unsigned int Lane = 0; Lane < Lanes; ++Lane)
+        {
+            //Games that finished last step start again from where their
+            //random series left off
+            if(Block->State[Lane] == GAMEOVER)
+            {
+                InitialiseLockstepLane(Block, Lane);
+                VecEnv->PreviousScore[First + Lane] = 0;
+            }
+
+            Inputs[Lane] = VecEnv->Actions[First + Lane];
+        }
+
+        StepLockstepGames(Block, Inputs);
+
+        for(unsigned int Lane = 0; Lane < Lanes; ++Lane)
+        {
+            unsigned int Score = Block->Score[Lane];
+
+            if(VecEnv->Obs)
+            {
+                WriteLaneObservation(Block, Lane, Score - VecEnv->PreviousScore[First + Lane], VecEnv->Obs + First + Lane);
+            }
+
+            VecEnv->PreviousScore[First + Lane] = Score;
+        }
+    }
+}
+
+void VecEnvWorkerLoop(AgafbVecEnv* VecEnv, VecEnvWorker* Worker)
+{
+    unsigned int Seen = 0;
+
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> Guard(VecEnv->Lock);
+            VecEnv->WorkReady.wait(Guard, [&]{ return VecEnv->Quit || (VecEnv->Generation != Seen); });
+
+            if(VecEnv->Quit)
+            {
+                return;
+            }
+
+            Seen = VecEnv->Generation;
+        }
+
+        StepVecEnvBlocks(VecEnv, Worker->FirstBlock, Worker->BlockCount);
+
+        std::lock_guard<std::mutex> Guard(VecEnv->Lock);
+
+        if(--VecEnv->Remaining == 0)
+        {
+            VecEnv->WorkDone.notify_one();
+        }
+    }
+}
+
+AgafbVecEnv* agafb_vec_create(unsigned int Count, unsigned int Threads)
+{
+    if(Count == 0)
+    {
+        return NULL;
+    }
+
+    BuildLockstepShapes();
+
+    AgafbVecEnv* Result = new AgafbVecEnv();
+
+    Result->Count = Count;
+    Result->BlockCount = (Count + VEC_ENV_LANES - 1)/VEC_ENV_LANES;
+    Result->Blocks = (VecEnvBlock*)calloc(Result->BlockCount, sizeof(VecEnvBlock));
+    Result->PreviousScore = (unsigned int*)calloc(Count, sizeof(unsigned int));
+
+    for(unsigned int BlockIndex = 0; BlockIndex < Result->BlockCount; ++BlockIndex)
+    {
+        for(unsigned int Lane = 0; Lane < VEC_ENV_LANES; ++Lane)
+        {
+            Result->Blocks[BlockIndex].State[Lane] = GAMEOVER;
+        }
+    }
+
+    //No point having more threads than blocks
+    if(Threads == 0)
+    {
+        Threads = std::thread::hardware_concurrency();
+    }
+
+    Threads = (Threads < Result->BlockCount) ? Threads : Result->BlockCount;
+    Threads = Threads ? Threads : 1;
+
+    unsigned int PerThread = Result->BlockCount/Threads;
+    unsigned int Extra = Result->BlockCount%Threads;
+
+    Result->FirstBlock = 0;
+    Result->OwnBlockCount = PerThread + (Extra > 0);
+
+    Result->WorkerCount = Threads - 1;
+    Result->Workers = new VecEnvWorker[Result->WorkerCount];
+
+    unsigned int NextBlock = Result->OwnBlockCount;
+
+    for(unsigned int Index = 0; Index < Result->WorkerCount; ++Index)
+    {
+        VecEnvWorker* Worker = Result->Workers + Index;
+
+        Worker->FirstBlock = NextBlock;
+        Worker->BlockCount = PerThread + ((Index + 1) < Extra);
+        NextBlock += Worker->BlockCount;
+
+        Worker->Thread = std::thread(VecEnvWorkerLoop, Result, Worker);
+    }
+
+    agafb_vec_reset(Result, 0, NULL);
+
+    return Result;
+}
+
+void agafb_vec_destroy(AgafbVecEnv* VecEnv)
+{
+    if(!VecEnv)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> Guard(VecEnv->Lock);
+        VecEnv->Quit = true;
+    }
+
+    VecEnv->WorkReady.notify_all();
+
+    for(unsigned int Index = 0; Index < VecEnv->WorkerCount; ++Index)
+    {
+        VecEnv->Workers[Index].Thread.join();
+    }
+
+    delete[] VecEnv->Workers;
+    free(VecEnv->Blocks);
+    free(VecEnv->PreviousScore);
+    delete VecEnv;
+}
+
+void agafb_vec_reset(AgafbVecEnv* VecEnv, unsigned int Seed, AgafbObservation* Obs)
+{
+    for(unsigned int Index = 0; Index < VecEnv->Count; ++Index)
+    {
+        VecEnvBlock* Block = VecEnv->Blocks + Index/VEC_ENV_LANES;
+        unsigned int Lane = Index%VEC_ENV_LANES;
+
+        SeedLockstepLane(Block, Lane, Seed + Index);
+        VecEnv->PreviousScore[Index] = 0;
+
+        if(Obs)
+        {
+            WriteLaneObservation(Block, Lane, 0, Obs + Index);
+        }
+    }
+}
+
+void agafb_vec_step(AgafbVecEnv* VecEnv, const unsigned int* Actions, AgafbObservation* Obs)
+{
+    VecEnv->Actions = Actions;
+    VecEnv->Obs = Obs;
+
+    if(VecEnv->WorkerCount)
+    {
+        std::lock_guard<std::mutex> Guard(VecEnv->Lock);
+        VecEnv->Remaining = VecEnv->WorkerCount;
+        ++VecEnv->Generation;
+    }
+
+    VecEnv->WorkReady.notify_all();
+
+    StepVecEnvBlocks(VecEnv, VecEnv->FirstBlock, VecEnv->OwnBlockCount);
+
+    if(VecEnv->WorkerCount)
+    {
+        std::unique_lock<std::mutex> Guard(VecEnv->Lock);
+        VecEnv->WorkDone.wait(Guard, [&]{ return VecEnv->Remaining == 0; });
+    }
+}
+
+/*
+ * Shared memory observations
+ */
+
+AgafbObservation* agafb_shm_open(const char* Name, unsigned int Count, int Create)
+{
+#if defined(_WIN32)
+    return NULL;
+#else
+    size_t Size = sizeof(AgafbObservation)*Count;
+
+    int File = shm_open(Name, O_RDWR | (Create ? O_CREAT : 0), 0600);
+
+    if(File < 0)
+    {
+        return NULL;
+    }
+
+    if(Create && (ftruncate(File, Size) != 0))
+    {
+        close(File);
+        return NULL;
+    }
+
+    void* Memory = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_SHARED, File, 0);
+    close(File);
+
+    return (Memory == MAP_FAILED) ? NULL : (AgafbObservation*)Memory;
+#endif
+}
+
+void agafb_shm_close(AgafbObservation* Obs, unsigned int Count)
+{
+#if !defined(_WIN32)
+    if(Obs)
+    {
+        munmap(Obs, sizeof(AgafbObservation)*Count);
+    }
+#endif
+}
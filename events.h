@@ -0,0 +1,136 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include "game.h"
+
+/*
+ * Game Events
+ *
+ * What a tick did, as it does it: SimulateTick(Game, Inputs, Events) calls
+ * these for Events as each thing happens. A listener is any struct with its
+ * own overloads of the ones it cares about, taking a pointer to it first:
+ *
+ *   void OnPieceLocked(ScoreTracker* Tracker, const Tetromino& Piece);
+ *
+ * Which overload gets called is settled when SimulateTick is compiled for
+ * the listener, so there's no function pointer or virtual call anywhere, and
+ * the events a listener doesn't handle fall through to the empty templates
+ * below and compile to nothing. Plain SimulateTick(Game, Inputs) listens with
+ * NoGameEvents, and is the same code it was before there were events.
+ *
+ * In the order they happen in a tick:
+ *
+ *   OnPieceMoved       Left, right or down, by input or by gravity
+ *   OnPieceLocked      Stored into the grid, just before it's destroyed
+ *   OnPieceSpawned     Started falling, at the start of a game or after a lock
+ *   OnPieceRotated     Clockwise, FromRotation being its rotation before
+ *   OnLinesCleared     Rows are where the lines were before they were
+ *                      removed, bottom first, 0 being the top row
+ *   OnScoreChanged
+ *   OnStateChanged
+ *
+ * Piece is the falling piece as it is after the event. Listeners mustn't hold
+ * on to its grid, which goes back to the pool once the piece locks.
+ */
+
+struct NoGameEvents{
+};
+
+template<typename Listener>
+inline void OnPieceMoved(Listener*, const Tetromino&, int, int)
+{
+}
+
+template<typename Listener>
+inline void OnPieceLocked(Listener*, const Tetromino&)
+{
+}
+
+template<typename Listener>
+inline void OnPieceSpawned(Listener*, const Tetromino&)
+{
+}
+
+template<typename Listener>
+inline void OnPieceRotated(Listener*, const Tetromino&, unsigned int)
+{
+}
+
+template<typename Listener>
+inline void OnLinesCleared(Listener*, const unsigned int*, unsigned int)
+{
+}
+
+template<typename Listener>
+inline void OnScoreChanged(Listener*, unsigned int, unsigned int)
+{
+}
+
+template<typename Listener>
+inline void OnStateChanged(Listener*, GameState, GameState)
+{
+}
+
+/*
+ * Pairs
+ *
+ * Two listeners as one, either of which can be NULL. Pairs nest, for more
+ * than two.
+ */
+
+template<typename First, typename Second>
+struct GameEventPair{
+    First* A;
+    Second* B;
+};
+
+template<typename First, typename Second>
+inline void OnPieceMoved(GameEventPair<First, Second>* Events, const Tetromino& Piece, int FromRow, int FromCol)
+{
+    if(Events->A) OnPieceMoved(Events->A, Piece, FromRow, FromCol);
+    if(Events->B) OnPieceMoved(Events->B, Piece, FromRow, FromCol);
+}
+
+template<typename First, typename Second>
+inline void OnPieceLocked(GameEventPair<First, Second>* Events, const Tetromino& Piece)
+{
+    if(Events->A) OnPieceLocked(Events->A, Piece);
+    if(Events->B) OnPieceLocked(Events->B, Piece);
+}
+
+template<typename First, typename Second>
+inline void OnPieceSpawned(GameEventPair<First, Second>* Events, const Tetromino& Piece)
+{
+    if(Events->A) OnPieceSpawned(Events->A, Piece);
+    if(Events->B) OnPieceSpawned(Events->B, Piece);
+}
+
+template<typename First, typename Second>
+inline void OnPieceRotated(GameEventPair<First, Second>* Events, const Tetromino& Piece, unsigned int FromRotation)
+{
+    if(Events->A) OnPieceRotated(Events->A, Piece, FromRotation);
+    if(Events->B) OnPieceRotated(Events->B, Piece, FromRotation);
+}
+
+template<typename First, typename Second>
+inline void OnLinesCleared(GameEventPair<First, Second>* Events, const unsigned int* Rows, unsigned int Count)
+{
+    if(Events->A) OnLinesCleared(Events->A, Rows, Count);
+    if(Events->B) OnLinesCleared(Events->B, Rows, Count);
+}
+
+template<typename First, typename Second>
+inline void OnScoreChanged(GameEventPair<First, Second>* Events, unsigned int From, unsigned int To)
+{
+    if(Events->A) OnScoreChanged(Events->A, From, To);
+    if(Events->B) OnScoreChanged(Events->B, From, To);
+}
+
+template<typename First, typename Second>
+inline void OnStateChanged(GameEventPair<First, Second>* Events, GameState From, GameState To)
+{
+    if(Events->A) OnStateChanged(Events->A, From, To);
+    if(Events->B) OnStateChanged(Events->B, From, To);
+}
+
+#endif
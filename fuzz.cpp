@@ -0,0 +1,754 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "arena.cpp"
+#include "jobs.cpp"
+#include "game.cpp"
+#include "pieces.cpp"
+#include "lockstep.cpp"
+
+/*
+ * Differential Fuzzer
+ *
+ *   agafb_fuzz [--ticks n] [--max-ticks n] [--threads n] [--pin] [--seed s] [--generic] [--inject-fault]
+ *   agafb_fuzz replay --seed s --lane l --trace hex [--generic] [--inject-fault]
+ *
+ * Plays the reference engine (GameData through SimulateTick, so BlockGrid,
+ * CheckCollisions, RemoveGridLines and RotateTetroClockwise) and the lockstep
+ * engine side by side on the same seeds and random keys, and compares every
+ * part of the state both have - board, falling and next piece, timer, score,
+ * lines, random state and game state - after every tick.
+ *
+ * The reference engine's pieces come from the piece table, while the lockstep
+ * engine builds its shapes from the original block coordinates and rotation,
+ * so a mistake in either shows up as a disagreement. The reference engine
+ * takes the fixed dimension rule paths on the standard board; --generic makes
+ * it take the runtime sized ones instead.
+ *
+ * Games are played in batches of FUZZ_BATCH consecutive seeds, a batch list
+ * being a ParallelFor on the job system (see jobs.h). Each job worker keeps
+ * one LockstepGames of FUZZ_LANES games and a GameData for each lane for the
+ * whole campaign, and starts the batch's next seed whenever a lane's game
+ * ends. A game ends at game over, after max-ticks, or at the first tick the
+ * engines disagree. How many games --ticks takes isn't known up front, so
+ * batches go out a round at a time, and no new games start once the campaign
+ * has played that many ticks. --pin pins the workers to CPUs.
+ *
+ * The first few disagreements are shrunk: whole ticks, then keys, then single
+ * key bits are taken out of the trace for as long as the engines still
+ * disagree somewhere, and the trace is cut at the first tick they do. What's
+ * left is printed as a hex digit of LockstepInput bits per tick that replay
+ * runs again, printing both states at each tick.
+ *
+ * --inject-fault corrupts the lockstep board after every line clear, to check
+ * the harness itself catches and shrinks a real difference.
+ */
+
+enum FuzzConstants{
+    FUZZ_LANES              = 8,
+    FUZZ_DEFAULT_TICKS      = 10000000,
+    FUZZ_DEFAULT_MAX_TICKS  = 20000,
+
+    //Games a job plays, keeping its lanes full until the last few
+    FUZZ_BATCH              = 32,
+
+    //Batches per job worker in each round
+    FUZZ_ROUND_BATCHES      = 8,
+
+    //Divergences kept, and shrunk, per campaign
+    FUZZ_MAX_FAILURES       = 4,
+
+    FUZZ_MESSAGE_SIZE       = 160
+};
+
+double GetSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//Keys for a game come from their own series so they don't disturb the
+//game's. Left, right and rotate a quarter of the time each, down a third.
+unsigned int NextFuzzInput(RandomSeries* Keys)
+{
+    unsigned int Rand = RandomNext(Keys);
+    unsigned int Result = 0;
+
+    Result |= ((Rand & 3) == 0) ? LOCKSTEP_LEFT : 0;
+    Result |= (((Rand >> 2) & 3) == 0) ? LOCKSTEP_RIGHT : 0;
+    Result |= (((Rand >> 4) & 3) == 0) ? LOCKSTEP_ROTATE : 0;
+    Result |= (((Rand >> 8)%3) == 0) ? LOCKSTEP_DOWN : 0;
+
+    return Result;
+}
+
+RandomSeries SeedFuzzKeys(unsigned int Seed)
+{
+    return SeedRandomSeries(Seed ^ 0x5BD1E995);
+}
+
+InputState GetFuzzInputState(unsigned int Input)
+{
+    InputState Result = {};
+
+    Result.Left  = (Input & LOCKSTEP_LEFT) != 0;
+    Result.Right = (Input & LOCKSTEP_RIGHT) != 0;
+    Result.Up    = (Input & LOCKSTEP_ROTATE) != 0;
+    Result.Down  = (Input & LOCKSTEP_DOWN) != 0;
+
+    return Result;
+}
+
+/*
+ * Engines
+ */
+
+struct FuzzEngine{
+    LockstepGames<FUZZ_LANES> Lockstep;
+    GameData Games[FUZZ_LANES];
+    GameMemory Memory[FUZZ_LANES];
+    bool InjectFault;
+};
+
+void OpenFuzzEngine(FuzzEngine* Engine, bool InjectFault)
+{
+    memset(Engine, 0, sizeof(*Engine));
+    Engine->InjectFault = InjectFault;
+
+    for(unsigned int Lane = 0; Lane < FUZZ_LANES; ++Lane)
+    {
+        Engine->Memory[Lane] = GenerateGameMemory();
+
+        //Idle until a game starts in the lane
+        Engine->Lockstep.State[Lane] = GAMEOVER;
+    }
+}
+
+void CloseFuzzEngine(FuzzEngine* Engine)
+{
+    for(unsigned int Lane = 0; Lane < FUZZ_LANES; ++Lane)
+    {
+        DestroyGameMemory(Engine->Memory[Lane]);
+    }
+}
+
+void StartFuzzGame(FuzzEngine* Engine, unsigned int Lane, unsigned int Seed)
+{
+    GameData Game = {};
+    Game.Memory = Engine->Memory + Lane;
+    Game.State = INITIALISING;
+    Game.Random = SeedRandomSeries(Seed);
+
+    Engine->Games[Lane] = SimulateTick(Game, GetFuzzInputState(0));
+
+    SeedLockstepLane(&Engine->Lockstep, Lane, Seed);
+}
+
+void StopFuzzGame(FuzzEngine* Engine, unsigned int Lane)
+{
+    Engine->Lockstep.State[Lane] = GAMEOVER;
+}
+
+//One tick of both engines, for the lanes in Active
+void StepFuzzEngine(FuzzEngine* Engine, unsigned int Active, const unsigned int* Inputs)
+{
+    unsigned int LaneInputs[FUZZ_LANES];
+
+    for(unsigned int Lane = 0; Lane < FUZZ_LANES; ++Lane)
+    {
+        LaneInputs[Lane] = (Active & (1u << Lane)) ? Inputs[Lane] : 0;
+    }
+
+    StepLockstepGames(&Engine->Lockstep, LaneInputs);
+
+    for(unsigned int Lanes = Active; Lanes; Lanes &= Lanes - 1)
+    {
+        unsigned int Lane = CountTrailingZeros(Lanes);
+
+        Engine->Games[Lane] = SimulateTick(Engine->Games[Lane], GetFuzzInputState(Inputs[Lane]));
+
+        if( Engine->InjectFault && (Engine->Lockstep.LinesRemoved[Lane] > 0) )
+        {
+            Engine->Lockstep.RowMasks[GRID_ROWS - 1][Lane] ^= 1u << LOCKSTEP_WALL;
+        }
+    }
+}
+
+//False, with what differs in Message, if the lane's engines disagree
+bool CompareFuzzLane(const FuzzEngine* Engine, unsigned int Lane, char* Message)
+{
+    const GameData* Game = Engine->Games + Lane;
+    const LockstepGames<FUZZ_LANES>* Lockstep = &Engine->Lockstep;
+
+    if(Game->State != (GameState)Lockstep->State[Lane])
+    {
+        snprintf(Message, FUZZ_MESSAGE_SIZE, "state: reference %u, lockstep %u", Game->State, Lockstep->State[Lane]);
+        return false;
+    }
+
+    if(Game->Random.State != Lockstep->Random[Lane])
+    {
+        snprintf(Message, FUZZ_MESSAGE_SIZE, "random state: reference %08x, lockstep %08x",
+                 Game->Random.State, Lockstep->Random[Lane]);
+        return false;
+    }
+
+    if( (Game->Score != Lockstep->Score[Lane]) || (Game->LinesRemoved != Lockstep->LinesRemoved[Lane]) )
+    {
+        snprintf(Message, FUZZ_MESSAGE_SIZE, "score/lines: reference %u/%u, lockstep %u/%u",
+                 Game->Score, Game->LinesRemoved, Lockstep->Score[Lane], Lockstep->LinesRemoved[Lane]);
+        return false;
+    }
+
+    if(Game->FallingTimer != Lockstep->FallingTimer[Lane])
+    {
+        snprintf(Message, FUZZ_MESSAGE_SIZE, "falling timer: reference %u, lockstep %u",
+                 Game->FallingTimer, Lockstep->FallingTimer[Lane]);
+        return false;
+    }
+
+    const Tetromino* Tetro = &Game->FallingTetro;
+
+    if( ((unsigned int)Tetro->Type != Lockstep->Type[Lane]) || (Tetro->Row != Lockstep->Row[Lane]) ||
+        (Tetro->Col != Lockstep->Col[Lane]) || ((unsigned int)Game->NextTetro.Type != Lockstep->NextType[Lane]) )
+    {
+        snprintf(Message, FUZZ_MESSAGE_SIZE, "piece (type, row, col, next): reference %u %d %d %u, lockstep %u %d %d %u",
+                 Tetro->Type, Tetro->Row, Tetro->Col, Game->NextTetro.Type,
+                 Lockstep->Type[Lane], Lockstep->Row[Lane], Lockstep->Col[Lane], Lockstep->NextType[Lane]);
+        return false;
+    }
+
+    const unsigned int* Shape = LockstepShapes.Rows[Lockstep->Type[Lane]][Lockstep->Rotation[Lane]];
+
+    for(unsigned int Row = 0; Row < TETROMINO_MAX_SIZE; ++Row)
+    {
+        unsigned int Mask = 0;
+
+        for(unsigned int Col = 0; (Row < Tetro->GridSize) && (Col < Tetro->GridSize); ++Col)
+        {
+            Mask |= GetBlock(Tetro->Grid, Row, Col)->Occupied ? (1u << Col) : 0;
+        }
+
+        if(Mask != Shape[Row])
+        {
+            snprintf(Message, FUZZ_MESSAGE_SIZE, "piece row %u: reference %x, lockstep %x (rotation %u)",
+                     Row, Mask, Shape[Row], Lockstep->Rotation[Lane]);
+            return false;
+        }
+    }
+
+    for(unsigned int Row = 0; Row < GRID_ROWS; ++Row)
+    {
+        unsigned int Mask = 0;
+
+        for(unsigned int Col = 0; Col < GRID_COLS; ++Col)
+        {
+            Mask |= GetBlock(Game->MainGrid, Row, Col)->Occupied ? (1u << Col) : 0;
+        }
+
+        unsigned int Expected = (Lockstep->RowMasks[Row][Lane] >> LOCKSTEP_WALL) & ((1u << GRID_COLS) - 1);
+
+        if(Mask != Expected)
+        {
+            snprintf(Message, FUZZ_MESSAGE_SIZE, "board row %u: reference %03x, lockstep %03x", Row, Mask, Expected);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Traces
+ */
+
+//Plays Trace from Seed in one lane, returning the first tick (0 being the
+//state the game starts in) the engines disagree on, or -1 if they never do
+int RunFuzzTrace(FuzzEngine* Engine, unsigned int Seed, unsigned int Lane, const unsigned char* Trace, unsigned int Length,
+                 char* Message, bool Print)
+{
+    StartFuzzGame(Engine, Lane, Seed);
+
+    int Result = -1;
+
+    for(unsigned int Tick = 0; ; ++Tick)
+    {
+        bool Same = CompareFuzzLane(Engine, Lane, Message);
+
+        if(Print)
+        {
+            const LockstepGames<FUZZ_LANES>* Lockstep = &Engine->Lockstep;
+
+            printf("  %5u %x  piece %u at %d,%d r%u  score %u  %s\n", Tick, Tick ? Trace[Tick - 1] : 0,
+                   Lockstep->Type[Lane], Lockstep->Row[Lane], Lockstep->Col[Lane], Lockstep->Rotation[Lane],
+                   Lockstep->Score[Lane], Same ? "" : Message);
+        }
+
+        if(!Same)
+        {
+            Result = (int)Tick;
+            break;
+        }
+
+        if( (Tick == Length) || (Engine->Games[Lane].State != RUNNING) )
+        {
+            break;
+        }
+
+        unsigned int Inputs[FUZZ_LANES] = {};
+        Inputs[Lane] = Trace[Tick];
+
+        StepFuzzEngine(Engine, 1u << Lane, Inputs);
+    }
+
+    StopFuzzGame(Engine, Lane);
+
+    return Result;
+}
+
+//Takes ticks, then whole keys, then single key bits out of Trace while the
+//engines still disagree, and cuts it at the first tick they do. Returns the
+//new length.
+unsigned int ShrinkFuzzTrace(FuzzEngine* Engine, unsigned int Seed, unsigned int Lane, unsigned char* Trace,
+                             unsigned int Length, unsigned int* Runs)
+{
+    char Message[FUZZ_MESSAGE_SIZE];
+    unsigned char* Candidate = (unsigned char*)malloc(Length + 1);
+
+    bool Progress = true;
+
+    while(Progress)
+    {
+        Progress = false;
+
+        //Remove chunks of ticks, halving the chunk size each time none go
+        for(unsigned int Chunk = Length/2; Chunk >= 1; Chunk /= 2)
+        {
+            for(unsigned int Start = 0; Start + Chunk <= Length; )
+            {
+                memcpy(Candidate, Trace, Start);
+                memcpy(Candidate + Start, Trace + Start + Chunk, Length - Start - Chunk);
+
+                int Diverged = RunFuzzTrace(Engine, Seed, Lane, Candidate, Length - Chunk, Message, false);
+                (*Runs)++;
+
+                if(Diverged >= 0)
+                {
+                    Length = (unsigned int)Diverged;
+                    memcpy(Trace, Candidate, Length);
+                    Progress = true;
+                }
+                else
+                {
+                    Start += Chunk;
+                }
+            }
+        }
+
+        //Then take keys away, all of a tick's and then one at a time
+        for(unsigned int Tick = 0; Tick < Length; ++Tick)
+        {
+            for(unsigned int Bit = 0; (Bit <= 4) && Trace[Tick]; ++Bit)
+            {
+                unsigned char Without = (Bit == 0) ? 0 : (unsigned char)(Trace[Tick] & ~(1u << (Bit - 1)));
+
+                if(Without == Trace[Tick])
+                {
+                    continue;
+                }
+
+                memcpy(Candidate, Trace, Length);
+                Candidate[Tick] = Without;
+
+                int Diverged = RunFuzzTrace(Engine, Seed, Lane, Candidate, Length, Message, false);
+                (*Runs)++;
+
+                if(Diverged >= 0)
+                {
+                    Length = (unsigned int)Diverged;
+                    memcpy(Trace, Candidate, Length);
+                    Progress = true;
+                }
+            }
+        }
+    }
+
+    free(Candidate);
+
+    return Length;
+}
+
+/*
+ * Campaign
+ */
+
+struct FuzzFailure{
+    unsigned int Seed;
+    unsigned int Lane;
+    unsigned int Tick;
+    char Message[FUZZ_MESSAGE_SIZE];
+};
+
+struct FuzzJob{
+    unsigned int Seed;
+    unsigned long long TickTarget;
+    unsigned int MaxTicks;
+    unsigned int FirstBatch;    //Of the round being played
+    FuzzEngine* Engines;        //One per job worker
+
+    std::atomic<unsigned long long> Ticks;
+    std::atomic<unsigned long long> Games;
+
+    std::mutex Lock;
+    FuzzFailure Failures[FUZZ_MAX_FAILURES];
+    unsigned int FailureCount;
+    unsigned long long Divergences;
+};
+
+struct FuzzLane{
+    unsigned int Seed;
+    unsigned int Tick;
+    RandomSeries Keys;
+};
+
+//Plays the round's batches [Begin, End) on the worker's engine
+void RunFuzzBatches(void* Data, unsigned long long Begin, unsigned long long End, unsigned int Worker)
+{
+    FuzzJob* Job = (FuzzJob*)Data;
+    FuzzEngine* Engine = Job->Engines + Worker;
+
+    FuzzLane Lanes[FUZZ_LANES];
+    unsigned int Active = 0;
+    unsigned int NextGame = (unsigned int)(Job->FirstBatch + Begin)*FUZZ_BATCH;
+    unsigned int EndGame = (unsigned int)(Job->FirstBatch + End)*FUZZ_BATCH;
+    unsigned long long Ticks = 0;
+    char Message[FUZZ_MESSAGE_SIZE];
+
+    for(;;)
+    {
+        //Fill idle lanes with new games while there's still work
+        for(unsigned int Lane = 0; (Lane < FUZZ_LANES) && (NextGame < EndGame); ++Lane)
+        {
+            if(Active & (1u << Lane))
+            {
+                continue;
+            }
+
+            Job->Ticks += Ticks;
+            Ticks = 0;
+
+            if(Job->Ticks.load() >= Job->TickTarget)
+            {
+                NextGame = EndGame;
+                break;
+            }
+
+            Lanes[Lane].Seed = Job->Seed + NextGame++;
+            Lanes[Lane].Tick = 0;
+            Lanes[Lane].Keys = SeedFuzzKeys(Lanes[Lane].Seed);
+
+            StartFuzzGame(Engine, Lane, Lanes[Lane].Seed);
+            Active |= 1u << Lane;
+        }
+
+        if(!Active)
+        {
+            break;
+        }
+
+        unsigned int Inputs[FUZZ_LANES];
+
+        for(unsigned int Lane = 0; Lane < FUZZ_LANES; ++Lane)
+        {
+            Inputs[Lane] = (Active & (1u << Lane)) ? NextFuzzInput(&Lanes[Lane].Keys) : 0;
+        }
+
+        StepFuzzEngine(Engine, Active, Inputs);
+
+        for(unsigned int Remaining = Active; Remaining; Remaining &= Remaining - 1)
+        {
+            unsigned int Lane = CountTrailingZeros(Remaining);
+            FuzzLane* Current = Lanes + Lane;
+
+            Current->Tick++;
+            Ticks++;
+
+            bool Same = CompareFuzzLane(Engine, Lane, Message);
+
+            if(!Same)
+            {
+                std::lock_guard<std::mutex> Guard(Job->Lock);
+
+                if(Job->FailureCount < FUZZ_MAX_FAILURES)
+                {
+                    FuzzFailure* Failure = Job->Failures + Job->FailureCount++;
+
+                    Failure->Seed = Current->Seed;
+                    Failure->Lane = Lane;
+                    Failure->Tick = Current->Tick;
+                    memcpy(Failure->Message, Message, sizeof(Message));
+                }
+
+                Job->Divergences++;
+            }
+
+            if( !Same || (Engine->Games[Lane].State != RUNNING) || (Current->Tick >= Job->MaxTicks) )
+            {
+                StopFuzzGame(Engine, Lane);
+                Active &= ~(1u << Lane);
+                Job->Games++;
+            }
+        }
+    }
+
+    Job->Ticks += Ticks;
+}
+
+void PrintFuzzTrace(const unsigned char* Trace, unsigned int Length)
+{
+    for(unsigned int Tick = 0; Tick < Length; ++Tick)
+    {
+        printf("%x", Trace[Tick]);
+    }
+
+    printf("\n");
+}
+
+//Regenerates the keys a failing game was played with, up to the tick it
+//failed on, and shrinks them
+void ShrinkFuzzFailure(const FuzzFailure* Failure, bool InjectFault)
+{
+    FuzzEngine* Engine = (FuzzEngine*)malloc(sizeof(FuzzEngine));
+    OpenFuzzEngine(Engine, InjectFault);
+
+    unsigned int Length = Failure->Tick;
+    unsigned char* Trace = (unsigned char*)malloc(Length + 1);
+    RandomSeries Keys = SeedFuzzKeys(Failure->Seed);
+
+    for(unsigned int Tick = 0; Tick < Length; ++Tick)
+    {
+        Trace[Tick] = (unsigned char)NextFuzzInput(&Keys);
+    }
+
+    char Message[FUZZ_MESSAGE_SIZE];
+    unsigned int Runs = 0;
+
+    printf("Seed %u, lane %u, tick %u: %s\n", Failure->Seed, Failure->Lane, Failure->Tick, Failure->Message);
+
+    if(RunFuzzTrace(Engine, Failure->Seed, Failure->Lane, Trace, Length, Message, false) < 0)
+    {
+        printf("  doesn't happen again on its own, so it depends on something besides the seed and keys\n");
+    }
+    else
+    {
+        double Start = GetSeconds();
+        Length = ShrinkFuzzTrace(Engine, Failure->Seed, Failure->Lane, Trace, Length, &Runs);
+
+        unsigned int Keys = 0;
+
+        for(unsigned int Tick = 0; Tick < Length; ++Tick)
+        {
+            Keys += (Trace[Tick] != 0);
+        }
+
+        RunFuzzTrace(Engine, Failure->Seed, Failure->Lane, Trace, Length, Message, false);
+
+        printf("  shrunk to %u ticks, %u with keys, in %u runs (%.2fs): %s\n", Length, Keys, Runs,
+               GetSeconds() - Start, Message);
+        printf("  agafb_fuzz replay --seed %u --lane %u%s%s --trace ", Failure->Seed, Failure->Lane,
+               GenericRules ? " --generic" : "", InjectFault ? " --inject-fault" : "");
+        PrintFuzzTrace(Trace, Length);
+    }
+
+    free(Trace);
+    CloseFuzzEngine(Engine);
+    free(Engine);
+}
+
+int RunFuzzCampaign(unsigned long long TickTarget, unsigned int MaxTicks, JobSystem* System, unsigned int Seed,
+                    bool InjectFault)
+{
+    unsigned int WorkerCount = System->WorkerCount;
+    FuzzJob* Job = new FuzzJob;
+
+    Job->Seed = Seed;
+    Job->TickTarget = TickTarget;
+    Job->MaxTicks = MaxTicks;
+    Job->FirstBatch = 0;
+    Job->Ticks.store(0);
+    Job->Games.store(0);
+    Job->FailureCount = 0;
+    Job->Divergences = 0;
+
+    Job->Engines = (FuzzEngine*)malloc(sizeof(FuzzEngine)*WorkerCount);
+
+    for(unsigned int Worker = 0; Worker < WorkerCount; ++Worker)
+    {
+        OpenFuzzEngine(Job->Engines + Worker, InjectFault);
+    }
+
+    unsigned int RoundBatches = WorkerCount*FUZZ_ROUND_BATCHES;
+
+    ResetJobStats(System);
+    double Start = GetSeconds();
+
+    //Every game plays at least a tick, so the rounds always get there
+    while(Job->Ticks.load() < TickTarget)
+    {
+        ParallelFor(System, RoundBatches, 1, RunFuzzBatches, Job);
+        Job->FirstBatch += RoundBatches;
+    }
+
+    double Elapsed = GetSeconds() - Start;
+    unsigned long long Ticks = Job->Ticks.load();
+
+    printf("%llu games, %llu ticks on %u threads in %.2fs: %.2f M ticks/s, %llu games diverged%s\n",
+           Job->Games.load(), Ticks, WorkerCount, Elapsed, Ticks/Elapsed/1e6, Job->Divergences,
+           GenericRules ? " (generic rules)" : "");
+    PrintJobStats(System);
+
+    for(unsigned int Index = 0; Index < Job->FailureCount; ++Index)
+    {
+        ShrinkFuzzFailure(Job->Failures + Index, InjectFault);
+    }
+
+    int Result = Job->Divergences ? 1 : 0;
+
+    for(unsigned int Worker = 0; Worker < WorkerCount; ++Worker)
+    {
+        CloseFuzzEngine(Job->Engines + Worker);
+    }
+
+    free(Job->Engines);
+    delete Job;
+
+    return Result;
+}
+
+int ReplayFuzzTrace(unsigned int Seed, unsigned int Lane, const char* Hex, bool InjectFault)
+{
+    unsigned int Length = (unsigned int)strlen(Hex);
+    unsigned char* Trace = (unsigned char*)malloc(Length + 1);
+
+    for(unsigned int Tick = 0; Tick < Length; ++Tick)
+    {
+        char Digit = Hex[Tick];
+        Trace[Tick] = (unsigned char)((Digit >= 'a') ? Digit - 'a' + 10 : (Digit >= 'A') ? Digit - 'A' + 10 : Digit - '0');
+    }
+
+    FuzzEngine* Engine = (FuzzEngine*)malloc(sizeof(FuzzEngine));
+    OpenFuzzEngine(Engine, InjectFault);
+
+    char Message[FUZZ_MESSAGE_SIZE];
+
+    printf("Seed %u, lane %u, %u ticks (tick, keys, lockstep piece, score):\n", Seed, Lane % FUZZ_LANES, Length);
+
+    int Diverged = RunFuzzTrace(Engine, Seed, Lane % FUZZ_LANES, Trace, Length, Message, true);
+
+    if(Diverged >= 0)
+    {
+        printf("Engines disagree from tick %d: %s\n", Diverged, Message);
+    }
+    else
+    {
+        printf("Engines agree\n");
+    }
+
+    CloseFuzzEngine(Engine);
+    free(Engine);
+    free(Trace);
+
+    return (Diverged >= 0) ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned long long TickTarget = FUZZ_DEFAULT_TICKS;
+    unsigned int MaxTicks = FUZZ_DEFAULT_MAX_TICKS;
+    unsigned int ThreadCount = std::thread::hardware_concurrency();
+    unsigned int Seed = 1;
+    unsigned int Lane = 0;
+    const char* Trace = NULL;
+    bool InjectFault = false;
+    bool Replay = false;
+    bool Pin = false;
+
+    for(int Arg = 1; Arg < argc; ++Arg)
+    {
+        bool HasValue = (Arg + 1 < argc);
+
+        if( (Arg == 1) && (strcmp(argv[Arg], "replay") == 0) )
+        {
+            Replay = true;
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--ticks") == 0) )
+        {
+            TickTarget = strtoull(argv[++Arg], NULL, 10);
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--max-ticks") == 0) )
+        {
+            MaxTicks = atoi(argv[++Arg]);
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--threads") == 0) )
+        {
+            ThreadCount = atoi(argv[++Arg]);
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--seed") == 0) )
+        {
+            Seed = (unsigned int)strtoul(argv[++Arg], NULL, 10);
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--lane") == 0) )
+        {
+            Lane = atoi(argv[++Arg]);
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--trace") == 0) )
+        {
+            Trace = argv[++Arg];
+        }
+        else if(strcmp(argv[Arg], "--pin") == 0)
+        {
+            Pin = true;
+        }
+        else if(strcmp(argv[Arg], "--generic") == 0)
+        {
+            GenericRules = true;
+        }
+        else if(strcmp(argv[Arg], "--inject-fault") == 0)
+        {
+            InjectFault = true;
+        }
+        else
+        {
+            printf("Usage: %s [--ticks n] [--max-ticks n] [--threads n] [--pin] [--seed s] [--generic] [--inject-fault]\n"
+                   "       %s replay --seed s --lane l --trace hex [--generic] [--inject-fault]\n", argv[0], argv[0]);
+            return 1;
+        }
+    }
+
+    ThreadCount = ThreadCount ? ThreadCount : 1;
+    MaxTicks = MaxTicks ? MaxTicks : 1;
+
+    BuildLockstepShapes();
+
+    if(Replay)
+    {
+        return ReplayFuzzTrace(Seed, Lane, Trace ? Trace : "", InjectFault);
+    }
+
+    JobSystem* System = CreateJobSystem(ThreadCount, Pin);
+
+    if(System == NULL)
+    {
+        return 1;
+    }
+
+    int Result = RunFuzzCampaign(TickTarget, MaxTicks, System, Seed, InjectFault);
+
+    DestroyJobSystem(System);
+
+    return Result;
+}
@@ -0,0 +1,953 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "events.h"
+#include "game.h"
+#include "pieces.h"
+
+inline BlockPool* GetTetrominoPool(GameData Game)
+{
+    return Game.Memory ? &Game.Memory->Tetrominoes : NULL;
+}
+
+template<typename Listener>
+GameData InitialiseGame(GameData Current, Listener* Events)
+{
+    GameData Result = Current;
+
+    //Initialise all game parameters
+    Result.FallingTimer = FALL_FRAMES;
+    Result.MoveLeft = 0;
+    Result.MoveRight = 0;
+    Result.MoveDown = 0;
+    Result.Rotate = 0;
+    Result.Score = 0;
+    Result.LinesRemoved = 0;
+    Result.Redraw = 1;
+    Result.RenderScore = 1;
+
+    //Create Game Grid
+    if(Result.Memory)
+    {
+        //Whatever the last game left behind goes in one go
+        ResetGameMemory(Result.Memory);
+        Result.MainGrid = PushGrid(&Result.Memory->Session, GRID_ROWS, GRID_COLS);
+    }
+    else
+    {
+        Result.MainGrid = GenerateGrid(GRID_ROWS, GRID_COLS);
+    }
+
+    //Create first Tetro and next Tetro
+    Result.FallingTetro = GenerateTetromino(&Result.Random, GetTetrominoPool(Result));
+    Result.NextTetro = GenerateTetromino(&Result.Random, GetTetrominoPool(Result));
+    Result.NextTetro.Col += 1;
+    Result.NextTetro.Row += 1;
+
+    OnPieceSpawned(Events, Result.FallingTetro);
+
+    //Transition to Running
+    Result.State = RUNNING;
+
+    return Result;
+}
+
+GameData InitialiseGame(GameData Current)
+{
+    NoGameEvents None;
+    return InitialiseGame(Current, &None);
+}
+
+//Frees everything a running game owns. Games with their own GameMemory
+//are freed by resetting or destroying that instead.
+void DestroyGame(GameData Game)
+{
+    if(Game.Memory)
+    {
+        return;
+    }
+
+    DestroyTetromino(Game.FallingTetro);
+    DestroyTetromino(Game.NextTetro);
+    DestroyGrid(Game.MainGrid);
+}
+
+GameData HandleInputGame(InputState Inputs, GameData Current)
+{
+    GameData Result = Current;
+
+    Result.MoveLeft = Inputs.Left;
+    Result.MoveRight = Inputs.Right;
+    Result.MoveDown = Inputs.Down;
+    Result.Rotate = Inputs.Up;
+    Result.Pause = Inputs.Space;
+
+    return Result;
+}
+
+GameData HandleInputPaused(InputState Inputs, GameData Current)
+{
+    GameData Result = Current;
+
+    Result.Pause = Inputs.Space;
+
+    return Result;
+}
+
+GameData HandleInputGameOver(InputState Inputs, GameData Current)
+{
+    GameData Result = Current;
+
+    Result.Restart = Inputs.Space;
+    Result.Quit = Inputs.Escape;
+
+    return Result;
+}
+
+template<typename Listener>
+GameData UpdateGame(GameData Current, Listener* Events)
+{
+    GameData Result = Current;
+
+    //Drop Tetro if necessary
+    if(Result.FallingTimer == 0)
+    {
+        Result.MoveDown = 1;
+        Result.FallingTimer = FALL_FRAMES;
+    }
+    else
+    {
+        Result.FallingTimer--;
+    }
+
+    //Move Tetro if necessary
+    if(Result.MoveLeft)
+    {
+        //Duplicate Tetromino
+        Tetromino NewTetro = Result.FallingTetro;
+
+        NewTetro.Col--;
+
+        if(!CheckCollisions(Result.MainGrid, NewTetro))
+        {
+            Result.FallingTetro = NewTetro;
+            Result.Redraw = 1;
+
+            OnPieceMoved(Events, NewTetro, NewTetro.Row, NewTetro.Col + 1);
+        }
+
+        Result.MoveLeft = 0;
+    }
+
+    if(Result.MoveRight)
+    {
+        //Duplicate Tetromino
+        Tetromino NewTetro = Result.FallingTetro;
+
+        NewTetro.Col++;
+
+        if(!CheckCollisions(Result.MainGrid, NewTetro))
+        {
+            Result.FallingTetro = NewTetro;
+            Result.Redraw = 1;
+
+            OnPieceMoved(Events, NewTetro, NewTetro.Row, NewTetro.Col - 1);
+        }
+
+        Result.MoveRight = 0;
+    }
+
+    if(Result.MoveDown)
+    {
+        //Duplicate Tetromino
+        Tetromino NewTetro = Result.FallingTetro;
+
+        NewTetro.Row++;
+        //Check for collisions
+        if(CheckCollisions(Result.MainGrid, NewTetro))
+        {
+            StoreTetromino(Result.MainGrid, Result.FallingTetro);
+            OnPieceLocked(Events, Result.FallingTetro);
+
+            DestroyTetromino(Result.FallingTetro);
+            Result.FallingTetro = Result.NextTetro;
+            OnPieceSpawned(Events, Result.FallingTetro);
+
+            Result.NextTetro    = GenerateTetromino(&Result.Random, GetTetrominoPool(Result));
+            Result.NextTetro.Col += 1;
+            Result.NextTetro.Row += 1;
+
+
+            Result.FallingTimer = FALL_FRAMES;
+        }
+        else
+        {
+            Result.FallingTetro = NewTetro;
+
+            OnPieceMoved(Events, NewTetro, NewTetro.Row - 1, NewTetro.Col);
+        }
+
+        Result.Redraw = 1;
+        Result.MoveDown = 0;
+    }
+
+    if(Result.Rotate)
+    {
+        if(GetActivePieces()->Types[Result.FallingTetro.Type].RotationCount > 1)
+        {
+            //Duplicate Tetromino
+            Tetromino NewTetro = RotateTetroClockwise(Result.FallingTetro);
+
+            if(!CheckCollisions(Result.MainGrid, NewTetro))
+            {
+                unsigned int FromRotation = Result.FallingTetro.Rotation;
+
+                DestroyTetromino(Result.FallingTetro);
+                Result.FallingTetro = NewTetro;
+                Result.Redraw = 1;
+
+                OnPieceRotated(Events, NewTetro, FromRotation);
+            }
+            else
+            {
+                DestroyTetromino(NewTetro);
+            }
+
+        }
+        Result.Rotate = 0;
+    }
+
+    // Final check for collisons - quit game if any are found
+    if(CheckCollisions(Result.MainGrid, Result.FallingTetro))
+    {
+        Result.State = GAMEOVER;
+        Result.Redraw = 1;
+    }
+
+    //Remove any lines in the grid
+    unsigned int ClearedRows[TETROMINO_MAX_SIZE];
+    unsigned int LinesRemoved = RemoveGridLines(Result.MainGrid, ClearedRows);
+    Result.LinesRemoved = LinesRemoved;
+
+    if(LinesRemoved)
+    {
+        Result.RenderScore = 1;
+
+        OnLinesCleared(Events, ClearedRows, (LinesRemoved < TETROMINO_MAX_SIZE) ? LinesRemoved : (unsigned int)TETROMINO_MAX_SIZE);
+    }
+
+    switch(LinesRemoved)
+    {
+        case 1:
+            Result.Score+=1;
+            break;
+        case 2:
+            Result.Score+=4;
+            break;
+        case 3:
+            Result.Score+=8;
+            break;
+        case 4:
+            Result.Score+=16;
+            break;
+        default:
+            break;
+    }
+
+    if(Result.Pause)
+    {
+        Result.State = PAUSED;
+        Result.Pause = 0;
+        Result.Redraw = 1;
+    }
+
+    return Result;
+}
+
+GameData UpdateGame(GameData Current)
+{
+    NoGameEvents None;
+    return UpdateGame(Current, &None);
+}
+
+//One tick of the whole state machine with the tick's inputs held
+template<typename Listener>
+GameData SimulateTick(GameData Current, InputState Inputs, Listener* Events)
+{
+    GameData Result = Current;
+
+    switch(Result.State)
+    {
+        case INITIALISING:
+            {
+                Result = InitialiseGame(Result, Events);
+            }
+            break;
+        case RUNNING:
+            {
+                Result = HandleInputGame(Inputs, Result);
+                Result = UpdateGame(Result, Events);
+            }
+            break;
+        case PAUSED:
+            {
+                Result = HandleInputPaused(Inputs, Result);
+                Result = UpdatePaused(Result);
+            }
+            break;
+        case GAMEOVER:
+            {
+                Result = HandleInputGameOver(Inputs, Result);
+                Result = UpdateGameOver(Result);
+            }
+            break;
+    }
+
+    if(Result.Score != Current.Score)
+    {
+        OnScoreChanged(Events, Current.Score, Result.Score);
+    }
+
+    if(Result.State != Current.State)
+    {
+        OnStateChanged(Events, Current.State, Result.State);
+    }
+
+    return Result;
+}
+
+GameData SimulateTick(GameData Current, InputState Inputs)
+{
+    NoGameEvents None;
+    return SimulateTick(Current, Inputs, &None);
+}
+
+//The number of ticks from now until gravity next moves the falling piece,
+//1 being the very next UpdateGame
+unsigned int TicksUntilGravity(GameData Current)
+{
+    return Current.FallingTimer + 1;
+}
+
+//Skips Ticks updates in one go. Only valid while RUNNING with no input held
+//and Ticks < TicksUntilGravity, when an update does nothing except count
+//FallingTimer down: nothing moves, so nothing locks, collides or clears.
+GameData FastForwardGame(GameData Current, unsigned int Ticks)
+{
+    GameData Result = Current;
+
+    if(Ticks == 0)
+    {
+        return Result;
+    }
+
+    if(Ticks > Result.FallingTimer)
+    {
+        Ticks = Result.FallingTimer;
+    }
+
+    Result.FallingTimer -= Ticks;
+    Result.LinesRemoved = 0;
+
+    return Result;
+}
+
+GameData UpdatePaused(GameData Current)
+{
+    GameData Result = Current;
+
+    if(Result.Pause)
+    {
+        Result.State = RUNNING;
+        Result.Pause = 0;
+        Result.Redraw = 0;
+    }
+
+    return Result;
+}
+
+GameData UpdateGameOver(GameData Current)
+{
+    GameData Result = Current;
+
+    if(Result.Restart)
+    {
+        //Clean up game
+        DestroyGame(Result);
+
+        Result.State = INITIALISING;
+        Result.Restart = 0;
+        Result.Redraw = 0;
+    }
+
+    return Result;
+}
+
+/*
+ * Game Memory
+ */
+
+//The pool's arena pointer is set by ResetGameMemory, once the memory is
+//somewhere it won't be copied from (InitialiseGame does this)
+GameMemory GenerateGameMemory()
+{
+    GameMemory Result;
+
+    Result.Session = GenerateArena(GAME_SESSION_ARENA_SIZE);
+    Result.Tetrominoes.Arena = NULL;
+    Result.Tetrominoes.FreeList = NULL;
+
+    return Result;
+}
+
+void DestroyGameMemory(GameMemory Memory)
+{
+    DestroyArena(Memory.Session);
+}
+
+void ResetGameMemory(GameMemory* Memory)
+{
+    ResetArena(&Memory->Session);
+    Memory->Tetrominoes.Arena = &Memory->Session;
+    Memory->Tetrominoes.FreeList = NULL;
+}
+
+/*
+ * Random Numbers
+ *
+ * Each game carries its own xorshift state instead of sharing rand(), so a
+ * game is fully determined by its seed and inputs.
+ */
+
+RandomSeries SeedRandomSeries(unsigned int Seed)
+{
+    RandomSeries Result;
+
+    //Xorshift gets stuck on zero
+    Result.State = Seed ? Seed : 0x2545F491;
+
+    return Result;
+}
+
+unsigned int RandomNext(RandomSeries* Series)
+{
+    unsigned int X = Series->State;
+
+    X ^= X << 13;
+    X ^= X >> 17;
+    X ^= X << 5;
+
+    Series->State = X;
+
+    return X;
+}
+
+/*
+ * Block/Grid Operations
+ */
+
+Block GenerateBlock()
+{
+    Block Result = {0, 0};
+    return Result;
+}
+
+void DestroyGrid(BlockGrid Grid)
+{
+    HeapFree(Grid.Blocks);
+}
+
+Block* GetBlock(BlockGrid Grid, unsigned int Row, unsigned int Col)
+{
+    return Grid.Blocks + Grid.Cols*Row + Col;
+}
+
+void EraseBlock(Block* BlockToErase)
+{
+    BlockToErase->Occupied = 0;
+    BlockToErase->Colour = 0;
+}
+
+BlockGrid GenerateGrid(unsigned int Rows, unsigned int Cols)
+{
+    BlockGrid Result;
+
+    Result.Rows = Rows;
+    Result.Cols = Cols;
+
+    Result.Blocks = (Block*)(HeapAllocate(sizeof(Block)*Rows*Cols));
+
+    unsigned int BlockTotal = (Result.Rows)*(Result.Cols);
+    unsigned int Count = 0;
+    Block* CurrentBlock = Result.Blocks;
+
+    while(Count < BlockTotal)
+    {
+        *CurrentBlock = GenerateBlock();
+
+        ++Count;
+        ++CurrentBlock;
+    }
+
+    return Result;
+}
+
+BlockGrid PushGrid(MemoryArena* Arena, unsigned int Rows, unsigned int Cols)
+{
+    BlockGrid Result;
+
+    Result.Rows = Rows;
+    Result.Cols = Cols;
+    Result.Blocks = PushArray(Arena, Block, Rows*Cols);
+
+    if(Result.Blocks)
+    {
+        memset(Result.Blocks, 0, sizeof(Block)*Rows*Cols);
+    }
+
+    return Result;
+}
+
+//Tetromino grids always have room for the largest shape, so a tetromino's
+//blocks can be rewritten as a different shape (see LoadGameSnapshot) without
+//reallocating, and every pool buffer is the same size
+BlockGrid GenerateTetrominoGrid(BlockPool* Pool, unsigned int GridSize)
+{
+    BlockGrid Result;
+
+    if(Pool == NULL)
+    {
+        Result = GenerateGrid(TETROMINO_MAX_SIZE, TETROMINO_MAX_SIZE);
+    }
+    else
+    {
+        if(Pool->FreeList)
+        {
+            Result.Blocks = (Block*)Pool->FreeList;
+            Pool->FreeList = Pool->FreeList->Next;
+        }
+        else
+        {
+            Result.Blocks = PushArray(Pool->Arena, Block, TETROMINO_MAX_SIZE*TETROMINO_MAX_SIZE);
+        }
+
+        if(Result.Blocks)
+        {
+            memset(Result.Blocks, 0, sizeof(Block)*TETROMINO_MAX_SIZE*TETROMINO_MAX_SIZE);
+        }
+    }
+
+    Result.Rows = GridSize;
+    Result.Cols = GridSize;
+
+    return Result;
+}
+
+void DestroyTetrominoGrid(BlockPool* Pool, BlockGrid Grid)
+{
+    if(Pool == NULL)
+    {
+        DestroyGrid(Grid);
+    }
+    else if(Grid.Blocks)
+    {
+        BlockPoolEntry* Entry = (BlockPoolEntry*)Grid.Blocks;
+        Entry->Next = Pool->FreeList;
+        Pool->FreeList = Entry;
+    }
+}
+
+void StoreTetrominoGeneric(BlockGrid Grid, Tetromino Tetro)
+{
+    if( (Tetro.Grid.Blocks == NULL) || (Grid.Blocks == NULL) )
+    {
+        return;
+    }
+
+    for(unsigned int Row = 0; Row < Tetro.Grid.Rows; ++Row)
+    {
+        for(unsigned int Col = 0; Col < Tetro.Grid.Cols; ++Col)
+        {
+            Block* CurrentBlock = GetBlock(Tetro.Grid, Row, Col);
+
+            if(CurrentBlock->Occupied)
+            {
+                unsigned int GridCol = Tetro.Col + Col;
+                unsigned int GridRow = Tetro.Row + Row;
+
+                Block* GridBlock = GetBlock(Grid, GridRow, GridCol);
+
+                // Copy across block
+                *GridBlock = *CurrentBlock;
+            } 
+        }
+    }
+
+}
+
+unsigned int CheckCollisionsGeneric(BlockGrid Grid, Tetromino Tetro)
+{
+    //Check for null pointers
+    if( (Tetro.Grid.Blocks == NULL) || (Grid.Blocks == NULL) )
+    {
+        return 1;
+    }
+
+    for(unsigned int Row = 0; Row < Tetro.Grid.Rows; ++Row)
+    {
+        for(unsigned int Col = 0; Col < Tetro.Grid.Cols; ++Col)
+        {
+            Block* CurrentBlock = GetBlock(Tetro.Grid, Row, Col);
+
+            if(CurrentBlock->Occupied)
+            {
+                unsigned int GridCol = Tetro.Col + Col;
+                unsigned int GridRow = Tetro.Row + Row;
+
+                //If out of bounds, count as collision
+                if( (GridCol < 0) || (GridRow < 0) || (GridCol >= Grid.Cols) || (GridRow >= Grid.Rows) )
+                {
+                    return 1;
+                }
+
+                Block* GridBlock = GetBlock(Grid, GridRow, GridCol);
+
+                // Check for Collision
+                if(GridBlock->Occupied)
+                {
+                    return 1;
+                }
+            } 
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Palette
+ */
+
+//RGB 3-3-2, red in the top bits
+unsigned char GetPaletteIndex(unsigned char Red, unsigned char Green, unsigned char Blue)
+{
+    return (unsigned char)((Red & 0xE0) | ((Green >> 3) & 0x1C) | (Blue >> 6));
+}
+
+//Spreads each channel back over the full 0-255 range
+PaletteColour GetPaletteColour(unsigned char Index)
+{
+    PaletteColour Result;
+
+    Result.Red   = (unsigned char)(((Index >> 5) & 0x7)*255/7);
+    Result.Green = (unsigned char)(((Index >> 2) & 0x7)*255/7);
+    Result.Blue  = (unsigned char)((Index & 0x3)*255/3);
+    Result.Alpha = 0xFF;
+
+    return Result;
+}
+
+/*
+ * Tetromino Operations
+ */
+Tetromino GenerateTetromino(RandomSeries* Series, BlockPool* Pool)
+{
+    unsigned int Red   = RandomNext(Series)%0xFF;
+    unsigned int Green = RandomNext(Series)%0xFF;
+    unsigned int Blue  = RandomNext(Series)%0xFF;
+
+    unsigned int Rand = RandomNext(Series);
+
+    return GenerateTetrominoOfType((TetrominoType)(Rand%GetActivePieces()->Count), Red, Green, Blue, Pool);
+}
+
+//Type is a piece of the set in use (see pieces.h), at its spawn position
+Tetromino GenerateTetrominoOfType(TetrominoType Type, unsigned char Red, unsigned char Green, unsigned char Blue, BlockPool* Pool)
+{
+    const PieceType* Piece = GetActivePieces()->Types + Type;
+
+    Tetromino Result;
+
+    Result.Row = Piece->SpawnRow;
+    Result.Col = Piece->SpawnCol;
+    Result.Type = Type;
+    Result.Rotation = 0;
+    Result.GridSize = Piece->GridSize;
+    Result.Pool = Pool;
+    Result.Grid = GenerateTetrominoGrid(Pool, Result.GridSize);
+
+    unsigned char Colour = GetPaletteIndex(Red, Green, Blue);
+    const PieceRotation* Shape = Piece->Rotations;
+
+    for(unsigned int Cell = 0; (Cell < Shape->CellCount) && Result.Grid.Blocks; ++Cell)
+    {
+        Block* TBlock = GetBlock(Result.Grid, Shape->CellRows[Cell], Shape->CellCols[Cell]);
+
+        TBlock->Occupied = 1;
+        TBlock->Colour = Colour;
+    }
+
+    return Result;
+}
+
+void DestroyTetromino(Tetromino Tetro)
+{
+    DestroyTetrominoGrid(Tetro.Pool, Tetro.Grid);
+}
+
+//A fresh grid with the next rotation's blocks, in the piece's colour. Pieces
+//with only the one rotation come back as they are, grid and all.
+Tetromino RotateTetroClockwise(Tetromino Tetro)
+{
+    Tetromino Result = Tetro;
+
+    const PieceType* Piece = GetActivePieces()->Types + Tetro.Type;
+
+    if(Piece->RotationCount == 1)
+    {
+        return Result;
+    }
+
+    const PieceRotation* Current = Piece->Rotations + Tetro.Rotation;
+    Block Colour = *GetBlock(Tetro.Grid, Current->CellRows[0], Current->CellCols[0]);
+
+    Result.Rotation = (Tetro.Rotation + 1) % Piece->RotationCount;
+    Result.Grid = GenerateTetrominoGrid(Result.Pool, Result.GridSize);
+
+    const PieceRotation* Shape = Piece->Rotations + Result.Rotation;
+
+    for(unsigned int Cell = 0; (Cell < Shape->CellCount) && Result.Grid.Blocks; ++Cell)
+    {
+        *GetBlock(Result.Grid, Shape->CellRows[Cell], Shape->CellCols[Cell]) = Colour;
+    }
+
+    return Result;
+}
+
+unsigned int RemoveGridLinesGeneric(BlockGrid Grid, unsigned int* ClearedRows)
+{
+    unsigned int FullRowCount    = 0;
+    unsigned int ShiftRowsDownBy = 0;
+
+    for(unsigned int Row = (Grid.Rows-1); Row < Grid.Rows; --Row)
+    {
+        unsigned int IsRowFull = 1;
+
+        for(unsigned int Col = 0; Col < Grid.Cols; ++Col)
+        {
+            Block* CurrentBlock = GetBlock(Grid, Row, Col);
+
+            if(!CurrentBlock->Occupied)
+            {
+                IsRowFull = 0;
+            }
+
+            if(ShiftRowsDownBy)
+            {
+                Block* SwapBlock = GetBlock(Grid, Row+ShiftRowsDownBy, Col);
+                *SwapBlock = *CurrentBlock;
+            }
+        }
+
+        if(IsRowFull)
+        {
+            if( ClearedRows && (FullRowCount < TETROMINO_MAX_SIZE) )
+            {
+                ClearedRows[FullRowCount] = Row;
+            }
+
+            FullRowCount++;
+            ShiftRowsDownBy++;
+        }
+    }
+
+    //Cleanup the remaining rows
+    for(unsigned int Row = 0; Row < ShiftRowsDownBy; ++Row)
+    {
+        for(unsigned int Col = 0; Col < Grid.Cols; ++Col)
+        {
+            Block* CurrentBlock = GetBlock(Grid, Row, Col);
+
+            EraseBlock(CurrentBlock);
+        }
+    }
+
+    return FullRowCount;
+}
+
+Vector2D CalculateGridCentreOfMass(BlockGrid Grid)
+{
+    Vector2D Result = {0,0};
+
+    float TotalX = 0;
+    float TotalY = 0;
+    float TotalMass = 0;
+
+    for(float Row = 0; Row < Grid.Rows; ++Row)
+    {
+        for(float Col = 0; Col < Grid.Cols; ++Col)
+        {
+            Block* CurrentBlock = GetBlock(Grid, Row, Col);
+            if(CurrentBlock->Occupied)
+            {
+                TotalX += (Col+1)-0.5;
+                TotalY += (Row+1)-0.5;
+                ++TotalMass;
+            }
+        }
+    }
+
+    Result.X = TotalX/TotalMass;
+    Result.Y = TotalY/TotalMass;
+
+    return Result;
+}
+
+/*
+ * Fixed Dimension Operations
+ *
+ * Versions of the hot rule functions for grids whose dimensions are known at
+ * compile time. Every loop over the main grid has a constant trip count and
+ * stride, so the compiler can unroll the column loops and fold the indexing.
+ */
+
+//The piece's blocks come straight from its cell list in the piece table, so
+//it's one test per block whatever the piece or the size of its grid
+template<unsigned int Rows, unsigned int Cols>
+unsigned int CheckCollisionsFixed(BlockGrid Grid, Tetromino Tetro)
+{
+    //Check for null pointers
+    if( (Tetro.Grid.Blocks == NULL) || (Grid.Blocks == NULL) )
+    {
+        return 1;
+    }
+
+    const PieceRotation* Shape = GetActivePieces()->Types[Tetro.Type].Rotations + Tetro.Rotation;
+
+    for(unsigned int Cell = 0; Cell < Shape->CellCount; ++Cell)
+    {
+        //Negative positions wrap, so one unsigned compare per axis covers
+        //both edges
+        unsigned int GridRow = Tetro.Row + Shape->CellRows[Cell];
+        unsigned int GridCol = Tetro.Col + Shape->CellCols[Cell];
+
+        if( (GridCol >= Cols) || (GridRow >= Rows) || Grid.Blocks[GridRow*Cols + GridCol].Occupied )
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+template<unsigned int Rows, unsigned int Cols>
+void StoreTetrominoFixed(BlockGrid Grid, Tetromino Tetro)
+{
+    if( (Tetro.Grid.Blocks == NULL) || (Grid.Blocks == NULL) )
+    {
+        return;
+    }
+
+    const PieceRotation* Shape = GetActivePieces()->Types[Tetro.Type].Rotations + Tetro.Rotation;
+
+    for(unsigned int Cell = 0; Cell < Shape->CellCount; ++Cell)
+    {
+        unsigned int Row = Shape->CellRows[Cell];
+        unsigned int Col = Shape->CellCols[Cell];
+
+        // Copy across block
+        Grid.Blocks[(Tetro.Row + Row)*Cols + Tetro.Col + Col] = Tetro.Grid.Blocks[Row*Tetro.Grid.Cols + Col];
+    }
+}
+
+template<unsigned int Cols>
+bool IsRowFull(const Block* RowBlocks)
+{
+    unsigned char Full = 1;
+
+    for(unsigned int Col = 0; Col < Cols; ++Col)
+    {
+        Full &= (RowBlocks[Col].Occupied != 0);
+    }
+
+    return Full != 0;
+}
+
+template<unsigned int Rows, unsigned int Cols>
+unsigned int RemoveGridLinesFixed(BlockGrid Grid, unsigned int* ClearedRows)
+{
+    unsigned int FullRowCount = 0;
+
+    for(unsigned int Row = (Rows-1); Row < Rows; --Row)
+    {
+        Block* CurrentRow = Grid.Blocks + Row*Cols;
+
+        if(IsRowFull<Cols>(CurrentRow))
+        {
+            if( ClearedRows && (FullRowCount < TETROMINO_MAX_SIZE) )
+            {
+                ClearedRows[FullRowCount] = Row;
+            }
+
+            FullRowCount++;
+        }
+        else if(FullRowCount)
+        {
+            memcpy(CurrentRow + FullRowCount*Cols, CurrentRow, sizeof(Block)*Cols);
+        }
+    }
+
+    //Cleanup the remaining rows
+    memset(Grid.Blocks, 0, sizeof(Block)*Cols*FullRowCount);
+
+    return FullRowCount;
+}
+
+/*
+ * Rule Dispatch
+ *
+ * The standard board gets the fixed dimension instantiation, anything else
+ * falls back to the runtime sized loops. GenericRules sends every board down
+ * the runtime sized loops, which work from the piece's own grid rather than
+ * the piece table's cell lists, so a tool can check one path against the
+ * other.
+ */
+
+bool GenericRules = false;
+
+inline bool IsStandardGrid(BlockGrid Grid)
+{
+    return !GenericRules && (Grid.Rows == GRID_ROWS) && (Grid.Cols == GRID_COLS);
+}
+
+void StoreTetromino(BlockGrid Grid, Tetromino Tetro)
+{
+    if(IsStandardGrid(Grid))
+    {
+        StoreTetrominoFixed<GRID_ROWS, GRID_COLS>(Grid, Tetro);
+    }
+    else
+    {
+        StoreTetrominoGeneric(Grid, Tetro);
+    }
+}
+
+unsigned int CheckCollisions(BlockGrid Grid, Tetromino Tetro)
+{
+    if(IsStandardGrid(Grid))
+    {
+        return CheckCollisionsFixed<GRID_ROWS, GRID_COLS>(Grid, Tetro);
+    }
+
+    return CheckCollisionsGeneric(Grid, Tetro);
+}
+
+unsigned int RemoveGridLines(BlockGrid Grid, unsigned int* ClearedRows)
+{
+    if(IsStandardGrid(Grid))
+    {
+        return RemoveGridLinesFixed<GRID_ROWS, GRID_COLS>(Grid, ClearedRows);
+    }
+
+    return RemoveGridLinesGeneric(Grid, ClearedRows);
+}
@@ -0,0 +1,208 @@
+#ifndef GAME_H
+#define GAME_H
+
+#include "arena.h"
+
+/*
+ * Game Stuff
+ *
+ * Everything in here is headless: no SDL, no rendering. The platform layer in
+ * main.cpp and the command line tools both build on top of it.
+ */
+
+//Constants
+enum GameConstants{
+    //Main Grid Dimensions
+    GRID_ROWS   = 20,
+    GRID_COLS   = 10,
+
+    //Largest piece grid, the I shape's, which every piece set fits in (see
+    //pieces.h)
+    TETROMINO_MAX_SIZE = 4,
+
+    //Game Constants
+    FALL_FRAMES = 30,
+
+    //Session memory: the main grid plus a handful of live tetromino grids
+    GAME_SESSION_ARENA_SIZE = 16*1024
+};
+
+enum GameState{
+    INITIALISING,
+    RUNNING,
+    PAUSED,
+    GAMEOVER
+};
+
+//The tetromino set's types. Pieces from other sets are numbered the same
+//way, by where they are in their set.
+enum TetrominoType : unsigned int{
+    I_SHAPE,
+    T_SHAPE,
+    O_SHAPE,
+    Z_SHAPE,
+    S_SHAPE,
+    L_L_SHAPE,
+    L_R_SHAPE,
+};
+
+struct InputState{
+    bool Up;
+    bool Down;
+    bool Left;
+    bool Right;
+    bool Space;
+    bool Escape;
+};
+
+struct RandomSeries{
+    unsigned int State;
+};
+
+struct Vector2D{
+    float X;
+    float Y;
+};
+
+//Blocks store their colour as an index into a fixed palette. Piece colours
+//are quantised to 3 bits of red, 3 of green and 2 of blue, so every index is
+//a colour and the whole palette is 256 entries.
+enum PaletteConstants{
+    PALETTE_SIZE = 256
+};
+
+struct PaletteColour{
+    unsigned char Red;
+    unsigned char Green;
+    unsigned char Blue;
+    unsigned char Alpha;
+};
+
+struct Block{
+    unsigned char Occupied;
+    unsigned char Colour;   //Palette index
+};
+
+struct BlockGrid{
+    unsigned int Rows;
+    unsigned int Cols;
+    Block* Blocks;
+};
+
+//Free list of tetromino sized block buffers carved from an arena, so pieces
+//spawning, rotating and locking recycle the same few buffers
+struct BlockPoolEntry{
+    BlockPoolEntry* Next;
+};
+
+struct BlockPool{
+    MemoryArena* Arena;
+    BlockPoolEntry* FreeList;
+};
+
+struct Tetromino{
+    TetrominoType Type;
+    unsigned int Rotation;  //Into the piece table, see pieces.h
+    unsigned int GridSize;
+    int Row;
+    int Col;
+    BlockGrid Grid;
+    BlockPool* Pool; //Where Grid came from, NULL for the heap
+};
+
+//Everything one game allocates. A restart resets it wholesale rather than
+//freeing the grid and pieces one by one.
+struct GameMemory{
+    MemoryArena Session;
+    BlockPool Tetrominoes;
+};
+
+struct GameData{
+    GameState State;
+
+    bool Quit;
+    bool MoveLeft;
+    bool MoveRight;
+    bool Rotate;
+    bool MoveDown;
+    bool Pause;
+    bool Redraw;
+    bool RenderScore;
+    bool Restart;
+
+    unsigned int Score;
+    unsigned int LinesRemoved; //On the last update
+    unsigned int FallingTimer;
+    unsigned int StartTick;
+    unsigned int EndTick;
+
+    RandomSeries Random;
+
+    Tetromino FallingTetro;
+    Tetromino NextTetro;
+    BlockGrid MainGrid;
+
+    GameMemory* Memory; //NULL to allocate from the heap
+};
+
+GameData InitialiseGame(GameData Current);
+void     DestroyGame(GameData Game);
+
+GameMemory  GenerateGameMemory();
+void        DestroyGameMemory(GameMemory Memory);
+void        ResetGameMemory(GameMemory* Memory);
+
+GameData HandleInputGame(InputState Inputs, GameData Current);
+GameData HandleInputPaused(InputState Inputs, GameData Current);
+GameData HandleInputGameOver(InputState Inputs, GameData Current);
+
+GameData SimulateTick(GameData Current, InputState Inputs);
+//Telling Events what happens along the way, see events.h
+template<typename Listener>
+GameData SimulateTick(GameData Current, InputState Inputs, Listener* Events);
+GameData UpdateGame(GameData Current);
+unsigned int TicksUntilGravity(GameData Current);
+GameData FastForwardGame(GameData Current, unsigned int Ticks);
+GameData UpdatePaused(GameData Current);
+GameData UpdateGameOver(GameData Current);
+
+RandomSeries    SeedRandomSeries(unsigned int Seed);
+unsigned int    RandomNext(RandomSeries* Series);
+
+Block   GenerateBlock();
+Block*  GetBlock(BlockGrid Grid, unsigned int Row, unsigned int Col);
+void    EraseBlock(Block* BlockToErase);
+
+BlockGrid   GenerateGrid(unsigned int Rows, unsigned int Cols);
+BlockGrid   PushGrid(MemoryArena* Arena, unsigned int Rows, unsigned int Cols);
+BlockGrid   GenerateTetrominoGrid(BlockPool* Pool, unsigned int GridSize);
+void        DestroyTetrominoGrid(BlockPool* Pool, BlockGrid Grid);
+void        DestroyGrid(BlockGrid Grid);
+
+Tetromino       GenerateTetromino(RandomSeries* Series, BlockPool* Pool);
+unsigned char   GetPaletteIndex(unsigned char Red, unsigned char Green, unsigned char Blue);
+PaletteColour   GetPaletteColour(unsigned char Index);
+
+Tetromino       GenerateTetrominoOfType(TetrominoType Type, unsigned char Red, unsigned char Green, unsigned char Blue, BlockPool* Pool);
+void            DestroyTetromino(Tetromino Tetro);
+void            StoreTetromino(BlockGrid Grid, Tetromino Tetro);
+Tetromino       RotateTetroClockwise(Tetromino Tetro);
+Tetromino       RotateTetroAntiClockwise(Tetromino Tetro);
+
+unsigned int    CheckCollisions(BlockGrid Grid, Tetromino Tetro);
+//ClearedRows, if it isn't NULL, gets the first TETROMINO_MAX_SIZE full rows,
+//bottom first
+unsigned int    RemoveGridLines(BlockGrid Grid, unsigned int* ClearedRows);
+Vector2D CalculateGridCentreOfMass(BlockGrid Grid);
+
+//Runtime sized versions of the hot rule functions. The unsuffixed versions
+//above dispatch to these, or to the fixed dimension templates in game.cpp
+//when the grid matches a specialised size. Setting GenericRules sends every
+//grid to these, and is only safe before any threads that play games start.
+extern bool     GenericRules;
+
+void            StoreTetrominoGeneric(BlockGrid Grid, Tetromino Tetro);
+unsigned int    CheckCollisionsGeneric(BlockGrid Grid, Tetromino Tetro);
+unsigned int    RemoveGridLinesGeneric(BlockGrid Grid, unsigned int* ClearedRows);
+
+#endif
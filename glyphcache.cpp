@@ -0,0 +1,286 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "glyphcache.h"
+
+/*
+ * Keys and Paths
+ */
+
+//FNV-1a, but a word at a time since whole font files go through it
+unsigned long long HashBytes(unsigned long long Hash, const unsigned char* Bytes, size_t Count)
+{
+    const unsigned long long Prime = 0x100000001B3ull;
+    size_t Index = 0;
+
+    for(; Index + 8 <= Count; Index += 8)
+    {
+        unsigned long long Word;
+        memcpy(&Word, Bytes + Index, 8);
+        Hash = (Hash ^ Word)*Prime;
+    }
+
+    for(; Index < Count; ++Index)
+    {
+        Hash = (Hash ^ Bytes[Index])*Prime;
+    }
+
+    return Hash;
+}
+
+//Hashes the path, size and font file. Returns 0 if the font can't be
+//read, which is never a valid key.
+unsigned long long GlyphCacheKey(const char* FontPath, unsigned int PointSize)
+{
+    FILE* Font = fopen(FontPath, "rb");
+
+    if(Font == NULL)
+    {
+        return 0;
+    }
+
+    unsigned long long Hash = 0xCBF29CE484222325ull;
+    Hash = HashBytes(Hash, (const unsigned char*)FontPath, strlen(FontPath) + 1);
+    Hash = HashBytes(Hash, (const unsigned char*)&PointSize, sizeof(PointSize));
+
+    unsigned char Buffer[16*1024];
+    size_t Read = 0;
+
+    while( (Read = fread(Buffer, 1, sizeof(Buffer), Font)) > 0 )
+    {
+        Hash = HashBytes(Hash, Buffer, Read);
+    }
+
+    fclose(Font);
+
+    return Hash ? Hash : 1;
+}
+
+void MakeDirectory(const char* Path)
+{
+#if defined(_WIN32)
+    _mkdir(Path);
+#else
+    mkdir(Path, 0755);
+#endif
+}
+
+//The per user cache directory ($XDG_CACHE_HOME/agafb, ~/.cache/agafb or
+//%LOCALAPPDATA%\agafb), created if need be
+bool GlyphCachePath(unsigned long long Key, char* Path, unsigned int PathSize)
+{
+    char Directory[GLYPH_CACHE_PATH_MAX];
+
+#if defined(_WIN32)
+    const char* Base = getenv("LOCALAPPDATA");
+
+    if(Base == NULL)
+    {
+        return false;
+    }
+
+    snprintf(Directory, sizeof(Directory), "%s\\agafb", Base);
+#else
+    const char* Base = getenv("XDG_CACHE_HOME");
+
+    if( (Base == NULL) || (Base[0] == '\0') )
+    {
+        const char* Home = getenv("HOME");
+
+        if(Home == NULL)
+        {
+            return false;
+        }
+
+        snprintf(Directory, sizeof(Directory), "%s/.cache", Home);
+        MakeDirectory(Directory);
+    }
+    else
+    {
+        snprintf(Directory, sizeof(Directory), "%s", Base);
+        MakeDirectory(Directory);
+    }
+
+    size_t Length = strlen(Directory);
+    snprintf(Directory + Length, sizeof(Directory) - Length, "/agafb");
+#endif
+
+    MakeDirectory(Directory);
+
+    int Written = snprintf(Path, PathSize, "%s/glyphs-%016llx.bin", Directory, Key);
+
+    return (Written > 0) && ((unsigned int)Written < PathSize);
+}
+
+/*
+ * Reading and Writing
+ */
+
+void* MapWholeFile(const char* Path, size_t* Size)
+{
+#if defined(_WIN32)
+    //No mmap, read it into memory instead
+    FILE* File = fopen(Path, "rb");
+
+    if(File == NULL)
+    {
+        return NULL;
+    }
+
+    fseek(File, 0, SEEK_END);
+    long Length = ftell(File);
+    fseek(File, 0, SEEK_SET);
+
+    void* Result = (Length > 0) ? malloc(Length) : NULL;
+
+    if( Result && (fread(Result, 1, Length, File) != (size_t)Length) )
+    {
+        free(Result);
+        Result = NULL;
+    }
+
+    fclose(File);
+    *Size = Result ? (size_t)Length : 0;
+
+    return Result;
+#else
+    int File = open(Path, O_RDONLY);
+
+    if(File < 0)
+    {
+        return NULL;
+    }
+
+    struct stat Info;
+    void* Result = NULL;
+
+    if( (fstat(File, &Info) == 0) && (Info.st_size > 0) )
+    {
+        Result = mmap(NULL, Info.st_size, PROT_READ, MAP_PRIVATE, File, 0);
+
+        if(Result == MAP_FAILED)
+        {
+            Result = NULL;
+        }
+    }
+
+    close(File);
+    *Size = Result ? (size_t)Info.st_size : 0;
+
+    return Result;
+#endif
+}
+
+void UnmapWholeFile(void* Mapping, size_t Size)
+{
+#if defined(_WIN32)
+    free(Mapping);
+#else
+    munmap(Mapping, Size);
+#endif
+}
+
+//Valid is false on a miss, or if the file is stale, truncated or damaged
+GlyphCache OpenGlyphCache(const char* Path, unsigned long long Key)
+{
+    GlyphCache Result;
+    memset(&Result, 0, sizeof(Result));
+
+    Result.Mapping = MapWholeFile(Path, &Result.MappingSize);
+
+    if( (Result.Mapping == NULL) || (Result.MappingSize < sizeof(GlyphCacheHeader)) )
+    {
+        return Result;
+    }
+
+    const GlyphCacheHeader* Header = (const GlyphCacheHeader*)Result.Mapping;
+
+    if( (Header->Magic != GLYPH_CACHE_MAGIC) || (Header->Version != GLYPH_CACHE_VERSION) || (Header->Key != Key) )
+    {
+        return Result;
+    }
+
+    size_t EntriesSize = sizeof(GlyphCacheEntry)*(size_t)Header->GlyphCount;
+    size_t PixelsSize = 4*(size_t)Header->Width*Header->Height;
+
+    if(Result.MappingSize != sizeof(GlyphCacheHeader) + EntriesSize + PixelsSize)
+    {
+        return Result;
+    }
+
+    Result.Header = Header;
+    Result.Entries = (const GlyphCacheEntry*)(Header + 1);
+    Result.Pixels = (const unsigned char*)Result.Entries + EntriesSize;
+
+    for(unsigned int Index = 0; Index < Header->GlyphCount; ++Index)
+    {
+        const GlyphCacheEntry* Entry = Result.Entries + Index;
+
+        if( (Entry->X + Entry->Width > Header->Width) || (Entry->Y + Entry->Height > Header->Height) )
+        {
+            return Result;
+        }
+    }
+
+    Result.Valid = true;
+
+    return Result;
+}
+
+void CloseGlyphCache(GlyphCache Cache)
+{
+    if(Cache.Mapping)
+    {
+        UnmapWholeFile(Cache.Mapping, Cache.MappingSize);
+    }
+}
+
+//Written to a temporary file and renamed into place, so another launch
+//never maps a half written cache
+bool WriteGlyphCache(const char* Path, const GlyphCacheHeader* Header, const GlyphCacheEntry* Entries,
+                     const unsigned char* Pixels, unsigned int Pitch)
+{
+    char TempPath[GLYPH_CACHE_PATH_MAX + 8];
+    snprintf(TempPath, sizeof(TempPath), "%s.tmp", Path);
+
+    FILE* File = fopen(TempPath, "wb");
+
+    if(File == NULL)
+    {
+        printf("Unable to write glyph cache \"%s\"!\n", TempPath);
+        return false;
+    }
+
+    bool Success = (fwrite(Header, sizeof(GlyphCacheHeader), 1, File) == 1) &&
+                   (fwrite(Entries, sizeof(GlyphCacheEntry), Header->GlyphCount, File) == Header->GlyphCount);
+
+    for(unsigned int Row = 0; Success && (Row < Header->Height); ++Row)
+    {
+        Success = fwrite(Pixels + (size_t)Row*Pitch, 4, Header->Width, File) == Header->Width;
+    }
+
+    Success = (fclose(File) == 0) && Success;
+
+#if defined(_WIN32)
+    remove(Path);
+#endif
+
+    if( !Success || (rename(TempPath, Path) != 0) )
+    {
+        printf("Unable to write glyph cache \"%s\"!\n", Path);
+        remove(TempPath);
+        return false;
+    }
+
+    return true;
+}
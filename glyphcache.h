@@ -0,0 +1,65 @@
+#ifndef GLYPHCACHE_H
+#define GLYPHCACHE_H
+
+#include <stddef.h>
+
+/*
+ * Glyph Atlas Cache
+ *
+ * Rasterising the font is the slowest part of starting up, and the result
+ * never changes for a given font file and size. So the platform layer bakes
+ * every glyph into one atlas image, saves it here with each glyph's rectangle,
+ * and later launches map the file straight in and upload it as one texture.
+ *
+ * The key covers the font's path, point size and a hash of the font file
+ * itself, so editing or replacing the font is a miss rather than stale glyphs.
+ *
+ * File layout: GlyphCacheHeader, GlyphCount GlyphCacheEntry, then the atlas
+ * pixels at 4 bytes per pixel, Width*4 bytes per row.
+ */
+
+enum GlyphCacheConstants{
+    GLYPH_CACHE_MAGIC   = 0x41464741, //"AGFA"
+    GLYPH_CACHE_VERSION = 1,
+    GLYPH_CACHE_PATH_MAX = 1024
+};
+
+struct GlyphCacheHeader{
+    unsigned int Magic;
+    unsigned int Version;
+    unsigned long long Key;
+    unsigned int FirstGlyph;
+    unsigned int GlyphCount;
+    unsigned int Width;
+    unsigned int Height;
+    unsigned int PixelFormat;   //Whatever the writer uses, the cache doesn't interpret it
+    unsigned int Reserved;
+};
+
+struct GlyphCacheEntry{
+    unsigned short X;
+    unsigned short Y;
+    unsigned short Width;
+    unsigned short Height;
+};
+
+//A loaded cache file. Everything points into the file's mapping, and stays
+//valid until CloseGlyphCache.
+struct GlyphCache{
+    bool Valid;
+    const GlyphCacheHeader* Header;
+    const GlyphCacheEntry* Entries;
+    const unsigned char* Pixels;
+
+    void* Mapping;
+    size_t MappingSize;
+};
+
+unsigned long long  GlyphCacheKey(const char* FontPath, unsigned int PointSize);
+bool                GlyphCachePath(unsigned long long Key, char* Path, unsigned int PathSize);
+GlyphCache          OpenGlyphCache(const char* Path, unsigned long long Key);
+void                CloseGlyphCache(GlyphCache Cache);
+bool                WriteGlyphCache(const char* Path, const GlyphCacheHeader* Header, const GlyphCacheEntry* Entries,
+                                    const unsigned char* Pixels, unsigned int Pitch);
+
+#endif
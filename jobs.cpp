@@ -0,0 +1,452 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "jobs.h"
+
+//Which system and worker the running thread belongs to
+static thread_local const JobSystem* CurrentJobSystem;
+static thread_local unsigned int CurrentJobWorker;
+
+unsigned long long GetJobNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+unsigned int GetJobWorker(const JobSystem* System)
+{
+    return (CurrentJobSystem == System) ? CurrentJobWorker : 0;
+}
+
+//Best effort, a worker that can't be pinned just runs wherever it's put
+void PinJobWorker(unsigned int Worker)
+{
+    unsigned int CpuCount = std::thread::hardware_concurrency();
+    unsigned int Cpu = CpuCount ? Worker % CpuCount : 0;
+
+#if defined(_WIN32)
+    SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << (Cpu % (8*sizeof(DWORD_PTR))));
+#else
+    cpu_set_t Set;
+    CPU_ZERO(&Set);
+    CPU_SET(Cpu, &Set);
+    pthread_setaffinity_np(pthread_self(), sizeof(Set), &Set);
+#endif
+}
+
+/*
+ * Deques
+ *
+ * A lock each, as the tuner's task queues always had: the jobs here are whole
+ * batches of games, so a few uncontended locks a job are nothing next to them.
+ */
+
+bool PushJob(JobWorker* Worker, const QueuedJob* Job)
+{
+    std::lock_guard<std::mutex> Guard(Worker->Lock);
+
+    if(Worker->Bottom - Worker->Top == JOB_DEQUE_SIZE)
+    {
+        return false;
+    }
+
+    Worker->Deque[Worker->Bottom++ % JOB_DEQUE_SIZE] = *Job;
+
+    return true;
+}
+
+bool PopJob(JobWorker* Worker, QueuedJob* Job)
+{
+    std::lock_guard<std::mutex> Guard(Worker->Lock);
+
+    if(Worker->Bottom == Worker->Top)
+    {
+        return false;
+    }
+
+    *Job = Worker->Deque[--Worker->Bottom % JOB_DEQUE_SIZE];
+
+    return true;
+}
+
+bool StealJob(JobWorker* Worker, QueuedJob* Job)
+{
+    std::lock_guard<std::mutex> Guard(Worker->Lock);
+
+    if(Worker->Bottom == Worker->Top)
+    {
+        return false;
+    }
+
+    *Job = Worker->Deque[Worker->Top++ % JOB_DEQUE_SIZE];
+
+    return true;
+}
+
+/*
+ * Running
+ */
+
+//Its own deque first, then the others' in turn starting from the next one
+bool FindJob(JobSystem* System, unsigned int Worker, QueuedJob* Job)
+{
+    if(System->Queued.load() == 0)
+    {
+        return false;
+    }
+
+    bool Found = PopJob(System->Workers + Worker, Job);
+
+    for(unsigned int Victim = 1; !Found && (Victim < System->WorkerCount); ++Victim)
+    {
+        Found = StealJob(System->Workers + (Worker + Victim) % System->WorkerCount, Job);
+        System->Workers[Worker].Steals.fetch_add(Found, std::memory_order_relaxed);
+    }
+
+    if(Found)
+    {
+        System->Queued--;
+    }
+
+    return Found;
+}
+
+void RunJob(JobSystem* System, unsigned int Worker, const QueuedJob* Job)
+{
+    JobWorker* Self = System->Workers + Worker;
+
+    //Only the outermost job is timed, the ones it runs while joining are
+    //already inside its time
+    unsigned long long Start = Self->Depth ? 0 : GetJobNanoseconds();
+
+    Self->Depth++;
+    Job->Function(Job->Data, Job->Begin, Job->End, Worker);
+    Self->Depth--;
+
+    if(Self->Depth == 0)
+    {
+        Self->BusyNanoseconds.fetch_add(GetJobNanoseconds() - Start, std::memory_order_relaxed);
+    }
+
+    Self->Jobs.fetch_add(1, std::memory_order_relaxed);
+
+    //Last, as the group can go out of scope the moment it reaches 0
+    Job->Group->Remaining--;
+}
+
+void RunJobWorker(JobSystem* System, unsigned int Worker)
+{
+    CurrentJobSystem = System;
+    CurrentJobWorker = Worker;
+
+    if(System->Pinned)
+    {
+        PinJobWorker(Worker);
+    }
+
+    while(!System->Quit.load())
+    {
+        QueuedJob Job;
+
+        if(FindJob(System, Worker, &Job))
+        {
+            RunJob(System, Worker, &Job);
+            continue;
+        }
+
+        //Sleeping is counted before Queued is checked, and ForkJob counts
+        //Queued before it checks Sleeping, so one of them always sees the other
+        std::unique_lock<std::mutex> Guard(System->SleepLock);
+        System->Sleeping++;
+
+        while( (System->Queued.load() == 0) && !System->Quit.load() )
+        {
+            System->Forked.wait(Guard);
+        }
+
+        System->Sleeping--;
+    }
+}
+
+void ForkJob(JobSystem* System, JobGroup* Group, JobFunction* Function, void* Data,
+             unsigned long long Begin, unsigned long long End)
+{
+    unsigned int Worker = GetJobWorker(System);
+
+    QueuedJob Job;
+    Job.Function = Function;
+    Job.Data = Data;
+    Job.Begin = Begin;
+    Job.End = End;
+    Job.Group = Group;
+
+    Group->Remaining++;
+
+    //Counted before it's pushed so Queued is never short, only over for a
+    //moment, which just keeps a worker looking a little longer
+    System->Queued++;
+
+    if(!PushJob(System->Workers + Worker, &Job))
+    {
+        System->Queued--;
+        RunJob(System, Worker, &Job);
+        return;
+    }
+
+    if(System->Sleeping.load())
+    {
+        //Taking the lock means a worker between counting itself asleep and
+        //waiting has got to the wait, where it can be woken
+        {
+            std::lock_guard<std::mutex> Guard(System->SleepLock);
+        }
+
+        System->Forked.notify_one();
+    }
+}
+
+void JoinJobs(JobSystem* System, JobGroup* Group)
+{
+    unsigned int Worker = GetJobWorker(System);
+
+    while(Group->Remaining.load())
+    {
+        QueuedJob Job;
+
+        if(FindJob(System, Worker, &Job))
+        {
+            RunJob(System, Worker, &Job);
+        }
+        else
+        {
+            //Group's last jobs are running elsewhere
+            std::this_thread::yield();
+        }
+    }
+}
+
+/*
+ * Parallel For
+ */
+
+struct ParallelForJob{
+    JobSystem* System;
+    JobGroup* Group;
+    JobFunction* Function;
+    void* Data;
+    unsigned long long Grain;
+};
+
+//Forks off the top half until what's left is a single grain, then runs that
+void RunParallelFor(void* Data, unsigned long long Begin, unsigned long long End, unsigned int Worker)
+{
+    ParallelForJob* For = (ParallelForJob*)Data;
+
+    while(End - Begin > For->Grain)
+    {
+        //Split on a whole number of grains so the ranges stay aligned
+        unsigned long long Grains = (End - Begin + For->Grain - 1)/For->Grain;
+        unsigned long long Middle = Begin + (Grains/2)*For->Grain;
+
+        ForkJob(For->System, For->Group, RunParallelFor, For, Middle, End);
+        End = Middle;
+    }
+
+    For->Function(For->Data, Begin, End, Worker);
+}
+
+void ParallelFor(JobSystem* System, unsigned long long Count, unsigned long long Grain,
+                 JobFunction* Function, void* Data)
+{
+    if(Count == 0)
+    {
+        return;
+    }
+
+    JobGroup Group;
+    Group.Remaining.store(0);
+
+    ParallelForJob For;
+    For.System = System;
+    For.Group = &Group;
+    For.Function = Function;
+    For.Data = Data;
+    For.Grain = Grain ? Grain : 1;
+
+    ForkJob(System, &Group, RunParallelFor, &For, 0, Count);
+    JoinJobs(System, &Group);
+}
+
+/*
+ * Setup
+ */
+
+JobSystem* CreateJobSystem(unsigned int WorkerCount, bool Pin)
+{
+    WorkerCount = WorkerCount ? WorkerCount : std::thread::hardware_concurrency();
+    WorkerCount = (WorkerCount < 1) ? 1 : (WorkerCount > JOB_MAX_WORKERS) ? (unsigned int)JOB_MAX_WORKERS : WorkerCount;
+
+    JobSystem* System = new JobSystem;
+
+    System->Workers = new JobWorker[WorkerCount];
+    System->WorkerCount = WorkerCount;
+    System->Pinned = Pin;
+    System->Queued.store(0);
+    System->Sleeping.store(0);
+    System->Quit.store(false);
+
+    bool Allocated = true;
+
+    for(unsigned int Worker = 0; Worker < WorkerCount; ++Worker)
+    {
+        JobWorker* Self = System->Workers + Worker;
+
+        Self->Deque = (QueuedJob*)malloc(sizeof(QueuedJob)*JOB_DEQUE_SIZE);
+        Self->Top = 0;
+        Self->Bottom = 0;
+        Self->Depth = 0;
+
+        Allocated = Allocated && (Self->Deque != NULL);
+    }
+
+    if(!Allocated)
+    {
+        printf("Could not allocate deques for %u job workers\n", WorkerCount);
+
+        for(unsigned int Worker = 0; Worker < WorkerCount; ++Worker)
+        {
+            free(System->Workers[Worker].Deque);
+        }
+
+        delete[] System->Workers;
+        delete System;
+        return NULL;
+    }
+
+    ResetJobStats(System);
+
+    //The creating thread is worker 0
+    CurrentJobSystem = System;
+    CurrentJobWorker = 0;
+
+    if(Pin)
+    {
+        PinJobWorker(0);
+    }
+
+    for(unsigned int Worker = 1; Worker < WorkerCount; ++Worker)
+    {
+        System->Workers[Worker].Thread = std::thread(RunJobWorker, System, Worker);
+    }
+
+    return System;
+}
+
+void DestroyJobSystem(JobSystem* System)
+{
+    {
+        std::lock_guard<std::mutex> Guard(System->SleepLock);
+        System->Quit.store(true);
+    }
+
+    System->Forked.notify_all();
+
+    for(unsigned int Worker = 1; Worker < System->WorkerCount; ++Worker)
+    {
+        System->Workers[Worker].Thread.join();
+    }
+
+    if(CurrentJobSystem == System)
+    {
+        CurrentJobSystem = NULL;
+    }
+
+    for(unsigned int Worker = 0; Worker < System->WorkerCount; ++Worker)
+    {
+        free(System->Workers[Worker].Deque);
+    }
+
+    delete[] System->Workers;
+    delete System;
+}
+
+/*
+ * Stats
+ */
+
+void ResetJobStats(JobSystem* System)
+{
+    for(unsigned int Worker = 0; Worker < System->WorkerCount; ++Worker)
+    {
+        System->Workers[Worker].Jobs.store(0);
+        System->Workers[Worker].Steals.store(0);
+        System->Workers[Worker].BusyNanoseconds.store(0);
+    }
+
+    System->StatsStart = GetJobNanoseconds();
+}
+
+JobStats GetJobStats(const JobSystem* System, unsigned int Worker)
+{
+    const JobWorker* Self = System->Workers + Worker;
+
+    JobStats Stats;
+    Stats.Jobs = Self->Jobs.load(std::memory_order_relaxed);
+    Stats.Steals = Self->Steals.load(std::memory_order_relaxed);
+    Stats.BusyNanoseconds = Self->BusyNanoseconds.load(std::memory_order_relaxed);
+
+    return Stats;
+}
+
+JobStats GetTotalJobStats(const JobSystem* System)
+{
+    JobStats Total;
+    memset(&Total, 0, sizeof(Total));
+
+    for(unsigned int Worker = 0; Worker < System->WorkerCount; ++Worker)
+    {
+        JobStats Stats = GetJobStats(System, Worker);
+
+        Total.Jobs += Stats.Jobs;
+        Total.Steals += Stats.Steals;
+        Total.BusyNanoseconds += Stats.BusyNanoseconds;
+    }
+
+    return Total;
+}
+
+double GetJobUtilisation(const JobSystem* System)
+{
+    double Elapsed = (double)(GetJobNanoseconds() - System->StatsStart);
+
+    return (Elapsed > 0.0) ? GetTotalJobStats(System).BusyNanoseconds/(Elapsed*System->WorkerCount) : 0.0;
+}
+
+void PrintJobStats(const JobSystem* System)
+{
+    double Elapsed = (double)(GetJobNanoseconds() - System->StatsStart);
+    Elapsed = (Elapsed > 0.0) ? Elapsed : 1.0;
+
+    JobStats Total = GetTotalJobStats(System);
+
+    printf("%u job workers%s, %.0f%% busy, %llu jobs, %llu stolen\n", System->WorkerCount,
+           System->Pinned ? " pinned" : "", 100.0*Total.BusyNanoseconds/(Elapsed*System->WorkerCount),
+           Total.Jobs, Total.Steals);
+
+    for(unsigned int Worker = 0; Worker < System->WorkerCount; ++Worker)
+    {
+        JobStats Stats = GetJobStats(System, Worker);
+
+        printf("  worker %3u: %5.1f%% busy, %llu jobs, %llu stolen\n", Worker, 100.0*Stats.BusyNanoseconds/Elapsed,
+               Stats.Jobs, Stats.Steals);
+    }
+}
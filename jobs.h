@@ -0,0 +1,134 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/*
+ * Job System
+ *
+ * One pool of workers the headless tools share their parallel work out on:
+ * batches of games, solver branches, corpus stretches, table rows. A job is a
+ * function run over a range, [Begin, End) of whatever the Data it's given
+ * holds, and is told which worker it's running on so it can keep per worker
+ * scratch - an engine, a game, a set of totals - in an array indexed by it.
+ *
+ * Every worker has its own deque. Jobs forked on a worker go on the bottom of
+ * its deque and it takes them back from the bottom, newest first, so it keeps
+ * working on what's still in cache. A worker with nothing left steals from the
+ * top of the others', oldest first, which for ParallelFor is the biggest half
+ * of a range still unsplit. Workers with nothing to run or steal sleep until
+ * something is forked.
+ *
+ * Worker 0 is the thread that made the system. It runs jobs only while it's
+ * waiting in JoinJobs or ParallelFor, the way the tools' main threads have
+ * always taken a share. Only that thread, and jobs themselves, may fork and
+ * join. Jobs can fork and join their own jobs, and a worker waiting on a join
+ * runs whatever it can find meanwhile.
+ *
+ * Pinning puts worker N on CPU N, wrapping round, the creating thread
+ * included. It stops the scheduler moving workers off their caches, at the
+ * cost of sharing CPUs badly with anything else running.
+ *
+ * Each worker counts the jobs it ran, the jobs it stole and the time it spent
+ * running them, so a tool can report how evenly the work spread and how much
+ * of the time the workers were busy rather than waiting.
+ */
+
+enum JobConstants{
+    JOB_MAX_WORKERS     = 256,
+
+    //Jobs a worker's deque holds. Forking onto a full deque runs the job there
+    //and then, which is slower but can't deadlock.
+    JOB_DEQUE_SIZE      = 4096
+};
+
+//Runs over [Begin, End) of Data, on worker Worker
+typedef void JobFunction(void* Data, unsigned long long Begin, unsigned long long End, unsigned int Worker);
+
+//Jobs forked and not yet finished. Zeroed before the first fork, and it has to
+//outlive JoinJobs.
+struct JobGroup{
+    std::atomic<unsigned int> Remaining;
+};
+
+struct QueuedJob{
+    JobFunction* Function;
+    void* Data;
+    unsigned long long Begin;
+    unsigned long long End;
+    JobGroup* Group;
+};
+
+struct JobStats{
+    unsigned long long Jobs;
+    unsigned long long Steals;
+    unsigned long long BusyNanoseconds;
+};
+
+//On a cache line of its own, as every worker writes its counters constantly
+struct alignas(64) JobWorker{
+    std::mutex Lock;
+    QueuedJob* Deque;
+    unsigned long long Top;         //Where thieves take from
+    unsigned long long Bottom;      //Where the owner forks to and takes from
+
+    std::thread Thread;
+    unsigned int Depth;             //Jobs running on this worker, counting ones joining
+
+    //Written only by the worker, read by anyone
+    std::atomic<unsigned long long> Jobs;
+    std::atomic<unsigned long long> Steals;
+    std::atomic<unsigned long long> BusyNanoseconds;
+};
+
+struct JobSystem{
+    JobWorker* Workers;
+    unsigned int WorkerCount;
+    bool Pinned;
+
+    std::atomic<unsigned int> Queued;       //Jobs sitting in a deque
+    std::atomic<unsigned int> Sleeping;
+    std::atomic<bool> Quit;
+    std::mutex SleepLock;
+    std::condition_variable Forked;
+
+    unsigned long long StatsStart;          //When the counters were last reset
+};
+
+//WorkerCount 0 is one per hardware thread. NULL, having said why, if the
+//workers couldn't be started.
+JobSystem*      CreateJobSystem(unsigned int WorkerCount, bool Pin);
+void            DestroyJobSystem(JobSystem* System);
+
+//Queues Function over [Begin, End) of Data as part of Group
+void            ForkJob(JobSystem* System, JobGroup* Group, JobFunction* Function, void* Data,
+                        unsigned long long Begin, unsigned long long End);
+
+//Runs jobs, Group's or anyone's, until all of Group's have finished
+void            JoinJobs(JobSystem* System, JobGroup* Group);
+
+//Runs Function over [0, Count) in ranges of Grain (the last may be shorter),
+//returning once every range is done. The range is halved onto the deque
+//until it's down to Grain, so idle workers steal big pieces first.
+void            ParallelFor(JobSystem* System, unsigned long long Count, unsigned long long Grain,
+                            JobFunction* Function, void* Data);
+
+//The worker the calling thread is, 0 for any thread that isn't one
+unsigned int    GetJobWorker(const JobSystem* System);
+
+//Only meaningful with no jobs running
+void            ResetJobStats(JobSystem* System);
+JobStats        GetJobStats(const JobSystem* System, unsigned int Worker);
+JobStats        GetTotalJobStats(const JobSystem* System);
+
+//Share of the workers' time since the counters were reset that they spent
+//running jobs
+double          GetJobUtilisation(const JobSystem* System);
+
+//A line per worker: jobs, steals and how busy it was
+void            PrintJobStats(const JobSystem* System);
+
+#endif
@@ -0,0 +1,389 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "arena.cpp"
+#include "game.cpp"
+#include "pieces.cpp"
+#include "net.cpp"
+
+/*
+ * Load Client
+ *
+ * Simulates many players against agafb_server from one thread, so the server
+ * can be load tested on one machine. Every connection presses a random key at
+ * a fixed rate, staggered across connections, restarts when its game ends, and
+ * checks each update it gets. The time from sending an input to the first
+ * update acknowledging it is the input latency reported at the end.
+ *
+ * With --idle, that percentage of the connections pause their games and go
+ * quiet for the first half of the run, long enough for the server to
+ * hibernate them, then unpause and play like the rest.
+ *
+ *   agafb_loadclient [--connect address] [--sessions n] [--seconds s] [--key-every-ms ms] [--idle percent]
+ */
+
+enum LoadClientConstants{
+    LOAD_DEFAULT_SESSIONS   = 1000,
+    LOAD_DEFAULT_SECONDS    = 10,
+    LOAD_DEFAULT_KEY_MS     = 250,
+    LOAD_EVENT_BATCH        = 512,
+
+    //Latency histogram, in 100us buckets up to 1s
+    LOAD_LATENCY_BUCKET_NS  = 100000,
+    LOAD_LATENCY_BUCKETS    = 10000
+};
+
+struct LoadConnection{
+    int Socket;
+    bool Open;
+
+    unsigned short Sequence;
+    unsigned long long SentTime;    //Of Sequence, 0 once it's been acknowledged
+    unsigned char State;            //From the last update
+    bool Idle;                      //Pauses for the first half of the run
+
+    unsigned char Partial[sizeof(ServerUpdate)];
+    unsigned int PartialSize;
+};
+
+struct LoadStats{
+    unsigned long long Sent;
+    unsigned long long SendFailures;
+    unsigned long long Updates;
+    unsigned long long BadUpdates;
+    unsigned long long GamesOver;
+    unsigned long long Disconnects;
+
+    unsigned long long Latencies;
+    unsigned long long TotalLatencyNs;
+    unsigned long long MaxLatencyNs;
+    unsigned int Latency[LOAD_LATENCY_BUCKETS + 1];
+};
+
+volatile sig_atomic_t LoadInterrupted = 0;
+
+void HandleLoadSignal(int)
+{
+    LoadInterrupted = 1;
+}
+
+unsigned long long GetNanoseconds()
+{
+    timespec Now;
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+
+    return (unsigned long long)Now.tv_sec*1000000000ull + Now.tv_nsec;
+}
+
+void SendInput(LoadConnection* Connection, unsigned int Inputs, LoadStats* Stats)
+{
+    ClientMessage Message;
+
+    Message.Type = CLIENT_INPUT;
+    Message.Inputs = (unsigned char)Inputs;
+    Message.Sequence = ++Connection->Sequence;
+
+    ssize_t Sent = send(Connection->Socket, &Message, sizeof(Message), MSG_DONTWAIT | MSG_NOSIGNAL);
+
+    if(Sent == (ssize_t)sizeof(Message))
+    {
+        Connection->SentTime = GetNanoseconds();
+        Stats->Sent++;
+    }
+    else
+    {
+        //Never happens unless the server stops reading, so it's not retried
+        Stats->SendFailures++;
+    }
+}
+
+void HandleUpdate(LoadConnection* Connection, const ServerUpdate* Update, LoadStats* Stats)
+{
+    bool Valid = (Update->Type == SERVER_UPDATE) && (Update->State <= GAMEOVER) &&
+                 ((Update->State == INITIALISING) || (Update->Piece < 7));
+
+    for(unsigned int Row = 0; Valid && (Row < GRID_ROWS); ++Row)
+    {
+        Valid = (Update->Rows[Row] >> GRID_COLS) == 0;
+    }
+
+    if(!Valid)
+    {
+        Stats->BadUpdates++;
+        return;
+    }
+
+    Stats->Updates++;
+
+    if( Connection->SentTime && (Update->Ack == Connection->Sequence) )
+    {
+        unsigned long long Latency = GetNanoseconds() - Connection->SentTime;
+        unsigned int Bucket = (unsigned int)(Latency/LOAD_LATENCY_BUCKET_NS);
+
+        Stats->Latency[(Bucket < LOAD_LATENCY_BUCKETS) ? Bucket : (unsigned int)LOAD_LATENCY_BUCKETS]++;
+        Stats->Latencies++;
+        Stats->TotalLatencyNs += Latency;
+        Stats->MaxLatencyNs = (Latency > Stats->MaxLatencyNs) ? Latency : Stats->MaxLatencyNs;
+
+        Connection->SentTime = 0;
+    }
+
+    if( (Update->State == GAMEOVER) && (Connection->State != GAMEOVER) )
+    {
+        Stats->GamesOver++;
+    }
+
+    Connection->State = Update->State;
+}
+
+void ReadConnection(LoadConnection* Connection, LoadStats* Stats)
+{
+    unsigned char Buffer[4096];
+
+    for(;;)
+    {
+        ssize_t Read = recv(Connection->Socket, Buffer, sizeof(Buffer), MSG_DONTWAIT);
+
+        if(Read <= 0)
+        {
+            if( (Read == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)) )
+            {
+                close(Connection->Socket);
+                Connection->Open = false;
+                Stats->Disconnects++;
+            }
+
+            return;
+        }
+
+        for(ssize_t Index = 0; Index < Read; )
+        {
+            unsigned int Wanted = sizeof(ServerUpdate) - Connection->PartialSize;
+            unsigned int Available = (unsigned int)(Read - Index);
+            unsigned int Take = (Wanted < Available) ? Wanted : Available;
+
+            memcpy(Connection->Partial + Connection->PartialSize, Buffer + Index, Take);
+            Connection->PartialSize += Take;
+            Index += Take;
+
+            if(Connection->PartialSize == sizeof(ServerUpdate))
+            {
+                ServerUpdate Update;
+                memcpy(&Update, Connection->Partial, sizeof(Update));
+                Connection->PartialSize = 0;
+
+                HandleUpdate(Connection, &Update, Stats);
+            }
+        }
+    }
+}
+
+//Latency below which Fraction of the inputs were acknowledged, in ms
+double GetLatencyPercentile(const LoadStats* Stats, double Fraction)
+{
+    unsigned long long Wanted = (unsigned long long)(Stats->Latencies*Fraction);
+    unsigned long long Seen = 0;
+
+    for(unsigned int Bucket = 0; Bucket <= LOAD_LATENCY_BUCKETS; ++Bucket)
+    {
+        Seen += Stats->Latency[Bucket];
+
+        if(Seen > Wanted)
+        {
+            return (Bucket + 1)*(LOAD_LATENCY_BUCKET_NS/1e6);
+        }
+    }
+
+    return LOAD_LATENCY_BUCKETS*(LOAD_LATENCY_BUCKET_NS/1e6);
+}
+
+int main(int argc, char** argv)
+{
+    const char* Address = DEFAULT_SERVER_SOCKET;
+    unsigned int SessionCount = LOAD_DEFAULT_SESSIONS;
+    unsigned int Seconds = LOAD_DEFAULT_SECONDS;
+    unsigned int KeyEveryMs = LOAD_DEFAULT_KEY_MS;
+    unsigned int IdlePercent = 0;
+
+    for(int Arg = 1; Arg < argc; ++Arg)
+    {
+        if( (strcmp(argv[Arg], "--connect") == 0) && (Arg + 1 < argc) )
+        {
+            Address = argv[++Arg];
+        }
+        else if( (strcmp(argv[Arg], "--sessions") == 0) && (Arg + 1 < argc) )
+        {
+            SessionCount = atoi(argv[++Arg]);
+        }
+        else if( (strcmp(argv[Arg], "--seconds") == 0) && (Arg + 1 < argc) )
+        {
+            Seconds = atoi(argv[++Arg]);
+        }
+        else if( (strcmp(argv[Arg], "--key-every-ms") == 0) && (Arg + 1 < argc) )
+        {
+            KeyEveryMs = atoi(argv[++Arg]);
+        }
+        else if( (strcmp(argv[Arg], "--idle") == 0) && (Arg + 1 < argc) )
+        {
+            IdlePercent = atoi(argv[++Arg]);
+        }
+        else
+        {
+            printf("Usage: %s [--connect path|host:port] [--sessions n] [--seconds s] [--key-every-ms ms] [--idle percent]\n",
+                   argv[0]);
+            return 1;
+        }
+    }
+
+    SessionCount = SessionCount ? SessionCount : 1;
+    KeyEveryMs = KeyEveryMs ? KeyEveryMs : 1;
+
+    RaiseFileLimit();
+    signal(SIGINT, HandleLoadSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    MemoryArena Arena = GenerateArena(SessionCount*sizeof(LoadConnection) + sizeof(LoadStats) + 2*ARENA_ALIGNMENT);
+    LoadConnection* Connections = PushArray(&Arena, LoadConnection, SessionCount);
+    LoadStats* Stats = PushStruct(&Arena, LoadStats);
+
+    int Epoll = epoll_create1(EPOLL_CLOEXEC);
+
+    if( (Connections == NULL) || (Stats == NULL) || (Epoll < 0) )
+    {
+        printf("Could not set up the load client!\n");
+        return 1;
+    }
+
+    memset(Connections, 0, SessionCount*sizeof(LoadConnection));
+    memset(Stats, 0, sizeof(*Stats));
+
+    unsigned int OpenCount = 0;
+
+    for(unsigned int Index = 0; Index < SessionCount; ++Index)
+    {
+        int Socket = ConnectSocket(Address);
+
+        if( (Socket < 0) || !SetNonBlocking(Socket) )
+        {
+            printf("Connection %u to %s failed: %s\n", Index, Address, strerror(errno));
+            break;
+        }
+
+        epoll_event Event;
+        Event.events = EPOLLIN;
+        Event.data.u32 = Index;
+        epoll_ctl(Epoll, EPOLL_CTL_ADD, Socket, &Event);
+
+        Connections[Index].Socket = Socket;
+        Connections[Index].Open = true;
+        Connections[Index].Idle = (Index%100 < IdlePercent);
+        ++OpenCount;
+    }
+
+    printf("%u connections to %s, a key every %ums each for %us\n", OpenCount, Address, KeyEveryMs, Seconds);
+    fflush(stdout);
+
+    RandomSeries Random = SeedRandomSeries((unsigned int)GetNanoseconds());
+
+    //Keys go out evenly spread: one every KeyEveryMs/OpenCount, round robin
+    unsigned long long Start = GetNanoseconds();
+    unsigned long long End = Start + Seconds*1000000000ull;
+    unsigned long long IdleEnd = Start + Seconds*500000000ull;
+    unsigned long long KeyInterval = OpenCount ? (KeyEveryMs*1000000ull)/OpenCount : 1;
+    KeyInterval = KeyInterval ? KeyInterval : 1;
+
+    unsigned long long KeysDue = 0;
+    unsigned int NextConnection = 0;
+
+    epoll_event Events[LOAD_EVENT_BATCH];
+
+    while( OpenCount && !LoadInterrupted )
+    {
+        unsigned long long Now = GetNanoseconds();
+
+        if(Now >= End)
+        {
+            break;
+        }
+
+        for(unsigned long long Due = (Now - Start)/KeyInterval; KeysDue < Due; ++KeysDue)
+        {
+            LoadConnection* Connection = Connections + NextConnection;
+            NextConnection = (NextConnection + 1)%OpenCount;
+
+            if(!Connection->Open)
+            {
+                continue;
+            }
+
+            static const unsigned int Keys[] = {CLIENT_UP, CLIENT_DOWN, CLIENT_LEFT, CLIENT_RIGHT};
+            unsigned int Inputs = (Connection->State == GAMEOVER) ? (unsigned int)CLIENT_SPACE : Keys[RandomNext(&Random)%4];
+
+            //Idling connections pause once and then leave the game alone, or
+            //sit at game over
+            if( Connection->Idle && (Now < IdleEnd) )
+            {
+                if(Connection->State != RUNNING)
+                {
+                    continue;
+                }
+
+                Inputs = CLIENT_SPACE;
+            }
+            else if(Connection->State == PAUSED)
+            {
+                Inputs = CLIENT_SPACE;
+            }
+
+            SendInput(Connection, Inputs, Stats);
+        }
+
+        int Count = epoll_wait(Epoll, Events, LOAD_EVENT_BATCH, 1);
+
+        for(int Index = 0; Index < Count; ++Index)
+        {
+            LoadConnection* Connection = Connections + Events[Index].data.u32;
+
+            if(Connection->Open)
+            {
+                ReadConnection(Connection, Stats);
+            }
+        }
+    }
+
+    double Elapsed = (GetNanoseconds() - Start)/1e9;
+
+    printf("%.1fs: %llu inputs sent (%llu failed), %.0f updates/s, %llu bad updates, %llu games over, %llu disconnects\n",
+           Elapsed, Stats->Sent, Stats->SendFailures, Stats->Updates/Elapsed, Stats->BadUpdates,
+           Stats->GamesOver, Stats->Disconnects);
+
+    if(Stats->Latencies)
+    {
+        printf("Input to update latency: avg %.2fms p50 %.2fms p99 %.2fms max %.2fms over %llu inputs\n",
+               (Stats->TotalLatencyNs/1e6)/Stats->Latencies, GetLatencyPercentile(Stats, 0.5),
+               GetLatencyPercentile(Stats, 0.99), Stats->MaxLatencyNs/1e6, Stats->Latencies);
+    }
+
+    for(unsigned int Index = 0; Index < SessionCount; ++Index)
+    {
+        if(Connections[Index].Open)
+        {
+            close(Connections[Index].Socket);
+        }
+    }
+
+    bool Clean = (Stats->BadUpdates == 0);
+
+    close(Epoll);
+    DestroyArena(Arena);
+
+    return Clean ? 0 : 1;
+}
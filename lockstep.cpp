@@ -0,0 +1,110 @@
+#include <string.h>
+
+#include "lockstep.h"
+
+LockstepShapeTable LockstepShapes;
+
+//Where the per type code in GenerateTetrominoOfType put each tetromino's
+//blocks before piece sets, as indices into a 4x4 grid:
+/*
+ *| 0  | 1  | 2  | 3  |
+ *| 4  | 5  | 6  | 7  |
+ *| 8  | 9  | 10 | 11 |
+ *| 12 | 13 | 14 | 15 |
+ */
+struct LockstepShapeCoords{
+    unsigned int GridSize;
+    unsigned int Coords[4];
+};
+
+static const LockstepShapeCoords LockstepShapeLayouts[LOCKSTEP_SHAPES] = {
+    {4, {0, 4, 8, 12}},     //I_SHAPE
+    {3, {0, 1, 2, 5}},      //T_SHAPE
+    {2, {0, 1, 4, 5}},      //O_SHAPE
+    {3, {0, 1, 5, 6}},      //Z_SHAPE
+    {3, {1, 2, 4, 5}},      //S_SHAPE
+    {3, {0, 1, 2, 6}},      //L_L_SHAPE
+    {3, {0, 1, 2, 4}}       //L_R_SHAPE
+};
+
+//Built from the coordinates above, rotating by transposing the grid and then
+//mirroring its columns the way RotateTetroClockwise used to. None of it goes
+//through the piece table, so the fuzzer comparing the two engines checks the
+//table too.
+void BuildLockstepShapes()
+{
+    if(LockstepShapes.Initialised)
+    {
+        return;
+    }
+
+    for(unsigned int Type = 0; Type < LOCKSTEP_SHAPES; ++Type)
+    {
+        const LockstepShapeCoords* Layout = LockstepShapeLayouts + Type;
+        unsigned int GridSize = Layout->GridSize;
+
+        unsigned char Cells[TETROMINO_MAX_SIZE][TETROMINO_MAX_SIZE];
+        memset(Cells, 0, sizeof(Cells));
+
+        for(unsigned int Index = 0; Index < 4; ++Index)
+        {
+            Cells[Layout->Coords[Index]/4][Layout->Coords[Index]%4] = 1;
+        }
+
+        for(unsigned int Rotation = 0; Rotation < LOCKSTEP_ROTATIONS; ++Rotation)
+        {
+            for(unsigned int Row = 0; Row < TETROMINO_MAX_SIZE; ++Row)
+            {
+                unsigned int Mask = 0;
+
+                for(unsigned int Col = 0; Col < TETROMINO_MAX_SIZE; ++Col)
+                {
+                    Mask |= Cells[Row][Col] ? (1u << Col) : 0;
+                }
+
+                LockstepShapes.Rows[Type][Rotation][Row] = Mask;
+            }
+
+            //The O shape never rotated, but transposing and mirroring a full
+            //square leaves it as it is anyway
+            unsigned char Transposed[TETROMINO_MAX_SIZE][TETROMINO_MAX_SIZE];
+            memset(Transposed, 0, sizeof(Transposed));
+
+            for(unsigned int Row = 0; Row < GridSize; ++Row)
+            {
+                for(unsigned int Col = 0; Col < GridSize; ++Col)
+                {
+                    Transposed[Col][Row] = Cells[Row][Col];
+                }
+            }
+
+            memset(Cells, 0, sizeof(Cells));
+
+            for(unsigned int Row = 0; Row < GridSize; ++Row)
+            {
+                for(unsigned int Col = 0; Col < GridSize; ++Col)
+                {
+                    Cells[Row][(GridSize - 1) - Col] = Transposed[Row][Col];
+                }
+            }
+        }
+    }
+
+    LockstepShapes.Initialised = true;
+}
+
+//Draws from the series in the same order as GenerateTetromino, colour first
+unsigned int LockstepGenerateType(unsigned int* RandomState)
+{
+    RandomSeries Series = {*RandomState};
+
+    RandomNext(&Series);
+    RandomNext(&Series);
+    RandomNext(&Series);
+
+    unsigned int Rand = RandomNext(&Series);
+
+    *RandomState = Series.State;
+
+    return Rand%7;
+}
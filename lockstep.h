@@ -0,0 +1,400 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include "game.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/*
+ * Lockstep Games
+ *
+ * K games held as struct-of-arrays and stepped together, one UpdateGame
+ * equivalent tick per call. Board rows are occupancy masks interleaved across
+ * games (RowMasks[Row][Lane]) and every per game field is its own 32 bit lane
+ * array, so gravity, moves, rotation and their collision tests run as branch
+ * free passes over the lanes - eight at a time with AVX2 gathers when the
+ * compiler targets it, one at a time otherwise. Locking, line clears and game
+ * over only happen in a few lanes on any tick, so those fall back to scalar
+ * code for just the lanes concerned.
+ *
+ * Only occupancy is tracked - there are no colours - but the random series is
+ * consumed exactly as GenerateTetromino consumes it, so a lane stays in step
+ * with a GameData seeded the same way and fed the same inputs.
+ */
+
+enum LockstepConstants{
+    //Board columns sit LOCKSTEP_WALL bits up with wall bits either side, and
+    //there are solid floor rows under the board, so a piece hanging off any
+    //edge collides without a separate bounds check
+    LOCKSTEP_WALL       = TETROMINO_MAX_SIZE,
+    LOCKSTEP_ROWS       = GRID_ROWS + TETROMINO_MAX_SIZE,
+    LOCKSTEP_ROTATIONS  = 4,
+    LOCKSTEP_SHAPES     = 7,
+
+    LOCKSTEP_EMPTY_ROW  = ~(((1u << GRID_COLS) - 1) << LOCKSTEP_WALL),
+    LOCKSTEP_SOLID_ROW  = ~0u
+};
+
+//Per lane input bits, one set per tick
+enum LockstepInput{
+    LOCKSTEP_LEFT   = 1 << 0,
+    LOCKSTEP_RIGHT  = 1 << 1,
+    LOCKSTEP_ROTATE = 1 << 2,
+    LOCKSTEP_DOWN   = 1 << 3
+};
+
+//Row masks for every shape in every rotation, bit N is column N of the
+//tetromino grid. Built on their own from the tetrominoes' original block
+//coordinates rather than from the piece table (pieces.h), so the two are an
+//independent check on each other.
+struct LockstepShapeTable{
+    bool Initialised;
+    unsigned int Rows[LOCKSTEP_SHAPES][LOCKSTEP_ROTATIONS][TETROMINO_MAX_SIZE];
+};
+
+extern LockstepShapeTable LockstepShapes;
+
+void            BuildLockstepShapes();
+unsigned int    LockstepGenerateType(unsigned int* RandomState);
+
+//For walking the lanes set in a lane mask
+inline unsigned int CountTrailingZeros(unsigned int Value)
+{
+#if defined(_MSC_VER)
+    unsigned long Index;
+    _BitScanForward(&Index, Value);
+    return Index;
+#else
+    return __builtin_ctz(Value);
+#endif
+}
+
+template<unsigned int K>
+struct LockstepGames{
+    unsigned int RowMasks[LOCKSTEP_ROWS][K];
+
+    int          Row[K];
+    int          Col[K];
+    unsigned int Type[K];
+    unsigned int Rotation[K];
+    unsigned int NextType[K];
+
+    unsigned int State[K];
+    unsigned int FallingTimer[K];
+    unsigned int Score[K];
+    unsigned int LinesRemoved[K]; //This tick only
+    unsigned int Random[K];       //RandomSeries state
+};
+
+//Indexing is kept flat (base + offset) so the lane loop can turn the board and
+//shape lookups into gathers
+template<unsigned int K>
+inline unsigned int LockstepCollides(const LockstepGames<K>* Games, unsigned int Lane, int Row, int Col, unsigned int Rotation)
+{
+    const unsigned int* Masks = &Games->RowMasks[0][0];
+    const unsigned int* Shapes = &LockstepShapes.Rows[0][0][0];
+
+    int Shape = (Games->Type[Lane]*LOCKSTEP_ROTATIONS + (Rotation & (LOCKSTEP_ROTATIONS-1)))*TETROMINO_MAX_SIZE;
+    unsigned int Shift = Col + LOCKSTEP_WALL;
+    unsigned int Hit = 0;
+
+    for(int Row2 = 0; Row2 < TETROMINO_MAX_SIZE; ++Row2)
+    {
+        Hit |= Masks[(Row + Row2)*(int)K + (int)Lane] & (Shapes[Shape + Row2] << Shift);
+    }
+
+    return Hit != 0;
+}
+
+//Equivalent of InitialiseGame, carrying on from the lane's current random state
+template<unsigned int K>
+void InitialiseLockstepLane(LockstepGames<K>* Games, unsigned int Lane)
+{
+    for(unsigned int Row = 0; Row < LOCKSTEP_ROWS; ++Row)
+    {
+        Games->RowMasks[Row][Lane] = (Row < GRID_ROWS) ? LOCKSTEP_EMPTY_ROW : LOCKSTEP_SOLID_ROW;
+    }
+
+    Games->Type[Lane]     = LockstepGenerateType(&Games->Random[Lane]);
+    Games->NextType[Lane] = LockstepGenerateType(&Games->Random[Lane]);
+    Games->Row[Lane] = 0;
+    Games->Col[Lane] = 0;
+    Games->Rotation[Lane] = 0;
+
+    Games->State[Lane] = RUNNING;
+    Games->FallingTimer[Lane] = FALL_FRAMES;
+    Games->Score[Lane] = 0;
+    Games->LinesRemoved[Lane] = 0;
+}
+
+template<unsigned int K>
+void SeedLockstepLane(LockstepGames<K>* Games, unsigned int Lane, unsigned int Seed)
+{
+    Games->Random[Lane] = SeedRandomSeries(Seed).State;
+    InitialiseLockstepLane(Games, Lane);
+}
+
+//Scalar tail of a tick for a lane whose piece locked: store it, spawn the next
+//one, apply any rotation to the new piece, check for game over and then
+//remove lines, in the same order UpdateGame does
+template<unsigned int K>
+void LockLockstepLane(LockstepGames<K>* Games, unsigned int Lane, unsigned int Input)
+{
+    const unsigned int* Shape = LockstepShapes.Rows[Games->Type[Lane]][Games->Rotation[Lane]];
+    unsigned int Shift = Games->Col[Lane] + LOCKSTEP_WALL;
+
+    for(unsigned int Row = 0; Row < TETROMINO_MAX_SIZE; ++Row)
+    {
+        Games->RowMasks[Games->Row[Lane] + Row][Lane] |= Shape[Row] << Shift;
+    }
+
+    //The next tetromino keeps its preview position when it starts falling
+    Games->Type[Lane]     = Games->NextType[Lane];
+    Games->NextType[Lane] = LockstepGenerateType(&Games->Random[Lane]);
+    Games->Row[Lane] = 1;
+    Games->Col[Lane] = 1;
+    Games->Rotation[Lane] = 0;
+    Games->FallingTimer[Lane] = FALL_FRAMES;
+
+    if( (Input & LOCKSTEP_ROTATE) && (Games->Type[Lane] != O_SHAPE) )
+    {
+        if(!LockstepCollides(Games, Lane, Games->Row[Lane], Games->Col[Lane], 1))
+        {
+            Games->Rotation[Lane] = 1;
+        }
+    }
+
+    if(LockstepCollides(Games, Lane, Games->Row[Lane], Games->Col[Lane], Games->Rotation[Lane]))
+    {
+        Games->State[Lane] = GAMEOVER;
+    }
+
+    //Remove any lines in the grid
+    unsigned int FullRowCount = 0;
+
+    for(unsigned int Row = (GRID_ROWS-1); Row < GRID_ROWS; --Row)
+    {
+        unsigned int Mask = Games->RowMasks[Row][Lane];
+
+        if(Mask == LOCKSTEP_SOLID_ROW)
+        {
+            FullRowCount++;
+        }
+        else if(FullRowCount)
+        {
+            Games->RowMasks[Row + FullRowCount][Lane] = Mask;
+        }
+    }
+
+    for(unsigned int Row = 0; Row < FullRowCount; ++Row)
+    {
+        Games->RowMasks[Row][Lane] = LOCKSTEP_EMPTY_ROW;
+    }
+
+    static const unsigned int LineScores[TETROMINO_MAX_SIZE + 1] = {0, 1, 4, 8, 16};
+
+    Games->LinesRemoved[Lane] = FullRowCount;
+    Games->Score[Lane] += LineScores[FullRowCount];
+}
+
+//The per lane part of a tick: gravity, moves and rotation with their
+//collision tests, worked out into the New* arrays without touching the game
+//state. Lock is set for lanes whose piece couldn't move down.
+template<unsigned int K>
+void StepLockstepLanes(const LockstepGames<K>* Games, const unsigned int* Inputs,
+        int* NewRow, int* NewCol, unsigned int* NewRotation, unsigned int* NewTimer, unsigned int* Lock)
+{
+    for(unsigned int Lane = 0; Lane < K; ++Lane)
+    {
+        unsigned int Active = (Games->State[Lane] == RUNNING);
+        unsigned int Input = Active ? Inputs[Lane] : 0;
+
+        //Drop Tetro if necessary
+        unsigned int Timer = Games->FallingTimer[Lane];
+        unsigned int Drop = Active & ((Timer == 0) | ((Input & LOCKSTEP_DOWN) != 0));
+        unsigned int NextTimer = (Timer == 0) ? (unsigned int)FALL_FRAMES : Timer - 1;
+        NewTimer[Lane] = Active ? NextTimer : Timer;
+
+        int Row = Games->Row[Lane];
+        int Col = Games->Col[Lane];
+        unsigned int Rotation = Games->Rotation[Lane];
+
+        //Move Tetro if necessary
+        unsigned int Left = ((Input & LOCKSTEP_LEFT) != 0) & !LockstepCollides(Games, Lane, Row, Col - 1, Rotation);
+        Col -= Left;
+
+        unsigned int Right = ((Input & LOCKSTEP_RIGHT) != 0) & !LockstepCollides(Games, Lane, Row, Col + 1, Rotation);
+        Col += Right;
+
+        unsigned int Blocked = LockstepCollides(Games, Lane, Row + 1, Col, Rotation);
+        Row += Drop & !Blocked;
+        Lock[Lane] = Drop & Blocked;
+
+        //Locking lanes rotate their new piece in the scalar pass instead
+        unsigned int Rotate = ((Input & LOCKSTEP_ROTATE) != 0) & (Games->Type[Lane] != O_SHAPE) & !Lock[Lane];
+        Rotate &= !LockstepCollides(Games, Lane, Row, Col, Rotation + 1);
+
+        NewRow[Lane] = Row;
+        NewCol[Lane] = Col;
+        NewRotation[Lane] = (Rotation + Rotate) & (LOCKSTEP_ROTATIONS-1);
+    }
+}
+
+#if defined(__AVX2__)
+//Collision test for eight lanes at once, all ones in each lane that collides
+template<unsigned int K>
+inline __m256i LockstepCollides8(const LockstepGames<K>* Games, __m256i Lanes, __m256i Type, __m256i Row, __m256i Col, __m256i Rotation)
+{
+    const int* Masks = (const int*)&Games->RowMasks[0][0];
+    const int* Shapes = (const int*)&LockstepShapes.Rows[0][0][0];
+
+    __m256i Shape = _mm256_and_si256(Rotation, _mm256_set1_epi32(LOCKSTEP_ROTATIONS-1));
+    Shape = _mm256_add_epi32(_mm256_mullo_epi32(Type, _mm256_set1_epi32(LOCKSTEP_ROTATIONS)), Shape);
+    Shape = _mm256_mullo_epi32(Shape, _mm256_set1_epi32(TETROMINO_MAX_SIZE));
+
+    __m256i Shift = _mm256_add_epi32(Col, _mm256_set1_epi32(LOCKSTEP_WALL));
+    __m256i Index = _mm256_add_epi32(_mm256_mullo_epi32(Row, _mm256_set1_epi32(K)), Lanes);
+    __m256i Hit = _mm256_setzero_si256();
+
+    for(int Row2 = 0; Row2 < TETROMINO_MAX_SIZE; ++Row2)
+    {
+        __m256i Board = _mm256_i32gather_epi32(Masks, Index, 4);
+        __m256i Piece = _mm256_sllv_epi32(_mm256_i32gather_epi32(Shapes, Shape, 4), Shift);
+
+        Hit = _mm256_or_si256(Hit, _mm256_and_si256(Board, Piece));
+
+        Index = _mm256_add_epi32(Index, _mm256_set1_epi32(K));
+        Shape = _mm256_add_epi32(Shape, _mm256_set1_epi32(1));
+    }
+
+    return _mm256_xor_si256(_mm256_cmpeq_epi32(Hit, _mm256_setzero_si256()), _mm256_set1_epi32(-1));
+}
+
+//StepLockstepLanes eight lanes at a time. Conditions are all ones/zero lane
+//masks, so adding or subtracting one is just subtracting or adding the mask.
+template<unsigned int K>
+void StepLockstepLanesAVX2(const LockstepGames<K>* Games, const unsigned int* Inputs,
+        int* NewRow, int* NewCol, unsigned int* NewRotation, unsigned int* NewTimer, unsigned int* Lock)
+{
+    const __m256i Zero = _mm256_setzero_si256();
+
+    for(unsigned int Base = 0; Base < K; Base += 8)
+    {
+        __m256i Lanes = _mm256_add_epi32(_mm256_set1_epi32(Base), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+        __m256i Active = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(Games->State + Base)), _mm256_set1_epi32(RUNNING));
+        __m256i Input = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(Inputs + Base)), Active);
+
+        __m256i WantLeft   = _mm256_cmpeq_epi32(_mm256_and_si256(Input, _mm256_set1_epi32(LOCKSTEP_LEFT)), _mm256_set1_epi32(LOCKSTEP_LEFT));
+        __m256i WantRight  = _mm256_cmpeq_epi32(_mm256_and_si256(Input, _mm256_set1_epi32(LOCKSTEP_RIGHT)), _mm256_set1_epi32(LOCKSTEP_RIGHT));
+        __m256i WantRotate = _mm256_cmpeq_epi32(_mm256_and_si256(Input, _mm256_set1_epi32(LOCKSTEP_ROTATE)), _mm256_set1_epi32(LOCKSTEP_ROTATE));
+        __m256i WantDown   = _mm256_cmpeq_epi32(_mm256_and_si256(Input, _mm256_set1_epi32(LOCKSTEP_DOWN)), _mm256_set1_epi32(LOCKSTEP_DOWN));
+
+        //Drop Tetro if necessary
+        __m256i Timer = _mm256_loadu_si256((const __m256i*)(Games->FallingTimer + Base));
+        __m256i Expired = _mm256_cmpeq_epi32(Timer, Zero);
+        __m256i Drop = _mm256_and_si256(Active, _mm256_or_si256(Expired, WantDown));
+        __m256i NextTimer = _mm256_blendv_epi8(_mm256_sub_epi32(Timer, _mm256_set1_epi32(1)), _mm256_set1_epi32(FALL_FRAMES), Expired);
+        _mm256_storeu_si256((__m256i*)(NewTimer + Base), _mm256_blendv_epi8(Timer, NextTimer, Active));
+
+        __m256i Type     = _mm256_loadu_si256((const __m256i*)(Games->Type + Base));
+        __m256i Row      = _mm256_loadu_si256((const __m256i*)(Games->Row + Base));
+        __m256i Col      = _mm256_loadu_si256((const __m256i*)(Games->Col + Base));
+        __m256i Rotation = _mm256_loadu_si256((const __m256i*)(Games->Rotation + Base));
+
+        //Move Tetro if necessary
+        __m256i One = _mm256_set1_epi32(1);
+
+        __m256i Left = _mm256_andnot_si256(LockstepCollides8(Games, Lanes, Type, Row, _mm256_sub_epi32(Col, One), Rotation), WantLeft);
+        Col = _mm256_add_epi32(Col, Left);
+
+        __m256i Right = _mm256_andnot_si256(LockstepCollides8(Games, Lanes, Type, Row, _mm256_add_epi32(Col, One), Rotation), WantRight);
+        Col = _mm256_sub_epi32(Col, Right);
+
+        __m256i Blocked = LockstepCollides8(Games, Lanes, Type, _mm256_add_epi32(Row, One), Col, Rotation);
+        __m256i Locked = _mm256_and_si256(Drop, Blocked);
+        Row = _mm256_sub_epi32(Row, _mm256_andnot_si256(Blocked, Drop));
+
+        //Locking lanes rotate their new piece in the scalar pass instead
+        __m256i NotO = _mm256_xor_si256(_mm256_cmpeq_epi32(Type, _mm256_set1_epi32(O_SHAPE)), _mm256_set1_epi32(-1));
+        __m256i Rotate = _mm256_andnot_si256(Locked, _mm256_and_si256(WantRotate, NotO));
+        Rotate = _mm256_andnot_si256(LockstepCollides8(Games, Lanes, Type, Row, Col, _mm256_add_epi32(Rotation, One)), Rotate);
+        Rotation = _mm256_and_si256(_mm256_sub_epi32(Rotation, Rotate), _mm256_set1_epi32(LOCKSTEP_ROTATIONS-1));
+
+        _mm256_storeu_si256((__m256i*)(NewRow + Base), Row);
+        _mm256_storeu_si256((__m256i*)(NewCol + Base), Col);
+        _mm256_storeu_si256((__m256i*)(NewRotation + Base), Rotation);
+        _mm256_storeu_si256((__m256i*)(Lock + Base), _mm256_and_si256(Locked, One));
+    }
+}
+#endif
+
+//One tick for every running lane. Inputs holds LockstepInput bits per lane.
+//Returns a bit per lane that went to GAMEOVER on this tick (K <= 32); those
+//lanes sit idle until they're initialised again.
+template<unsigned int K>
+unsigned int StepLockstepGames(LockstepGames<K>* Games, const unsigned int* Inputs)
+{
+    static_assert(K <= 32, "Lockstep game over mask only holds 32 lanes");
+
+    //The lane pass only reads the game state, its results are written back
+    //once it's done
+    int          NewRow[K];
+    int          NewCol[K];
+    unsigned int NewRotation[K];
+    unsigned int NewTimer[K];
+    unsigned int Lock[K];
+
+#if defined(__AVX2__)
+    if((K % 8) == 0)
+    {
+        StepLockstepLanesAVX2(Games, Inputs, NewRow, NewCol, NewRotation, NewTimer, Lock);
+    }
+    else
+#endif
+    {
+        StepLockstepLanes(Games, Inputs, NewRow, NewCol, NewRotation, NewTimer, Lock);
+    }
+
+    unsigned int AnyLock = 0;
+
+    for(unsigned int Lane = 0; Lane < K; ++Lane)
+    {
+        Games->Row[Lane] = NewRow[Lane];
+        Games->Col[Lane] = NewCol[Lane];
+        Games->Rotation[Lane] = NewRotation[Lane];
+        Games->FallingTimer[Lane] = NewTimer[Lane];
+        Games->LinesRemoved[Lane] = 0;
+        AnyLock |= Lock[Lane];
+    }
+
+    //A piece that didn't lock only ever moved into free space on an unchanged
+    //board, so game over and line clears can only come from locking lanes
+    unsigned int GameOverMask = 0;
+
+    if(AnyLock)
+    {
+        for(unsigned int Lane = 0; Lane < K; ++Lane)
+        {
+            if(Lock[Lane])
+            {
+                LockLockstepLane(Games, Lane, Inputs[Lane]);
+
+                if(Games->State[Lane] == GAMEOVER)
+                {
+                    GameOverMask |= 1u << Lane;
+                }
+            }
+        }
+    }
+
+    return GameOverMask;
+}
+
+#endif
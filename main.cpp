@@ -4,6 +4,21 @@
 #include <stdlib.h>
 #include <time.h>
 
+#include "arena.cpp"
+#include "jobs.cpp"
+#include "game.cpp"
+#include "pieces.cpp"
+#include "snapshot.cpp"
+#include "glyphcache.cpp"
+#include "lockstep.cpp"
+#include "bot.cpp"
+#include "solver.cpp"
+#include "broadcast.cpp"
+#include "replay.cpp"
+#include "scorelog.cpp"
+#include "capture.cpp"
+#include "surface.cpp"
+
 /*
  * Platform Stuff
  */
@@ -18,8 +33,6 @@ enum GlobalConstants{
     //Main Grid Dimensions
     GRID_WIDTH  = SCREEN_WIDTH/3,
     GRID_HEIGHT = SCREEN_HEIGHT,
-    GRID_ROWS   = 20,
-    GRID_COLS   = 10,
     GRID_X      = SCREEN_WIDTH/3,
     GRID_Y      = 0,
 
@@ -38,30 +51,88 @@ enum GlobalConstants{
     CELL_WIDTH  = (SCREEN_WIDTH - SCREEN_COLS*CELL_PADDING)/SCREEN_COLS,
     CELL_HEIGHT = (SCREEN_HEIGHT - SCREEN_ROWS*CELL_PADDING)/SCREEN_ROWS,
 
-    //Game Constants
-    FALL_FRAMES = 30
+    //Memory
+    PLATFORM_ARENA_SIZE = 64*1024,  //Lives as long as the program (glyphs, spectator wall)
+    FRAME_ARENA_SIZE    = 64*1024,  //Reset at the end of every frame
+
+    //How often the render loop prints snapshot age stats
+    SNAPSHOT_AGE_REPORT_SECONDS = 5,
+
+    //Longest the main thread sleeps waiting for events (ms), only a
+    //backstop since the simulation wakes it whenever there's a new frame
+    RENDER_WAIT_TIMEOUT = 1000,
+
+    //Glyphs (printable ASCII), baked into one atlas texture
+    FONT_POINT_SIZE     = 18,
+    GLYPH_FIRST         = 0x20,
+    GLYPH_LAST          = 0x7E,
+    GLYPH_COUNT         = GLYPH_LAST - GLYPH_FIRST + 1,
+    GLYPH_ATLAS_WIDTH   = 256,
+
+    STARTUP_MAX_PHASES  = 8,
+
+    //Spectator wall (--wall [boards])
+    WALL_DEFAULT_BOARDS = 36,
+    WALL_MAX_BOARDS     = 64,
+    WALL_GUTTER         = 1,    //Texels between boards
+    WALL_MAX_LAG_TICKS  = 4,    //Further behind than this and the wall skips ahead
+
+    //Perfect clear search for each new piece on the wall (--perfect-clear),
+    //kept small since every board searches on the main thread
+    WALL_SOLVER_PIECES      = 10,
+    WALL_SOLVER_NODES       = 5000,
+    WALL_SOLVER_MEMO_BITS   = 16,
+
+    //Steady state frames and ticks that allocate are reported one by one up
+    //to this many, then only counted (--check-allocations)
+    ALLOCATION_REPORT_LIMIT = 10,
+
+    //How often a replay export prints its progress (--export)
+    EXPORT_REPORT_SECONDS = 2,
+
+    //Scripted frame benchmark (--frame-bench)
+    FRAME_BENCH_DEFAULT_SEED    = 1,
+    FRAME_BENCH_MAX_SECTIONS    = 16
+};
+
+//Overridden by the AGAFB_FONT environment variable
+#define DEFAULT_FONT_PATH "/usr/share/fonts/TTF/FiraMono-Regular.ttf"
+
+//Keys pressed since the simulation last took its inputs
+enum InputBits{
+    INPUT_UP        = 1 << 0,
+    INPUT_DOWN      = 1 << 1,
+    INPUT_LEFT      = 1 << 2,
+    INPUT_RIGHT     = 1 << 3,
+    INPUT_SPACE     = 1 << 4,
+    INPUT_ESCAPE    = 1 << 5
 };
 
-//A wrapper for the SDL textures
+//A wrapper for the SDL textures, or a region of one
 struct Texture{
     SDL_Texture* Data;
     unsigned int Width;
     unsigned int Height;
+    unsigned int SourceX;
+    unsigned int SourceY;
 };
 
 struct TextureArray{
     bool Initialised;
     Texture* Textures;
     unsigned int Length;
+    SDL_Texture* Atlas;     //If set, every texture is a region of it
 };
 
-struct InputState{
-    bool Up;
-    bool Down;
-    bool Left;
-    bool Right;
-    bool Space;
-    bool Escape;
+//The board is drawn as one streaming texture with a texel per cell, filled
+//from the palette indices and stretched over the grid area, so drawing it
+//costs the same however full it is
+struct BoardTexture{
+    SDL_Texture* Data;
+    unsigned int Rows;
+    unsigned int Cols;
+    Uint32 Palette[PALETTE_SIZE];   //ARGB8888
+    Uint32 Empty;
 };
 
 enum Alignment{
@@ -77,133 +148,428 @@ struct Rect{
     float Height;
 };
 
-bool init();
+//One bot driven game on the spectator wall
+struct WallBoard{
+    GameData Game;
+    GameMemory Memory;
+    PerfectClearBot Bot;
+};
+
+//Many games stepped on the main thread and drawn side by side. Every board
+//goes into one streaming texture, a texel per cell, so the whole wall is a
+//single SDL_RenderCopy however many boards there are.
+struct SpectatorWall{
+    WallBoard* Boards;
+    unsigned int Count;
+    unsigned int Columns;   //Boards across
+    unsigned int Rows;      //Boards down
+
+    SDL_Texture* Texture;
+    unsigned int Width;     //Texels
+    unsigned int Height;
+    SDL_Rect Destination;
+
+    BotWeights Weights;
+    unsigned int GamesPlayed;
+    unsigned int BestScore;
+
+    //Bots look for perfect clears, sharing one memo since they take turns
+    bool PerfectClear;
+    SolverMemo Memo;
+
+    //Bots take their moves from a surface table where it has them (--surfaces)
+    SurfaceTable Surfaces;
+    SurfaceStats SurfaceLookups;
+};
+
+struct WallStats{
+    Uint64 StepTime;
+    Uint64 DrawTime;
+    unsigned int Frames;
+    unsigned int LateFrames;
+    Uint64 ReportTime;
+};
+
+//What the frame benchmark's script does for a stretch of ticks
+enum FrameBenchAction{
+    FRAME_BENCH_PLAY,       //The bot plays, clearing lines as it goes
+    FRAME_BENCH_PAUSE,      //Paused on the first tick, unpaused on the last
+    FRAME_BENCH_TOP_OUT,    //Only down held, until the stack reaches the top
+    FRAME_BENCH_IDLE        //Nothing pressed
+};
+
+struct FrameBenchStep{
+    const char* Name;
+    FrameBenchAction Action;
+    unsigned int Ticks;     //For FRAME_BENCH_TOP_OUT, the most it can take
+};
+
+//Where a frame's time goes, in the order it's spent
+enum FrameBenchPhase{
+    FRAME_PHASE_SIMULATE,   //The tick that asked for the frame
+    FRAME_PHASE_PUBLISH,    //Saving it into the triple buffer
+    FRAME_PHASE_HANDOFF,    //Waking the main thread and loading it for drawing
+    FRAME_PHASE_DRAW,
+    FRAME_PHASE_PRESENT,
+    FRAME_PHASE_COUNT
+};
+
+struct FrameBenchSection{
+    unsigned int Ticks;
+    unsigned int Frames;
+    Uint64 FrameTime;
+    unsigned int Lines;
+};
+
+struct FrameBenchStats{
+    //Per frame, every phase and then the whole frame
+    Uint64* Times[FRAME_PHASE_COUNT + 1];
+    unsigned int Frames;
+    unsigned int Ticks;
+    unsigned int Wakes; //Ticks the simulation woke for, the rest were fast forwarded
+    Uint64 TickTime;    //Every woken tick's simulation, drawn or not
+
+    unsigned long long DrawCalls;
+    unsigned int MostDrawCalls;
+    unsigned long long TextureUploads;
+    unsigned long long TextureCreations;
+
+    //Steady state frames and ticks (RUNNING after RUNNING) and how many of
+    //them allocated
+    unsigned long long SteadyFrames;
+    unsigned long long AllocatingFrames;
+    unsigned long long SteadyTicks;
+    unsigned long long AllocatingTicks;
+    HeapCounters Heap;  //Everything the run allocated
+
+    unsigned int Score;
+    unsigned int Lines;
+    unsigned int GameOverTick;  //0 if the game never ended
+    FrameBenchSection Sections[FRAME_BENCH_MAX_SECTIONS];
+};
+
+//The frame benchmark's script as the simulation plays it. Apart from Drawn,
+//only the simulation thread touches it until the run is over.
+struct FrameBench{
+    FrameBenchStats* Stats;
+    BotWeights Weights;
+
+    unsigned int Step;              //Step being played, the step count once the script is over
+    unsigned long long StepStart;   //Its first tick
+    unsigned long long StepEnd;     //The tick after its last
+
+    HeapCounters SimulationHeap;    //What the simulation thread allocated
+    bool Finished;
+
+    //Version of the last snapshot the main thread presented. The simulation
+    //waits for each one it publishes, so every one is drawn.
+    SDL_atomic_t Drawn;
+};
+
+//Everything the main thread and the simulation thread share
+struct SimulationData{
+    SnapshotTripleBuffer Snapshots;
+    SDL_atomic_t Inputs;    //InputBits, or'd in by the main thread and taken each tick
+    SDL_atomic_t Quit;      //Set by either side
+
+    //The simulation sleeps on Wake, the main thread signals it with new
+    //inputs or to quit
+    SDL_mutex* Lock;
+    SDL_cond* Wake;
+
+    //Pushed by the simulation to wake the main thread when there's a new
+    //snapshot to draw
+    Uint32 SnapshotEvent;
+
+    unsigned int Seed;
+
+    //Spectator stream of the game, NULL when not broadcasting. Only the
+    //simulation thread touches it.
+    BroadcastPublisher* Broadcast;
+
+    //Replay archive every game is recorded to, NULL when not recording.
+    //Also simulation thread only.
+    ReplayWriter* Recorder;
+
+    //Log every finished game's stats go to, NULL for none. Submitted to
+    //from the simulation thread, written out on the log's own thread.
+    ScoreLogWriter* Scores;
+
+    //Heap allocations the last tick made, and how many RUNNING ticks
+    //following a RUNNING tick allocated anything. Written by the simulation,
+    //read by the overlay.
+    SDL_atomic_t TickAllocations;
+    SDL_atomic_t AllocatingTicks;
+    bool CheckAllocations;
+
+    //Script and stats when running the frame benchmark, NULL otherwise
+    FrameBench* Bench;
+};
+
+//Timed work for the simulation thread, as tick numbers
+enum SimulationTimer{
+    TIMER_NEXT_TICK,    //Input waiting, or a restart
+    TIMER_GRAVITY,      //The falling piece drops
+    TIMER_SCRIPT,       //The frame benchmark's next scripted input
+    TIMER_COUNT
+};
+
+#define TIMER_NONE (~0ull)
+
+struct TimerQueue{
+    unsigned long long Deadlines[TIMER_COUNT];
+};
+
+struct SnapshotAgeStats{
+    Uint64 Min;
+    Uint64 Max;
+    Uint64 Total;
+    unsigned int Frames;
+    unsigned int Skipped;
+    Uint64 ReportTime;
+};
+
+//Renderer work, counted as it's issued
+struct RenderCounters{
+    unsigned int DrawCalls;         //Clears, fills and copies
+    unsigned int TextureCreations;
+    unsigned int TextureUploads;    //Streaming texture locks
+};
+
+//What drawing costs, shown by the overlay (F3). Steady state frames are
+//RUNNING frames following a RUNNING frame, which shouldn't allocate at all.
+struct FrameAccounting{
+    bool Overlay;
+    bool CheckAllocations;      //Report steady state frames and ticks that allocate
+
+    RenderCounters Frame;       //Since the last frame was presented
+    RenderCounters LastFrame;
+    HeapCounters LastFrameHeap;
+
+    unsigned long long TextureCreations;
+    unsigned long long SteadyFrames;
+    unsigned long long AllocatingFrames;
+};
+
+//Time spent in each step of starting up, reported once the first frame is up
+struct StartupTimes{
+    Uint64 Start;
+    Uint64 Last;
+    const char* Names[STARTUP_MAX_PHASES];
+    Uint64 Times[STARTUP_MAX_PHASES];
+    unsigned int Count;
+    bool Reported;
+};
+
+bool init(Uint32 WindowFlags, Uint32 RendererFlags);
 bool loadMedia();
-TextureArray LoadFontTextures();
+TextureArray LoadFontTextures(const char* FontPath);
+SDL_Surface* RasteriseGlyphAtlas(const char* FontPath, GlyphCacheEntry* Entries);
+TextureArray UploadGlyphAtlas(TextureArray Array, const GlyphCacheHeader* Header, const GlyphCacheEntry* Entries,
+                              const void* Pixels, unsigned int Pitch);
 void close();
 void DrawRect(int X, int Y, int Width, int Height, unsigned char Red, unsigned char Green, unsigned char Blue, unsigned char Alpha);
 bool loadFromRenderedText(const char* String, SDL_Color TextColor, Texture* Result);
-bool LoadGlyphToTexture(char Glyph, SDL_Color TextColor, Texture* Result);
+
+void MarkStartupPhase(const char* Name);
+void ReportStartupTimes();
 
 void DrawText(const char* Text, float X, float Y);
 void DrawTextToRect(const char* Text, Rect Box, Alignment Align);
+void DrawAccountingOverlay(SimulationData* Simulation);
 
 Texture GenerateTexture();
 void DestroyTexture(Texture TextureToKill);
-TextureArray GenerateTextureArray(unsigned int Length);
+TextureArray GenerateTextureArray(MemoryArena* Arena, unsigned int Length);
 void DestroyTextureArray(TextureArray ArrayToKill);
 void DrawTexture(Texture T, unsigned int X, unsigned int Y, unsigned int Width, unsigned int Height);
 
+int RunSimulation(void* Data);
+void PostInputs(SimulationData* Simulation, unsigned int Pressed);
+void StopSimulation(SimulationData* Simulation);
+void RenderLoop(SimulationData* Simulation);
+void RunSpectatorWall(unsigned int BoardCount, bool PerfectClear, const char* SurfacesPath);
+bool ExportReplay(const char* ArchivePath, unsigned int GameIndex, const char* Output, unsigned int ThreadCount);
+bool RunFrameBench(unsigned int Seed, const char* SummaryPath);
+
+unsigned long long NextFrameBenchTick(FrameBench* Bench, unsigned long long Tick, GameData Game);
+InputState GetFrameBenchTickInputs(FrameBench* Bench, unsigned long long Tick, GameData Game);
+void RecordFrameBenchTick(FrameBench* Bench, unsigned long long Tick, GameState PreviousState, GameData Game,
+                          Uint64 TickTime, HeapCounters TickHeap);
+void RecordFrameBenchPublish(FrameBench* Bench, const PublishedSnapshot* Slot, Uint64 TickStart, Uint64 Simulated);
+void WaitForFrameBenchFrame(SimulationData* Simulation, unsigned int Version);
+void RecordFrameBenchFrame(SimulationData* Simulation, const PublishedSnapshot* Slot, Uint64 Loaded, Uint64 Drawn,
+                           Uint64 Presented);
+
 SDL_Window* gWindow = NULL;
 SDL_Renderer* gRenderer = NULL;
-TTF_Font* gFont = NULL;
+TTF_Font* gFont = NULL;    //Only opened when the glyph cache misses
 TextureArray Glyphs;
+BoardTexture Board;
+StartupTimes Startup;
+FrameAccounting Accounting;
+
+MemoryArena PlatformArena;
+MemoryArena FrameArena;
 
 /*
- * Game Stuff
+ * Rendering
  */
 
-enum GameState{
-    INITIALISING,
-    RUNNING,
-    PAUSED,
-    GAMEOVER
-};
+GameData DrawGame(GameData Current);
+GameData DrawFrame(GameData Current);
 
-enum TetrominoType{
-    I_SHAPE,
-    T_SHAPE,
-    O_SHAPE,
-    Z_SHAPE,
-    S_SHAPE,
-    L_L_SHAPE,
-    L_R_SHAPE,
-};
+void DrawGrid(BlockGrid Grid, unsigned int X, unsigned int Y, unsigned Width, unsigned Height);
+void DrawBoard(BlockGrid Grid, Tetromino Falling, unsigned int X, unsigned int Y, unsigned int Width, unsigned int Height);
+void WriteBoardTexels(BlockGrid Grid, Tetromino Falling, Uint32* Pixels, int Pitch);
+void InitialiseBoardPalette();
 
-struct Vector2D{
-    float X;
-    float Y;
-};
+int main( int argc, char* args[] )
+{
+    Startup.Start = SDL_GetPerformanceCounter();
+    Startup.Last = Startup.Start;
 
-struct Block{
-    unsigned char Occupied;
-    unsigned char Red;
-    unsigned char Green;
-    unsigned char Blue;
-    unsigned char Alpha;
-};
+    //Number of boards on the spectator wall, 0 to play normally
+    unsigned int WallBoards = 0;
 
-struct BlockGrid{
-    unsigned int Rows;
-    unsigned int Cols;
-    Block* Blocks;
-};
+    //Name to broadcast the game under for agafb_watch, NULL for none
+    const char* BroadcastName = NULL;
 
-struct Tetromino{
-    TetrominoType Type;
-    unsigned int GridSize;
-    int Row;
-    int Col;
-    BlockGrid Grid;
-};
+    //Replay archive to record to, NULL for none
+    const char* RecordPath = NULL;
 
-struct GameData{
-    GameState State;
+    //Score log to add finished games to, NULL for none
+    const char* ScoresPath = NULL;
 
-    bool Quit;
-    bool MoveLeft;
-    bool MoveRight;
-    bool Rotate;
-    bool MoveDown;
-    bool Pause;
-    bool Redraw;
-    bool RenderScore;
-    bool Restart;
+    //Whether the spectator wall's bots look for perfect clears
+    bool WallPerfectClear = false;
 
-    unsigned int Score;
-    unsigned int FallingTimer;
-    unsigned int StartTick;
-    unsigned int EndTick;
-
-    Tetromino FallingTetro;
-    Tetromino NextTetro;
-    BlockGrid MainGrid;
-    Texture ScoreTexture;
-};
+    //Surface table for the spectator wall's bots, NULL to always search
+    const char* WallSurfaces = NULL;
 
-GameData HandleInputGame(InputState Inputs, GameData Current);
-GameData HandleInputPaused(InputState Inputs, GameData Current);
-GameData HandleInputGameOver(InputState Inputs, GameData Current);
+    //Replay archive, game and output to render offline, NULL to play
+    const char* ExportArchive = NULL;
+    unsigned int ExportGame = 0;
+    const char* ExportOutput = NULL;
+    unsigned int ExportThreads = SDL_GetCPUCount();
 
-GameData UpdateGame(GameData Current);
-GameData UpdatePaused(GameData Current);
-GameData UpdateGameOver(GameData Current);
+    //Whether to run the scripted frame benchmark, and where to write its
+    //summary, NULL for only printing it
+    bool FrameBench = false;
+    const char* FrameBenchSummary = NULL;
+    unsigned int FrameBenchSeed = FRAME_BENCH_DEFAULT_SEED;
 
-GameData DrawGame(GameData Current);
+    //Piece set to play with
+    unsigned int PieceSet = PIECES_TETROMINOES;
+
+    //Non zero if an offline export didn't finish
+    int ExitCode = 0;
 
-Block   GenerateBlock();
-Block*  GetBlock(BlockGrid Grid, unsigned int Row, unsigned int Col);
-void    EraseBlock(Block* BlockToErase);
+    for(int Arg = 1; Arg < argc; ++Arg)
+    {
+        bool HasValue = (Arg + 1 < argc) && (args[Arg + 1][0] != '-');
+
+        if(strcmp(args[Arg], "--wall") == 0)
+        {
+            WallBoards = HasValue ? atoi(args[++Arg]) : WALL_DEFAULT_BOARDS;
+            WallBoards = (WallBoards < 1) ? 1 : (WallBoards > WALL_MAX_BOARDS) ? WALL_MAX_BOARDS : WallBoards;
+        }
+        else if(strcmp(args[Arg], "--perfect-clear") == 0)
+        {
+            WallPerfectClear = true;
+        }
+        else if( (strcmp(args[Arg], "--surfaces") == 0) && HasValue )
+        {
+            WallSurfaces = args[++Arg];
+        }
+        else if(strcmp(args[Arg], "--broadcast") == 0)
+        {
+            BroadcastName = HasValue ? args[++Arg] : DEFAULT_BROADCAST_NAME;
+        }
+        else if( (strcmp(args[Arg], "--record") == 0) && HasValue )
+        {
+            RecordPath = args[++Arg];
+        }
+        else if( (strcmp(args[Arg], "--scores") == 0) && HasValue )
+        {
+            ScoresPath = args[++Arg];
+        }
+        else if(strcmp(args[Arg], "--overlay") == 0)
+        {
+            Accounting.Overlay = true;
+        }
+        else if(strcmp(args[Arg], "--check-allocations") == 0)
+        {
+            Accounting.CheckAllocations = true;
+        }
+        else if( (strcmp(args[Arg], "--export") == 0) && (Arg + 3 < argc) )
+        {
+            ExportArchive = args[++Arg];
+            ExportGame = atoi(args[++Arg]);
+            ExportOutput = args[++Arg];
+        }
+        else if( (strcmp(args[Arg], "--export-threads") == 0) && HasValue )
+        {
+            ExportThreads = atoi(args[++Arg]);
+        }
+        else if(strcmp(args[Arg], "--frame-bench") == 0)
+        {
+            FrameBench = true;
+            FrameBenchSummary = HasValue ? args[++Arg] : NULL;
+        }
+        else if( (strcmp(args[Arg], "--bench-seed") == 0) && HasValue )
+        {
+            FrameBenchSeed = atoi(args[++Arg]);
+        }
+        else if( (strcmp(args[Arg], "--pieces") == 0) && HasValue )
+        {
+            const char* Name = args[++Arg];
 
-BlockGrid   GenerateGrid(unsigned int Rows, unsigned int Cols);
-void        DestroyGrid(BlockGrid Grid);
+            if(FindPieceSet(Name, &PieceSet) == NULL)
+            {
+                printf("There's no piece set called %s, playing the tetrominoes. The sets are:", Name);
 
-Tetromino       GenerateTetromino();
-void            DestroyTetromino(Tetromino Tetro);
-void            StoreTetromino(BlockGrid Grid, Tetromino Tetro);
-Tetromino       RotateTetroClockwise(Tetromino Tetro);
-Tetromino       RotateTetroAntiClockwise(Tetromino Tetro);
+                for(unsigned int Id = 0; Id < PIECE_SET_COUNT; ++Id)
+                {
+                    printf(" %s", GetPieceSet(Id)->Name);
+                }
 
-unsigned int    CheckCollisions(BlockGrid Grid, Tetromino Tetro);
-unsigned int    RemoveGridLines(BlockGrid Grid);
-Vector2D CalculateGridCentreOfMass(BlockGrid Grid);
+                printf("\n");
+                PieceSet = PIECES_TETROMINOES;
+            }
+        }
+    }
 
-void DrawGrid(BlockGrid Grid, unsigned int X, unsigned int Y, unsigned Width, unsigned Height);
+    //The bots only know the tetrominoes, and an export plays with whatever
+    //its archive was recorded with
+    if( (PieceSet != PIECES_TETROMINOES) && (WallBoards || FrameBench) )
+    {
+        printf("The bots only play the tetrominoes, so they're what the %s gets\n", WallBoards ? "wall" : "benchmark");
+        PieceSet = PIECES_TETROMINOES;
+    }
 
-int main( int argc, char* args[] )
-{
-    //Start up SDL and create window
-    if( !init() )
+    if( !UsePieceSet(PieceSet) )
+    {
+        return 1;
+    }
+
+    Uint32 WindowFlags = ExportArchive ? SDL_WINDOW_HIDDEN : SDL_WINDOW_SHOWN;
+    //Exports draw into a texture
+    Uint32 RendererFlags = SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE;
+
+    //The benchmark needs no display or GPU, so it runs the same on any box.
+    //Setting SDL_VIDEODRIVER or SDL_RENDER_DRIVER still picks another.
+    if(FrameBench)
+    {
+        SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+        SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
+
+        WindowFlags = SDL_WINDOW_HIDDEN;
+        RendererFlags = SDL_RENDERER_SOFTWARE | SDL_RENDERER_TARGETTEXTURE;
+    }
+
+    //Start up SDL and create window, which an export never shows
+    if( !init(WindowFlags, RendererFlags) )
     {
         printf( "Failed to initialize!\n" );
     }
@@ -213,164 +579,148 @@ int main( int argc, char* args[] )
         {
             printf( "Failed to load media!\n" );
         }
+        else if(ExportArchive)
+        {
+            ExitCode = ExportReplay(ExportArchive, ExportGame, ExportOutput, ExportThreads) ? 0 : 1;
+
+            DestroyTextureArray(Glyphs);
+        }
+        else if(FrameBench)
+        {
+            RunFrameBench(FrameBenchSeed, FrameBenchSummary);
+
+            DestroyTextureArray(Glyphs);
+        }
+        else if(WallBoards)
+        {
+            RunSpectatorWall(WallBoards, WallPerfectClear, WallSurfaces);
+
+            DestroyTextureArray(Glyphs);
+        }
         else
         {
-            //Main loop flag
-            GameData CurrentGameData;
+            //Shared with the simulation thread
+            SimulationData* Simulation = (SimulationData*)HeapAllocate(sizeof(SimulationData));
+
+            InitialiseSnapshotBuffer(&Simulation->Snapshots);
+            SDL_AtomicSet(&Simulation->Inputs, 0);
+            SDL_AtomicSet(&Simulation->Quit, 0);
+            Simulation->Lock = SDL_CreateMutex();
+            Simulation->Wake = SDL_CreateCond();
+            Simulation->SnapshotEvent = SDL_RegisterEvents(1);
+            Simulation->Seed = time(NULL);
+            Simulation->Broadcast = NULL;
+            Simulation->Recorder = NULL;
+            Simulation->Scores = NULL;
+            SDL_AtomicSet(&Simulation->TickAllocations, 0);
+            SDL_AtomicSet(&Simulation->AllocatingTicks, 0);
+            Simulation->CheckAllocations = Accounting.CheckAllocations;
+            Simulation->Bench = NULL;
+
+            BroadcastPublisher Broadcast = {};
+
+            if(BroadcastName)
+            {
+                Broadcast = OpenBroadcastPublisher(BroadcastName, BROADCAST_DEFAULT_CAPACITY);
+
+                if(Broadcast.Valid)
+                {
+                    Simulation->Broadcast = &Broadcast;
+                    printf("Broadcasting as %s\n", BroadcastName);
+                }
+            }
+
+            ReplayWriter Recorder = {};
+
+            if(RecordPath)
+            {
+                Recorder = OpenReplayWriter(RecordPath, REPLAY_DEFAULT_KEYFRAME_PIECES);
+
+                if(Recorder.Valid)
+                {
+                    Simulation->Recorder = &Recorder;
+                }
+            }
+
+            if(ScoresPath)
+            {
+                ScoreLogWriter* Scores = new ScoreLogWriter;
+
+                if( OpenScoreLogWriter(Scores, ScoresPath) )
+                {
+                    Simulation->Scores = Scores;
+                }
+                else
+                {
+                    delete Scores;
+                }
+            }
+
+            SDL_Thread* SimulationThread = NULL;
 
-            CurrentGameData.Quit = false;
-            CurrentGameData.State = INITIALISING;
-            CurrentGameData.StartTick = 0;
-            CurrentGameData.EndTick = 0;
+            if( (Simulation->Lock == NULL) || (Simulation->Wake == NULL) || (Simulation->SnapshotEvent == (Uint32)-1) )
+            {
+                printf( "Simulation could not be set up! SDL Error: %s\n", SDL_GetError() );
+            }
+            else
+            {
+                SimulationThread = SDL_CreateThread(RunSimulation, "Simulation", Simulation);
 
-            //Input Struct
-            InputState Inputs;
+                if(SimulationThread == NULL)
+                {
+                    printf( "Simulation thread could not be created! SDL Error: %s\n", SDL_GetError() );
+                }
+            }
 
-            Inputs.Up = false;
-            Inputs.Down = false;
-            Inputs.Left = false;
-            Inputs.Right = false;
-            Inputs.Space = false;
+            if(SimulationThread)
+            {
+                RenderLoop(Simulation);
 
-            //Event handler
-            SDL_Event e;
+                StopSimulation(Simulation);
+                SDL_WaitThread(SimulationThread, NULL);
+            }
 
-            unsigned int FrameDuration = 0;
+            if(Broadcast.Valid)
+            {
+                printf("Broadcast: %llu records, %llu keyframes, %.1f bytes per record\n", Broadcast.Records,
+                       Broadcast.Keyframes, Broadcast.Records ? (double)Broadcast.Bytes/Broadcast.Records : 0.0);
 
-            float CellWidth = (float)(SCREEN_WIDTH - SCREEN_COLS*CELL_PADDING)/SCREEN_COLS;
-            float CellHeight = (float)(SCREEN_HEIGHT - SCREEN_ROWS*CELL_PADDING)/SCREEN_ROWS;
+                CloseBroadcastPublisher(&Broadcast);
+            }
 
-            //While application is running
-            while( !CurrentGameData.Quit )
+            if(Simulation->Recorder)
             {
-                CurrentGameData.StartTick = SDL_GetTicks();
+                unsigned int Games = Recorder.GameCount + (Recorder.Recording ? 1 : 0);
 
-                //Handle events on queue
-                while( SDL_PollEvent( &e ) != 0 )
+                if(CloseReplayWriter(&Recorder))
                 {
-                    //User requests quit
-                    if( e.type == SDL_QUIT )
-                    {
-                        CurrentGameData.Quit = true;
-                    }
-                    else if (e.type == SDL_KEYDOWN)
-                    {
-                        switch( e.key.keysym.sym )
-                        {
-                            case SDLK_UP:
-                                Inputs.Up = true;
-                                break;
-                            case SDLK_DOWN:
-                                Inputs.Down = true;
-                                break;
-                            case SDLK_LEFT:
-                                Inputs.Left = true;
-                                break;
-                            case SDLK_RIGHT:
-                                Inputs.Right = true;
-                                break;
-                            case SDLK_SPACE:
-                                Inputs.Space = true;
-                                break;
-                            case SDLK_ESCAPE:
-                                Inputs.Escape = true;
-                                break;
-                            default:
-                                break;
-                        }
-                    }
+                    printf("Recorded %u games to %s\n", Games, RecordPath);
                 }
+            }
 
-                switch(CurrentGameData.State)
+            if(Simulation->Scores)
+            {
+                unsigned long long Dropped = Simulation->Scores->Dropped.load();
+
+                if(Dropped)
                 {
-                    case INITIALISING:
-                        {
-                            //Initialise all game parameters
-                            CurrentGameData.FallingTimer = FALL_FRAMES;
-                            CurrentGameData.MoveLeft = 0;
-                            CurrentGameData.MoveRight = 0;
-                            CurrentGameData.MoveDown = 0;
-                            CurrentGameData.Rotate = 0;
-                            CurrentGameData.Score = 0;
-                            CurrentGameData.Redraw = 1;
-                            CurrentGameData.RenderScore = 1;
-
-                            //Create Game Grid
-                            //Create first Tetro and next Tetro
-                            CurrentGameData.MainGrid      = GenerateGrid(GRID_ROWS, GRID_COLS);
-                            CurrentGameData.FallingTetro = GenerateTetromino();
-                            CurrentGameData.NextTetro = GenerateTetromino();
-                            CurrentGameData.NextTetro.Col = 1;
-                            CurrentGameData.NextTetro.Row = 1;
-
-                            //Transition to Running
-                            CurrentGameData.State = RUNNING;
-                        }
-                        break;
-                    case RUNNING:
-                        {
-                            if(CurrentGameData.Redraw)
-                            {
-                                CurrentGameData = DrawGame(CurrentGameData);
-                                CurrentGameData.Redraw = 0;
-                            }
-
-                            CurrentGameData = HandleInputGame(Inputs, CurrentGameData);
-                            CurrentGameData = UpdateGame(CurrentGameData);
-                        }
-                        break;
-                    case PAUSED:
-                        {
-                            if(CurrentGameData.Redraw)
-                            {
-                                CurrentGameData = DrawGame(CurrentGameData);
-                                DrawRect(GRID_X,GRID_Y,GRID_WIDTH,GRID_HEIGHT,0,0,0,128);
-                                Rect TextBox = {GRID_X, GRID_Y, GRID_WIDTH, GRID_HEIGHT};
-                                DrawTextToRect("Paused!", TextBox, CENTRE);
-                                SDL_RenderPresent( gRenderer );
-                                CurrentGameData.Redraw = 0;
-                            }
-
-                            CurrentGameData = HandleInputPaused(Inputs, CurrentGameData);
-                            CurrentGameData = UpdatePaused(CurrentGameData);
-
-                        }
-                        break;
-                     case GAMEOVER:
-                        {
-                            if(CurrentGameData.Redraw)
-                            {
-                                CurrentGameData = DrawGame(CurrentGameData);
-                                DrawRect(GRID_X,GRID_Y,GRID_WIDTH,GRID_HEIGHT,0,0,0,128);
-                                Rect TextBox= {GRID_X, GRID_Y, GRID_WIDTH, GRID_HEIGHT};
-                                DrawTextToRect("Game Over!\nPress [Esc] to Quit or [Space] to Try again!", TextBox, CENTRE);
-                                SDL_RenderPresent( gRenderer );
-                                CurrentGameData.Redraw = 0;
-                            }
-
-                            CurrentGameData = HandleInputGameOver(Inputs, CurrentGameData);
-                            CurrentGameData = UpdateGameOver(CurrentGameData);
-                        }
+                    printf("%llu games were not logged, the score log fell behind\n", Dropped);
                 }
-                
-                //Reset Inputs
-                Inputs.Up = false;
-                Inputs.Down = false;
-                Inputs.Left = false;
-                Inputs.Right = false;
-                Inputs.Space = false;
-                Inputs.Escape = false;
-
-                //Delay till the end of the maximum frame duration (1/FRAMERATE seconds)
-                CurrentGameData.EndTick = SDL_GetTicks();
-                FrameDuration = CurrentGameData.EndTick - CurrentGameData.StartTick;
-
-                SDL_Delay((1000/FRAMERATE)-FrameDuration);
+
+                CloseScoreLogWriter(Simulation->Scores);
+                delete Simulation->Scores;
+            }
+
+            if(Accounting.CheckAllocations)
+            {
+                printf("Steady state allocations: %llu of %llu frames and %d ticks allocated, %llu textures created\n",
+                       Accounting.AllocatingFrames, Accounting.SteadyFrames, SDL_AtomicGet(&Simulation->AllocatingTicks),
+                       Accounting.TextureCreations);
             }
 
-            //Clean up game
-            DestroyTetromino(CurrentGameData.FallingTetro);
-            DestroyGrid(CurrentGameData.MainGrid);
+            SDL_DestroyCond(Simulation->Wake);
+            SDL_DestroyMutex(Simulation->Lock);
+            HeapFree(Simulation);
 
             //Free textures
             DestroyTextureArray(Glyphs);
@@ -380,505 +730,1982 @@ int main( int argc, char* args[] )
     //Free resources and close SDL
     close();
 
-    return 0;
+    return ExitCode;
 }
 
 /*
- * Platform Operations
+ * Simulation Thread
+ *
+ * The game runs on its own thread and never touches SDL rendering. Ticks land
+ * on a fixed FRAMERATE grid, but the thread only wakes for ticks where
+ * something can happen: the next tick after a key press, or the tick gravity
+ * next moves the piece. The idle ticks in between only count FallingTimer
+ * down, so they're skipped in one go with FastForwardGame. Paused or game
+ * over, nothing is timed and the thread sleeps until a key arrives.
+ *
+ * After every tick it saves a snapshot of the game into a triple buffer and,
+ * if anything visible changed, wakes the main thread to draw it. A slow draw
+ * or a present blocked on vsync can't hold up input handling or gravity, it
+ * only means some snapshots are never drawn. With --broadcast the same
+ * snapshot also goes out to spectators, see broadcast.h.
+ *
+ * The frame benchmark runs this same loop, with its script as one more timer
+ * and on its own clock, see Frame Benchmark below.
  */
 
-bool init()
+InputState UnpackInputs(unsigned int Bits)
 {
-    //Initialization flag
-    bool success = true;
+    InputState Result;
 
-    //Initialize SDL
-    if( SDL_Init( SDL_INIT_VIDEO ) < 0 )
-    {
-        printf( "SDL could not initialize! SDL Error: %s\n", SDL_GetError() );
-        success = false;
-    }
-    else
+    Result.Up       = (Bits & INPUT_UP) != 0;
+    Result.Down     = (Bits & INPUT_DOWN) != 0;
+    Result.Left     = (Bits & INPUT_LEFT) != 0;
+    Result.Right    = (Bits & INPUT_RIGHT) != 0;
+    Result.Space    = (Bits & INPUT_SPACE) != 0;
+    Result.Escape   = (Bits & INPUT_ESCAPE) != 0;
+
+    return Result;
+}
+
+//Called from the main thread
+void PostInputs(SimulationData* Simulation, unsigned int Pressed)
+{
+    //Merged with any the simulation hasn't taken yet
+    for(;;)
     {
-        srand(time(NULL));
+        int Current = SDL_AtomicGet(&Simulation->Inputs);
 
-        //Create window
-        gWindow = SDL_CreateWindow( "A Game About Falling Blocks", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN );
-        if( gWindow == NULL )
+        if(SDL_AtomicCAS(&Simulation->Inputs, Current, Current | Pressed))
         {
-            printf( "Window could not be created! SDL Error: %s\n", SDL_GetError() );
-            success = false;
-        }
-        else
-        {
-            //Create renderer for window
-            gRenderer = SDL_CreateRenderer( gWindow, -1, SDL_RENDERER_ACCELERATED );
-            if( gRenderer == NULL )
-            {
-                printf( "Renderer could not be created! SDL Error: %s\n", SDL_GetError() );
-                success = false;
-            }
-            else
-            {
-                //Initialize renderer color
-                SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
-
-                if(TTF_Init() == -1)
-                {
-                    success = false;
-                }
-            }
+            break;
         }
     }
 
-    return success;
+    SDL_LockMutex(Simulation->Lock);
+    SDL_CondSignal(Simulation->Wake);
+    SDL_UnlockMutex(Simulation->Lock);
 }
 
-bool loadMedia()
+//Called from the main thread
+void StopSimulation(SimulationData* Simulation)
 {
-    bool success = true;
+    SDL_AtomicSet(&Simulation->Quit, 1);
 
-    gFont = TTF_OpenFont("/usr/share/fonts/TTF/FiraMono-Regular.ttf", 18);
+    SDL_LockMutex(Simulation->Lock);
+    SDL_CondSignal(Simulation->Wake);
+    SDL_UnlockMutex(Simulation->Lock);
+}
 
-    if(gFont == NULL)
+void ClearTimers(TimerQueue* Timers)
+{
+    for(unsigned int Timer = 0; Timer < TIMER_COUNT; ++Timer)
     {
-        success = false;
+        Timers->Deadlines[Timer] = TIMER_NONE;
     }
+}
+
+void SetTimer(TimerQueue* Timers, SimulationTimer Timer, unsigned long long Tick)
+{
+    Timers->Deadlines[Timer] = Tick;
+}
 
-    Glyphs = LoadFontTextures();
+//The earliest tick anything is waiting for, TIMER_NONE if nothing is
+unsigned long long NextTimer(TimerQueue* Timers)
+{
+    unsigned long long Result = TIMER_NONE;
 
-    if(!Glyphs.Initialised)
+    for(unsigned int Timer = 0; Timer < TIMER_COUNT; ++Timer)
     {
-        success = false;
+        if(Timers->Deadlines[Timer] < Result)
+        {
+            Result = Timers->Deadlines[Timer];
+        }
     }
 
-    return success;
+    return Result;
 }
 
-TextureArray LoadFontTextures()
+int RunSimulation(void* Data)
 {
-    unsigned int StartGlyph = 0x20;
-    unsigned int EndGlyph = 0x7E;
-    unsigned int GlyphRange = EndGlyph - StartGlyph;
+    SimulationData* Simulation = (SimulationData*)Data;
 
+    //All of a game's grids and pieces come out of here, and a
+    //restart resets it in one go
+    GameMemory Memory = GenerateGameMemory();
 
-    TextureArray Result = GenerateTextureArray(GlyphRange+1);
-    Result.Initialised = true;
-    SDL_Color TextColor = {255,255,255};
+    GameData CurrentGameData = {};
+
+    CurrentGameData.Memory = &Memory;
+    CurrentGameData.Quit = false;
+    CurrentGameData.State = INITIALISING;
+    CurrentGameData.Random = SeedRandomSeries(Simulation->Seed);
+
+    //Bumped whenever the game asks for a redraw, so the renderer can tell
+    //a changed snapshot from one it has already drawn
+    unsigned int DrawVersion = 0;
+
+    //Tick N is due at Start + N*TickLength
+    Uint64 Frequency = SDL_GetPerformanceFrequency();
+    Uint64 TickLength = Frequency/FRAMERATE;
+    Uint64 Start = SDL_GetPerformanceCounter();
+    unsigned long long Tick = 0;
 
+    TimerQueue Timers;
 
-    //Load ASCII A-Z
-    for(unsigned int Char = StartGlyph; Char <= EndGlyph; ++Char)
+    //Stats of the game in progress, for the score log
+    ScoreTracker Tracker = {};
+
+    //The recorder and tracker both count pieces and clears as they happen
+    GameEventPair<ReplayWriter, ScoreTracker> Events = {Simulation->Recorder, Simulation->Scores ? &Tracker : NULL};
+
+    FrameBench* Bench = Simulation->Bench;
+    HeapCounters SimulationHeap = GetHeapCounters();
+
+    while( !CurrentGameData.Quit && !SDL_AtomicGet(&Simulation->Quit) )
     {
-        unsigned int Index = Char - StartGlyph;
-        Result.Textures[Index] = GenerateTexture();
+        Uint64 Now = SDL_GetPerformanceCounter();
 
-        bool result = LoadGlyphToTexture((char)Char,TextColor,&Result.Textures[Index]);
+        //The tick input pressed now is read on: the one whose time is
+        //running, unless that has already been simulated
+        unsigned long long NextTick = (Now - Start)/TickLength;
 
-        if(!result)
+        //The benchmark plays on its own clock, as fast as it can
+        if( (NextTick <= Tick) || Bench )
         {
-            printf( "Failed to load texture for '%c'!\n", Char );
-            Result.Initialised = false;
+            NextTick = Tick + 1;
         }
+
+        ClearTimers(&Timers);
+
+        if(Bench)
+        {
+            unsigned long long ScriptTick = NextFrameBenchTick(Bench, Tick, CurrentGameData);
+
+            if(ScriptTick == TIMER_NONE)
+            {
+                Bench->Finished = true;
+                break;
+            }
+
+            SetTimer(&Timers, TIMER_SCRIPT, ScriptTick);
+        }
+
+        if( (CurrentGameData.State == INITIALISING) || SDL_AtomicGet(&Simulation->Inputs) )
+        {
+            SetTimer(&Timers, TIMER_NEXT_TICK, NextTick);
+        }
+
+        if(CurrentGameData.State == RUNNING)
+        {
+            SetTimer(&Timers, TIMER_GRAVITY, Tick + TicksUntilGravity(CurrentGameData));
+        }
+
+        unsigned long long WakeTick = NextTimer(&Timers);
+
+        //Sleep until the deadline, or until a key press or quit might have
+        //brought it forward
+        if( !Bench && ((WakeTick == TIMER_NONE) || (Now < Start + WakeTick*TickLength)) )
+        {
+            SDL_LockMutex(Simulation->Lock);
+
+            if( !SDL_AtomicGet(&Simulation->Inputs) && !SDL_AtomicGet(&Simulation->Quit) )
+            {
+                if(WakeTick == TIMER_NONE)
+                {
+                    SDL_CondWait(Simulation->Wake, Simulation->Lock);
+                }
+                else
+                {
+                    //Rounded up, waking a little late is better than spinning
+                    Uint64 Wait = Start + WakeTick*TickLength - Now;
+                    SDL_CondWaitTimeout(Simulation->Wake, Simulation->Lock, (Uint32)((Wait*1000 + Frequency - 1)/Frequency));
+                }
+            }
+
+            SDL_UnlockMutex(Simulation->Lock);
+            continue;
+        }
+
+        //Woken a long way late (the machine was suspended, say): carry on
+        //from here rather than racing through the missed ticks
+        Uint64 Late = Bench ? 0 : (Now - (Start + WakeTick*TickLength))/TickLength;
+
+        if(Late > 4)
+        {
+            Start += Late*TickLength;
+        }
+
+        HeapCounters TickHeap = GetHeapCounters();
+
+        //Nothing happens on the ticks before WakeTick
+        if(CurrentGameData.State == RUNNING)
+        {
+            CurrentGameData = FastForwardGame(CurrentGameData, (unsigned int)(WakeTick - Tick - 1));
+
+            if(Simulation->Recorder)
+            {
+                SkipReplayTicks(Simulation->Recorder, (unsigned int)(WakeTick - Tick - 1));
+            }
+
+            Tracker.Record.Ticks += (unsigned int)(WakeTick - Tick - 1);
+        }
+
+        Tick = WakeTick;
+
+        CurrentGameData.StartTick = SDL_GetTicks();
+
+        //Everything pressed since the last tick, or the script's inputs for it
+        InputState Inputs = Bench ? GetFrameBenchTickInputs(Bench, Tick, CurrentGameData)
+                                  : UnpackInputs(SDL_AtomicSet(&Simulation->Inputs, 0));
+        GameState PreviousState = CurrentGameData.State;
+        unsigned int PreviousRandomState = CurrentGameData.Random.State;
+        Uint64 TickStart = SDL_GetPerformanceCounter();
+
+        CurrentGameData = SimulateTick(CurrentGameData, Inputs, &Events);
+
+        Uint64 Simulated = SDL_GetPerformanceCounter();
+        CurrentGameData.EndTick = SDL_GetTicks();
+
+        //Each game is recorded from its first RUNNING tick to game over.
+        //Paused ticks without input do nothing, so they're not recorded.
+        if(Simulation->Recorder)
+        {
+            if( (PreviousState == INITIALISING) && (CurrentGameData.State == RUNNING) )
+            {
+                BeginReplayGame(Simulation->Recorder, &CurrentGameData);
+            }
+            else
+            {
+                RecordReplayTick(Simulation->Recorder, &CurrentGameData, PackReplayInputs(Inputs));
+            }
+
+            if(CurrentGameData.State == GAMEOVER)
+            {
+                EndReplayGame(Simulation->Recorder);
+            }
+        }
+
+        //Tracked the same way, but only logged once the game is over
+        if(Simulation->Scores)
+        {
+            if( (PreviousState == INITIALISING) && (CurrentGameData.State == RUNNING) )
+            {
+                BeginScoreTracking(&Tracker, PreviousRandomState);
+            }
+            else if(PreviousState != GAMEOVER)
+            {
+                TrackScoreTicks(&Tracker, &CurrentGameData, 1);
+
+                if(CurrentGameData.State == GAMEOVER)
+                {
+                    ScoreRecord Record = FinishScoreTracking(&Tracker, &CurrentGameData);
+                    SubmitScoreRecord(Simulation->Scores, &Record);
+                }
+            }
+        }
+
+        //Publish, a restart in progress has nothing worth drawing
+        if( CurrentGameData.Redraw && (CurrentGameData.State != INITIALISING) )
+        {
+            ++DrawVersion;
+            CurrentGameData.Redraw = 0;
+
+            PublishedSnapshot* Slot = BeginSnapshotWrite(&Simulation->Snapshots);
+
+            SaveGameSnapshot(&CurrentGameData, &Slot->Snapshot);
+            Slot->Version = DrawVersion;
+            Slot->PublishTime = SDL_GetPerformanceCounter();
+
+            //Encoded once however many are watching
+            if(Simulation->Broadcast)
+            {
+                PublishBroadcast(Simulation->Broadcast, &Slot->Snapshot, (unsigned int)Tick);
+            }
+
+            if(Bench)
+            {
+                RecordFrameBenchPublish(Bench, Slot, TickStart, Simulated);
+            }
+
+            PublishSnapshot(&Simulation->Snapshots);
+
+            SDL_Event Wake = {};
+            Wake.type = Simulation->SnapshotEvent;
+            SDL_PushEvent(&Wake);
+
+            //So the benchmark draws the same frames however the threads
+            //are scheduled
+            if(Bench)
+            {
+                WaitForFrameBenchFrame(Simulation, DrawVersion);
+            }
+        }
+
+        TickHeap = GetHeapCountersSince(TickHeap);
+        SDL_AtomicSet(&Simulation->TickAllocations, (int)TickHeap.Allocations);
+
+        if(Bench)
+        {
+            RecordFrameBenchTick(Bench, Tick, PreviousState, CurrentGameData, Simulated - TickStart, TickHeap);
+        }
+
+        if( TickHeap.Allocations && (PreviousState == RUNNING) && (CurrentGameData.State == RUNNING) )
+        {
+            int Allocating = SDL_AtomicAdd(&Simulation->AllocatingTicks, 1) + 1;
+
+            if( Simulation->CheckAllocations && (Allocating <= ALLOCATION_REPORT_LIMIT) )
+            {
+                printf("Tick %llu allocated %llu times (%llu bytes) while running\n",
+                       Tick, TickHeap.Allocations, TickHeap.Bytes);
+            }
+        }
+    }
+
+    if(Bench)
+    {
+        Bench->SimulationHeap = GetHeapCountersSince(SimulationHeap);
+    }
+
+    //Let the renderer know if the game quit itself
+    SDL_AtomicSet(&Simulation->Quit, 1);
+
+    SDL_Event Wake = {};
+    Wake.type = Simulation->SnapshotEvent;
+    SDL_PushEvent(&Wake);
+
+    DestroyGame(CurrentGameData);
+    DestroyGameMemory(Memory);
+
+    return 0;
+}
+
+/*
+ * Render Loop
+ */
+
+void ResetSnapshotAgeStats(SnapshotAgeStats* Stats, Uint64 Now)
+{
+    Stats->Min = ~(Uint64)0;
+    Stats->Max = 0;
+    Stats->Total = 0;
+    Stats->Frames = 0;
+    Stats->Skipped = 0;
+    Stats->ReportTime = Now;
+}
+
+//Age is the time from the simulation publishing a snapshot to the frame
+//showing it being presented
+void RecordSnapshotAge(SnapshotAgeStats* Stats, Uint64 Age, Uint64 Now)
+{
+    if(Age < Stats->Min) Stats->Min = Age;
+    if(Age > Stats->Max) Stats->Max = Age;
+    Stats->Total += Age;
+    ++Stats->Frames;
+
+    Uint64 Frequency = SDL_GetPerformanceFrequency();
+
+    if(Now - Stats->ReportTime >= SNAPSHOT_AGE_REPORT_SECONDS*Frequency)
+    {
+        double ToMs = 1000.0/(double)Frequency;
+
+        printf("Snapshot age at present: min %.2fms avg %.2fms max %.2fms over %u frames, %u snapshots not drawn\n",
+                Stats->Min*ToMs, (Stats->Total*ToMs)/Stats->Frames, Stats->Max*ToMs,
+                Stats->Frames, Stats->Skipped);
+
+        ResetSnapshotAgeStats(Stats, Now);
+    }
+}
+
+void RenderLoop(SimulationData* Simulation)
+{
+    //Snapshots are loaded into this to be drawn, it owns its own grids and
+    //is never seen by the simulation
+    GameSnapshot Empty;
+    memset(&Empty, 0, sizeof(Empty));
+    GameData RenderGameData = GenerateGameFromSnapshot(&Empty);
+
+    unsigned int DrawnVersion = 0;
+    unsigned long long DrawnSequence = 0;
+
+    SnapshotAgeStats AgeStats;
+    ResetSnapshotAgeStats(&AgeStats, SDL_GetPerformanceCounter());
+
+    //For telling steady state frames from the first of a game
+    GameState DrawnState = INITIALISING;
+
+    //Set when the overlay is toggled, to show the change without waiting
+    //for the game to move
+    bool Refresh = false;
+
+    //Event handler
+    SDL_Event e;
+
+    while( !SDL_AtomicGet(&Simulation->Quit) )
+    {
+        unsigned int Pressed = 0;
+
+        //Sleep until something happens: a key, or the simulation pushing
+        //SnapshotEvent when it has something new to draw
+        if( SDL_WaitEventTimeout( &e, RENDER_WAIT_TIMEOUT ) )
+        {
+            do
+            {
+                //User requests quit
+                if( e.type == SDL_QUIT )
+                {
+                    StopSimulation(Simulation);
+                }
+                else if (e.type == SDL_KEYDOWN)
+                {
+                    switch( e.key.keysym.sym )
+                    {
+                        case SDLK_UP:
+                            Pressed |= INPUT_UP;
+                            break;
+                        case SDLK_DOWN:
+                            Pressed |= INPUT_DOWN;
+                            break;
+                        case SDLK_LEFT:
+                            Pressed |= INPUT_LEFT;
+                            break;
+                        case SDLK_RIGHT:
+                            Pressed |= INPUT_RIGHT;
+                            break;
+                        case SDLK_SPACE:
+                            Pressed |= INPUT_SPACE;
+                            break;
+                        case SDLK_ESCAPE:
+                            Pressed |= INPUT_ESCAPE;
+                            break;
+                        case SDLK_F3:
+                            Accounting.Overlay = !Accounting.Overlay;
+                            Refresh = true;
+                            break;
+                        default:
+                            break;
+                    }
+                }
+            } while( SDL_PollEvent( &e ) != 0 );
+        }
+
+        if(Pressed)
+        {
+            PostInputs(Simulation, Pressed);
+        }
+
+        bool New = false;
+        const PublishedSnapshot* Slot = AcquireSnapshot(&Simulation->Snapshots, &New);
+
+        if(New)
+        {
+            AgeStats.Skipped += (unsigned int)(Slot->Sequence - DrawnSequence - 1);
+            DrawnSequence = Slot->Sequence;
+        }
+
+        if( !Refresh && (!New || (Slot->Version == DrawnVersion)) )
+        {
+            continue;
+        }
+
+        Refresh = false;
+
+        HeapCounters FrameHeap = GetHeapCounters();
+
+        LoadGameSnapshot(&Slot->Snapshot, &RenderGameData);
+        DrawnVersion = Slot->Version;
+
+        Uint64 Loaded = SDL_GetPerformanceCounter();
+        RenderGameData = DrawFrame(RenderGameData);
+
+        if(Accounting.Overlay)
+        {
+            DrawAccountingOverlay(Simulation);
+        }
+
+        Uint64 Drawn = SDL_GetPerformanceCounter();
+
+        //Update screen
+        SDL_RenderPresent( gRenderer );
+
+        Uint64 Presented = SDL_GetPerformanceCounter();
+        RecordSnapshotAge(&AgeStats, Presented - Slot->PublishTime, Presented);
+
+        if(!Startup.Reported)
+        {
+            MarkStartupPhase("first frame");
+            ReportStartupTimes();
+        }
+
+        //Anything pushed for this frame is finished with
+        ResetArena(&FrameArena);
+
+        Accounting.LastFrameHeap = GetHeapCountersSince(FrameHeap);
+        Accounting.LastFrame = Accounting.Frame;
+        Accounting.TextureCreations += Accounting.Frame.TextureCreations;
+        memset(&Accounting.Frame, 0, sizeof(Accounting.Frame));
+
+        if( (RenderGameData.State == RUNNING) && (DrawnState == RUNNING) )
+        {
+            Accounting.SteadyFrames++;
+
+            if(Accounting.LastFrameHeap.Allocations || Accounting.LastFrame.TextureCreations)
+            {
+                Accounting.AllocatingFrames++;
+
+                if( Accounting.CheckAllocations && (Accounting.AllocatingFrames <= ALLOCATION_REPORT_LIMIT) )
+                {
+                    printf("Frame allocated %llu times (%llu bytes) and created %u textures while running\n",
+                           Accounting.LastFrameHeap.Allocations, Accounting.LastFrameHeap.Bytes,
+                           Accounting.LastFrame.TextureCreations);
+                }
+            }
+        }
+
+        DrawnState = RenderGameData.State;
+
+        if(Simulation->Bench)
+        {
+            RecordFrameBenchFrame(Simulation, Slot, Loaded, Drawn, Presented);
+        }
+    }
+
+    DestroyGame(RenderGameData);
+}
+
+/*
+ * Spectator Wall
+ *
+ * A view of many bot driven games at once, for watching bots or a tournament.
+ * It runs on the main thread at FRAMERATE: each tick steps every game once
+ * and redraws the wall, which is one texture upload and one copy in total.
+ */
+
+SpectatorWall GenerateSpectatorWall(MemoryArena* Arena, unsigned int Count, unsigned int Seed, bool PerfectClear,
+                                    const char* SurfacesPath)
+{
+    SpectatorWall Result;
+    memset(&Result, 0, sizeof(Result));
+
+    Result.Boards = PushArray(Arena, WallBoard, Count);
+
+    if(Result.Boards == NULL)
+    {
+        return Result;
+    }
+
+    Result.Count = Count;
+    Result.Weights = DefaultBotWeights();
+    Result.PerfectClear = PerfectClear;
+
+    if(PerfectClear)
+    {
+        OpenSolverMemo(&Result.Memo, WALL_SOLVER_MEMO_BITS);
+    }
+
+    //A table that won't open just leaves the bots searching
+    if(SurfacesPath)
+    {
+        Result.Surfaces = OpenSurfaceTable(SurfacesPath);
+
+        if(!Result.Surfaces.Valid)
+        {
+            printf("Wall: searching every move instead\n");
+        }
+    }
+
+    //Pick the arrangement that shows the boards biggest
+    float BestScale = 0;
+
+    for(unsigned int Columns = 1; Columns <= Count; ++Columns)
+    {
+        unsigned int Rows = (Count + Columns - 1)/Columns;
+        unsigned int Width = Columns*(GRID_COLS + WALL_GUTTER) + WALL_GUTTER;
+        unsigned int Height = Rows*(GRID_ROWS + WALL_GUTTER) + WALL_GUTTER;
+
+        float ScaleX = (float)SCREEN_WIDTH/(float)Width;
+        float ScaleY = (float)SCREEN_HEIGHT/(float)Height;
+        float Scale = (ScaleX < ScaleY) ? ScaleX : ScaleY;
+
+        if(Scale > BestScale)
+        {
+            BestScale = Scale;
+            Result.Columns = Columns;
+            Result.Rows = Rows;
+            Result.Width = Width;
+            Result.Height = Height;
+        }
+    }
+
+    Result.Destination.w = Result.Width*BestScale;
+    Result.Destination.h = Result.Height*BestScale;
+    Result.Destination.x = (SCREEN_WIDTH - Result.Destination.w)/2;
+    Result.Destination.y = (SCREEN_HEIGHT - Result.Destination.h)/2;
+
+    Result.Texture = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+                                       Result.Width, Result.Height);
+
+    if(Result.Texture == NULL)
+    {
+        printf( "Unable to create spectator wall texture! SDL Error: %s\n", SDL_GetError() );
+        return Result;
+    }
+
+    SDL_SetTextureBlendMode(Result.Texture, SDL_BLENDMODE_NONE);
+
+    for(unsigned int Index = 0; Index < Count; ++Index)
+    {
+        WallBoard* Board = Result.Boards + Index;
+        memset(&Board->Game, 0, sizeof(Board->Game));
+
+        Board->Memory = GenerateGameMemory();
+        Board->Game.Memory = &Board->Memory;
+        Board->Game.Random = SeedRandomSeries(Seed + Index);
+        Board->Game.State = INITIALISING;
+        Board->Bot = GeneratePerfectClearBot(WALL_SOLVER_PIECES, WALL_SOLVER_NODES);
+    }
+
+    return Result;
+}
+
+void DestroySpectatorWall(SpectatorWall Wall)
+{
+    for(unsigned int Index = 0; Index < Wall.Count; ++Index)
+    {
+        DestroyGameMemory(Wall.Boards[Index].Memory);
+    }
+
+    if(Wall.Texture)
+    {
+        SDL_DestroyTexture(Wall.Texture);
+    }
+
+    if(Wall.PerfectClear)
+    {
+        CloseSolverMemo(&Wall.Memo);
+    }
+
+    CloseSurfaceTable(&Wall.Surfaces);
+
+    //The boards go with their arena
+}
+
+//One tick of every game, finished games start again straight away
+void StepSpectatorWall(SpectatorWall* Wall)
+{
+    for(unsigned int Index = 0; Index < Wall->Count; ++Index)
+    {
+        GameData Game = Wall->Boards[Index].Game;
+
+        switch(Game.State)
+        {
+            case INITIALISING:
+                Game = InitialiseGame(Game);
+                break;
+            case RUNNING:
+                if(Wall->PerfectClear)
+                {
+                    Game = HandleInputGame(GetPerfectClearBotInputs(Game, Wall->Weights, &Wall->Boards[Index].Bot,
+                                                                    &Wall->Memo), Game);
+                }
+                else
+                {
+                    Game = HandleInputGame(GetSurfaceBotInputs(Game, Wall->Weights, &Wall->Surfaces,
+                                                               &Wall->SurfaceLookups), Game);
+                }
+
+                Game = UpdateGame(Game);
+                break;
+            case GAMEOVER:
+                Wall->GamesPlayed++;
+                Wall->BestScore = (Game.Score > Wall->BestScore) ? Game.Score : Wall->BestScore;
+
+                Game.Restart = 1;
+                Game = UpdateGameOver(Game);
+                break;
+            default:
+                break;
+        }
+
+        Wall->Boards[Index].Game = Game;
+    }
+}
+
+void DrawSpectatorWall(SpectatorWall* Wall)
+{
+    void* Pixels = NULL;
+    int Pitch = 0;
+
+    if(SDL_LockTexture(Wall->Texture, NULL, &Pixels, &Pitch) != 0)
+    {
+        printf( "Unable to lock spectator wall texture! SDL Error: %s\n", SDL_GetError() );
+        return;
+    }
+
+    //Locked texels start out undefined, so the gutters are written every time
+    for(unsigned int Row = 0; Row < Wall->Height; ++Row)
+    {
+        Uint32* Texel = (Uint32*)((Uint8*)Pixels + Row*Pitch);
+
+        for(unsigned int Col = 0; Col < Wall->Width; ++Col)
+        {
+            Texel[Col] = 0xFF000000;
+        }
+    }
+
+    for(unsigned int Index = 0; Index < Wall->Count; ++Index)
+    {
+        GameData* Game = &Wall->Boards[Index].Game;
+
+        if( (Game->State == INITIALISING) || (Game->MainGrid.Blocks == NULL) )
+        {
+            continue;
+        }
+
+        unsigned int X = (Index % Wall->Columns)*(GRID_COLS + WALL_GUTTER) + WALL_GUTTER;
+        unsigned int Y = (Index / Wall->Columns)*(GRID_ROWS + WALL_GUTTER) + WALL_GUTTER;
+
+        Uint32* Origin = (Uint32*)((Uint8*)Pixels + Y*Pitch) + X;
+        WriteBoardTexels(Game->MainGrid, Game->FallingTetro, Origin, Pitch);
+    }
+
+    SDL_UnlockTexture(Wall->Texture);
+
+    SDL_SetRenderDrawColor( gRenderer, 0, 0, 0, 0 );
+    SDL_RenderClear( gRenderer );
+    SDL_RenderCopy( gRenderer, Wall->Texture, NULL, &Wall->Destination );
+    SDL_RenderPresent( gRenderer );
+}
+
+void ReportWallStats(WallStats* Stats, SpectatorWall* Wall, Uint64 Now)
+{
+    Uint64 Frequency = SDL_GetPerformanceFrequency();
+
+    if( (Stats->Frames == 0) || (Now - Stats->ReportTime < SNAPSHOT_AGE_REPORT_SECONDS*Frequency) )
+    {
+        return;
+    }
+
+    double ToMs = 1000.0/(double)Frequency;
+
+    printf("Wall: %u boards, step %.3fms draw %.3fms per frame, %u of %u frames late, %u games played, best score %u\n",
+            Wall->Count, (Stats->StepTime*ToMs)/Stats->Frames, (Stats->DrawTime*ToMs)/Stats->Frames,
+            Stats->LateFrames, Stats->Frames, Wall->GamesPlayed, Wall->BestScore);
+
+    if(Wall->PerfectClear)
+    {
+        unsigned int Plans = 0;
+        unsigned int PerfectClears = 0;
+
+        for(unsigned int Index = 0; Index < Wall->Count; ++Index)
+        {
+            Plans += Wall->Boards[Index].Bot.PlansFound;
+            PerfectClears += Wall->Boards[Index].Bot.PerfectClears;
+        }
+
+        printf("Wall: %u perfect clears planned, %u made\n", Plans, PerfectClears);
+    }
+    else if(Wall->Surfaces.Valid && Wall->SurfaceLookups.Lookups)
+    {
+        printf("Wall: surface table answered %llu of %llu moves (%.1f%%)\n", Wall->SurfaceLookups.Hits,
+                Wall->SurfaceLookups.Lookups, 100.0*Wall->SurfaceLookups.Hits/Wall->SurfaceLookups.Lookups);
+    }
+
+    memset(Stats, 0, sizeof(*Stats));
+    Stats->ReportTime = Now;
+}
+
+void RunSpectatorWall(unsigned int BoardCount, bool PerfectClear, const char* SurfacesPath)
+{
+    SpectatorWall Wall = GenerateSpectatorWall(&PlatformArena, BoardCount, time(NULL), PerfectClear, SurfacesPath);
+
+    if(Wall.Texture == NULL)
+    {
+        DestroySpectatorWall(Wall);
+        return;
+    }
+
+    Uint64 Frequency = SDL_GetPerformanceFrequency();
+    Uint64 TickLength = Frequency/FRAMERATE;
+    Uint64 NextTick = SDL_GetPerformanceCounter();
+
+    WallStats Stats;
+    memset(&Stats, 0, sizeof(Stats));
+    Stats.ReportTime = NextTick;
+
+    bool Quit = false;
+    SDL_Event e;
+
+    while(!Quit)
+    {
+        Uint64 Now = SDL_GetPerformanceCounter();
+
+        //Sleep in the event queue until the next tick is due
+        Uint32 Timeout = (Now < NextTick) ? (Uint32)(((NextTick - Now)*1000 + Frequency - 1)/Frequency) : 0;
+        bool HaveEvent = Timeout ? SDL_WaitEventTimeout(&e, Timeout) : SDL_PollEvent(&e);
+
+        while(HaveEvent)
+        {
+            if( (e.type == SDL_QUIT) || ((e.type == SDL_KEYDOWN) && (e.key.keysym.sym == SDLK_ESCAPE)) )
+            {
+                Quit = true;
+            }
+
+            HaveEvent = SDL_PollEvent(&e);
+        }
+
+        Now = SDL_GetPerformanceCounter();
+
+        if(Now < NextTick)
+        {
+            continue;
+        }
+
+        //Too far behind to catch up, start the clock again from here
+        if(Now - NextTick > WALL_MAX_LAG_TICKS*TickLength)
+        {
+            NextTick = Now;
+            Stats.LateFrames++;
+        }
+
+        NextTick += TickLength;
+
+        StepSpectatorWall(&Wall);
+        Uint64 Stepped = SDL_GetPerformanceCounter();
+
+        DrawSpectatorWall(&Wall);
+        Uint64 Drawn = SDL_GetPerformanceCounter();
+
+        Stats.StepTime += Stepped - Now;
+        Stats.DrawTime += Drawn - Stepped;
+        Stats.Frames++;
+
+        if(!Startup.Reported)
+        {
+            MarkStartupPhase("first frame");
+            ReportStartupTimes();
+        }
+
+        ReportWallStats(&Stats, &Wall, Drawn);
+    }
+
+    DestroySpectatorWall(Wall);
+}
+
+/*
+ * Replay Export
+ *
+ * Renders a recorded game offline, a frame for every tick, as fast as frames
+ * can be drawn rather than at FRAMERATE. Each frame goes through DrawFrame,
+ * the same as the game window, into a texture the size of the window, is
+ * read back into a FrameCapture slot and handed to its threads to encode and
+ * write (see capture.h), while the next tick is simulated and drawn.
+ */
+
+bool ExportReplay(const char* ArchivePath, unsigned int GameIndex, const char* Output, unsigned int ThreadCount)
+{
+    ReplayArchive Archive = OpenReplayArchive(ArchivePath);
+
+    if(!Archive.Valid)
+    {
+        return false;
+    }
+
+    if(GameIndex >= Archive.Header->GameCount)
+    {
+        printf("%s only has %u games\n", ArchivePath, Archive.Header->GameCount);
+        CloseReplayArchive(&Archive);
+        return false;
+    }
+
+    SDL_Texture* Target = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, SCREEN_WIDTH, SCREEN_HEIGHT);
+
+    if( (Target == NULL) || (SDL_SetRenderTarget(gRenderer, Target) != 0) )
+    {
+        printf( "Export target could not be created! SDL Error: %s\n", SDL_GetError() );
+
+        if(Target)
+        {
+            SDL_DestroyTexture(Target);
+        }
+
+        CloseReplayArchive(&Archive);
+        return false;
+    }
+
+    FrameCapture* Capture = new FrameCapture;
+
+    if( !OpenFrameCapture(Capture, Output, SCREEN_WIDTH, SCREEN_HEIGHT, ThreadCount) )
+    {
+        delete Capture;
+        SDL_SetRenderTarget(gRenderer, NULL);
+        SDL_DestroyTexture(Target);
+        CloseReplayArchive(&Archive);
+        return false;
+    }
+
+    const ReplayGame* Game = Archive.Games + GameIndex;
+    const unsigned char* Inputs = GetReplayInputs(&Archive, GameIndex);
+    GameData Current = GenerateGameFromSnapshot(&GetReplayKeyframes(&Archive, GameIndex)->Snapshot);
+
+    unsigned int FrameCount = Game->TickCount + 1;
+    unsigned int Frames = 0;
+    Uint64 DrawTime = 0;
+    Uint64 ReadTime = 0;
+
+    Uint64 Frequency = SDL_GetPerformanceFrequency();
+    Uint64 Start = SDL_GetPerformanceCounter();
+    Uint64 ReportTime = Start;
+
+    bool Quit = false;
+    SDL_Event e;
+
+    printf("Exporting game %u (%u frames) to %s on %u threads\n", GameIndex, FrameCount, Output, Capture->ThreadCount);
+
+    //Frame N is the game as it stood before tick N's inputs, the last one
+    //as it ended
+    for(unsigned int Tick = 0; (Tick < FrameCount) && !Quit; ++Tick)
+    {
+        while( SDL_PollEvent(&e) )
+        {
+            Quit = Quit || (e.type == SDL_QUIT);
+        }
+
+        CaptureFrame* Frame = AcquireCaptureFrame(Capture);
+        Uint64 Drawing = SDL_GetPerformanceCounter();
+
+        Current = DrawFrame(Current);
+        Uint64 Drawn = SDL_GetPerformanceCounter();
+
+        if(SDL_RenderReadPixels(gRenderer, NULL, SDL_PIXELFORMAT_RGB24, Frame->Pixels, Capture->Pitch) != 0)
+        {
+            printf( "Frame could not be read back! SDL Error: %s\n", SDL_GetError() );
+            AbandonCaptureFrame(Capture, Frame);
+            break;
+        }
+
+        Uint64 Read = SDL_GetPerformanceCounter();
+
+        SubmitCaptureFrame(Capture, Frame);
+        Frames++;
+
+        DrawTime += Drawn - Drawing;
+        ReadTime += Read - Drawn;
+
+        ResetArena(&FrameArena);
+        memset(&Accounting.Frame, 0, sizeof(Accounting.Frame));
+
+        if(Tick < Game->TickCount)
+        {
+            Current = SimulateTick(Current, UnpackReplayInputs(Inputs[Tick]));
+        }
+
+        if(Read - ReportTime >= EXPORT_REPORT_SECONDS*Frequency)
+        {
+            printf("  %u of %u frames\n", Frames, FrameCount);
+            ReportTime = Read;
+        }
+    }
+
+    bool Written = CloseFrameCapture(Capture);
+    double Elapsed = (double)(SDL_GetPerformanceCounter() - Start)/Frequency;
+
+    printf("%s %u frames in %.2fs: %.0f frames/s, %.1fx real time, %.1f MB\n", Written ? "Exported" : "Failed after",
+           Frames, Elapsed, Frames/Elapsed, Frames/Elapsed/FRAMERATE, Capture->Bytes.load()/(1024.0*1024.0));
+
+    if(Frames)
+    {
+        printf("  per frame: drawing %.2fms, readback %.2fms, writing %.2fms on one of %u threads; "
+               "waited for a free slot %u times (%.2fs)\n",
+               1000.0*DrawTime/Frequency/Frames, 1000.0*ReadTime/Frequency/Frames,
+               Capture->EncodeNanoseconds.load()/1e6/Frames, Capture->ThreadCount, Capture->Stalls,
+               Capture->StallNanoseconds/1e9);
+    }
+
+    DestroyGame(Current);
+    delete Capture;
+
+    SDL_SetRenderTarget(gRenderer, NULL);
+    SDL_DestroyTexture(Target);
+    CloseReplayArchive(&Archive);
+
+    return Written;
+}
+
+/*
+ * Frame Benchmark
+ *
+ * Plays one long game from a fixed seed to a script: the bot playing and
+ * clearing lines, pauses, a top out and the game over screen. It runs the
+ * game window's own simulation thread and render loop, with each phase of each
+ * frame timed from the tick that asked for it to the present.
+ *
+ * Three things keep it repeatable. The script gives the inputs for each tick
+ * by number, and its next input is one of the simulation's timers, so idle
+ * ticks are still fast forwarded. Ticks run on their own clock as fast as the
+ * simulation can go rather than at FRAMERATE. And every snapshot published
+ * waits to be presented before the next tick, so none are skipped. A seed
+ * always plays the same game and gives the same frames, draw calls and
+ * allocations, and only the times differ between builds.
+ *
+ * The summary written to a file is JSON, a field to a line, so two builds'
+ * summaries can be diffed as they are.
+ */
+
+static const FrameBenchStep FrameBenchScript[] = {
+    {"opening",     FRAME_BENCH_PLAY,       1200},
+    {"pause",       FRAME_BENCH_PAUSE,      150},
+    {"midgame",     FRAME_BENCH_PLAY,       1200},
+    {"pause again", FRAME_BENCH_PAUSE,      150},
+    {"top out",     FRAME_BENCH_TOP_OUT,    3000},
+    {"game over",   FRAME_BENCH_IDLE,       90}
+};
+
+static const char* FrameBenchPhaseNames[FRAME_PHASE_COUNT + 1] = {"simulate", "publish", "handoff", "draw", "present",
+                                                                   "frame"};
+
+InputState GetFrameBenchInputs(const FrameBenchStep* Step, unsigned int StepTick, GameData Game, BotWeights Weights)
+{
+    InputState Result;
+    memset(&Result, 0, sizeof(Result));
+
+    if( (Step->Action == FRAME_BENCH_PLAY) && (Game.State == RUNNING) )
+    {
+        Result = GetBotInputs(Game, Weights);
+    }
+    else if(Step->Action == FRAME_BENCH_PAUSE)
+    {
+        //Space restarts a game that's over, so only when it pauses
+        Result.Space = ((StepTick == 0) && (Game.State == RUNNING)) ||
+                       ((StepTick + 1 == Step->Ticks) && (Game.State == PAUSED));
+    }
+    else if(Step->Action == FRAME_BENCH_TOP_OUT)
+    {
+        Result.Down = (Game.State == RUNNING);
     }
 
     return Result;
 }
 
-Texture GetGlyph(char Character)
+//Moves the script on to the step Tick is in
+void AdvanceFrameBenchScript(FrameBench* Bench, unsigned long long Tick)
 {
-    Texture Result;
+    unsigned int StepCount = sizeof(FrameBenchScript)/sizeof(FrameBenchScript[0]);
 
-    if((Character >= 0x20) || (Character <= 0x7E))
+    while( (Bench->Step < StepCount) && (Tick >= Bench->StepEnd) )
+    {
+        Bench->Stats->Sections[Bench->Step].Ticks = (unsigned int)(Bench->StepEnd - Bench->StepStart);
+        Bench->Step++;
+        Bench->StepStart = Bench->StepEnd;
+
+        if(Bench->Step < StepCount)
+        {
+            Bench->StepEnd += FrameBenchScript[Bench->Step].Ticks;
+        }
+    }
+}
+
+InputState GetFrameBenchTickInputs(FrameBench* Bench, unsigned long long Tick, GameData Game)
+{
+    AdvanceFrameBenchScript(Bench, Tick);
+
+    return GetFrameBenchInputs(FrameBenchScript + Bench->Step, (unsigned int)(Tick - Bench->StepStart), Game,
+                               Bench->Weights);
+}
+
+//The next tick after Tick the script has to be woken for, TIMER_NONE once
+//it's over. Until the game moves the inputs only change with the step, so
+//with nothing to press the simulation only needs waking for the step's last
+//tick, if nothing else wakes it first.
+unsigned long long NextFrameBenchTick(FrameBench* Bench, unsigned long long Tick, GameData Game)
+{
+    unsigned int StepCount = sizeof(FrameBenchScript)/sizeof(FrameBenchScript[0]);
+
+    AdvanceFrameBenchScript(Bench, Tick + 1);
+
+    if(Bench->Step == StepCount)
+    {
+        return TIMER_NONE;
+    }
+
+    InputState Inputs = GetFrameBenchInputs(FrameBenchScript + Bench->Step, (unsigned int)(Tick + 1 - Bench->StepStart),
+                                            Game, Bench->Weights);
+
+    return PackReplayInputs(Inputs) ? Tick + 1 : Bench->StepEnd - 1;
+}
+
+//Called by the simulation after every tick it wakes for
+void RecordFrameBenchTick(FrameBench* Bench, unsigned long long Tick, GameState PreviousState, GameData Game,
+                          Uint64 TickTime, HeapCounters TickHeap)
+{
+    FrameBenchStats* Stats = Bench->Stats;
+    FrameBenchSection* Section = Stats->Sections + Bench->Step;
+
+    Stats->Ticks = (unsigned int)Tick;
+    Stats->Wakes++;
+    Stats->TickTime += TickTime;
+
+    if(PreviousState == RUNNING)
+    {
+        Stats->Lines += Game.LinesRemoved;
+        Section->Lines += Game.LinesRemoved;
+    }
+
+    if( (PreviousState == RUNNING) && (Game.State == RUNNING) )
+    {
+        Stats->SteadyTicks++;
+        Stats->AllocatingTicks += TickHeap.Allocations ? 1 : 0;
+    }
+
+    if(Game.State != INITIALISING)
+    {
+        Stats->Score = Game.Score;
+    }
+
+    if( (PreviousState != GAMEOVER) && (Game.State == GAMEOVER) )
+    {
+        Stats->GameOverTick = (unsigned int)Tick;
+
+        //Topping out ends as soon as it's done
+        if(FrameBenchScript[Bench->Step].Action == FRAME_BENCH_TOP_OUT)
+        {
+            Bench->StepEnd = Tick + 1;
+        }
+    }
+}
+
+//Called by the simulation with each snapshot it's about to publish
+void RecordFrameBenchPublish(FrameBench* Bench, const PublishedSnapshot* Slot, Uint64 TickStart, Uint64 Simulated)
+{
+    FrameBenchStats* Stats = Bench->Stats;
+    unsigned int Frame = Stats->Frames++;
+
+    Stats->Times[FRAME_PHASE_SIMULATE][Frame] = Simulated - TickStart;
+    Stats->Times[FRAME_PHASE_PUBLISH][Frame] = Slot->PublishTime - Simulated;
+    Stats->Sections[Bench->Step].Frames++;
+}
+
+//Called by the simulation once it has published a snapshot, returns when
+//the main thread has presented it or either side is quitting
+void WaitForFrameBenchFrame(SimulationData* Simulation, unsigned int Version)
+{
+    FrameBench* Bench = Simulation->Bench;
+
+    SDL_LockMutex(Simulation->Lock);
+
+    while( (SDL_AtomicGet(&Bench->Drawn) != (int)Version) && !SDL_AtomicGet(&Simulation->Quit) )
+    {
+        SDL_CondWait(Simulation->Wake, Simulation->Lock);
+    }
+
+    SDL_UnlockMutex(Simulation->Lock);
+
+    if(SDL_AtomicGet(&Bench->Drawn) == (int)Version)
+    {
+        Bench->Stats->Sections[Bench->Step].FrameTime += Bench->Stats->Times[FRAME_PHASE_COUNT][Version - 1];
+    }
+}
+
+//Called by the render loop with each frame it presents. The simulation is
+//waiting on it, so the frame's times can be filled in without a lock.
+void RecordFrameBenchFrame(SimulationData* Simulation, const PublishedSnapshot* Slot, Uint64 Loaded, Uint64 Drawn,
+                           Uint64 Presented)
+{
+    FrameBench* Bench = Simulation->Bench;
+    FrameBenchStats* Stats = Bench->Stats;
+    unsigned int Frame = Slot->Version - 1;
+
+    Stats->Times[FRAME_PHASE_HANDOFF][Frame] = Loaded - Slot->PublishTime;
+    Stats->Times[FRAME_PHASE_DRAW][Frame] = Drawn - Loaded;
+    Stats->Times[FRAME_PHASE_PRESENT][Frame] = Presented - Drawn;
+    Stats->Times[FRAME_PHASE_COUNT][Frame] = Stats->Times[FRAME_PHASE_SIMULATE][Frame] +
+                                             Stats->Times[FRAME_PHASE_PUBLISH][Frame] + (Presented - Slot->PublishTime);
+
+    Stats->DrawCalls += Accounting.LastFrame.DrawCalls;
+    Stats->MostDrawCalls = (Accounting.LastFrame.DrawCalls > Stats->MostDrawCalls) ? Accounting.LastFrame.DrawCalls
+                                                                                   : Stats->MostDrawCalls;
+    Stats->TextureUploads += Accounting.LastFrame.TextureUploads;
+
+    SDL_AtomicSet(&Bench->Drawn, (int)Slot->Version);
+
+    SDL_LockMutex(Simulation->Lock);
+    SDL_CondSignal(Simulation->Wake);
+    SDL_UnlockMutex(Simulation->Lock);
+}
+
+int CompareFrameTimes(const void* A, const void* B)
+{
+    Uint64 X = *(const Uint64*)A;
+    Uint64 Y = *(const Uint64*)B;
+
+    return (X > Y) - (X < Y);
+}
+
+void ReportFrameBench(FrameBenchStats* Stats, unsigned int Seed, double Elapsed, FILE* Summary)
+{
+    double ToUs = 1e6/(double)SDL_GetPerformanceFrequency();
+    unsigned int StepCount = sizeof(FrameBenchScript)/sizeof(FrameBenchScript[0]);
+
+    printf("Frame bench: seed %u, %u ticks (%u woken for) and %u frames in %.2fs, score %u, %u lines, "
+           "game over on tick %u\n", Seed, Stats->Ticks, Stats->Wakes, Stats->Frames, Elapsed, Stats->Score,
+           Stats->Lines, Stats->GameOverTick);
+
+    if(Summary)
+    {
+        fprintf(Summary, "{\n");
+        fprintf(Summary, "  \"seed\": %u,\n", Seed);
+        fprintf(Summary, "  \"ticks\": %u,\n", Stats->Ticks);
+        fprintf(Summary, "  \"woken_ticks\": %u,\n", Stats->Wakes);
+        fprintf(Summary, "  \"frames\": %u,\n", Stats->Frames);
+        fprintf(Summary, "  \"score\": %u,\n", Stats->Score);
+        fprintf(Summary, "  \"lines\": %u,\n", Stats->Lines);
+        fprintf(Summary, "  \"game_over_tick\": %u,\n", Stats->GameOverTick);
+        fprintf(Summary, "  \"seconds\": %.3f,\n", Elapsed);
+        fprintf(Summary, "  \"tick_mean_us\": %.2f,\n", Stats->Wakes ? Stats->TickTime*ToUs/Stats->Wakes : 0.0);
+    }
+
+    //Sorted in place, the order frames came in isn't needed any more
+    for(unsigned int Phase = 0; (Phase <= FRAME_PHASE_COUNT) && Stats->Frames; ++Phase)
+    {
+        Uint64* Sorted = Stats->Times[Phase];
+        qsort(Sorted, Stats->Frames, sizeof(Uint64), CompareFrameTimes);
+
+        Uint64 Total = 0;
+
+        for(unsigned int Frame = 0; Frame < Stats->Frames; ++Frame)
+        {
+            Total += Sorted[Frame];
+        }
+
+        unsigned int Last = Stats->Frames - 1;
+        double Mean = Total*ToUs/Stats->Frames;
+        double P50 = Sorted[Last/2]*ToUs;
+        double P90 = Sorted[(unsigned long long)Last*90/100]*ToUs;
+        double P99 = Sorted[(unsigned long long)Last*99/100]*ToUs;
+        double P999 = Sorted[(unsigned long long)Last*999/1000]*ToUs;
+        double Max = Sorted[Last]*ToUs;
+
+        printf("  %-8s mean %8.1fus  p50 %8.1fus  p90 %8.1fus  p99 %8.1fus  p99.9 %8.1fus  max %8.1fus\n",
+               FrameBenchPhaseNames[Phase], Mean, P50, P90, P99, P999, Max);
+
+        if(Summary)
+        {
+            fprintf(Summary, "  \"%s_us\": {\"mean\": %.1f, \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, "
+                    "\"p99.9\": %.1f, \"max\": %.1f},\n", FrameBenchPhaseNames[Phase], Mean, P50, P90, P99, P999, Max);
+        }
+    }
+
+    printf("  draw calls %.1f a frame (most %u), %llu texture uploads, %llu textures created\n",
+           Stats->Frames ? (double)Stats->DrawCalls/Stats->Frames : 0.0, Stats->MostDrawCalls, Stats->TextureUploads,
+           Stats->TextureCreations);
+    printf("  %llu allocations (%llu bytes); %llu of %llu steady frames and %llu of %llu steady ticks allocated\n",
+           Stats->Heap.Allocations, Stats->Heap.Bytes, Stats->AllocatingFrames, Stats->SteadyFrames,
+           Stats->AllocatingTicks, Stats->SteadyTicks);
+
+    for(unsigned int Step = 0; Step < StepCount; ++Step)
+    {
+        FrameBenchSection* Section = Stats->Sections + Step;
+
+        printf("  %-12s %5u ticks %5u frames, mean frame %8.1fus, %3u lines\n", FrameBenchScript[Step].Name,
+               Section->Ticks, Section->Frames, Section->Frames ? Section->FrameTime*ToUs/Section->Frames : 0.0,
+               Section->Lines);
+    }
+
+    if(Summary)
+    {
+        fprintf(Summary, "  \"draw_calls\": %llu,\n", Stats->DrawCalls);
+        fprintf(Summary, "  \"most_draw_calls\": %u,\n", Stats->MostDrawCalls);
+        fprintf(Summary, "  \"texture_uploads\": %llu,\n", Stats->TextureUploads);
+        fprintf(Summary, "  \"texture_creations\": %llu,\n", Stats->TextureCreations);
+        fprintf(Summary, "  \"allocations\": %llu,\n", Stats->Heap.Allocations);
+        fprintf(Summary, "  \"allocated_bytes\": %llu,\n", Stats->Heap.Bytes);
+        fprintf(Summary, "  \"steady_frames\": %llu,\n", Stats->SteadyFrames);
+        fprintf(Summary, "  \"allocating_frames\": %llu,\n", Stats->AllocatingFrames);
+        fprintf(Summary, "  \"steady_ticks\": %llu,\n", Stats->SteadyTicks);
+        fprintf(Summary, "  \"allocating_ticks\": %llu,\n", Stats->AllocatingTicks);
+        fprintf(Summary, "  \"sections\": [\n");
+
+        for(unsigned int Step = 0; Step < StepCount; ++Step)
+        {
+            FrameBenchSection* Section = Stats->Sections + Step;
+
+            fprintf(Summary, "    {\"name\": \"%s\", \"ticks\": %u, \"frames\": %u, \"frame_mean_us\": %.1f, \"lines\": %u}%s\n",
+                    FrameBenchScript[Step].Name, Section->Ticks, Section->Frames,
+                    Section->Frames ? Section->FrameTime*ToUs/Section->Frames : 0.0, Section->Lines,
+                    (Step + 1 < StepCount) ? "," : "");
+        }
+
+        fprintf(Summary, "  ]\n}\n");
+    }
+}
+
+bool RunFrameBench(unsigned int Seed, const char* SummaryPath)
+{
+    unsigned int StepCount = sizeof(FrameBenchScript)/sizeof(FrameBenchScript[0]);
+    unsigned int MaxTicks = 0;
+
+    for(unsigned int Step = 0; Step < StepCount; ++Step)
+    {
+        MaxTicks += FrameBenchScript[Step].Ticks;
+    }
+
+    FILE* Summary = NULL;
+
+    if(SummaryPath)
+    {
+        Summary = fopen(SummaryPath, "w");
+
+        if(Summary == NULL)
+        {
+            printf("Could not open %s for the benchmark summary!\n", SummaryPath);
+            return false;
+        }
+    }
+
+    //Everything's allocated up front, so the run's own allocations are the
+    //game's and the renderer's
+    FrameBenchStats* Stats = (FrameBenchStats*)HeapAllocate(sizeof(FrameBenchStats));
+    FrameBench* Bench = (FrameBench*)HeapAllocate(sizeof(FrameBench));
+    SimulationData* Simulation = (SimulationData*)HeapAllocate(sizeof(SimulationData));
+    bool Allocated = (Stats != NULL) && (Bench != NULL) && (Simulation != NULL);
+
+    if(Stats)
+    {
+        memset(Stats, 0, sizeof(*Stats));
+
+        for(unsigned int Phase = 0; Phase <= FRAME_PHASE_COUNT; ++Phase)
+        {
+            Stats->Times[Phase] = (Uint64*)HeapAllocate(MaxTicks*sizeof(Uint64));
+            Allocated = Allocated && (Stats->Times[Phase] != NULL);
+        }
+    }
+
+    if(!Allocated)
+    {
+        printf("Could not allocate the benchmark's frame times!\n");
+    }
+
+    bool Finished = false;
+
+    if(Allocated)
+    {
+        //Ticks count from 1, the first starting the game
+        Bench->Stats = Stats;
+        Bench->Weights = DefaultBotWeights();
+        Bench->Step = 0;
+        Bench->StepStart = 1;
+        Bench->StepEnd = 1 + FrameBenchScript[0].Ticks;
+        Bench->Finished = false;
+        SDL_AtomicSet(&Bench->Drawn, 0);
+
+        //Set up as the game window's is, without recording or broadcasting
+        InitialiseSnapshotBuffer(&Simulation->Snapshots);
+        SDL_AtomicSet(&Simulation->Inputs, 0);
+        SDL_AtomicSet(&Simulation->Quit, 0);
+        Simulation->Lock = SDL_CreateMutex();
+        Simulation->Wake = SDL_CreateCond();
+        Simulation->SnapshotEvent = SDL_RegisterEvents(1);
+        Simulation->Seed = Seed;
+        Simulation->Broadcast = NULL;
+        Simulation->Recorder = NULL;
+        Simulation->Scores = NULL;
+        SDL_AtomicSet(&Simulation->TickAllocations, 0);
+        SDL_AtomicSet(&Simulation->AllocatingTicks, 0);
+        Simulation->CheckAllocations = false;
+        Simulation->Bench = Bench;
+
+        SDL_Thread* SimulationThread = NULL;
+
+        if( (Simulation->Lock == NULL) || (Simulation->Wake == NULL) || (Simulation->SnapshotEvent == (Uint32)-1) )
+        {
+            printf( "Simulation could not be set up! SDL Error: %s\n", SDL_GetError() );
+        }
+        else
+        {
+            SimulationThread = SDL_CreateThread(RunSimulation, "Simulation", Simulation);
+
+            if(SimulationThread == NULL)
+            {
+                printf( "Simulation thread could not be created! SDL Error: %s\n", SDL_GetError() );
+            }
+        }
+
+        if(SimulationThread)
+        {
+            HeapCounters RenderHeap = GetHeapCounters();
+            Uint64 Start = SDL_GetPerformanceCounter();
+
+            RenderLoop(Simulation);
+
+            StopSimulation(Simulation);
+            SDL_WaitThread(SimulationThread, NULL);
+
+            double Elapsed = (double)(SDL_GetPerformanceCounter() - Start)/SDL_GetPerformanceFrequency();
+
+            RenderHeap = GetHeapCountersSince(RenderHeap);
+            Finished = Bench->Finished;
+
+            //Counted by the render loop as it does for the overlay
+            Stats->TextureCreations = Accounting.TextureCreations;
+            Stats->SteadyFrames = Accounting.SteadyFrames;
+            Stats->AllocatingFrames = Accounting.AllocatingFrames;
+
+            Stats->Heap.Allocations = RenderHeap.Allocations + Bench->SimulationHeap.Allocations;
+            Stats->Heap.Frees = RenderHeap.Frees + Bench->SimulationHeap.Frees;
+            Stats->Heap.Bytes = RenderHeap.Bytes + Bench->SimulationHeap.Bytes;
+
+            if(Finished)
+            {
+                ReportFrameBench(Stats, Seed, Elapsed, Summary);
+            }
+            else
+            {
+                printf("The frame benchmark was stopped before the end of its script\n");
+            }
+        }
+
+        SDL_DestroyCond(Simulation->Wake);
+        SDL_DestroyMutex(Simulation->Lock);
+    }
+
+    if(Summary)
+    {
+        fclose(Summary);
+    }
+
+    if(Stats)
+    {
+        for(unsigned int Phase = 0; Phase <= FRAME_PHASE_COUNT; ++Phase)
+        {
+            HeapFree(Stats->Times[Phase]);
+        }
+    }
+
+    HeapFree(Simulation);
+    HeapFree(Bench);
+    HeapFree(Stats);
+
+    return Finished;
+}
+
+/*
+ * Platform Operations
+ */
+
+//SDL's own allocations, counted along with the game's
+void* SDLCALL CountSDLMalloc(size_t Size)
+{
+    return HeapAllocate(Size);
+}
+
+void* SDLCALL CountSDLCalloc(size_t Count, size_t Size)
+{
+    if( Size && (Count > ((size_t)-1)/Size) )
     {
-        Result = Glyphs.Textures[Character - 0x20];
+        return NULL;
     }
-    else
+
+    void* Result = HeapAllocate(Count*Size);
+
+    if(Result)
     {
-        Result = Glyphs.Textures['X' - 0x20];
+        memset(Result, 0, Count*Size);
     }
+
     return Result;
 }
 
-void close()
+void* SDLCALL CountSDLRealloc(void* Memory, size_t Size)
 {
-    //Free global text
-    TTF_CloseFont(gFont);
-    gFont=NULL;
-
-    //Destroy window	
-    SDL_DestroyRenderer( gRenderer );
-    SDL_DestroyWindow( gWindow );
-    gWindow = NULL;
-    gRenderer = NULL;
-
-    //Quit SDL subsystems
-    SDL_Quit();
-    TTF_Quit();
+    return HeapReallocate(Memory, Size);
 }
 
-void DrawRect(int X, int Y, int Width, int Height, unsigned char Red, unsigned char Green, unsigned char Blue, unsigned char Alpha)
+void SDLCALL CountSDLFree(void* Memory)
 {
-    SDL_SetRenderDrawColor( gRenderer, Red, Green, Blue, Alpha);
-    SDL_Rect Rect = {X, Y, Width, Height};
-    SDL_SetRenderDrawBlendMode( gRenderer, SDL_BLENDMODE_BLEND);
-    SDL_RenderFillRect( gRenderer, &Rect );
+    HeapFree(Memory);
 }
 
-bool LoadGlyphToTexture(char Glyph, SDL_Color TextColor, Texture* Result)
+bool init(Uint32 WindowFlags, Uint32 RendererFlags)
 {
-    if(!Result)
+    //Initialization flag
+    bool success = true;
+
+#if SDL_VERSION_ATLEAST(2, 0, 7)
+    //Has to happen before SDL allocates anything
+    SDL_SetMemoryFunctions(CountSDLMalloc, CountSDLCalloc, CountSDLRealloc, CountSDLFree);
+#endif
+
+    PlatformArena = GenerateArena(PLATFORM_ARENA_SIZE);
+    FrameArena = GenerateArena(FRAME_ARENA_SIZE);
+
+    if( (PlatformArena.Base == NULL) || (FrameArena.Base == NULL) )
     {
-        printf("Null pointer!\n");
-        return false;
+        printf( "Could not allocate platform memory!\n" );
+        success = false;
     }
 
-    SDL_Surface* textSurface = TTF_RenderGlyph_Blended( gFont, Glyph, TextColor);
-
-    if(!textSurface)
+    //Initialize SDL
+    if( SDL_Init( SDL_INIT_VIDEO ) < 0 )
     {
-        printf("Unable to render text surface!\n");
+        printf( "SDL could not initialize! SDL Error: %s\n", SDL_GetError() );
+        success = false;
     }
     else
     {
-        Result->Data = SDL_CreateTextureFromSurface(gRenderer, textSurface);
-
-        if(Result->Data == NULL)
+        //Create window
+        gWindow = SDL_CreateWindow( "A Game About Falling Blocks", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, WindowFlags );
+        if( gWindow == NULL )
         {
-            printf("Unable to create texture from rendered surface!\n");
+            printf( "Window could not be created! SDL Error: %s\n", SDL_GetError() );
+            success = false;
         }
         else
         {
-            Result->Width = textSurface->w;
-            Result->Height = textSurface->h;
-        }        
+            //Create renderer for window
+            gRenderer = SDL_CreateRenderer( gWindow, -1, RendererFlags );
+            if( gRenderer == NULL )
+            {
+                printf( "Renderer could not be created! SDL Error: %s\n", SDL_GetError() );
+                success = false;
+            }
+            else
+            {
+                //Initialize renderer color
+                SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
 
-        SDL_FreeSurface( textSurface);
+                if(TTF_Init() == -1)
+                {
+                    success = false;
+                }
+            }
+        }
     }
 
-    return Result->Data != NULL;
+    MarkStartupPhase("init");
+
+    return success;
 }
 
-bool loadFromRenderedText(const char* String, SDL_Color TextColor, Texture* Result)
+bool loadMedia()
 {
-    if(!Result)
+    const char* FontPath = getenv("AGAFB_FONT");
+
+    if(FontPath == NULL)
     {
-        printf("Null pointer!\n");
-        return false;
+        FontPath = DEFAULT_FONT_PATH;
     }
 
-    SDL_Surface* textSurface = TTF_RenderText_Blended( gFont, String, TextColor);
+    Glyphs = LoadFontTextures(FontPath);
+    InitialiseBoardPalette();
 
-    if(!textSurface)
+    return Glyphs.Initialised;
+}
+
+//Loads the glyph atlas from the cache, or rasterises it with TTF and caches
+//it for next time
+TextureArray LoadFontTextures(const char* FontPath)
+{
+    TextureArray Result = GenerateTextureArray(&PlatformArena, GLYPH_COUNT);
+
+    if(Result.Length != GLYPH_COUNT)
     {
-        printf("Unable to render text surface!\n");
+        return Result;
     }
-    else
+
+    unsigned long long Key = GlyphCacheKey(FontPath, FONT_POINT_SIZE);
+    char CachePath[GLYPH_CACHE_PATH_MAX];
+    bool Cacheable = (Key != 0) && GlyphCachePath(Key, CachePath, sizeof(CachePath));
+
+    MarkStartupPhase("font hash");
+
+    GlyphCache Cache;
+    memset(&Cache, 0, sizeof(Cache));
+
+    if(Cacheable)
     {
-        Result->Data = SDL_CreateTextureFromSurface(gRenderer, textSurface);
+        Cache = OpenGlyphCache(CachePath, Key);
+    }
 
-        if(Result->Data == NULL)
-        {
-            printf("Unable to create texture from rendered surface!\n");
-        }
-        else
-        {
-            Result->Width = textSurface->w;
-            Result->Height = textSurface->h;
-        }        
+    if( Cache.Valid && (Cache.Header->FirstGlyph == GLYPH_FIRST) && (Cache.Header->GlyphCount == GLYPH_COUNT) &&
+        (Cache.Header->PixelFormat == SDL_PIXELFORMAT_ARGB8888) )
+    {
+        MarkStartupPhase("atlas cache hit");
 
-        SDL_FreeSurface( textSurface);
+        Result = UploadGlyphAtlas(Result, Cache.Header, Cache.Entries, Cache.Pixels, 4*Cache.Header->Width);
+        MarkStartupPhase("atlas upload");
+
+        CloseGlyphCache(Cache);
+        return Result;
     }
 
-    return Result->Data != NULL;
-}
+    CloseGlyphCache(Cache);
+    MarkStartupPhase("atlas cache miss");
 
-Texture GenerateTexture()
-{
-    Texture Result;
+    GlyphCacheEntry Entries[GLYPH_COUNT];
+    SDL_Surface* Atlas = RasteriseGlyphAtlas(FontPath, Entries);
 
-    Result.Data = NULL;
-    Result.Width = 0;
-    Result.Height = 0;
+    if(Atlas == NULL)
+    {
+        return Result;
+    }
+
+    MarkStartupPhase("rasterise");
+
+    GlyphCacheHeader Header;
+    memset(&Header, 0, sizeof(Header));
+
+    Header.Magic        = GLYPH_CACHE_MAGIC;
+    Header.Version      = GLYPH_CACHE_VERSION;
+    Header.Key          = Key;
+    Header.FirstGlyph   = GLYPH_FIRST;
+    Header.GlyphCount   = GLYPH_COUNT;
+    Header.Width        = Atlas->w;
+    Header.Height       = Atlas->h;
+    Header.PixelFormat  = SDL_PIXELFORMAT_ARGB8888;
+
+    Result = UploadGlyphAtlas(Result, &Header, Entries, Atlas->pixels, Atlas->pitch);
+    MarkStartupPhase("atlas upload");
+
+    if(Cacheable && Result.Initialised)
+    {
+        WriteGlyphCache(CachePath, &Header, Entries, (const unsigned char*)Atlas->pixels, Atlas->pitch);
+        MarkStartupPhase("cache write");
+    }
+
+    SDL_FreeSurface(Atlas);
 
     return Result;
 }
-void DestroyTexture(Texture TextureToKill)
-{
-    //free(TextureToKill.Data);
-    SDL_DestroyTexture(TextureToKill.Data);
-}
 
-TextureArray GenerateTextureArray(unsigned int Length)
+//Renders every glyph and packs them left to right in rows into one
+//ARGB8888 surface, returns NULL on failure
+SDL_Surface* RasteriseGlyphAtlas(const char* FontPath, GlyphCacheEntry* Entries)
 {
-    TextureArray Result;
+    if(gFont == NULL)
+    {
+        gFont = TTF_OpenFont(FontPath, FONT_POINT_SIZE);
+    }
 
-    Result.Length = Length;
-    Result.Initialised = false;
+    if(gFont == NULL)
+    {
+        printf( "Unable to open font \"%s\"! TTF Error: %s\n", FontPath, TTF_GetError() );
+        return NULL;
+    }
 
-    Result.Textures = (Texture*)(malloc(sizeof(Texture)*Length));
+    SDL_Color TextColor = {255,255,255};
+    SDL_Surface* GlyphSurfaces[GLYPH_COUNT];
+    bool success = true;
 
-    unsigned int Count = 0;
-    Texture* CurrentTexture = Result.Textures;
+    unsigned int X = 0;
+    unsigned int Y = 0;
+    unsigned int RowHeight = 0;
 
-    while(Count < Result.Length)
+    for(unsigned int Index = 0; Index < GLYPH_COUNT; ++Index)
     {
-        *CurrentTexture = GenerateTexture();
+        unsigned int Char = GLYPH_FIRST + Index;
+        GlyphSurfaces[Index] = TTF_RenderGlyph_Blended(gFont, (Uint16)Char, TextColor);
 
-        ++Count;
-        ++CurrentTexture;
+        if( (GlyphSurfaces[Index] == NULL) || (GlyphSurfaces[Index]->w > GLYPH_ATLAS_WIDTH) )
+        {
+            printf( "Failed to load texture for '%c'!\n", Char );
+            success = false;
+            continue;
+        }
+
+        unsigned int Width = GlyphSurfaces[Index]->w;
+        unsigned int Height = GlyphSurfaces[Index]->h;
+
+        if(X + Width > GLYPH_ATLAS_WIDTH)
+        {
+            X = 0;
+            Y += RowHeight;
+            RowHeight = 0;
+        }
+
+        Entries[Index].X        = (unsigned short)X;
+        Entries[Index].Y        = (unsigned short)Y;
+        Entries[Index].Width    = (unsigned short)Width;
+        Entries[Index].Height   = (unsigned short)Height;
+
+        X += Width;
+        RowHeight = (Height > RowHeight) ? Height : RowHeight;
     }
 
-    return Result;
-}
+    SDL_Surface* Atlas = NULL;
 
-void DestroyTextureArray(TextureArray ArrayToKill)
-{
-    for(unsigned int Index = 0; Index < ArrayToKill.Length; ++Index)
+    if(success)
     {
-        DestroyTexture(ArrayToKill.Textures[Index]);
+        //New surfaces start out zeroed, i.e. fully transparent
+        Atlas = SDL_CreateRGBSurfaceWithFormat(0, GLYPH_ATLAS_WIDTH, Y + RowHeight, 32, SDL_PIXELFORMAT_ARGB8888);
+
+        if(Atlas == NULL)
+        {
+            printf( "Unable to create glyph atlas! SDL Error: %s\n", SDL_GetError() );
+        }
     }
 
-    free(ArrayToKill.Textures);
-}
+    for(unsigned int Index = 0; Index < GLYPH_COUNT; ++Index)
+    {
+        if(GlyphSurfaces[Index] == NULL)
+        {
+            continue;
+        }
 
-GameData HandleInputGame(InputState Inputs, GameData Current)
-{
-    GameData Result = Current;
+        if(Atlas)
+        {
+            //Copy the glyph's alpha as is rather than blending it onto black
+            SDL_Rect Destination = {Entries[Index].X, Entries[Index].Y, Entries[Index].Width, Entries[Index].Height};
+            SDL_SetSurfaceBlendMode(GlyphSurfaces[Index], SDL_BLENDMODE_NONE);
+            SDL_BlitSurface(GlyphSurfaces[Index], NULL, Atlas, &Destination);
+        }
 
-    Result.MoveLeft = Inputs.Left;
-    Result.MoveRight = Inputs.Right;
-    Result.MoveDown = Inputs.Down;
-    Result.Rotate = Inputs.Up;
-    Result.Pause = Inputs.Space;
+        SDL_FreeSurface(GlyphSurfaces[Index]);
+    }
 
-    return Result;
+    return Atlas;
 }
 
-GameData HandleInputPaused(InputState Inputs, GameData Current)
+//One texture for the whole atlas, each glyph becomes a region of it
+TextureArray UploadGlyphAtlas(TextureArray Array, const GlyphCacheHeader* Header, const GlyphCacheEntry* Entries,
+                              const void* Pixels, unsigned int Pitch)
 {
-    GameData Result = Current;
+    TextureArray Result = Array;
 
-    Result.Pause = Inputs.Space;
+    Result.Atlas = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC,
+                                     Header->Width, Header->Height);
+    Accounting.Frame.TextureCreations++;
 
-    return Result;
-}
+    if( (Result.Atlas == NULL) || (SDL_UpdateTexture(Result.Atlas, NULL, Pixels, Pitch) != 0) )
+    {
+        printf( "Unable to create glyph atlas texture! SDL Error: %s\n", SDL_GetError() );
+        return Result;
+    }
 
-GameData HandleInputGameOver(InputState Inputs, GameData Current)
-{
-    GameData Result = Current;
+    SDL_SetTextureBlendMode(Result.Atlas, SDL_BLENDMODE_BLEND);
+
+    for(unsigned int Index = 0; Index < Result.Length; ++Index)
+    {
+        Result.Textures[Index].Data     = Result.Atlas;
+        Result.Textures[Index].SourceX  = Entries[Index].X;
+        Result.Textures[Index].SourceY  = Entries[Index].Y;
+        Result.Textures[Index].Width    = Entries[Index].Width;
+        Result.Textures[Index].Height   = Entries[Index].Height;
+    }
 
-    Result.Restart = Inputs.Space;
-    Result.Quit = Inputs.Escape;
+    Result.Initialised = true;
 
     return Result;
 }
 
-GameData UpdateGame(GameData Current)
+Texture GetGlyph(char Character)
 {
-    GameData Result = Current;
+    Texture Result;
 
-    //Drop Tetro if necessary
-    if(Result.FallingTimer == 0)
+    if((Character >= 0x20) || (Character <= 0x7E))
     {
-        Result.MoveDown = 1;
-        Result.FallingTimer = FALL_FRAMES;
+        Result = Glyphs.Textures[Character - 0x20];
     }
     else
     {
-        Result.FallingTimer--;
+        Result = Glyphs.Textures['X' - 0x20];
+    }
+    return Result;
+}
+
+void close()
+{
+    //Free global text
+    if(gFont)
+    {
+        TTF_CloseFont(gFont);
+        gFont=NULL;
     }
 
-    //Move Tetro if necessary
-    if(Result.MoveLeft)
+    if(Board.Data)
     {
-        //Duplicate Tetromino
-        Tetromino NewTetro = Result.FallingTetro;
+        SDL_DestroyTexture(Board.Data);
+        Board.Data = NULL;
+    }
 
-        NewTetro.Col--;
+    //Destroy window	
+    SDL_DestroyRenderer( gRenderer );
+    SDL_DestroyWindow( gWindow );
+    gWindow = NULL;
+    gRenderer = NULL;
 
-        if(!CheckCollisions(Result.MainGrid, NewTetro))
-        {
-            Result.FallingTetro = NewTetro;
-            Result.Redraw = 1;
-        }
+    //Quit SDL subsystems
+    SDL_Quit();
+    TTF_Quit();
 
-        Result.MoveLeft = 0;
-    }
+    DestroyArena(FrameArena);
+    DestroyArena(PlatformArena);
+}
+
+void MarkStartupPhase(const char* Name)
+{
+    Uint64 Now = SDL_GetPerformanceCounter();
 
-    if(Result.MoveRight)
+    if(Startup.Count < STARTUP_MAX_PHASES)
     {
-        //Duplicate Tetromino
-        Tetromino NewTetro = Result.FallingTetro;
+        Startup.Names[Startup.Count] = Name;
+        Startup.Times[Startup.Count] = Now - Startup.Last;
+        ++Startup.Count;
+    }
 
-        NewTetro.Col++;
+    Startup.Last = Now;
+}
 
-        if(!CheckCollisions(Result.MainGrid, NewTetro))
-        {
-            Result.FallingTetro = NewTetro;
-            Result.Redraw = 1;
-        }
+void ReportStartupTimes()
+{
+    double ToMs = 1000.0/(double)SDL_GetPerformanceFrequency();
 
-        Result.MoveRight = 0;
-    }
+    printf("Startup:");
 
-    if(Result.MoveDown)
+    for(unsigned int Index = 0; Index < Startup.Count; ++Index)
     {
-        //Duplicate Tetromino
-        Tetromino NewTetro = Result.FallingTetro;
+        printf(" %s %.2fms,", Startup.Names[Index], Startup.Times[Index]*ToMs);
+    }
 
-        NewTetro.Row++;
-        //Check for collisions
-        if(CheckCollisions(Result.MainGrid, NewTetro))
-        {
-            StoreTetromino(Result.MainGrid, Result.FallingTetro);
-            DestroyTetromino(Result.FallingTetro);
-            Result.FallingTetro = Result.NextTetro;
+    printf(" total %.2fms\n", (Startup.Last - Startup.Start)*ToMs);
+
+    Startup.Reported = true;
+}
+
+void DrawRect(int X, int Y, int Width, int Height, unsigned char Red, unsigned char Green, unsigned char Blue, unsigned char Alpha)
+{
+    SDL_SetRenderDrawColor( gRenderer, Red, Green, Blue, Alpha);
+    SDL_Rect Rect = {X, Y, Width, Height};
+    SDL_SetRenderDrawBlendMode( gRenderer, SDL_BLENDMODE_BLEND);
+    SDL_RenderFillRect( gRenderer, &Rect );
+    Accounting.Frame.DrawCalls++;
+}
+
+bool loadFromRenderedText(const char* String, SDL_Color TextColor, Texture* Result)
+{
+    if(!Result)
+    {
+        printf("Null pointer!\n");
+        return false;
+    }
 
-            Result.NextTetro    = GenerateTetromino();
-            Result.NextTetro.Col = 1;
-            Result.NextTetro.Row = 1;
+    SDL_Surface* textSurface = TTF_RenderText_Blended( gFont, String, TextColor);
 
+    if(!textSurface)
+    {
+        printf("Unable to render text surface!\n");
+    }
+    else
+    {
+        Result->Data = SDL_CreateTextureFromSurface(gRenderer, textSurface);
+        Accounting.Frame.TextureCreations++;
 
-            Result.FallingTimer = FALL_FRAMES;
+        if(Result->Data == NULL)
+        {
+            printf("Unable to create texture from rendered surface!\n");
         }
         else
         {
-            Result.FallingTetro = NewTetro;
-        }
+            Result->Width = textSurface->w;
+            Result->Height = textSurface->h;
+        }        
 
-        Result.Redraw = 1;
-        Result.MoveDown = 0;
+        SDL_FreeSurface( textSurface);
     }
 
-    if(Result.Rotate)
-    {
-        if(Result.FallingTetro.Type != O_SHAPE)
-        {
-            //Duplicate Tetromino
-            Tetromino NewTetro = RotateTetroClockwise(Result.FallingTetro);
+    return Result->Data != NULL;
+}
 
-            if(!CheckCollisions(Result.MainGrid, NewTetro))
-            {
-                DestroyTetromino(Result.FallingTetro);
-                Result.FallingTetro = NewTetro;
-                Result.Redraw = 1;
-            }
-            else
-            {
-                DestroyTetromino(NewTetro);
-            }
+Texture GenerateTexture()
+{
+    Texture Result;
 
-        }
-        Result.Rotate = 0;
-    }
+    Result.Data = NULL;
+    Result.Width = 0;
+    Result.Height = 0;
+    Result.SourceX = 0;
+    Result.SourceY = 0;
 
-    // Final check for collisons - quit game if any are found
-    if(CheckCollisions(Result.MainGrid, Result.FallingTetro))
-    {
-        Result.State = GAMEOVER;
-        Result.Redraw = 1;
-    }
+    return Result;
+}
+void DestroyTexture(Texture TextureToKill)
+{
+    //free(TextureToKill.Data);
+    SDL_DestroyTexture(TextureToKill.Data);
+}
 
-    //Remove any lines in the grid
-    unsigned int LinesRemoved = RemoveGridLines(Result.MainGrid);
+TextureArray GenerateTextureArray(MemoryArena* Arena, unsigned int Length)
+{
+    TextureArray Result;
 
-    if(LinesRemoved)
-    {
-        Result.RenderScore = 1;
-    }
+    Result.Length = Length;
+    Result.Initialised = false;
+    Result.Atlas = NULL;
 
-    switch(LinesRemoved)
-    {
-        case 1:
-            Result.Score+=1;
-            break;
-        case 2:
-            Result.Score+=4;
-            break;
-        case 3:
-            Result.Score+=8;
-            break;
-        case 4:
-            Result.Score+=16;
-            break;
-        default:
-            break;
-    }
+    Result.Textures = PushArray(Arena, Texture, Length);
 
-    if(Result.Pause)
+    if(Result.Textures == NULL)
     {
-        Result.State = PAUSED;
-        Result.Pause = 0;
-        Result.Redraw = 1;
+        Result.Length = 0;
     }
 
-    return Result;
-}
-
-GameData UpdatePaused(GameData Current)
-{
-    GameData Result = Current;
+    unsigned int Count = 0;
+    Texture* CurrentTexture = Result.Textures;
 
-    if(Result.Pause)
+    while(Count < Result.Length)
     {
-        Result.State = RUNNING;
-        Result.Pause = 0;
-        Result.Redraw = 0;
+        *CurrentTexture = GenerateTexture();
+
+        ++Count;
+        ++CurrentTexture;
     }
 
     return Result;
 }
 
-GameData UpdateGameOver(GameData Current)
+void DestroyTextureArray(TextureArray ArrayToKill)
 {
-    GameData Result = Current;
-
-    if(Result.Restart)
+    //The textures are all regions of the atlas
+    if(ArrayToKill.Atlas)
     {
-        //Clean up game
-        DestroyTetromino(Result.FallingTetro);
-        DestroyGrid(Result.MainGrid);
+        SDL_DestroyTexture(ArrayToKill.Atlas);
+        return;
+    }
 
-        Result.State = INITIALISING;
-        Result.Restart = 0;
-        Result.Redraw = 0;
+    for(unsigned int Index = 0; Index < ArrayToKill.Length; ++Index)
+    {
+        DestroyTexture(ArrayToKill.Textures[Index]);
     }
 
-    return Result;
+    //The array itself goes with its arena
 }
 
+//Draws the game as it is on the full screen: the grid in the middle third, the
+//preview and score in the right third. Clearing and presenting are up to the
+//caller.
 GameData DrawGame(GameData Current)
 {
     GameData Result = Current;
 
-    //Clear screen
-    SDL_SetRenderDrawColor( gRenderer, 0, 0, 0, 0 );
-    SDL_RenderClear( gRenderer );
-
-    float BlockWidth = (float)GRID_WIDTH/(float)Result.MainGrid.Cols;
-    float BlockHeight = (float)GRID_HEIGHT/(float)Result.MainGrid.Rows;
+    float GridX = GRID_X;
+    float GridY = GRID_Y;
+    float GridWidth = GRID_WIDTH;
+    float GridHeight = GRID_HEIGHT;
 
-    // Draw Grid Background
-    DrawRect(GRID_X, GRID_Y, GRID_WIDTH, GRID_HEIGHT, 0x55, 0x55, 0x55, 0xFF);
+    float PreviewX = PREVIEW_X;
+    float PreviewY = PREVIEW_Y;
 
-    //Draw Grid
-    DrawGrid(Result.MainGrid, GRID_X, GRID_Y, GRID_WIDTH, GRID_HEIGHT);
+    float BlockWidth = GridWidth/(float)Result.MainGrid.Cols;
+    float BlockHeight = GridHeight/(float)Result.MainGrid.Rows;
 
-    //Draw Tetromino
-    DrawGrid(Result.FallingTetro.Grid,
-            GRID_X+Result.FallingTetro.Col*BlockWidth,
-            GRID_Y+Result.FallingTetro.Row*BlockHeight,
-            Result.FallingTetro.GridSize*BlockWidth,
-            Result.FallingTetro.GridSize*BlockHeight);
+    //Draw Grid and Tetromino
+    DrawBoard(Result.MainGrid, Result.FallingTetro, GridX, GridY, GridWidth, GridHeight);
 
     //Draw Preview Grid Background
 
     unsigned int PreviewWidth = 6.0*BlockWidth;
     unsigned int PreviewHeight = 6.0*BlockHeight;
 
-    DrawRect(PREVIEW_X,
-            PREVIEW_Y,
+    DrawRect(PreviewX,
+            PreviewY,
             PreviewWidth,
             PreviewHeight,
             0x77,
@@ -895,27 +2722,66 @@ GameData DrawGame(GameData Current)
     unsigned int PreviewCentreY = PreviewHeight*0.5;
 
     DrawGrid(Result.NextTetro.Grid,
-            PREVIEW_X + PreviewCentreX - TetroCentre.X*BlockWidth,
-            PREVIEW_Y + PreviewCentreY - TetroCentre.Y*BlockHeight,
+            PreviewX + PreviewCentreX - TetroCentre.X*BlockWidth,
+            PreviewY + PreviewCentreY - TetroCentre.Y*BlockHeight,
             Result.NextTetro.GridSize*BlockWidth,
             Result.NextTetro.GridSize*BlockHeight);
 
     //Draw Score
-    SDL_Color TextColor = {255,255,255};
     char ScoreText[100] = "\0";
 
     sprintf(ScoreText, "Score: %04d", Result.Score);
-    DrawText(ScoreText, PREVIEW_X, PREVIEW_Y + PreviewHeight+ Result.ScoreTexture.Height);
+    DrawText(ScoreText, PreviewX, PreviewY + PreviewHeight+ GetGlyph('0').Height);
+
+    return Result;
+}
+
+//The whole window for a game in any state, as the player sees it
+GameData DrawFrame(GameData Current)
+{
+    GameData Result = Current;
+
+    //Clear screen
+    SDL_SetRenderDrawColor( gRenderer, 0, 0, 0, 0 );
+    SDL_RenderClear( gRenderer );
+    Accounting.Frame.DrawCalls++;
+
+    switch(Result.State)
+    {
+        case RUNNING:
+            {
+                Result = DrawGame(Result);
+            }
+            break;
+        case PAUSED:
+            {
+                Result = DrawGame(Result);
+                DrawRect(GRID_X,GRID_Y,GRID_WIDTH,GRID_HEIGHT,0,0,0,128);
+                Rect TextBox = {GRID_X, GRID_Y, GRID_WIDTH, GRID_HEIGHT};
+                DrawTextToRect("Paused!", TextBox, CENTRE);
+            }
+            break;
+        case GAMEOVER:
+            {
+                Result = DrawGame(Result);
+                DrawRect(GRID_X,GRID_Y,GRID_WIDTH,GRID_HEIGHT,0,0,0,128);
+                Rect TextBox= {GRID_X, GRID_Y, GRID_WIDTH, GRID_HEIGHT};
+                DrawTextToRect("Game Over!\nPress [Esc] to Quit or [Space] to Try again!", TextBox, CENTRE);
+            }
+            break;
+        default:
+            break;
+    }
 
-    //Update screen
-    SDL_RenderPresent( gRenderer );
     return Result;
 }
 
 void DrawTexture(Texture T, unsigned int X, unsigned int Y, unsigned int Width, unsigned int Height)
 {
+    SDL_Rect Source = {(int)T.SourceX, (int)T.SourceY, (int)T.Width, (int)T.Height};
     SDL_Rect Rect = {X, Y, Width, Height};
-    SDL_RenderCopy( gRenderer, T.Data, NULL, &Rect );
+    SDL_RenderCopy( gRenderer, T.Data, &Source, &Rect );
+    Accounting.Frame.DrawCalls++;
 }
 
 void DrawText(const char* Text, float X, float Y)
@@ -962,398 +2828,166 @@ void DrawGrid(BlockGrid Grid, unsigned int X, unsigned int Y, unsigned Width, un
                         Y + Row*BlockHeight,
                         BlockWidth + GapFillerHori,
                         BlockHeight + GapFillerVert,
-                        CurrentBlock->Red,
-                        CurrentBlock->Green,
-                        CurrentBlock->Blue,
-                        CurrentBlock->Alpha );
+                        Board.Palette[CurrentBlock->Colour] >> 16,
+                        Board.Palette[CurrentBlock->Colour] >> 8,
+                        Board.Palette[CurrentBlock->Colour],
+                        0xFF );
             }
         }
     }
 }
 
-/*
- * Block/Grid Operations
- */
-
-Block GenerateBlock()
-{
-    Block Result = {0, 0, 0, 0, 0};
-    return Result;
-}
-
-void DestroyGrid(BlockGrid Grid)
-{
-    free(Grid.Blocks);
-}
-
-Block* GetBlock(BlockGrid Grid, unsigned int Row, unsigned int Col)
-{
-    return Grid.Blocks + Grid.Cols*Row + Col;
-}
-
-void EraseBlock(Block* BlockToErase)
-{
-    BlockToErase->Occupied = 0;
-    BlockToErase->Red = 0;
-    BlockToErase->Green = 0;
-    BlockToErase->Blue = 0;
-    BlockToErase->Alpha = 0;
-}
-
-BlockGrid GenerateGrid(unsigned int Rows, unsigned int Cols)
-{
-    BlockGrid Result;
-
-    Result.Rows = Rows;
-    Result.Cols = Cols;
-
-    Result.Blocks = (Block*)(malloc(sizeof(Block)*Rows*Cols));
-
-    unsigned int BlockTotal = (Result.Rows)*(Result.Cols);
-    unsigned int Count = 0;
-    Block* CurrentBlock = Result.Blocks;
-
-    while(Count < BlockTotal)
-    {
-        *CurrentBlock = GenerateBlock();
-
-        ++Count;
-        ++CurrentBlock;
-    }
-
-    return Result;
-}
-
-void StoreTetromino(BlockGrid Grid, Tetromino Tetro)
+void InitialiseBoardPalette()
 {
-    if( (Tetro.Grid.Blocks == NULL) || (Grid.Blocks == NULL) )
-    {
-        return;
-    }
-
-    for(unsigned int Row = 0; Row < Tetro.Grid.Rows; ++Row)
+    for(unsigned int Index = 0; Index < PALETTE_SIZE; ++Index)
     {
-        for(unsigned int Col = 0; Col < Tetro.Grid.Cols; ++Col)
-        {
-            Block* CurrentBlock = GetBlock(Tetro.Grid, Row, Col);
-
-            if(CurrentBlock->Occupied)
-            {
-                unsigned int GridCol = Tetro.Col + Col;
-                unsigned int GridRow = Tetro.Row + Row;
-
-                Block* GridBlock = GetBlock(Grid, GridRow, GridCol);
-
-                // Copy across block
-                *GridBlock = *CurrentBlock;
-            } 
-        }
+        PaletteColour Colour = GetPaletteColour((unsigned char)Index);
+        Board.Palette[Index] = ((Uint32)Colour.Alpha << 24) | ((Uint32)Colour.Red << 16) | ((Uint32)Colour.Green << 8) | Colour.Blue;
     }
 
+    //Grid background
+    Board.Empty = 0xFF555555;
 }
 
-unsigned int CheckCollisions(BlockGrid Grid, Tetromino Tetro)
+//(Re)creates the board texture when the grid's size changes
+bool PrepareBoardTexture(unsigned int Rows, unsigned int Cols)
 {
-    //Check for null pointers
-    if( (Tetro.Grid.Blocks == NULL) || (Grid.Blocks == NULL) )
+    if( Board.Data && (Board.Rows == Rows) && (Board.Cols == Cols) )
     {
-        return 1;
+        return true;
     }
 
-    for(unsigned int Row = 0; Row < Tetro.Grid.Rows; ++Row)
+    if(Board.Data)
     {
-        for(unsigned int Col = 0; Col < Tetro.Grid.Cols; ++Col)
-        {
-            Block* CurrentBlock = GetBlock(Tetro.Grid, Row, Col);
-
-            if(CurrentBlock->Occupied)
-            {
-                unsigned int GridCol = Tetro.Col + Col;
-                unsigned int GridRow = Tetro.Row + Row;
-
-                //If out of bounds, count as collision
-                if( (GridCol < 0) || (GridRow < 0) || (GridCol >= Grid.Cols) || (GridRow >= Grid.Rows) )
-                {
-                    return 1;
-                }
-
-                Block* GridBlock = GetBlock(Grid, GridRow, GridCol);
-
-                // Check for Collision
-                if(GridBlock->Occupied)
-                {
-                    return 1;
-                }
-            } 
-        }
-    }
-
-    return 0;
-}
-
-/*
- * Tetromino Operations
- */
-Tetromino GenerateTetromino()
-{
-    Tetromino Result;
-
-    Result.Col = 0;
-    Result.Row = 0;
-
-    unsigned int Red   = rand()%0xFF;
-    unsigned int Green = rand()%0xFF;
-    unsigned int Blue  = rand()%0xFF;
-
-    unsigned int Rand = rand();
-    Result.Type = (TetrominoType)(Rand%7);
-
-    unsigned int Coords[4] = {0};
-
-    /*
-     *| 0  | 1  | 2  | 3  |
-     *| 4  | 5  | 6  | 7  |
-     *| 8  | 9  | 10 | 11 |
-     *| 12 | 13 | 14 | 15 |
-     */
-    switch(Result.Type)
-    {
-        case I_SHAPE:
-            Result.GridSize = 4;
-            Coords[0] = 0;
-            Coords[1] = 4;
-            Coords[2] = 8;
-            Coords[3] = 12;
-            break;
-        case T_SHAPE:
-            Result.GridSize = 3;
-            Coords[0] = 0;
-            Coords[1] = 1;
-            Coords[2] = 2;
-            Coords[3] = 5;
-            break;
-        case O_SHAPE:
-            Result.GridSize = 2;
-            Coords[0] = 0;
-            Coords[1] = 1;
-            Coords[2] = 4;
-            Coords[3] = 5;
-            break;
-        case Z_SHAPE:
-            Result.GridSize = 3;
-            Coords[0] = 0;
-            Coords[1] = 1;
-            Coords[2] = 5;
-            Coords[3] = 6;
-            break;
-        case S_SHAPE:
-            Result.GridSize = 3;
-            Coords[0] = 1;
-            Coords[1] = 2;
-            Coords[2] = 4;
-            Coords[3] = 5;
-            break;
-        case L_L_SHAPE:
-            Result.GridSize = 3;
-            Coords[0] = 0;
-            Coords[1] = 1;
-            Coords[2] = 2;
-            Coords[3] = 6;
-            break;
-        case L_R_SHAPE:
-            Result.GridSize = 3;
-            Coords[0] = 0;
-            Coords[1] = 1;
-            Coords[2] = 2;
-            Coords[3] = 4;
-            break;
-        default:
-            Result.GridSize = 4;
-            Coords[0] = 0;
-            Coords[1] = 3;
-            Coords[2] = 12;
-            Coords[3] = 15;
-            break;
+        SDL_DestroyTexture(Board.Data);
     }
 
-    Result.Grid = GenerateGrid(Result.GridSize,Result.GridSize);
+    Board.Data = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, Cols, Rows);
+    Accounting.Frame.TextureCreations++;
+    Board.Rows = Rows;
+    Board.Cols = Cols;
 
-    for(unsigned int Index = 0; Index < 4; ++Index)
+    if(Board.Data == NULL)
     {
-        Block* TBlock = GetBlock(Result.Grid, Coords[Index]/4, Coords[Index]%4);
-
-        TBlock->Occupied = 1;
-        TBlock->Red   = Red;
-        TBlock->Green = Green;
-        TBlock->Blue  = Blue;
-        TBlock->Alpha = 0xFF;
+        printf( "Unable to create board texture! SDL Error: %s\n", SDL_GetError() );
+        return false;
     }
 
-    return Result;
-}
+    //Every texel is written each frame, nothing shows through
+    SDL_SetTextureBlendMode(Board.Data, SDL_BLENDMODE_NONE);
 
-void DestroyTetromino(Tetromino Tetro)
-{
-    DestroyGrid(Tetro.Grid);
+    return true;
 }
 
-Tetromino RotateTetroClockwise(Tetromino Tetro)
+//A texel per cell into Pixels (Pitch bytes per row), falling piece included
+void WriteBoardTexels(BlockGrid Grid, Tetromino Falling, Uint32* Pixels, int Pitch)
 {
-    Tetromino Result = Tetro;
+    Block* CurrentBlock = Grid.Blocks;
 
-    if(Result.Type == O_SHAPE)
+    for(unsigned int Row = 0; Row < Grid.Rows; ++Row)
     {
-        return Result;
-    }
-
-    BlockGrid TransposeGrid = GenerateGrid(Result.GridSize,Result.GridSize);
+        Uint32* Texel = (Uint32*)((Uint8*)Pixels + Row*Pitch);
 
-    for(unsigned int Row = 0; Row < Result.GridSize; ++Row)
-    {
-        for(unsigned int Col = 0; Col < Result.GridSize; ++Col)
+        for(unsigned int Col = 0; Col < Grid.Cols; ++Col)
         {
-            Block* Block1 = GetBlock(Result.Grid,   Row, Col);
-            Block* Block2 = GetBlock(TransposeGrid, Col, Row);
-
-            *Block2 = *Block1;
+            Texel[Col] = CurrentBlock->Occupied ? Board.Palette[CurrentBlock->Colour] : Board.Empty;
+            ++CurrentBlock;
         }
     }
 
-    Result.Grid = TransposeGrid;
-
-    // Swap Cols
-    BlockGrid SwappedGrid = GenerateGrid(Result.GridSize,Result.GridSize);
-
-    Block* EndBlock = NULL;
-    Block* StartBlock = NULL;
-
-    for(unsigned int Row = 0; Row < Result.GridSize; ++Row)
+    //The falling piece goes on top
+    for(unsigned int Row = 0; Row < Falling.Grid.Rows; ++Row)
     {
-        for(unsigned int Col = 0; Col < Result.GridSize; ++Col)
+        for(unsigned int Col = 0; Col < Falling.Grid.Cols; ++Col)
         {
-            unsigned int SwapCol = (Result.GridSize - 1) - Col;
+            Block* TBlock = GetBlock(Falling.Grid, Row, Col);
+            unsigned int GridRow = Falling.Row + Row;
+            unsigned int GridCol = Falling.Col + Col;
 
-            EndBlock    = GetBlock(Result.Grid,     Row,    Col);
-            StartBlock  = GetBlock(SwappedGrid,     Row,    SwapCol);
-
-            *StartBlock = *EndBlock;
+            if( TBlock->Occupied && (GridRow < Grid.Rows) && (GridCol < Grid.Cols) )
+            {
+                Uint32* Texel = (Uint32*)((Uint8*)Pixels + GridRow*Pitch);
+                Texel[GridCol] = Board.Palette[TBlock->Colour];
+            }
         }
     }
-
-    DestroyGrid(Result.Grid);
-    Result.Grid = SwappedGrid;
-
-    return Result;
 }
 
-unsigned int RemoveGridLines(BlockGrid Grid)
+void DrawBoard(BlockGrid Grid, Tetromino Falling, unsigned int X, unsigned int Y, unsigned int Width, unsigned int Height)
 {
-    unsigned int FullRowCount    = 0;
-    unsigned int ShiftRowsDownBy = 0;
-
-    for(unsigned int Row = (Grid.Rows-1); Row < Grid.Rows; --Row)
+    if(!PrepareBoardTexture(Grid.Rows, Grid.Cols))
     {
-        unsigned int IsRowFull = 1;
-
-        for(unsigned int Col = 0; Col < Grid.Cols; ++Col)
-        {
-            Block* CurrentBlock = GetBlock(Grid, Row, Col);
-
-            if(!CurrentBlock->Occupied)
-            {
-                IsRowFull = 0;
-            }
+        return;
+    }
 
-            if(ShiftRowsDownBy)
-            {
-                Block* SwapBlock = GetBlock(Grid, Row+ShiftRowsDownBy, Col);
-                *SwapBlock = *CurrentBlock;
-            }
-        }
+    void* Pixels = NULL;
+    int Pitch = 0;
 
-        if(IsRowFull)
-        {
-            FullRowCount++;
-            ShiftRowsDownBy++;
-        }
+    if(SDL_LockTexture(Board.Data, NULL, &Pixels, &Pitch) != 0)
+    {
+        printf( "Unable to lock board texture! SDL Error: %s\n", SDL_GetError() );
+        return;
     }
 
-    //Cleanup the remaining rows
-    for(unsigned int Row = 0; Row < ShiftRowsDownBy; ++Row)
-    {
-        for(unsigned int Col = 0; Col < Grid.Cols; ++Col)
-        {
-            Block* CurrentBlock = GetBlock(Grid, Row, Col);
+    WriteBoardTexels(Grid, Falling, (Uint32*)Pixels, Pitch);
 
-            EraseBlock(CurrentBlock);
-        }
-    }
+    SDL_UnlockTexture(Board.Data);
+    Accounting.Frame.TextureUploads++;
 
-    return FullRowCount;
+    //Nearest neighbour scaling (SDL's default) keeps the cells sharp
+    SDL_Rect Rect = {(int)X, (int)Y, (int)Width, (int)Height};
+    SDL_RenderCopy( gRenderer, Board.Data, NULL, &Rect );
+    Accounting.Frame.DrawCalls++;
 }
 
-Vector2D CalculateGridCentreOfMass(BlockGrid Grid)
+
+void DrawTextToRect(const char* Text, Rect Box, Alignment Align)
 {
-    Vector2D Result = {0,0};
+    unsigned int StringLength = strlen(Text);
 
-    float TotalX = 0;
-    float TotalY = 0;
-    float TotalMass = 0;
+    float MaxWidth = 0;
+    float MaxHeight = 0;
+    unsigned int MaxLines = 1; //Assume at least one line of text (even if blank)
 
-    for(float Row = 0; Row < Grid.Rows; ++Row)
+    for(unsigned int Index = 0; Index < StringLength; ++Index)
     {
-        for(float Col = 0; Col < Grid.Cols; ++Col)
+        if(Text[Index] == '\n')
         {
-            Block* CurrentBlock = GetBlock(Grid, Row, Col);
-            if(CurrentBlock->Occupied)
-            {
-                TotalX += (Col+1)-0.5;
-                TotalY += (Row+1)-0.5;
-                ++TotalMass;
-            }
+            ++MaxLines;
         }
     }
 
-    Result.X = TotalX/TotalMass;
-    Result.Y = TotalY/TotalMass;
+    //Only needed for this frame
+    unsigned int* LineWidths = PushArray(&FrameArena, unsigned int, MaxLines);
 
-    return Result;
-}
+    if(LineWidths == NULL)
+    {
+        return;
+    }
 
-void DrawTextToRect(const char* Text, Rect Box, Alignment Align)
-{
-    unsigned int StringLength = strlen(Text);
+    memset(LineWidths, 0, sizeof(unsigned int)*MaxLines);
 
-    float MaxWidth = 0;
-    float MaxHeight = 0;
-    unsigned int MaxLines = 1; //Assume at least one line of text (even if blank)
-    unsigned int* LineWidths = (unsigned int*)malloc(sizeof(unsigned int)*MaxLines);
+    //Work out the Width of each Line
+    unsigned int CurrentLine = 0;
 
-    //Work out MaxLines and the Width of each Line
-    for(unsigned int Line = 0; Line < MaxLines; ++Line)
+    for(unsigned int Index = 0; Index < StringLength; ++Index)
     {
-        for(unsigned int Index = 0; Index < StringLength; ++Index)
+        if(Text[Index] == '\n')
         {
-            if(Text[Index] == '\n')
-            {
-                ++MaxLines;
-                realloc((void*)LineWidths, sizeof(unsigned int)*MaxLines);
-            }
-            else
-            {
-                Texture Char = GetGlyph(Text[Index]);
-                LineWidths[Line] += Char.Width;
+            ++CurrentLine;
+        }
+        else
+        {
+            Texture Char = GetGlyph(Text[Index]);
+            LineWidths[CurrentLine] += Char.Width;
 
-                if(Char.Height > MaxHeight)
-                {
-                    MaxHeight = Char.Height;
-                }
+            if(Char.Height > MaxHeight)
+            {
+                MaxHeight = Char.Height;
             }
         }
     }
 
-    printf("There are %d lines in \"%s\".\n");
-
     for(unsigned int Line = 0; Line < MaxLines; ++Line)
     {
         float DrawWidth = LineWidths[Line];
@@ -1411,6 +3045,35 @@ void DrawTextToRect(const char* Text, Rect Box, Alignment Align)
             }
         }
     }
+}
+
+//Last frame's counts in the empty left third, so drawing the overlay shows up
+//in the next one
+void DrawAccountingOverlay(SimulationData* Simulation)
+{
+    char Lines[512];
 
-    free(LineWidths);
+    sprintf(Lines, "Draws    %u\nTextures %u\nUploads  %u\nAllocs   %llu\nTick     %d\n"
+                   "Bad frames %llu\nBad ticks  %d",
+            Accounting.LastFrame.DrawCalls, Accounting.LastFrame.TextureCreations, Accounting.LastFrame.TextureUploads,
+            Accounting.LastFrameHeap.Allocations, SDL_AtomicGet(&Simulation->TickAllocations),
+            Accounting.AllocatingFrames, SDL_AtomicGet(&Simulation->AllocatingTicks));
+
+    float LineHeight = GetGlyph('0').Height;
+    float Y = 0;
+    char* Line = Lines;
+
+    while(Line)
+    {
+        char* End = strchr(Line, '\n');
+
+        if(End)
+        {
+            *End = '\0';
+        }
+
+        DrawText(Line, 0, Y);
+        Y += LineHeight;
+        Line = End ? End + 1 : NULL;
+    }
 }
@@ -0,0 +1,253 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "net.h"
+
+/*
+ * Protocol
+ */
+
+InputState UnpackClientInputs(unsigned int Bits)
+{
+    InputState Result;
+
+    Result.Up       = (Bits & CLIENT_UP) != 0;
+    Result.Down     = (Bits & CLIENT_DOWN) != 0;
+    Result.Left     = (Bits & CLIENT_LEFT) != 0;
+    Result.Right    = (Bits & CLIENT_RIGHT) != 0;
+    Result.Space    = (Bits & CLIENT_SPACE) != 0;
+    Result.Escape   = (Bits & CLIENT_ESCAPE) != 0;
+
+    return Result;
+}
+
+void EncodeServerUpdate(const GameData* Game, unsigned int Tick, unsigned short Ack, ServerUpdate* Update)
+{
+    memset(Update, 0, sizeof(*Update));
+
+    Update->Type    = SERVER_UPDATE;
+    Update->State   = (unsigned char)Game->State;
+    Update->Tick    = Tick;
+    Update->Score   = Game->Score;
+    Update->Ack     = Ack;
+
+    if(Game->MainGrid.Blocks == NULL)
+    {
+        return;
+    }
+
+    const Block* CurrentBlock = Game->MainGrid.Blocks;
+
+    for(unsigned int Row = 0; Row < GRID_ROWS; ++Row)
+    {
+        unsigned short Mask = 0;
+
+        for(unsigned int Col = 0; Col < GRID_COLS; ++Col)
+        {
+            Mask |= (unsigned short)((CurrentBlock->Occupied != 0) << Col);
+            ++CurrentBlock;
+        }
+
+        Update->Rows[Row] = Mask;
+    }
+
+    const Tetromino* Tetro = &Game->FallingTetro;
+
+    for(unsigned int Row = 0; Row < Tetro->GridSize; ++Row)
+    {
+        for(unsigned int Col = 0; Col < Tetro->GridSize; ++Col)
+        {
+            if(GetBlock(Tetro->Grid, Row, Col)->Occupied)
+            {
+                Update->PieceShape |= (unsigned short)(1 << (Row*TETROMINO_MAX_SIZE + Col));
+            }
+        }
+    }
+
+    Update->Piece       = (unsigned char)Tetro->Type;
+    Update->NextPiece   = (unsigned char)Game->NextTetro.Type;
+    Update->PieceRow    = (signed char)Tetro->Row;
+    Update->PieceCol    = (signed char)Tetro->Col;
+}
+
+/*
+ * Sockets
+ */
+
+bool IsTcpAddress(const char* Address)
+{
+    return (Address[0] != '/') && (Address[0] != '.') && (strchr(Address, ':') != NULL);
+}
+
+//Splits host:port in place, returns the port
+const char* SplitTcpAddress(char* Address)
+{
+    char* Colon = strrchr(Address, ':');
+    *Colon = '\0';
+
+    return Colon + 1;
+}
+
+int OpenListenSocket(const char* Address)
+{
+    int Result = -1;
+
+    if(IsTcpAddress(Address))
+    {
+        char Host[256];
+        snprintf(Host, sizeof(Host), "%s", Address);
+        const char* Port = SplitTcpAddress(Host);
+
+        addrinfo Hints;
+        memset(&Hints, 0, sizeof(Hints));
+        Hints.ai_family = AF_UNSPEC;
+        Hints.ai_socktype = SOCK_STREAM;
+        Hints.ai_flags = AI_PASSIVE;
+
+        addrinfo* Info = NULL;
+
+        if(getaddrinfo(Host[0] ? Host : NULL, Port, &Hints, &Info) != 0)
+        {
+            printf("Unable to resolve \"%s\"!\n", Address);
+            return -1;
+        }
+
+        Result = socket(Info->ai_family, SOCK_STREAM, 0);
+
+        if(Result >= 0)
+        {
+            int Reuse = 1;
+            setsockopt(Result, SOL_SOCKET, SO_REUSEADDR, &Reuse, sizeof(Reuse));
+
+            if(bind(Result, Info->ai_addr, Info->ai_addrlen) != 0)
+            {
+                close(Result);
+                Result = -1;
+            }
+        }
+
+        freeaddrinfo(Info);
+    }
+    else
+    {
+        sockaddr_un Local;
+        memset(&Local, 0, sizeof(Local));
+        Local.sun_family = AF_UNIX;
+        snprintf(Local.sun_path, sizeof(Local.sun_path), "%s", Address);
+
+        //Left behind by a server that didn't shut down cleanly
+        unlink(Address);
+
+        Result = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if( (Result >= 0) && (bind(Result, (sockaddr*)&Local, sizeof(Local)) != 0) )
+        {
+            close(Result);
+            Result = -1;
+        }
+    }
+
+    if( (Result < 0) || (listen(Result, SOMAXCONN) != 0) || !SetNonBlocking(Result) )
+    {
+        printf("Unable to listen on \"%s\": %s\n", Address, strerror(errno));
+
+        if(Result >= 0)
+        {
+            close(Result);
+        }
+
+        return -1;
+    }
+
+    return Result;
+}
+
+//Blocking connect, the socket is left blocking
+int ConnectSocket(const char* Address)
+{
+    int Result = -1;
+
+    if(IsTcpAddress(Address))
+    {
+        char Host[256];
+        snprintf(Host, sizeof(Host), "%s", Address);
+        const char* Port = SplitTcpAddress(Host);
+
+        addrinfo Hints;
+        memset(&Hints, 0, sizeof(Hints));
+        Hints.ai_family = AF_UNSPEC;
+        Hints.ai_socktype = SOCK_STREAM;
+
+        addrinfo* Info = NULL;
+
+        if(getaddrinfo(Host[0] ? Host : "localhost", Port, &Hints, &Info) != 0)
+        {
+            printf("Unable to resolve \"%s\"!\n", Address);
+            return -1;
+        }
+
+        Result = socket(Info->ai_family, SOCK_STREAM, 0);
+
+        if( (Result >= 0) && (connect(Result, Info->ai_addr, Info->ai_addrlen) != 0) )
+        {
+            close(Result);
+            Result = -1;
+        }
+
+        freeaddrinfo(Info);
+
+        if(Result >= 0)
+        {
+            //Updates are small and latency matters more than packet count
+            int NoDelay = 1;
+            setsockopt(Result, IPPROTO_TCP, TCP_NODELAY, &NoDelay, sizeof(NoDelay));
+        }
+    }
+    else
+    {
+        sockaddr_un Remote;
+        memset(&Remote, 0, sizeof(Remote));
+        Remote.sun_family = AF_UNIX;
+        snprintf(Remote.sun_path, sizeof(Remote.sun_path), "%s", Address);
+
+        Result = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if( (Result >= 0) && (connect(Result, (sockaddr*)&Remote, sizeof(Remote)) != 0) )
+        {
+            close(Result);
+            Result = -1;
+        }
+    }
+
+    return Result;
+}
+
+bool SetNonBlocking(int Socket)
+{
+    int Flags = fcntl(Socket, F_GETFL, 0);
+
+    return (Flags >= 0) && (fcntl(Socket, F_SETFL, Flags | O_NONBLOCK) == 0);
+}
+
+//Thousands of sessions means thousands of descriptors, more than the usual
+//soft limit
+void RaiseFileLimit()
+{
+    rlimit Limit;
+
+    if(getrlimit(RLIMIT_NOFILE, &Limit) == 0)
+    {
+        Limit.rlim_cur = Limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &Limit);
+    }
+}
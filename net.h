@@ -0,0 +1,80 @@
+#ifndef NET_H
+#define NET_H
+
+#include "game.h"
+
+/*
+ * Network Protocol
+ *
+ * Fixed size messages over a stream socket, Unix or TCP. Clients send their
+ * key presses as they happen. The server steps every session on one shared
+ * tick, and sends a session an update on any tick where something visible
+ * changed or its inputs were taken.
+ *
+ * An update carries the whole visible state (board occupancy, falling and
+ * next piece, score) in 60 bytes, so a client can miss any number of them
+ * and the next one still stands alone. Fields are in host byte order, as
+ * both ends are expected to be little endian.
+ */
+
+enum NetConstants{
+    DEFAULT_SERVER_PORT = 7390,
+
+    //Bits in ClientMessage::Inputs, the same keys the SDL front end takes
+    CLIENT_UP       = 1 << 0,   //Rotate
+    CLIENT_DOWN     = 1 << 1,
+    CLIENT_LEFT     = 1 << 2,
+    CLIENT_RIGHT    = 1 << 3,
+    CLIENT_SPACE    = 1 << 4,   //Pause, or restart after game over
+    CLIENT_ESCAPE   = 1 << 5    //Quit after game over
+};
+
+#define DEFAULT_SERVER_SOCKET "/tmp/agafb.sock"
+
+enum ClientMessageType{
+    CLIENT_INPUT = 1
+};
+
+enum ServerMessageType{
+    SERVER_UPDATE = 1
+};
+
+struct ClientMessage{
+    unsigned char Type;
+    unsigned char Inputs;
+    unsigned short Sequence;    //Echoed back as ServerUpdate::Ack once taken
+};
+
+struct ServerUpdate{
+    unsigned char Type;
+    unsigned char State;        //GameState
+    unsigned char Piece;        //TetrominoType
+    unsigned char NextPiece;
+    unsigned int Tick;
+    unsigned int Score;
+    unsigned short Ack;         //Sequence of the last input taken
+    signed char PieceRow;
+    signed char PieceCol;
+    unsigned short PieceShape;  //Bit Row*4 + Col set for each block of the falling piece
+    unsigned short Reserved;
+    unsigned short Rows[GRID_ROWS]; //Bit N set for an occupied block in column N
+};
+
+typedef char ServerUpdateSizeCheck[(sizeof(ServerUpdate) == 60) ? 1 : -1];
+
+InputState  UnpackClientInputs(unsigned int Bits);
+void        EncodeServerUpdate(const GameData* Game, unsigned int Tick, unsigned short Ack, ServerUpdate* Update);
+
+/*
+ * Sockets
+ *
+ * Addresses are either a path for a Unix socket or host:port for TCP.
+ */
+
+bool    IsTcpAddress(const char* Address);
+int     OpenListenSocket(const char* Address);
+int     ConnectSocket(const char* Address);
+bool    SetNonBlocking(int Socket);
+void    RaiseFileLimit();
+
+#endif
@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "pieces.h"
+
+/*
+ * Sets
+ */
+
+//Kept in TetrominoType order, and so exactly where GenerateTetrominoOfType
+//always put the blocks
+static const PieceDefinition Tetrominoes[] = {
+    {"I", {"#...",
+           "#...",
+           "#...",
+           "#..."}},
+    {"T", {"###",
+           ".#.",
+           "..."}},
+    {"O", {"##",
+           "##"}},
+    {"Z", {"##.",
+           ".##",
+           "..."}},
+    {"S", {".##",
+           "##.",
+           "..."}},
+    {"J", {"###",
+           "..#",
+           "..."}},
+    {"L", {"###",
+           "#..",
+           "..."}}
+};
+
+//The one sided pentominoes bar the straight one, which needs a 5 wide grid
+static const PieceDefinition Pentominoes[] = {
+    {"F", {".##",
+           "##.",
+           ".#."}},
+    {"F'", {"##.",
+            ".##",
+            ".#."}},
+    {"L", {"####",
+           "#...",
+           "....",
+           "...."}},
+    {"J", {"####",
+           "...#",
+           "....",
+           "...."}},
+    {"N", {"###.",
+           "..##",
+           "....",
+           "...."}},
+    {"N'", {".###",
+            "##..",
+            "....",
+            "...."}},
+    {"Y", {"####",
+           ".#..",
+           "....",
+           "...."}},
+    {"Y'", {"####",
+            "..#.",
+            "....",
+            "...."}},
+    {"P", {"##.",
+           "##.",
+           "#.."}},
+    {"P'", {"##.",
+            "##.",
+            ".#."}},
+    {"T", {"###",
+           ".#.",
+           ".#."}},
+    {"U", {"#.#",
+           "###",
+           "..."}},
+    {"V", {"#..",
+           "#..",
+           "###"}},
+    {"W", {"#..",
+           "##.",
+           ".##"}},
+    {"X", {".#.",
+           "###",
+           ".#."}},
+    {"Z", {"##.",
+           ".#.",
+           ".##"}},
+    {"S", {".##",
+           ".#.",
+           "##."}}
+};
+
+static const PieceSet PieceSets[PIECE_SET_COUNT] = {
+    {"tetrominoes", Tetrominoes, sizeof(Tetrominoes)/sizeof(Tetrominoes[0])},
+    {"pentominoes", Pentominoes, sizeof(Pentominoes)/sizeof(Pentominoes[0])}
+};
+
+const PieceSet* FindPieceSet(const char* Name, unsigned int* SetId)
+{
+    for(unsigned int Id = 0; Id < PIECE_SET_COUNT; ++Id)
+    {
+        if(strcmp(PieceSets[Id].Name, Name) == 0)
+        {
+            *SetId = Id;
+            return PieceSets + Id;
+        }
+    }
+
+    return NULL;
+}
+
+const PieceSet* GetPieceSet(unsigned int SetId)
+{
+    return (SetId < PIECE_SET_COUNT) ? PieceSets + SetId : NULL;
+}
+
+/*
+ * Table Generation
+ */
+
+//Fills in the cell list from the row masks
+void ListPieceCells(PieceRotation* Rotation, unsigned int GridSize)
+{
+    Rotation->CellCount = 0;
+
+    for(unsigned int Row = 0; Row < GridSize; ++Row)
+    {
+        for(unsigned int Col = 0; Col < GridSize; ++Col)
+        {
+            if(Rotation->Rows[Row] & (1u << Col))
+            {
+                Rotation->CellRows[Rotation->CellCount] = (unsigned char)Row;
+                Rotation->CellCols[Rotation->CellCount] = (unsigned char)Col;
+                Rotation->CellCount++;
+            }
+        }
+    }
+}
+
+//Transposes and then mirrors the columns, as RotateTetroClockwise always did
+PieceRotation RotatePieceClockwise(const PieceRotation* Rotation, unsigned int GridSize)
+{
+    PieceRotation Result;
+    memset(&Result, 0, sizeof(Result));
+
+    for(unsigned int Row = 0; Row < GridSize; ++Row)
+    {
+        for(unsigned int Col = 0; Col < GridSize; ++Col)
+        {
+            if(Rotation->Rows[Row] & (1u << Col))
+            {
+                Result.Rows[Col] |= 1u << (GridSize - 1 - Row);
+            }
+        }
+    }
+
+    ListPieceCells(&Result, GridSize);
+
+    return Result;
+}
+
+bool BuildPieceTable(const PieceSet* Set, unsigned int SetId, PieceTable* Table)
+{
+    memset(Table, 0, sizeof(*Table));
+
+    if( (Set->Count == 0) || (Set->Count > PIECE_MAX_TYPES) )
+    {
+        printf("Piece set %s has %u pieces, it needs 1 to %u\n", Set->Name, Set->Count, (unsigned int)PIECE_MAX_TYPES);
+        return false;
+    }
+
+    for(unsigned int Index = 0; Index < Set->Count; ++Index)
+    {
+        const PieceDefinition* Definition = Set->Pieces + Index;
+        PieceType* Type = Table->Types + Index;
+        PieceRotation* First = Type->Rotations;
+
+        Type->Name = Definition->Name;
+        Type->GridSize = (unsigned int)strlen(Definition->Rows[0]);
+
+        bool Valid = (Type->GridSize > 0) && (Type->GridSize <= TETROMINO_MAX_SIZE);
+
+        for(unsigned int Row = 0; Valid && (Row < TETROMINO_MAX_SIZE); ++Row)
+        {
+            const char* Cells = Definition->Rows[Row];
+
+            if(Row >= Type->GridSize)
+            {
+                Valid = (Cells == NULL);
+                continue;
+            }
+
+            Valid = (Cells != NULL) && (strlen(Cells) == Type->GridSize);
+
+            for(unsigned int Col = 0; Valid && (Col < Type->GridSize); ++Col)
+            {
+                First->Rows[Row] |= (Cells[Col] == '#') ? (1u << Col) : 0;
+            }
+        }
+
+        if(Valid)
+        {
+            ListPieceCells(First, Type->GridSize);
+            Valid = (First->CellCount > 0);
+        }
+
+        if(!Valid)
+        {
+            printf("Piece %s in set %s isn't a square grid of up to %u rows with a block in it\n", Definition->Name,
+                   Set->Name, (unsigned int)TETROMINO_MAX_SIZE);
+            return false;
+        }
+
+        //Rotations repeat after 1, 2 or 4 turns
+        Type->RotationCount = PIECE_ROTATIONS;
+
+        for(unsigned int Rotation = 1; Rotation < PIECE_ROTATIONS; ++Rotation)
+        {
+            Type->Rotations[Rotation] = RotatePieceClockwise(Type->Rotations + Rotation - 1, Type->GridSize);
+
+            if(memcmp(Type->Rotations[Rotation].Rows, First->Rows, sizeof(First->Rows)) == 0)
+            {
+                Type->RotationCount = Rotation;
+                break;
+            }
+        }
+
+        Type->SpawnRow = -(int)First->CellRows[0];
+        Type->SpawnCol = TETROMINO_MAX_SIZE;
+
+        for(unsigned int Cell = 0; Cell < First->CellCount; ++Cell)
+        {
+            Type->SpawnCol = (First->CellCols[Cell] < Type->SpawnCol) ? First->CellCols[Cell] : Type->SpawnCol;
+        }
+
+        Type->SpawnCol = -Type->SpawnCol;
+    }
+
+    Table->Valid = true;
+    Table->SetId = SetId;
+    Table->Name = Set->Name;
+    Table->Count = Set->Count;
+
+    return true;
+}
+
+PieceTable GenerateDefaultPieceTable()
+{
+    PieceTable Table;
+    BuildPieceTable(PieceSets + PIECES_TETROMINOES, PIECES_TETROMINOES, &Table);
+
+    return Table;
+}
+
+//Dynamic initialisation, so it runs before main - or, for the env library,
+//as it's loaded - and the sets above, being constants, are ready for it
+PieceTable ActivePieces = GenerateDefaultPieceTable();
+
+bool UsePieceSet(unsigned int SetId)
+{
+    const PieceSet* Set = GetPieceSet(SetId);
+
+    if(Set == NULL)
+    {
+        printf("There's no piece set %u\n", SetId);
+        return false;
+    }
+
+    if(ActivePieces.SetId == SetId)
+    {
+        return true;
+    }
+
+    //Built to one side, so a set that fails leaves the one in use alone
+    PieceTable Table;
+
+    if( !BuildPieceTable(Set, SetId, &Table) )
+    {
+        return false;
+    }
+
+    ActivePieces = Table;
+
+    return true;
+}
+
+unsigned int FindPieceRotation(unsigned int Type, const Block* Blocks, unsigned int GridSize)
+{
+    const PieceTable* Pieces = GetActivePieces();
+
+    if( (Type >= Pieces->Count) || (GridSize != Pieces->Types[Type].GridSize) )
+    {
+        return 0;
+    }
+
+    const PieceType* Piece = Pieces->Types + Type;
+
+    for(unsigned int Rotation = 0; Rotation < Piece->RotationCount; ++Rotation)
+    {
+        const PieceRotation* Shape = Piece->Rotations + Rotation;
+        bool Match = true;
+
+        for(unsigned int Row = 0; Match && (Row < GridSize); ++Row)
+        {
+            for(unsigned int Col = 0; Match && (Col < GridSize); ++Col)
+            {
+                Match = ((Blocks[Row*GridSize + Col].Occupied != 0) == ((Shape->Rows[Row] & (1u << Col)) != 0));
+            }
+        }
+
+        if(Match)
+        {
+            return Rotation;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+#ifndef PIECES_H
+#define PIECES_H
+
+#include "game.h"
+
+/*
+ * Piece Sets
+ *
+ * The pieces a game deals are written out as pictures of their grids, a set
+ * to an array, and everything the rules need is generated from those when a
+ * set is put into use: each rotation's blocks as a cell list and as row masks,
+ * how many distinct rotations a piece has and where it spawns. The collision
+ * and store fast paths walk a piece's cell list straight out of the table, so
+ * a set costs the same per tick however its pieces are shaped - and the
+ * tetromino set is the same shapes, colours and random draws as it always was.
+ *
+ * Rotating is clockwise within the piece's square grid, as it always has been,
+ * so every set's pieces have to fit TETROMINO_MAX_SIZE square. That's what
+ * snapshots, replays and broadcasts hold, and it keeps the straight five block
+ * piece out of the pentominoes.
+ *
+ * Only the GameData rules follow the set in use. The lockstep engine, the bot,
+ * the solver and the surface tables are tetromino only.
+ */
+
+enum PieceConstants{
+    PIECE_MAX_TYPES     = 32,
+    PIECE_MAX_CELLS     = TETROMINO_MAX_SIZE*TETROMINO_MAX_SIZE,
+    PIECE_ROTATIONS     = 4
+};
+
+//Piece sets in the order of their ids, which replays record
+enum PieceSetId{
+    PIECES_TETROMINOES,
+    PIECES_PENTOMINOES,
+    PIECE_SET_COUNT
+};
+
+//A piece's grid, top row first: '#' for a block, anything else for a gap.
+//As many rows as the grid is wide, and unused rows NULL.
+struct PieceDefinition{
+    const char* Name;
+    const char* Rows[TETROMINO_MAX_SIZE];
+};
+
+struct PieceSet{
+    const char* Name;
+    const PieceDefinition* Pieces;
+    unsigned int Count;
+};
+
+struct PieceRotation{
+    unsigned int Rows[TETROMINO_MAX_SIZE];      //Bit N is column N of the piece grid
+    unsigned char CellRows[PIECE_MAX_CELLS];
+    unsigned char CellCols[PIECE_MAX_CELLS];
+    unsigned int CellCount;
+};
+
+struct PieceType{
+    const char* Name;
+    unsigned int GridSize;
+    unsigned int RotationCount;     //Distinct rotations, 1 for pieces rotating doesn't change
+    int SpawnRow;                   //Puts the top and left blocks at the spawn point
+    int SpawnCol;
+    PieceRotation Rotations[PIECE_ROTATIONS];
+};
+
+struct PieceTable{
+    bool Valid;
+    unsigned int SetId;
+    const char* Name;
+    unsigned int Count;
+    PieceType Types[PIECE_MAX_TYPES];
+};
+
+//The set games deal from, read through GetActivePieces. It's built with the
+//tetrominoes before main runs, so it's complete before any thread reads it.
+extern PieceTable ActivePieces;
+
+//NULL if there's no set called Name
+const PieceSet* FindPieceSet(const char* Name, unsigned int* SetId);
+const PieceSet* GetPieceSet(unsigned int SetId);
+
+//False, having said why, if the set's pictures don't make valid pieces
+bool            BuildPieceTable(const PieceSet* Set, unsigned int SetId, PieceTable* Table);
+
+//Switches the set games deal from. Only before any threads that play games
+//have started, as nothing else guards the table.
+bool            UsePieceSet(unsigned int SetId);
+
+//Which of its type's rotations a piece grid is in, 0 if it's none of them
+unsigned int    FindPieceRotation(unsigned int Type, const Block* Blocks, unsigned int GridSize);
+
+inline const PieceTable* GetActivePieces()
+{
+    return &ActivePieces;
+}
+
+#endif
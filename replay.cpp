@@ -0,0 +1,521 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "pieces.h"
+#include "replay.h"
+
+/*
+ * Inputs
+ */
+
+unsigned int PackReplayInputs(InputState Inputs)
+{
+    unsigned int Result = 0;
+
+    if(Inputs.Up)       Result |= REPLAY_UP;
+    if(Inputs.Down)     Result |= REPLAY_DOWN;
+    if(Inputs.Left)     Result |= REPLAY_LEFT;
+    if(Inputs.Right)    Result |= REPLAY_RIGHT;
+    if(Inputs.Space)    Result |= REPLAY_SPACE;
+    if(Inputs.Escape)   Result |= REPLAY_ESCAPE;
+
+    return Result;
+}
+
+InputState UnpackReplayInputs(unsigned int Bits)
+{
+    InputState Result;
+
+    Result.Up       = (Bits & REPLAY_UP) != 0;
+    Result.Down     = (Bits & REPLAY_DOWN) != 0;
+    Result.Left     = (Bits & REPLAY_LEFT) != 0;
+    Result.Right    = (Bits & REPLAY_RIGHT) != 0;
+    Result.Space    = (Bits & REPLAY_SPACE) != 0;
+    Result.Escape   = (Bits & REPLAY_ESCAPE) != 0;
+
+    return Result;
+}
+
+//Redraw and RenderScore are cleared by whoever draws the game, not by the
+//rules, so they're left out to keep replayed and recorded states comparable
+void SaveReplaySnapshot(const GameData* Game, GameSnapshot* Snapshot)
+{
+    SaveGameSnapshot(Game, Snapshot);
+    Snapshot->Flags &= ~(SNAPSHOT_REDRAW | SNAPSHOT_RENDER_SCORE);
+}
+
+/*
+ * Recording
+ *
+ * The game being recorded is buffered in memory and written out whole when it
+ * ends, followed by the index when the writer closes.
+ */
+
+//Doubles Capacity until Count more items fit. It's the game's own memory, so
+//it goes through the heap wrappers and growing shows up in the tick counts.
+bool GrowReplayBuffer(void** Buffer, unsigned int* Capacity, unsigned int Used, unsigned int Count, size_t ItemSize)
+{
+    if(Used + Count <= *Capacity)
+    {
+        return true;
+    }
+
+    unsigned int NewCapacity = *Capacity ? *Capacity : 1024;
+
+    while(NewCapacity < Used + Count)
+    {
+        NewCapacity *= 2;
+    }
+
+    void* Grown = HeapReallocate(*Buffer, NewCapacity*ItemSize);
+
+    if(Grown == NULL)
+    {
+        return false;
+    }
+
+    *Buffer = Grown;
+    *Capacity = NewCapacity;
+
+    return true;
+}
+
+bool WriteReplayBytes(ReplayWriter* Writer, const void* Bytes, size_t Size)
+{
+    if(fwrite(Bytes, 1, Size, Writer->File) != Size)
+    {
+        printf("Could not write replay! Disk full?\n");
+        Writer->Valid = false;
+        return false;
+    }
+
+    Writer->Offset += Size;
+
+    return true;
+}
+
+ReplayWriter OpenReplayWriter(const char* Path, unsigned int KeyframePieces)
+{
+    ReplayWriter Result;
+    memset(&Result, 0, sizeof(Result));
+
+    Result.File = fopen(Path, "wb");
+
+    if(Result.File == NULL)
+    {
+        printf("Could not create replay %s!\n", Path);
+        return Result;
+    }
+
+    Result.Valid = true;
+    Result.KeyframePieces = KeyframePieces ? KeyframePieces : (unsigned int)REPLAY_DEFAULT_KEYFRAME_PIECES;
+
+    //Filled in on close
+    ReplayHeader Header;
+    memset(&Header, 0, sizeof(Header));
+    WriteReplayBytes(&Result, &Header, sizeof(Header));
+
+    return Result;
+}
+
+void AddReplayKeyframe(ReplayWriter* Writer, const GameData* Game)
+{
+    if( !GrowReplayBuffer((void**)&Writer->Keyframes, &Writer->KeyframeCapacity, Writer->Game.KeyframeCount, 1,
+                          sizeof(ReplayKeyframe)) )
+    {
+        Writer->Valid = false;
+        return;
+    }
+
+    ReplayKeyframe* Keyframe = Writer->Keyframes + Writer->Game.KeyframeCount++;
+
+    Keyframe->Tick = Writer->Game.TickCount;
+    Keyframe->Piece = Writer->Game.PieceCount;
+    SaveReplaySnapshot(Game, &Keyframe->Snapshot);
+
+    Writer->PiecesSinceKeyframe = 0;
+}
+
+//Game should have just started RUNNING
+void BeginReplayGame(ReplayWriter* Writer, const GameData* Game)
+{
+    if(!Writer->Valid)
+    {
+        return;
+    }
+
+    if(Writer->Recording)
+    {
+        EndReplayGame(Writer);
+    }
+
+    memset(&Writer->Game, 0, sizeof(Writer->Game));
+    Writer->Recording = true;
+    Writer->Game.Score = Game->Score;
+
+    AddReplayKeyframe(Writer, Game);
+}
+
+//Game is the state after the tick Inputs were applied on
+void RecordReplayTick(ReplayWriter* Writer, const GameData* Game, unsigned int Inputs)
+{
+    if( !Writer->Valid || !Writer->Recording )
+    {
+        return;
+    }
+
+    if( !GrowReplayBuffer((void**)&Writer->Inputs, &Writer->InputCapacity, Writer->Game.TickCount, 1, 1) )
+    {
+        Writer->Valid = false;
+        return;
+    }
+
+    Writer->Inputs[Writer->Game.TickCount++] = (unsigned char)Inputs;
+    Writer->Game.Score = Game->Score;
+
+    if(Game->State == GAMEOVER)
+    {
+        Writer->Game.Flags |= REPLAY_FINISHED;
+    }
+    else if(Writer->PiecesSinceKeyframe >= Writer->KeyframePieces)
+    {
+        AddReplayKeyframe(Writer, Game);
+    }
+}
+
+void OnPieceLocked(ReplayWriter* Writer, const Tetromino&)
+{
+    if(Writer->Recording)
+    {
+        Writer->Game.PieceCount++;
+        Writer->PiecesSinceKeyframe++;
+    }
+}
+
+void OnLinesCleared(ReplayWriter* Writer, const unsigned int*, unsigned int Count)
+{
+    if(Writer->Recording)
+    {
+        Writer->Game.Lines += Count;
+    }
+}
+
+void SkipReplayTicks(ReplayWriter* Writer, unsigned int Ticks)
+{
+    if( !Writer->Valid || !Writer->Recording || (Ticks == 0) )
+    {
+        return;
+    }
+
+    if( !GrowReplayBuffer((void**)&Writer->Inputs, &Writer->InputCapacity, Writer->Game.TickCount, Ticks, 1) )
+    {
+        Writer->Valid = false;
+        return;
+    }
+
+    memset(Writer->Inputs + Writer->Game.TickCount, 0, Ticks);
+    Writer->Game.TickCount += Ticks;
+}
+
+//True if the game being recorded made it into the archive
+bool EndReplayGame(ReplayWriter* Writer)
+{
+    if( !Writer->Valid || !Writer->Recording )
+    {
+        return false;
+    }
+
+    Writer->Recording = false;
+
+    if( !GrowReplayBuffer((void**)&Writer->Index, &Writer->IndexCapacity, Writer->GameCount, 1, sizeof(ReplayGame)) )
+    {
+        Writer->Valid = false;
+        return false;
+    }
+
+    static const unsigned char Padding[8] = {0};
+    ReplayGame* Game = &Writer->Game;
+
+    Game->InputOffset = Writer->Offset;
+    WriteReplayBytes(Writer, Writer->Inputs, Game->TickCount);
+    WriteReplayBytes(Writer, Padding, (8 - (Writer->Offset & 7)) & 7);
+
+    Game->KeyframeOffset = Writer->Offset;
+    WriteReplayBytes(Writer, Writer->Keyframes, sizeof(ReplayKeyframe)*Game->KeyframeCount);
+
+    Writer->Index[Writer->GameCount++] = *Game;
+
+    return Writer->Valid;
+}
+
+//Writes the index and header. False if anything failed along the way.
+bool CloseReplayWriter(ReplayWriter* Writer)
+{
+    if(Writer->File == NULL)
+    {
+        return false;
+    }
+
+    EndReplayGame(Writer);
+
+    ReplayHeader Header;
+    memset(&Header, 0, sizeof(Header));
+
+    Header.Magic            = REPLAY_MAGIC;
+    Header.Version          = REPLAY_VERSION;
+    Header.GameCount        = Writer->GameCount;
+    Header.KeyframePieces   = Writer->KeyframePieces;
+    Header.IndexOffset      = Writer->Offset;
+    Header.PieceSet         = GetActivePieces()->SetId;
+
+    WriteReplayBytes(Writer, Writer->Index, sizeof(ReplayGame)*Writer->GameCount);
+
+    bool Result = Writer->Valid &&
+                  (fseek(Writer->File, 0, SEEK_SET) == 0) &&
+                  (fwrite(&Header, sizeof(Header), 1, Writer->File) == 1);
+
+    Result = (fclose(Writer->File) == 0) && Result;
+
+    HeapFree(Writer->Inputs);
+    HeapFree(Writer->Keyframes);
+    HeapFree(Writer->Index);
+    memset(Writer, 0, sizeof(*Writer));
+
+    return Result;
+}
+
+/*
+ * Reading
+ */
+
+bool MapReplayFile(const char* Path, ReplayArchive* Archive)
+{
+#if defined(_WIN32)
+    HANDLE File = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if(File == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER Size;
+    HANDLE Mapping = NULL;
+    void* Memory = NULL;
+
+    if( GetFileSizeEx(File, &Size) && (Size.QuadPart > 0) )
+    {
+        Mapping = CreateFileMappingA(File, NULL, PAGE_READONLY, 0, 0, NULL);
+    }
+
+    if(Mapping)
+    {
+        Memory = MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+
+    //The mapping keeps the file open
+    CloseHandle(File);
+
+    if(Memory == NULL)
+    {
+        if(Mapping)
+        {
+            CloseHandle(Mapping);
+        }
+
+        return false;
+    }
+
+    Archive->Base = (const unsigned char*)Memory;
+    Archive->Size = (size_t)Size.QuadPart;
+    Archive->Handle = Mapping;
+#else
+    int File = open(Path, O_RDONLY);
+
+    if(File < 0)
+    {
+        return false;
+    }
+
+    struct stat Info;
+    void* Memory = MAP_FAILED;
+
+    if( (fstat(File, &Info) == 0) && (Info.st_size > 0) )
+    {
+        Memory = mmap(NULL, Info.st_size, PROT_READ, MAP_SHARED, File, 0);
+    }
+
+    close(File);
+
+    if(Memory == MAP_FAILED)
+    {
+        return false;
+    }
+
+    Archive->Base = (const unsigned char*)Memory;
+    Archive->Size = Info.st_size;
+#endif
+
+    return true;
+}
+
+void UnmapReplayFile(ReplayArchive* Archive)
+{
+#if defined(_WIN32)
+    UnmapViewOfFile(Archive->Base);
+    CloseHandle((HANDLE)Archive->Handle);
+#else
+    munmap((void*)Archive->Base, Archive->Size);
+#endif
+}
+
+//Valid is false if the file is missing, truncated or not an archive
+ReplayArchive OpenReplayArchive(const char* Path)
+{
+    ReplayArchive Result;
+    memset(&Result, 0, sizeof(Result));
+
+    if( !MapReplayFile(Path, &Result) )
+    {
+        printf("Could not open replay %s!\n", Path);
+        return Result;
+    }
+
+    const ReplayHeader* Header = (const ReplayHeader*)Result.Base;
+
+    bool Valid = (Result.Size >= sizeof(ReplayHeader)) &&
+                 (Header->Magic == REPLAY_MAGIC) && (Header->Version == REPLAY_VERSION) &&
+                 (Header->IndexOffset <= Result.Size) && ((Header->IndexOffset & 7) == 0) &&
+                 (Header->PieceSet < PIECE_SET_COUNT) &&
+                 ((Result.Size - Header->IndexOffset)/sizeof(ReplayGame) >= Header->GameCount);
+
+    const ReplayGame* Games = Valid ? (const ReplayGame*)(Result.Base + Header->IndexOffset) : NULL;
+
+    for(unsigned int Index = 0; Valid && (Index < Header->GameCount); ++Index)
+    {
+        const ReplayGame* Game = Games + Index;
+
+        Valid = (Game->KeyframeCount > 0) && ((Game->KeyframeOffset & 7) == 0) &&
+                (Game->InputOffset + Game->TickCount <= Game->KeyframeOffset) &&
+                (Game->KeyframeOffset + (unsigned long long)Game->KeyframeCount*sizeof(ReplayKeyframe) <= Header->IndexOffset);
+    }
+
+    if(Valid)
+    {
+        Valid = UsePieceSet(Header->PieceSet);
+    }
+
+    //Keyframes are loaded straight into games and replayed on from, so their
+    //pieces have to be of the set just put in use and their ticks in order
+    //within the game's inputs
+    for(unsigned int Index = 0; Valid && (Index < Header->GameCount); ++Index)
+    {
+        const ReplayGame* Game = Games + Index;
+        const ReplayKeyframe* Keyframes = (const ReplayKeyframe*)(Result.Base + Game->KeyframeOffset);
+
+        for(unsigned int Keyframe = 0; Valid && (Keyframe < Game->KeyframeCount); ++Keyframe)
+        {
+            Valid = (Keyframes[Keyframe].Tick <= Game->TickCount) &&
+                    ((Keyframe == 0) || (Keyframes[Keyframe - 1].Tick <= Keyframes[Keyframe].Tick)) &&
+                    ValidGameSnapshot(&Keyframes[Keyframe].Snapshot);
+        }
+    }
+
+    if(!Valid)
+    {
+        printf("%s is not a replay archive, or is damaged!\n", Path);
+        UnmapReplayFile(&Result);
+        memset(&Result, 0, sizeof(Result));
+        return Result;
+    }
+
+    Result.Header = Header;
+    Result.Games = Games;
+    Result.Valid = true;
+
+    return Result;
+}
+
+void CloseReplayArchive(ReplayArchive* Archive)
+{
+    if(Archive->Valid)
+    {
+        UnmapReplayFile(Archive);
+    }
+
+    memset(Archive, 0, sizeof(*Archive));
+}
+
+const unsigned char* GetReplayInputs(const ReplayArchive* Archive, unsigned int Game)
+{
+    return Archive->Base + Archive->Games[Game].InputOffset;
+}
+
+const ReplayKeyframe* GetReplayKeyframes(const ReplayArchive* Archive, unsigned int Game)
+{
+    return (const ReplayKeyframe*)(Archive->Base + Archive->Games[Game].KeyframeOffset);
+}
+
+//The last keyframe at or before Tick
+const ReplayKeyframe* FindReplayKeyframe(const ReplayArchive* Archive, unsigned int Game, unsigned int Tick)
+{
+    const ReplayKeyframe* Keyframes = GetReplayKeyframes(Archive, Game);
+    unsigned int Low = 0;
+    unsigned int High = Archive->Games[Game].KeyframeCount;
+
+    while(High - Low > 1)
+    {
+        unsigned int Middle = (Low + High)/2;
+
+        if(Keyframes[Middle].Tick <= Tick)
+        {
+            Low = Middle;
+        }
+        else
+        {
+            High = Middle;
+        }
+    }
+
+    return Keyframes + Low;
+}
+
+//Runs the recorded inputs for ticks From up to (not including) To
+GameData SimulateReplay(GameData Current, const unsigned char* Inputs, unsigned int From, unsigned int To)
+{
+    GameData Result = Current;
+
+    for(unsigned int Tick = From; Tick < To; ++Tick)
+    {
+        Result = SimulateTick(Result, UnpackReplayInputs(Inputs[Tick]));
+    }
+
+    return Result;
+}
+
+//Result must already own its grids, as one from GenerateGameFromSnapshot
+//does. False if Tick is past the end of the game.
+bool SeekReplay(const ReplayArchive* Archive, unsigned int Game, unsigned int Tick, GameData* Result)
+{
+    if( (Game >= Archive->Header->GameCount) || (Tick > Archive->Games[Game].TickCount) )
+    {
+        return false;
+    }
+
+    const ReplayKeyframe* Keyframe = FindReplayKeyframe(Archive, Game, Tick);
+
+    LoadGameSnapshot(&Keyframe->Snapshot, Result);
+    *Result = SimulateReplay(*Result, GetReplayInputs(Archive, Game), Keyframe->Tick, Tick);
+
+    return true;
+}
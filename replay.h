@@ -0,0 +1,154 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "game.h"
+#include "snapshot.h"
+
+/*
+ * Replay Archives
+ *
+ * Games are deterministic given their starting state and the keys pressed on
+ * each tick, so a replay is one input byte per tick plus a keyframe (a full
+ * GameSnapshot) at the start and again every KeyframePieces pieces. Any tick
+ * can then be reached by loading the keyframe before it and simulating at
+ * most a few pieces' worth of ticks, and a corpus can be split at keyframes
+ * to be re-run on as many threads as there are cores.
+ *
+ * Many games go in one file, meant to be memory mapped whole:
+ *
+ *   ReplayHeader
+ *   Per game: TickCount input bytes, padded to 8, then KeyframeCount ReplayKeyframes
+ *   GameCount ReplayGames, at IndexOffset
+ *
+ * A keyframe holds the state before the inputs of its tick are applied, so
+ * keyframe 0 is the state a game started from at tick 0. Fields are in host
+ * byte order.
+ *
+ * The games only replay the same with the pieces they were dealt from, so
+ * opening an archive puts its piece set in use.
+ */
+
+enum ReplayConstants{
+    REPLAY_MAGIC    = 0x52414741, //"AGAR"
+    REPLAY_VERSION  = 1,
+
+    REPLAY_DEFAULT_KEYFRAME_PIECES = 16
+};
+
+//One byte per tick
+enum ReplayInputBits{
+    REPLAY_UP       = 1 << 0,
+    REPLAY_DOWN     = 1 << 1,
+    REPLAY_LEFT     = 1 << 2,
+    REPLAY_RIGHT    = 1 << 3,
+    REPLAY_SPACE    = 1 << 4,
+    REPLAY_ESCAPE   = 1 << 5
+};
+
+//Bits in ReplayGame::Flags
+enum ReplayGameFlags{
+    REPLAY_FINISHED = 1 << 0    //Played to game over, rather than cut off
+};
+
+struct ReplayHeader{
+    unsigned int Magic;
+    unsigned int Version;
+    unsigned int GameCount;
+    unsigned int KeyframePieces;
+    unsigned long long IndexOffset;
+    unsigned int PieceSet;      //PieceSetId the games were dealt from
+    unsigned int Reserved;
+};
+
+struct ReplayKeyframe{
+    unsigned int Tick;
+    unsigned int Piece;     //Pieces locked before this tick
+    GameSnapshot Snapshot;
+};
+
+struct ReplayGame{
+    unsigned long long InputOffset;
+    unsigned long long KeyframeOffset;
+    unsigned int TickCount;
+    unsigned int KeyframeCount;
+    unsigned int PieceCount;
+    unsigned int Score;
+    unsigned int Lines;
+    unsigned int Flags;
+};
+
+typedef char ReplayLayoutCheck[(sizeof(ReplayKeyframe)%8 == 0 && sizeof(ReplayGame) == 40) ? 1 : -1];
+
+/*
+ * Recording
+ *
+ * Begin a game once it's RUNNING, record every tick after simulating it, and
+ * end it at game over, or whenever recording stops. Ticks known to have had
+ * no input and no gravity (the ones FastForwardGame skips) can be recorded in
+ * bulk with SkipReplayTicks.
+ */
+
+struct ReplayWriter{
+    bool Valid;
+    FILE* File;
+    unsigned long long Offset;
+    unsigned int KeyframePieces;
+
+    //The game being recorded
+    bool Recording;
+    unsigned char* Inputs;
+    unsigned int InputCapacity;
+    ReplayKeyframe* Keyframes;
+    unsigned int KeyframeCapacity;
+    ReplayGame Game;
+    unsigned int PiecesSinceKeyframe;
+
+    ReplayGame* Index;
+    unsigned int IndexCapacity;
+    unsigned int GameCount;
+};
+
+unsigned int    PackReplayInputs(InputState Inputs);
+InputState      UnpackReplayInputs(unsigned int Bits);
+void            SaveReplaySnapshot(const GameData* Game, GameSnapshot* Snapshot);
+
+ReplayWriter    OpenReplayWriter(const char* Path, unsigned int KeyframePieces);
+void            BeginReplayGame(ReplayWriter* Writer, const GameData* Game);
+void            RecordReplayTick(ReplayWriter* Writer, const GameData* Game, unsigned int Inputs);
+
+//The writer counts pieces and lines as a game event listener (see events.h),
+//so it has to be passed to SimulateTick as well as getting every tick
+void            OnPieceLocked(ReplayWriter* Writer, const Tetromino& Piece);
+void            OnLinesCleared(ReplayWriter* Writer, const unsigned int* Rows, unsigned int Count);
+void            SkipReplayTicks(ReplayWriter* Writer, unsigned int Ticks);
+bool            EndReplayGame(ReplayWriter* Writer);
+bool            CloseReplayWriter(ReplayWriter* Writer);
+
+/*
+ * Reading
+ */
+
+struct ReplayArchive{
+    bool Valid;
+    const ReplayHeader* Header;
+    const ReplayGame* Games;
+
+    const unsigned char* Base;
+    size_t Size;
+    void* Handle;   //Windows only
+};
+
+ReplayArchive           OpenReplayArchive(const char* Path);
+void                    CloseReplayArchive(ReplayArchive* Archive);
+
+const unsigned char*    GetReplayInputs(const ReplayArchive* Archive, unsigned int Game);
+const ReplayKeyframe*   GetReplayKeyframes(const ReplayArchive* Archive, unsigned int Game);
+const ReplayKeyframe*   FindReplayKeyframe(const ReplayArchive* Archive, unsigned int Game, unsigned int Tick);
+
+GameData                SimulateReplay(GameData Current, const unsigned char* Inputs, unsigned int From, unsigned int To);
+bool                    SeekReplay(const ReplayArchive* Archive, unsigned int Game, unsigned int Tick, GameData* Result);
+
+#endif
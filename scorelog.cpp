@@ -0,0 +1,902 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "scorelog.h"
+
+unsigned int GetScoreRecordLines(const ScoreRecord* Record)
+{
+    unsigned int Result = 0;
+
+    for(unsigned int Size = 1; Size <= TETROMINO_MAX_SIZE; ++Size)
+    {
+        Result += Size*Record->Clears[Size - 1];
+    }
+
+    return Result;
+}
+
+/*
+ * Tracking
+ */
+
+void BeginScoreTracking(ScoreTracker* Tracker, unsigned int Seed)
+{
+    memset(Tracker, 0, sizeof(*Tracker));
+
+    Tracker->Record.Seed = Seed;
+}
+
+void TrackScoreTicks(ScoreTracker* Tracker, const GameData* Game, unsigned int Ticks)
+{
+    if(Game->State != PAUSED)
+    {
+        Tracker->Record.Ticks += Ticks;
+    }
+}
+
+void OnPieceLocked(ScoreTracker* Tracker, const Tetromino&)
+{
+    Tracker->Record.Pieces++;
+}
+
+//Count is at most TETROMINO_MAX_SIZE
+void OnLinesCleared(ScoreTracker* Tracker, const unsigned int*, unsigned int Count)
+{
+    Tracker->Record.Clears[Count - 1]++;
+}
+
+ScoreRecord FinishScoreTracking(ScoreTracker* Tracker, const GameData* Game)
+{
+    Tracker->Record.Score = Game->Score;
+
+    return Tracker->Record;
+}
+
+/*
+ * Runs
+ */
+
+int CompareScoreKeysByScore(const void* A, const void* B)
+{
+    const ScoreKey* KeyA = (const ScoreKey*)A;
+    const ScoreKey* KeyB = (const ScoreKey*)B;
+
+    if(KeyA->Key != KeyB->Key)
+    {
+        return (KeyA->Key > KeyB->Key) ? -1 : 1;
+    }
+
+    return (KeyA->Record < KeyB->Record) ? -1 : (KeyA->Record > KeyB->Record);
+}
+
+int CompareScoreKeysBySeed(const void* A, const void* B)
+{
+    const ScoreKey* KeyA = (const ScoreKey*)A;
+    const ScoreKey* KeyB = (const ScoreKey*)B;
+
+    if(KeyA->Key != KeyB->Key)
+    {
+        return (KeyA->Key < KeyB->Key) ? -1 : 1;
+    }
+
+    return (KeyA->Record < KeyB->Record) ? -1 : (KeyA->Record > KeyB->Record);
+}
+
+//Both inputs are sorted by Compare, Earlier covering lower record numbers
+void MergeScoreKeys(const ScoreKey* Earlier, unsigned int EarlierCount, const ScoreKey* Later, unsigned int LaterCount,
+                    ScoreKey* Result, int (*Compare)(const void*, const void*))
+{
+    unsigned int A = 0;
+    unsigned int B = 0;
+
+    while( (A < EarlierCount) && (B < LaterCount) )
+    {
+        if(Compare(Later + B, Earlier + A) < 0)
+        {
+            *Result++ = Later[B++];
+        }
+        else
+        {
+            *Result++ = Earlier[A++];
+        }
+    }
+
+    memcpy(Result, Earlier + A, (EarlierCount - A)*sizeof(ScoreKey));
+    Result += EarlierCount - A;
+    memcpy(Result, Later + B, (LaterCount - B)*sizeof(ScoreKey));
+}
+
+bool SeekScoreFile(FILE* File, unsigned long long Offset)
+{
+#if defined(_WIN32)
+    return _fseeki64(File, (long long)Offset, SEEK_SET) == 0;
+#else
+    return fseeko(File, (off_t)Offset, SEEK_SET) == 0;
+#endif
+}
+
+unsigned long long GetScoreFileSize(FILE* File)
+{
+#if defined(_WIN32)
+    _fseeki64(File, 0, SEEK_END);
+    return (unsigned long long)_ftelli64(File);
+#else
+    fseeko(File, 0, SEEK_END);
+    return (unsigned long long)ftello(File);
+#endif
+}
+
+bool ReserveScoreKeys(ScoreLogWriter* Writer, unsigned long long Count)
+{
+    if(Count <= Writer->KeyCapacity)
+    {
+        return true;
+    }
+
+    unsigned long long Capacity = Writer->KeyCapacity ? Writer->KeyCapacity : 1024;
+
+    while(Capacity < Count)
+    {
+        Capacity *= 2;
+    }
+
+    ScoreKey* Keys = (ScoreKey*)realloc(Writer->Keys, Capacity*sizeof(ScoreKey));
+
+    if(Keys == NULL)
+    {
+        return false;
+    }
+
+    Writer->Keys = Keys;
+    Writer->KeyCapacity = Capacity;
+
+    return true;
+}
+
+//Sorts a batch into a run, merges in the runs before it that are no more than
+//twice its size and writes the result over them. The header goes in last, so
+//a run cut short by a crash is never mistaken for a complete one.
+bool AppendScoreRun(ScoreLogWriter* Writer, const ScoreRecord* Records, unsigned int Count, unsigned long long FirstRecord)
+{
+    if( !ReserveScoreKeys(Writer, 2ull*Count) )
+    {
+        return false;
+    }
+
+    ScoreKey* ByScore = Writer->Keys;
+    ScoreKey* BySeed = Writer->Keys + Count;
+
+    for(unsigned int Index = 0; Index < Count; ++Index)
+    {
+        unsigned int Record = (unsigned int)(FirstRecord + Index);
+
+        ByScore[Index].Key = Records[Index].Score;
+        ByScore[Index].Record = Record;
+        BySeed[Index].Key = Records[Index].Seed;
+        BySeed[Index].Record = Record;
+    }
+
+    qsort(ByScore, Count, sizeof(ScoreKey), CompareScoreKeysByScore);
+    qsort(BySeed, Count, sizeof(ScoreKey), CompareScoreKeysBySeed);
+
+    //Goes after the last run, or over the runs it's merged with
+    unsigned long long Offset = 0;
+
+    if(Writer->RunCount)
+    {
+        const ScoreRunEntry* Last = Writer->Runs + Writer->RunCount - 1;
+        Offset = Last->Offset + sizeof(ScoreRunHeader) + 2ull*Last->Count*sizeof(ScoreKey);
+    }
+
+    while( Writer->RunCount && (Writer->Runs[Writer->RunCount - 1].Count <= 2ull*Count) )
+    {
+        ScoreRunEntry Previous = Writer->Runs[Writer->RunCount - 1];
+        unsigned long long Merged = (unsigned long long)Previous.Count + Count;
+
+        //Keys laid out as: this run, the previous run, then the merge of both
+        if( !ReserveScoreKeys(Writer, 4*Merged) )
+        {
+            return false;
+        }
+
+        ScoreKey* Current = Writer->Keys;
+        ScoreKey* Loaded = Writer->Keys + 2ull*Count;
+        ScoreKey* Result = Loaded + 2ull*Previous.Count;
+
+        if( !SeekScoreFile(Writer->Index, Previous.Offset + sizeof(ScoreRunHeader)) ||
+            (fread(Loaded, sizeof(ScoreKey), 2ull*Previous.Count, Writer->Index) != 2ull*Previous.Count) )
+        {
+            return false;
+        }
+
+        MergeScoreKeys(Loaded, Previous.Count, Current, Count, Result, CompareScoreKeysByScore);
+        MergeScoreKeys(Loaded + Previous.Count, Previous.Count, Current + Count, Count, Result + Merged, CompareScoreKeysBySeed);
+        memmove(Writer->Keys, Result, 2*Merged*sizeof(ScoreKey));
+
+        Count = (unsigned int)Merged;
+        FirstRecord = Previous.FirstRecord;
+        Offset = Previous.Offset;
+        Writer->RunCount--;
+    }
+
+    ScoreRunHeader Header;
+    Header.Magic = 0;
+    Header.Count = Count;
+    Header.FirstRecord = FirstRecord;
+
+    bool Written = SeekScoreFile(Writer->Index, Offset) &&
+                   (fwrite(&Header, sizeof(Header), 1, Writer->Index) == 1) &&
+                   (fwrite(Writer->Keys, sizeof(ScoreKey), 2ull*Count, Writer->Index) == 2ull*Count) &&
+                   (fflush(Writer->Index) == 0);
+
+    Header.Magic = SCORE_RUN_MAGIC;
+
+    Written = Written && SeekScoreFile(Writer->Index, Offset) &&
+              (fwrite(&Header, sizeof(Header), 1, Writer->Index) == 1) &&
+              (fflush(Writer->Index) == 0);
+
+    if(!Written)
+    {
+        return false;
+    }
+
+    ScoreRunEntry* Entry = Writer->Runs + Writer->RunCount++;
+    Entry->Offset = Offset;
+    Entry->FirstRecord = FirstRecord;
+    Entry->Count = Count;
+
+    return true;
+}
+
+/*
+ * Writing
+ */
+
+//Appends to the log, then indexes what was appended
+bool WriteScoreBatch(ScoreLogWriter* Writer, const ScoreRecord* Records, unsigned int Count)
+{
+    unsigned long long Offset = sizeof(ScoreLogHeader) + Writer->RecordCount*sizeof(ScoreRecord);
+
+    bool Written = SeekScoreFile(Writer->Log, Offset) &&
+                   (fwrite(Records, sizeof(ScoreRecord), Count, Writer->Log) == Count) &&
+                   (fflush(Writer->Log) == 0);
+
+    if( !Written || !AppendScoreRun(Writer, Records, Count, Writer->RecordCount) )
+    {
+        return false;
+    }
+
+    Writer->RecordCount += Count;
+
+    return true;
+}
+
+void RunScoreLogWriter(ScoreLogWriter* Writer)
+{
+    for(;;)
+    {
+        //Read before the queue, so whatever was submitted before stopping is
+        //still written
+        bool Stopping = Writer->Stop.load(std::memory_order_acquire);
+
+        unsigned int Submitted = Writer->Submitted.load(std::memory_order_acquire);
+        unsigned int Written = Writer->Written.load(std::memory_order_relaxed);
+        unsigned int Count = Submitted - Written;
+
+        if(Count == 0)
+        {
+            if(Stopping)
+            {
+                break;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(SCORE_LOG_FLUSH_MS));
+            continue;
+        }
+
+        for(unsigned int Index = 0; Index < Count; ++Index)
+        {
+            Writer->Batch[Index] = Writer->Queue[(Written + Index) & (SCORE_LOG_QUEUE_SIZE - 1)];
+        }
+
+        Writer->Written.store(Submitted, std::memory_order_release);
+
+        if( !Writer->Failed && !WriteScoreBatch(Writer, Writer->Batch, Count) )
+        {
+            printf("Writing score log %s failed, no more games will be logged!\n", Writer->IndexPath);
+            Writer->Failed = true;
+        }
+    }
+}
+
+bool SubmitScoreRecord(ScoreLogWriter* Writer, const ScoreRecord* Record)
+{
+    unsigned int Submitted = Writer->Submitted.load(std::memory_order_relaxed);
+    unsigned int Written = Writer->Written.load(std::memory_order_acquire);
+
+    if(Submitted - Written >= SCORE_LOG_QUEUE_SIZE)
+    {
+        Writer->Dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    Writer->Queue[Submitted & (SCORE_LOG_QUEUE_SIZE - 1)] = *Record;
+    Writer->Submitted.store(Submitted + 1, std::memory_order_release);
+
+    return true;
+}
+
+FILE* OpenScoreFile(const char* Path)
+{
+    FILE* Result = fopen(Path, "r+b");
+
+    if(Result == NULL)
+    {
+        Result = fopen(Path, "w+b");
+    }
+
+    return Result;
+}
+
+//Creates the log if it's missing, indexes any records the index doesn't cover
+//and starts the writer thread. Valid is false if either file can't be opened
+//or the log isn't one.
+bool OpenScoreLogWriter(ScoreLogWriter* Writer, const char* Path)
+{
+    Writer->Valid = false;
+    Writer->Log = NULL;
+    Writer->Index = NULL;
+    Writer->RecordCount = 0;
+    Writer->RunCount = 0;
+    Writer->Batch = NULL;
+    Writer->Keys = NULL;
+    Writer->KeyCapacity = 0;
+    Writer->Failed = false;
+    Writer->Queue = NULL;
+    Writer->Submitted.store(0);
+    Writer->Written.store(0);
+    Writer->Dropped.store(0);
+    Writer->Stop.store(false);
+
+    if(strlen(Path) + 5 > SCORE_LOG_PATH_MAX)
+    {
+        printf("Score log path %s is too long!\n", Path);
+        return false;
+    }
+
+    sprintf(Writer->IndexPath, "%s.idx", Path);
+
+    Writer->Log = OpenScoreFile(Path);
+    Writer->Index = OpenScoreFile(Writer->IndexPath);
+    Writer->Batch = (ScoreRecord*)malloc(SCORE_LOG_QUEUE_SIZE*sizeof(ScoreRecord));
+    Writer->Queue = (ScoreRecord*)malloc(SCORE_LOG_QUEUE_SIZE*sizeof(ScoreRecord));
+
+    //Touched now, so the first games submitted don't page fault
+    if(Writer->Queue)
+    {
+        memset(Writer->Queue, 0, SCORE_LOG_QUEUE_SIZE*sizeof(ScoreRecord));
+    }
+
+    bool Valid = Writer->Log && Writer->Index && Writer->Batch && Writer->Queue;
+
+    if(!Valid)
+    {
+        printf("Could not open score log %s!\n", Path);
+    }
+
+    //A new log gets a header, an existing one has to have a matching one
+    ScoreLogHeader Header;
+    unsigned long long LogSize = Valid ? GetScoreFileSize(Writer->Log) : 0;
+
+    if( Valid && (LogSize == 0) )
+    {
+        Header.Magic = SCORE_LOG_MAGIC;
+        Header.Version = SCORE_LOG_VERSION;
+        Header.RecordSize = sizeof(ScoreRecord);
+        Header.Reserved = 0;
+
+        Valid = SeekScoreFile(Writer->Log, 0) && (fwrite(&Header, sizeof(Header), 1, Writer->Log) == 1) &&
+                (fflush(Writer->Log) == 0);
+        LogSize = sizeof(Header);
+    }
+    else if(Valid)
+    {
+        Valid = SeekScoreFile(Writer->Log, 0) && (fread(&Header, sizeof(Header), 1, Writer->Log) == 1) &&
+                (Header.Magic == SCORE_LOG_MAGIC) && (Header.Version == SCORE_LOG_VERSION) &&
+                (Header.RecordSize == sizeof(ScoreRecord));
+
+        if(!Valid)
+        {
+            printf("%s is not a score log!\n", Path);
+        }
+    }
+
+    //A record cut short at the end is overwritten by the next one
+    Writer->RecordCount = Valid ? (LogSize - sizeof(ScoreLogHeader))/sizeof(ScoreRecord) : 0;
+
+    //Keep every complete run that carries on from the one before
+    unsigned long long IndexSize = Valid ? GetScoreFileSize(Writer->Index) : 0;
+    unsigned long long Offset = 0;
+    unsigned long long Indexed = 0;
+    ScoreRunHeader Run;
+
+    while( Valid && (Writer->RunCount < SCORE_LOG_MAX_RUNS) && (Offset + sizeof(Run) <= IndexSize) &&
+           SeekScoreFile(Writer->Index, Offset) && (fread(&Run, sizeof(Run), 1, Writer->Index) == 1) &&
+           (Run.Magic == SCORE_RUN_MAGIC) && Run.Count && (Run.FirstRecord == Indexed) &&
+           (Indexed + Run.Count <= Writer->RecordCount) &&
+           (Offset + sizeof(Run) + 2ull*Run.Count*sizeof(ScoreKey) <= IndexSize) )
+    {
+        ScoreRunEntry* Entry = Writer->Runs + Writer->RunCount++;
+        Entry->Offset = Offset;
+        Entry->FirstRecord = Run.FirstRecord;
+        Entry->Count = Run.Count;
+
+        Offset += sizeof(Run) + 2ull*Run.Count*sizeof(ScoreKey);
+        Indexed += Run.Count;
+    }
+
+    //Index whatever the last writer logged but didn't get to
+    unsigned long long Logged = Writer->RecordCount;
+    Writer->RecordCount = Indexed;
+
+    while( Valid && (Writer->RecordCount < Logged) )
+    {
+        unsigned long long Remaining = Logged - Writer->RecordCount;
+        unsigned int Count = (Remaining < SCORE_LOG_QUEUE_SIZE) ? (unsigned int)Remaining : (unsigned int)SCORE_LOG_QUEUE_SIZE;
+
+        Valid = SeekScoreFile(Writer->Log, sizeof(ScoreLogHeader) + Writer->RecordCount*sizeof(ScoreRecord)) &&
+                (fread(Writer->Batch, sizeof(ScoreRecord), Count, Writer->Log) == Count) &&
+                AppendScoreRun(Writer, Writer->Batch, Count, Writer->RecordCount);
+
+        Writer->RecordCount += Count;
+
+        if(!Valid)
+        {
+            printf("Could not index score log %s!\n", Path);
+        }
+    }
+
+    if(!Valid)
+    {
+        if(Writer->Log)     fclose(Writer->Log);
+        if(Writer->Index)   fclose(Writer->Index);
+
+        free(Writer->Batch);
+        free(Writer->Queue);
+        free(Writer->Keys);
+
+        Writer->Log = NULL;
+        Writer->Index = NULL;
+        Writer->Batch = NULL;
+        Writer->Queue = NULL;
+        Writer->Keys = NULL;
+
+        return false;
+    }
+
+    Writer->Thread = std::thread(RunScoreLogWriter, Writer);
+    Writer->Valid = true;
+
+    return true;
+}
+
+//Writes out everything submitted so far. False if anything failed to write.
+bool CloseScoreLogWriter(ScoreLogWriter* Writer)
+{
+    if(!Writer->Valid)
+    {
+        return false;
+    }
+
+    Writer->Stop.store(true, std::memory_order_release);
+    Writer->Thread.join();
+
+    bool Result = !Writer->Failed;
+
+    fclose(Writer->Log);
+    fclose(Writer->Index);
+    free(Writer->Batch);
+    free(Writer->Queue);
+    free(Writer->Keys);
+
+    Writer->Log = NULL;
+    Writer->Index = NULL;
+    Writer->Batch = NULL;
+    Writer->Queue = NULL;
+    Writer->Keys = NULL;
+    Writer->Valid = false;
+
+    return Result;
+}
+
+/*
+ * Queries
+ */
+
+bool MapScoreLogFile(const char* Path, ScoreLogMapping* Mapping)
+{
+    memset(Mapping, 0, sizeof(*Mapping));
+
+#if defined(_WIN32)
+    HANDLE File = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if(File == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER Size;
+    HANDLE Handle = NULL;
+    void* Memory = NULL;
+
+    if( GetFileSizeEx(File, &Size) && (Size.QuadPart > 0) )
+    {
+        Handle = CreateFileMappingA(File, NULL, PAGE_READONLY, 0, 0, NULL);
+    }
+
+    if(Handle)
+    {
+        Memory = MapViewOfFile(Handle, FILE_MAP_READ, 0, 0, 0);
+    }
+
+    //The mapping keeps the file open
+    CloseHandle(File);
+
+    if(Memory == NULL)
+    {
+        if(Handle)
+        {
+            CloseHandle(Handle);
+        }
+
+        return false;
+    }
+
+    Mapping->Base = (const unsigned char*)Memory;
+    Mapping->Size = (size_t)Size.QuadPart;
+    Mapping->Handle = Handle;
+#else
+    int File = open(Path, O_RDONLY);
+
+    if(File < 0)
+    {
+        return false;
+    }
+
+    struct stat Info;
+    void* Memory = MAP_FAILED;
+
+    if( (fstat(File, &Info) == 0) && (Info.st_size > 0) )
+    {
+        Memory = mmap(NULL, Info.st_size, PROT_READ, MAP_SHARED, File, 0);
+    }
+
+    close(File);
+
+    if(Memory == MAP_FAILED)
+    {
+        return false;
+    }
+
+    Mapping->Base = (const unsigned char*)Memory;
+    Mapping->Size = Info.st_size;
+#endif
+
+    return true;
+}
+
+void UnmapScoreLogFile(ScoreLogMapping* Mapping)
+{
+    if(Mapping->Base)
+    {
+#if defined(_WIN32)
+        UnmapViewOfFile(Mapping->Base);
+        CloseHandle((HANDLE)Mapping->Handle);
+#else
+        munmap((void*)Mapping->Base, Mapping->Size);
+#endif
+    }
+
+    memset(Mapping, 0, sizeof(*Mapping));
+}
+
+//Valid is false if the log is missing or isn't one. A missing or damaged
+//index only means more of the log gets scanned.
+ScoreLog OpenScoreLog(const char* Path)
+{
+    ScoreLog Result;
+    memset(&Result, 0, sizeof(Result));
+
+    if( !MapScoreLogFile(Path, &Result.LogFile) )
+    {
+        printf("Could not open score log %s!\n", Path);
+        return Result;
+    }
+
+    const ScoreLogHeader* Header = (const ScoreLogHeader*)Result.LogFile.Base;
+
+    if( (Result.LogFile.Size < sizeof(ScoreLogHeader)) || (Header->Magic != SCORE_LOG_MAGIC) ||
+        (Header->Version != SCORE_LOG_VERSION) || (Header->RecordSize != sizeof(ScoreRecord)) )
+    {
+        printf("%s is not a score log!\n", Path);
+        UnmapScoreLogFile(&Result.LogFile);
+        return Result;
+    }
+
+    Result.Records = (const ScoreRecord*)(Result.LogFile.Base + sizeof(ScoreLogHeader));
+    Result.RecordCount = (Result.LogFile.Size - sizeof(ScoreLogHeader))/sizeof(ScoreRecord);
+
+    char IndexPath[SCORE_LOG_PATH_MAX];
+    snprintf(IndexPath, sizeof(IndexPath), "%s.idx", Path);
+
+    if( MapScoreLogFile(IndexPath, &Result.IndexFile) )
+    {
+        unsigned long long Offset = 0;
+
+        while( (Result.RunCount < SCORE_LOG_MAX_RUNS) && (Offset + sizeof(ScoreRunHeader) <= Result.IndexFile.Size) )
+        {
+            const ScoreRunHeader* Run = (const ScoreRunHeader*)(Result.IndexFile.Base + Offset);
+            unsigned long long End = Offset + sizeof(ScoreRunHeader) + 2ull*Run->Count*sizeof(ScoreKey);
+
+            if( (Run->Magic != SCORE_RUN_MAGIC) || !Run->Count || (Run->FirstRecord != Result.IndexedCount) ||
+                (Result.IndexedCount + Run->Count > Result.RecordCount) || (End > Result.IndexFile.Size) )
+            {
+                break;
+            }
+
+            ScoreRun* Entry = Result.Runs + Result.RunCount++;
+            Entry->FirstRecord = Run->FirstRecord;
+            Entry->Count = Run->Count;
+            Entry->ByScore = (const ScoreKey*)(Run + 1);
+            Entry->BySeed = Entry->ByScore + Run->Count;
+
+            Result.IndexedCount += Run->Count;
+            Offset = End;
+        }
+    }
+
+    Result.Valid = true;
+
+    return Result;
+}
+
+void CloseScoreLog(ScoreLog* Log)
+{
+    UnmapScoreLogFile(&Log->LogFile);
+    UnmapScoreLogFile(&Log->IndexFile);
+
+    memset(Log, 0, sizeof(*Log));
+}
+
+//Higher scores first, the earlier game first between equal ones
+bool ScoreRanksAbove(unsigned int ScoreA, unsigned long long RecordA, unsigned int ScoreB, unsigned long long RecordB)
+{
+    return (ScoreA > ScoreB) || ( (ScoreA == ScoreB) && (RecordA < RecordB) );
+}
+
+//Merges the heads of the runs, which are already in order, with the best of
+//the unindexed tail. Returns how many records were found, at most Count.
+unsigned int GetTopScores(const ScoreLog* Log, unsigned int Count, unsigned long long* Records)
+{
+    unsigned long long Tail = Log->RecordCount - Log->IndexedCount;
+    unsigned int TailCount = (Tail < Count) ? (unsigned int)Tail : Count;
+    unsigned long long* TailBest = (unsigned long long*)malloc((TailCount + 1)*sizeof(unsigned long long));
+    unsigned int TailFound = 0;
+
+    //Insertion into the best TailCount so far
+    for(unsigned long long Record = Log->IndexedCount; Record < Log->RecordCount; ++Record)
+    {
+        unsigned int Score = Log->Records[Record].Score;
+        unsigned int Position = TailFound;
+
+        while( Position && ScoreRanksAbove(Score, Record, Log->Records[TailBest[Position - 1]].Score, TailBest[Position - 1]) )
+        {
+            if(Position < TailCount)
+            {
+                TailBest[Position] = TailBest[Position - 1];
+            }
+
+            --Position;
+        }
+
+        if(Position < TailCount)
+        {
+            TailBest[Position] = Record;
+            TailFound += (TailFound < TailCount);
+        }
+    }
+
+    unsigned int Heads[SCORE_LOG_MAX_RUNS] = {};
+    unsigned int TailHead = 0;
+    unsigned int Found = 0;
+
+    while(Found < Count)
+    {
+        int BestRun = -1;
+        unsigned int BestScore = 0;
+        unsigned long long BestRecord = 0;
+
+        for(unsigned int Run = 0; Run < Log->RunCount; ++Run)
+        {
+            if(Heads[Run] < Log->Runs[Run].Count)
+            {
+                const ScoreKey* Key = Log->Runs[Run].ByScore + Heads[Run];
+
+                if( (BestRun < 0) || ScoreRanksAbove(Key->Key, Key->Record, BestScore, BestRecord) )
+                {
+                    BestRun = Run;
+                    BestScore = Key->Key;
+                    BestRecord = Key->Record;
+                }
+            }
+        }
+
+        if(TailHead < TailFound)
+        {
+            unsigned long long Record = TailBest[TailHead];
+
+            if( (BestRun < 0) || ScoreRanksAbove(Log->Records[Record].Score, Record, BestScore, BestRecord) )
+            {
+                BestRun = Log->RunCount;
+                BestRecord = Record;
+            }
+        }
+
+        if(BestRun < 0)
+        {
+            break;
+        }
+
+        if(BestRun == (int)Log->RunCount)
+        {
+            TailHead++;
+        }
+        else
+        {
+            Heads[BestRun]++;
+        }
+
+        Records[Found++] = BestRecord;
+    }
+
+    free(TailBest);
+
+    return Found;
+}
+
+unsigned long long CountScoresAtLeast(const ScoreLog* Log, unsigned int Score)
+{
+    unsigned long long Result = 0;
+
+    //Runs are highest first, so the count is where the scores drop below
+    for(unsigned int Run = 0; Run < Log->RunCount; ++Run)
+    {
+        const ScoreKey* Keys = Log->Runs[Run].ByScore;
+        unsigned int Low = 0;
+        unsigned int High = Log->Runs[Run].Count;
+
+        while(Low < High)
+        {
+            unsigned int Middle = Low + (High - Low)/2;
+
+            if(Keys[Middle].Key >= Score)
+            {
+                Low = Middle + 1;
+            }
+            else
+            {
+                High = Middle;
+            }
+        }
+
+        Result += Low;
+    }
+
+    for(unsigned long long Record = Log->IndexedCount; Record < Log->RecordCount; ++Record)
+    {
+        Result += (Log->Records[Record].Score >= Score);
+    }
+
+    return Result;
+}
+
+//The lowest score at least Percentile percent of games scored no more than
+unsigned int GetScorePercentile(const ScoreLog* Log, double Percentile)
+{
+    if(Log->RecordCount == 0)
+    {
+        return 0;
+    }
+
+    double Wanted = Percentile*Log->RecordCount/100.0;
+    unsigned long long Target = (unsigned long long)Wanted;
+    Target += (Target < Wanted);
+    Target = (Target < 1) ? 1 : (Target > Log->RecordCount) ? Log->RecordCount : Target;
+
+    unsigned long long Best;
+    GetTopScores(Log, 1, &Best);
+
+    unsigned long long Low = 0;
+    unsigned long long High = Log->Records[Best].Score;
+
+    while(Low < High)
+    {
+        unsigned long long Middle = Low + (High - Low)/2;
+        unsigned long long AtMost = Log->RecordCount - CountScoresAtLeast(Log, (unsigned int)(Middle + 1));
+
+        if(AtMost >= Target)
+        {
+            High = Middle;
+        }
+        else
+        {
+            Low = Middle + 1;
+        }
+    }
+
+    return (unsigned int)Low;
+}
+
+//Every game played from Seed, in the order they were logged. Returns how many
+//there are, which may be more than MaxRecords.
+unsigned long long FindSeedScores(const ScoreLog* Log, unsigned int Seed, unsigned long long* Records, unsigned int MaxRecords)
+{
+    unsigned long long Result = 0;
+
+    for(unsigned int Run = 0; Run < Log->RunCount; ++Run)
+    {
+        const ScoreKey* Keys = Log->Runs[Run].BySeed;
+        unsigned int Count = Log->Runs[Run].Count;
+        unsigned int Low = 0;
+        unsigned int High = Count;
+
+        while(Low < High)
+        {
+            unsigned int Middle = Low + (High - Low)/2;
+
+            if(Keys[Middle].Key < Seed)
+            {
+                Low = Middle + 1;
+            }
+            else
+            {
+                High = Middle;
+            }
+        }
+
+        for(; (Low < Count) && (Keys[Low].Key == Seed); ++Low, ++Result)
+        {
+            if(Result < MaxRecords)
+            {
+                Records[Result] = Keys[Low].Record;
+            }
+        }
+    }
+
+    for(unsigned long long Record = Log->IndexedCount; Record < Log->RecordCount; ++Record)
+    {
+        if(Log->Records[Record].Seed == Seed)
+        {
+            if(Result < MaxRecords)
+            {
+                Records[Result] = Record;
+            }
+
+            ++Result;
+        }
+    }
+
+    return Result;
+}
@@ -0,0 +1,186 @@
+#ifndef SCORELOG_H
+#define SCORELOG_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <atomic>
+#include <thread>
+
+#include "game.h"
+
+/*
+ * Score Log
+ *
+ * Every finished game's stats, appended to a log of fixed size records:
+ *
+ *   <path>         ScoreLogHeader, then ScoreRecords in the order games ended
+ *   <path>.idx     Sorted runs, each covering the records the run before it
+ *                  stopped at: ScoreRunHeader, Count ScoreKeys by score
+ *                  (highest first), then Count ScoreKeys by seed
+ *
+ * Each batch the writer appends becomes a run, and a run is merged into the
+ * one before it whenever that one is no more than twice its size. Run sizes
+ * then at least halve from the front of the file to the back, so however many
+ * records there are, a query binary searches or merges a few dozen runs at
+ * most and never touches the log itself beyond the records it returns.
+ *
+ * Records past the end of the last complete run (a crash between writing the
+ * log and the index, say) are scanned. The writer indexes them the next time
+ * it opens the log. Fields are in host byte order, and record numbers in the
+ * index are 32 bits, so a log holds up to 4G games.
+ *
+ * Merges rewrite the tail of the index in place, so query a log while nothing
+ * is writing to it.
+ */
+
+enum ScoreLogConstants{
+    SCORE_LOG_MAGIC     = 0x53414741, //"AGAS"
+    SCORE_RUN_MAGIC     = 0x49414741, //"AGAI"
+    SCORE_LOG_VERSION   = 1,
+
+    //Records the game can get ahead of the disk before they're dropped, a
+    //power of two
+    SCORE_LOG_QUEUE_SIZE = 64*1024,
+
+    //How often the writer thread wakes to write out what's been submitted
+    SCORE_LOG_FLUSH_MS  = 50,
+
+    //Runs at least halve in size, so this covers any 32 bit record count
+    SCORE_LOG_MAX_RUNS  = 40,
+
+    SCORE_LOG_PATH_MAX  = 512
+};
+
+struct ScoreRecord{
+    unsigned int Seed;      //Random state the game was initialised from
+    unsigned int Score;
+    unsigned int Ticks;     //Played, so not counting the one that set the game up or paused ones
+    unsigned int Pieces;    //Locked
+    unsigned int Clears[TETROMINO_MAX_SIZE];    //By lines at once: single, double, ...
+};
+
+struct ScoreLogHeader{
+    unsigned int Magic;
+    unsigned int Version;
+    unsigned int RecordSize;
+    unsigned int Reserved;
+};
+
+struct ScoreKey{
+    unsigned int Key;       //Score or seed
+    unsigned int Record;
+};
+
+struct ScoreRunHeader{
+    unsigned int Magic;
+    unsigned int Count;
+    unsigned long long FirstRecord;
+};
+
+typedef char ScoreLogLayoutCheck[(sizeof(ScoreRecord) == 32 && sizeof(ScoreRunHeader) == 16) ? 1 : -1];
+
+unsigned int    GetScoreRecordLines(const ScoreRecord* Record);
+
+/*
+ * Tracking
+ *
+ * Begin once the game is RUNNING, passing the random state it was initialised
+ * from, track every tick after simulating it, and finish at game over. The
+ * tracker counts pieces and clears as a game event listener (see events.h),
+ * so it has to be passed to SimulateTick too.
+ */
+
+struct ScoreTracker{
+    ScoreRecord Record;
+};
+
+void            BeginScoreTracking(ScoreTracker* Tracker, unsigned int Seed);
+void            TrackScoreTicks(ScoreTracker* Tracker, const GameData* Game, unsigned int Ticks);
+ScoreRecord     FinishScoreTracking(ScoreTracker* Tracker, const GameData* Game);
+
+void            OnPieceLocked(ScoreTracker* Tracker, const Tetromino& Piece);
+void            OnLinesCleared(ScoreTracker* Tracker, const unsigned int* Rows, unsigned int Count);
+
+/*
+ * Writing
+ *
+ * SubmitScoreRecord only copies the record into a queue: it never waits, takes
+ * a lock or makes a system call, and if the writer thread has fallen a whole
+ * queue behind the record is dropped and counted rather than holding up the
+ * game. One thread submits. The writer thread wakes every SCORE_LOG_FLUSH_MS
+ * and writes everything queued as one batch.
+ */
+
+struct ScoreRunEntry{
+    unsigned long long Offset;  //In the index file
+    unsigned long long FirstRecord;
+    unsigned int Count;
+};
+
+struct ScoreLogWriter{
+    bool Valid;
+    char IndexPath[SCORE_LOG_PATH_MAX];
+
+    //Writer thread only once it's started
+    FILE* Log;
+    FILE* Index;
+    unsigned long long RecordCount;
+    ScoreRunEntry Runs[SCORE_LOG_MAX_RUNS];
+    unsigned int RunCount;
+    ScoreRecord* Batch;
+    ScoreKey* Keys;             //Scratch for building and merging runs
+    unsigned long long KeyCapacity;
+    bool Failed;
+
+    ScoreRecord* Queue;
+    alignas(64) std::atomic<unsigned int> Submitted;    //Moved on by the submitting thread
+    alignas(64) std::atomic<unsigned int> Written;      //Moved on by the writer thread
+    std::atomic<unsigned long long> Dropped;
+    std::atomic<bool> Stop;
+
+    std::thread Thread;
+};
+
+bool    OpenScoreLogWriter(ScoreLogWriter* Writer, const char* Path);
+bool    SubmitScoreRecord(ScoreLogWriter* Writer, const ScoreRecord* Record);
+bool    CloseScoreLogWriter(ScoreLogWriter* Writer);
+
+/*
+ * Queries
+ */
+
+struct ScoreRun{
+    unsigned long long FirstRecord;
+    unsigned int Count;
+    const ScoreKey* ByScore;
+    const ScoreKey* BySeed;
+};
+
+struct ScoreLogMapping{
+    const unsigned char* Base;
+    size_t Size;
+    void* Handle;   //Windows only
+};
+
+struct ScoreLog{
+    bool Valid;
+    const ScoreRecord* Records;
+    unsigned long long RecordCount;
+    unsigned long long IndexedCount;    //Records before this are in Runs, the rest are scanned
+
+    ScoreRun Runs[SCORE_LOG_MAX_RUNS];
+    unsigned int RunCount;
+
+    ScoreLogMapping LogFile;
+    ScoreLogMapping IndexFile;
+};
+
+ScoreLog            OpenScoreLog(const char* Path);
+void                CloseScoreLog(ScoreLog* Log);
+
+unsigned int        GetTopScores(const ScoreLog* Log, unsigned int Count, unsigned long long* Records);
+unsigned long long  CountScoresAtLeast(const ScoreLog* Log, unsigned int Score);
+unsigned int        GetScorePercentile(const ScoreLog* Log, double Percentile);
+unsigned long long  FindSeedScores(const ScoreLog* Log, unsigned int Seed, unsigned long long* Records, unsigned int MaxRecords);
+
+#endif
@@ -0,0 +1,272 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+#include "arena.cpp"
+#include "game.cpp"
+#include "pieces.cpp"
+#include "scorelog.cpp"
+
+/*
+ * Score Log Tool
+ *
+ *   agafb_scores info <log>
+ *   agafb_scores top <log> [--count k]
+ *   agafb_scores percentile <log> <percent>...
+ *   agafb_scores seed <log> <seed>
+ *   agafb_scores fill <log> [--games n] [--seed s]
+ *
+ * Logs are written by agafb --scores and agafb_corpus generate --scores. fill
+ * appends made up games through the same writer, to see how queries hold up
+ * on logs far bigger than anyone will play.
+ */
+
+enum ScoresConstants{
+    SCORES_DEFAULT_TOP      = 10,
+    SCORES_DEFAULT_FILL     = 1000000,
+    SCORES_MAX_SEED_GAMES   = 20
+};
+
+double GetSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void PrintScoreRecord(const ScoreLog* Log, unsigned long long Record)
+{
+    const ScoreRecord* Game = Log->Records + Record;
+
+    printf("  #%-10llu score %7u  seed %10u  %6u lines (%u/%u/%u/%u)  %6u pieces  %8u ticks\n",
+           Record, Game->Score, Game->Seed, GetScoreRecordLines(Game),
+           Game->Clears[0], Game->Clears[1], Game->Clears[2], Game->Clears[3], Game->Pieces, Game->Ticks);
+}
+
+int PrintScoreLogInfo(const ScoreLog* Log)
+{
+    printf("%llu games, %llu indexed in %u runs, %llu scanned\n", Log->RecordCount, Log->IndexedCount,
+           Log->RunCount, Log->RecordCount - Log->IndexedCount);
+
+    for(unsigned int Run = 0; Run < Log->RunCount; ++Run)
+    {
+        printf("  run %2u: games %llu to %llu\n", Run, Log->Runs[Run].FirstRecord,
+               Log->Runs[Run].FirstRecord + Log->Runs[Run].Count - 1);
+    }
+
+    if(Log->RecordCount)
+    {
+        printf("Score: median %u, p90 %u, p99 %u\n", GetScorePercentile(Log, 50.0),
+               GetScorePercentile(Log, 90.0), GetScorePercentile(Log, 99.0));
+    }
+
+    return 0;
+}
+
+int PrintTopScores(const ScoreLog* Log, unsigned int Count)
+{
+    unsigned long long* Records = (unsigned long long*)malloc(sizeof(unsigned long long)*(Count ? Count : 1));
+
+    double Start = GetSeconds();
+    unsigned int Found = GetTopScores(Log, Count, Records);
+    double Elapsed = GetSeconds() - Start;
+
+    printf("Top %u of %llu games (%.3fms)\n", Found, Log->RecordCount, Elapsed*1000.0);
+
+    for(unsigned int Index = 0; Index < Found; ++Index)
+    {
+        PrintScoreRecord(Log, Records[Index]);
+    }
+
+    free(Records);
+
+    return 0;
+}
+
+int PrintSeedScores(const ScoreLog* Log, unsigned int Seed)
+{
+    unsigned long long Records[SCORES_MAX_SEED_GAMES];
+
+    double Start = GetSeconds();
+    unsigned long long Found = FindSeedScores(Log, Seed, Records, SCORES_MAX_SEED_GAMES);
+    double Elapsed = GetSeconds() - Start;
+
+    printf("%llu games from seed %u (%.3fms)\n", Found, Seed, Elapsed*1000.0);
+
+    for(unsigned long long Index = 0; (Index < Found) && (Index < SCORES_MAX_SEED_GAMES); ++Index)
+    {
+        PrintScoreRecord(Log, Records[Index]);
+    }
+
+    return 0;
+}
+
+/*
+ * Fill
+ *
+ * Games are made up from a rough model of a bot that clears most of what it
+ * places, so scores spread out like real ones do. Unlike the game, this waits
+ * for the writer when the queue is full rather than dropping games.
+ */
+
+ScoreRecord GenerateFillRecord(RandomSeries* Series)
+{
+    ScoreRecord Result;
+    memset(&Result, 0, sizeof(Result));
+
+    static const unsigned int Points[TETROMINO_MAX_SIZE] = {1, 4, 8, 16};
+
+    Result.Seed = RandomNext(Series);
+    Result.Pieces = 10 + RandomNext(Series)%(1 + (RandomNext(Series)%2000));
+    Result.Ticks = Result.Pieces*(20 + RandomNext(Series)%20);
+
+    //Every 10 blocks placed is a line, cleared in clumps
+    unsigned int Lines = (Result.Pieces*4)/10;
+
+    while(Lines)
+    {
+        unsigned int Size = 1 + RandomNext(Series)%TETROMINO_MAX_SIZE;
+        Size = (Size > Lines) ? Lines : Size;
+
+        Result.Clears[Size - 1]++;
+        Result.Score += Points[Size - 1];
+        Lines -= Size;
+    }
+
+    return Result;
+}
+
+int FillScoreLog(const char* Path, unsigned int GameCount, unsigned int Seed)
+{
+    ScoreLogWriter* Writer = new ScoreLogWriter;
+
+    if( !OpenScoreLogWriter(Writer, Path) )
+    {
+        delete Writer;
+        return 1;
+    }
+
+    RandomSeries Series = SeedRandomSeries(Seed);
+    unsigned long long Waits = 0;
+    double SlowestSubmit = 0.0;
+    double Start = GetSeconds();
+
+    for(unsigned int Index = 0; Index < GameCount; ++Index)
+    {
+        ScoreRecord Record = GenerateFillRecord(&Series);
+
+        double SubmitStart = GetSeconds();
+        bool Submitted = SubmitScoreRecord(Writer, &Record);
+        double SubmitTime = GetSeconds() - SubmitStart;
+
+        SlowestSubmit = (SubmitTime > SlowestSubmit) ? SubmitTime : SlowestSubmit;
+
+        while(!Submitted)
+        {
+            Waits++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            Submitted = SubmitScoreRecord(Writer, &Record);
+        }
+    }
+
+    double Submitted = GetSeconds() - Start;
+    bool Written = CloseScoreLogWriter(Writer);
+    double Elapsed = GetSeconds() - Start;
+
+    printf("%u games in %.2fs (%.2fs to submit, slowest %.2fus), %llu waits for the writer\n",
+           GameCount, Elapsed, Submitted, SlowestSubmit*1e6, Waits);
+
+    delete Writer;
+
+    return Written ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 3)
+    {
+        printf("Usage: %s info <log>\n"
+               "       %s top <log> [--count k]\n"
+               "       %s percentile <log> <percent>...\n"
+               "       %s seed <log> <seed>\n"
+               "       %s fill <log> [--games n] [--seed s]\n", argv[0], argv[0], argv[0], argv[0], argv[0]);
+        return 1;
+    }
+
+    const char* Command = argv[1];
+    const char* Path = argv[2];
+
+    unsigned int Count = SCORES_DEFAULT_TOP;
+    unsigned int GameCount = SCORES_DEFAULT_FILL;
+    unsigned int Seed = 1;
+    int FirstPositional = 0;
+
+    for(int Arg = 3; Arg < argc; ++Arg)
+    {
+        bool HasValue = (Arg + 1 < argc);
+
+        if( HasValue && (strcmp(argv[Arg], "--count") == 0) )
+        {
+            Count = atoi(argv[++Arg]);
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--games") == 0) )
+        {
+            GameCount = atoi(argv[++Arg]);
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--seed") == 0) )
+        {
+            Seed = atoi(argv[++Arg]);
+        }
+        else if(!FirstPositional)
+        {
+            FirstPositional = Arg;
+        }
+    }
+
+    if(strcmp(Command, "fill") == 0)
+    {
+        return FillScoreLog(Path, GameCount, Seed);
+    }
+
+    ScoreLog Log = OpenScoreLog(Path);
+
+    if(!Log.Valid)
+    {
+        return 1;
+    }
+
+    int Result = 1;
+
+    if(strcmp(Command, "info") == 0)
+    {
+        Result = PrintScoreLogInfo(&Log);
+    }
+    else if(strcmp(Command, "top") == 0)
+    {
+        Result = PrintTopScores(&Log, Count);
+    }
+    else if( (strcmp(Command, "percentile") == 0) && FirstPositional )
+    {
+        for(int Arg = FirstPositional; Arg < argc; ++Arg)
+        {
+            double Start = GetSeconds();
+            unsigned int Score = GetScorePercentile(&Log, atof(argv[Arg]));
+
+            printf("p%s: %u (%.3fms)\n", argv[Arg], Score, (GetSeconds() - Start)*1000.0);
+        }
+
+        Result = 0;
+    }
+    else if( (strcmp(Command, "seed") == 0) && FirstPositional )
+    {
+        Result = PrintSeedScores(&Log, (unsigned int)strtoul(argv[FirstPositional], NULL, 10));
+    }
+    else
+    {
+        printf("Unknown command %s\n", Command);
+    }
+
+    CloseScoreLog(&Log);
+
+    return Result;
+}
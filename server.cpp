@@ -0,0 +1,955 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "arena.cpp"
+#include "game.cpp"
+#include "pieces.cpp"
+#include "snapshot.cpp"
+#include "net.cpp"
+
+/*
+ * Game Server
+ *
+ * Hosts many games in one process. The main thread owns the sockets: it
+ * accepts clients and reads their inputs from one epoll set, and a timerfd in
+ * the same set fires every tick. On a tick every live session is stepped once
+ * with whatever inputs arrived since the last one, split evenly across the
+ * main thread and a pool of workers, and each session sends its own update
+ * straight from whichever thread stepped it.
+ *
+ * Sessions are only added or removed between ticks, on the main thread, so
+ * the workers never need to lock anything but the tick hand-off itself.
+ *
+ * A paused or finished game doesn't change until its client presses
+ * something, so once it has sat like that for the hibernation time it's
+ * compressed into a snapshot and its game memory freed. It's off the active
+ * list until an input arrives, when it's woken up exactly as it was before
+ * the input is taken. A hibernating session is its slot, a few dozen bytes,
+ * plus its compressed snapshot.
+ *
+ *   agafb_server [--listen address]... [--threads n] [--max-sessions n] [--hibernate seconds]
+ *
+ * Addresses are a Unix socket path or host:port. By default it listens on
+ * DEFAULT_SERVER_SOCKET.
+ */
+
+enum ServerConstants{
+    SERVER_TICK_RATE        = 30,   //Hz, the same as the SDL front end
+    SERVER_MAX_LISTENERS    = 4,
+    SERVER_DEFAULT_SESSIONS = 16384,
+    SERVER_EVENT_BATCH      = 512,
+    SERVER_REPORT_SECONDS   = 5,
+    SERVER_HIBERNATE_SECONDS = 30,   //0 never hibernates
+
+    //Tick lateness histogram, in 10us buckets up to 10ms
+    SERVER_JITTER_BUCKET_NS = 10000,
+    SERVER_JITTER_BUCKETS   = 1000,
+
+    //epoll user data for anything that isn't a session
+    SERVER_TIMER_ID         = 0xFFFFFFFF,
+    SERVER_LISTENER_ID      = 0xFFFFFF00    //Plus the listener's index
+};
+
+//Everything a session frees when it hibernates
+struct ServerGame{
+    GameData Game;
+    GameMemory Memory;
+};
+
+struct ServerSession{
+    int Socket;
+    bool Closing;           //Set while stepping, closed after the tick
+
+    //Pending inputs, or'd together until the next tick takes them
+    unsigned int Inputs;
+    unsigned short Sequence;    //Of the last input received
+    unsigned short Ack;         //Of the last input taken
+
+    //A message split across reads
+    unsigned char Partial[sizeof(ClientMessage)];
+    unsigned int PartialSize;
+
+    //Ticks in a row the game has been paused or over without any input
+    unsigned int IdleTicks;
+
+    //Exactly one of these, Live while the session is awake
+    ServerGame* Live;
+    unsigned char* Hibernated;  //CompressGameSnapshot's output
+    unsigned int HibernatedSize;
+};
+
+struct ServerWorker{
+    std::thread Thread;
+    unsigned int Index;
+};
+
+struct ServerStats{
+    unsigned long long Ticks;
+    unsigned long long MissedTicks;     //Timer expirations that had to be folded into one tick
+    unsigned long long Steps;
+    unsigned long long Updates;
+    unsigned long long DroppedUpdates;  //Socket buffer full, the next update replaces it
+    unsigned long long Accepted;
+    unsigned long long Closed;
+    unsigned long long Hibernated;
+    unsigned long long Woken;
+
+    unsigned long long StepNs;          //Total time spent stepping
+    unsigned long long MaxStepNs;
+    unsigned int Jitter[SERVER_JITTER_BUCKETS + 1];
+    unsigned long long MaxJitterNs;
+
+    unsigned long long ReportTime;
+};
+
+struct GameServer{
+    MemoryArena Arena;
+
+    ServerSession* Sessions;
+    unsigned int MaxSessions;
+    unsigned int* FreeSessions;
+    unsigned int FreeCount;
+
+    //Awake sessions, packed so the tick can split them into even runs
+    unsigned int* Active;
+    unsigned int ActiveCount;
+
+    unsigned int HibernateTicks;    //0 never hibernates
+    unsigned int HibernatingCount;
+    unsigned long long HibernatedBytes;
+
+    int Epoll;
+    int Timer;
+    int Listeners[SERVER_MAX_LISTENERS];
+    unsigned int ListenerCount;
+
+    unsigned long long Start;   //Tick N is due at Start + N*TickLength
+    unsigned long long TickLength;
+    unsigned int Tick;
+
+    //Tick hand-off to the workers, the same generation scheme as the vector
+    //environment
+    unsigned int ThreadCount;   //Including the main thread
+    ServerWorker* Workers;
+    std::mutex Lock;
+    std::condition_variable WorkReady;
+    std::condition_variable WorkDone;
+    unsigned int Generation;
+    unsigned int Remaining;
+    bool Quit;
+
+    //Per thread counters, summed into Stats after each tick
+    unsigned long long* ThreadUpdates;
+    unsigned long long* ThreadDropped;
+
+    ServerStats Stats;
+};
+
+volatile sig_atomic_t ServerInterrupted = 0;
+
+void HandleServerSignal(int)
+{
+    ServerInterrupted = 1;
+}
+
+unsigned long long GetNanoseconds()
+{
+    timespec Now;
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+
+    return (unsigned long long)Now.tv_sec*1000000000ull + Now.tv_nsec;
+}
+
+/*
+ * Sessions
+ */
+
+void OpenSession(GameServer* Server, int Socket)
+{
+    if(Server->FreeCount == 0)
+    {
+        close(Socket);
+        return;
+    }
+
+    unsigned int Id = Server->FreeSessions[--Server->FreeCount];
+    ServerSession* Session = Server->Sessions + Id;
+
+    memset(Session, 0, sizeof(*Session));
+    Session->Socket = Socket;
+
+    //Each session's grids and pieces come from its own memory, which a
+    //restart resets in one go
+    Session->Live = (ServerGame*)HeapAllocate(sizeof(ServerGame));
+
+    if(Session->Live == NULL)
+    {
+        close(Socket);
+        Server->FreeSessions[Server->FreeCount++] = Id;
+        return;
+    }
+
+    memset(Session->Live, 0, sizeof(*Session->Live));
+    Session->Live->Memory = GenerateGameMemory();
+    Session->Live->Game.Memory = &Session->Live->Memory;
+    Session->Live->Game.State = INITIALISING;
+    Session->Live->Game.Random = SeedRandomSeries((unsigned int)GetNanoseconds() ^ (Id*0x9E3779B9u));
+
+    epoll_event Event;
+    Event.events = EPOLLIN | EPOLLRDHUP;
+    Event.data.u32 = Id;
+
+    if(epoll_ctl(Server->Epoll, EPOLL_CTL_ADD, Socket, &Event) != 0)
+    {
+        printf("Unable to watch client socket: %s\n", strerror(errno));
+        DestroyGameMemory(Session->Live->Memory);
+        HeapFree(Session->Live);
+        close(Socket);
+        Server->FreeSessions[Server->FreeCount++] = Id;
+        return;
+    }
+
+    Server->Active[Server->ActiveCount++] = Id;
+    Server->Stats.Accepted++;
+}
+
+void CloseSession(GameServer* Server, unsigned int Id)
+{
+    ServerSession* Session = Server->Sessions + Id;
+
+    //Closing the socket takes it out of the epoll set
+    close(Session->Socket);
+    Session->Closing = true;
+
+    if(Session->Live)
+    {
+        DestroyGameMemory(Session->Live->Memory);
+        HeapFree(Session->Live);
+        Session->Live = NULL;
+    }
+    else
+    {
+        Server->HibernatingCount--;
+        Server->HibernatedBytes -= Session->HibernatedSize;
+        HeapFree(Session->Hibernated);
+        Session->Hibernated = NULL;
+    }
+
+    Server->FreeSessions[Server->FreeCount++] = Id;
+    Server->Stats.Closed++;
+}
+
+//Also takes the sessions that hibernated this tick off the active list
+void CloseSessions(GameServer* Server)
+{
+    for(unsigned int Index = 0; Index < Server->ActiveCount; )
+    {
+        unsigned int Id = Server->Active[Index];
+        ServerSession* Session = Server->Sessions + Id;
+
+        if(Session->Closing)
+        {
+            CloseSession(Server, Id);
+        }
+        else if(Session->Live == NULL)
+        {
+            Server->HibernatingCount++;
+            Server->HibernatedBytes += Session->HibernatedSize;
+            Server->Stats.Hibernated++;
+        }
+        else
+        {
+            ++Index;
+            continue;
+        }
+
+        Server->Active[Index] = Server->Active[--Server->ActiveCount];
+    }
+}
+
+//From the main thread between ticks. The socket stops being watched straight
+//away, or a hung up client would wake every epoll_wait until the tick closes it.
+//Hibernating sessions aren't stepped, so they're closed there and then.
+void StopReadingSession(GameServer* Server, unsigned int Id)
+{
+    ServerSession* Session = Server->Sessions + Id;
+
+    if(Session->Live == NULL)
+    {
+        CloseSession(Server, Id);
+    }
+    else if(!Session->Closing)
+    {
+        epoll_ctl(Server->Epoll, EPOLL_CTL_DEL, Session->Socket, NULL);
+        Session->Closing = true;
+    }
+}
+
+/*
+ * Hibernation
+ */
+
+//From whichever thread stepped the session. It stays on the active list until
+//CloseSessions sees it's hibernating.
+void HibernateSession(ServerSession* Session)
+{
+    GameSnapshot Snapshot;
+    unsigned char Compressed[SNAPSHOT_COMPRESSED_MAX];
+
+    SaveGameSnapshot(&Session->Live->Game, &Snapshot);
+    unsigned int Size = CompressGameSnapshot(&Snapshot, Compressed);
+
+    //Stays awake if there's no memory to hibernate into
+    Session->Hibernated = (unsigned char*)HeapAllocate(Size);
+
+    if(Session->Hibernated == NULL)
+    {
+        return;
+    }
+
+    memcpy(Session->Hibernated, Compressed, Size);
+    Session->HibernatedSize = Size;
+
+    DestroyGameMemory(Session->Live->Memory);
+    HeapFree(Session->Live);
+    Session->Live = NULL;
+}
+
+//From the main thread between ticks, as an input arrives
+void WakeSession(GameServer* Server, unsigned int Id)
+{
+    ServerSession* Session = Server->Sessions + Id;
+    GameSnapshot Snapshot;
+
+    Session->Live = (ServerGame*)HeapAllocate(sizeof(ServerGame));
+
+    if( (Session->Live == NULL) ||
+        !DecompressGameSnapshot(Session->Hibernated, Session->HibernatedSize, &Snapshot) ||
+        !ValidGameSnapshot(&Snapshot) )
+    {
+        //Nothing to wake into, so the client is dropped
+        HeapFree(Session->Live);
+        Session->Live = NULL;
+        CloseSession(Server, Id);
+        return;
+    }
+
+    Session->Live->Memory = GenerateGameMemory();
+    Session->Live->Game = GenerateGameFromSnapshotInMemory(&Snapshot, &Session->Live->Memory);
+
+    Server->HibernatingCount--;
+    Server->HibernatedBytes -= Session->HibernatedSize;
+    HeapFree(Session->Hibernated);
+    Session->Hibernated = NULL;
+    Session->HibernatedSize = 0;
+    Session->IdleTicks = 0;
+
+    Server->Active[Server->ActiveCount++] = Id;
+    Server->Stats.Woken++;
+}
+
+void AcceptClients(GameServer* Server, int Listener)
+{
+    for(;;)
+    {
+        int Socket = accept4(Listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if(Socket < 0)
+        {
+            if( (errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR) )
+            {
+                printf("Unable to accept client: %s\n", strerror(errno));
+            }
+
+            return;
+        }
+
+        OpenSession(Server, Socket);
+    }
+}
+
+void ReadClient(GameServer* Server, unsigned int Id)
+{
+    ServerSession* Session = Server->Sessions + Id;
+    unsigned char Buffer[256];
+
+    while(!Session->Closing)
+    {
+        ssize_t Read = recv(Session->Socket, Buffer, sizeof(Buffer), 0);
+
+        if(Read < 0)
+        {
+            if( (errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR) )
+            {
+                StopReadingSession(Server, Id);
+            }
+
+            break;
+        }
+
+        if(Read == 0)
+        {
+            StopReadingSession(Server, Id);
+            break;
+        }
+
+        for(ssize_t Index = 0; Index < Read; ++Index)
+        {
+            Session->Partial[Session->PartialSize++] = Buffer[Index];
+
+            if(Session->PartialSize < sizeof(ClientMessage))
+            {
+                continue;
+            }
+
+            ClientMessage Message;
+            memcpy(&Message, Session->Partial, sizeof(Message));
+            Session->PartialSize = 0;
+
+            if(Message.Type != CLIENT_INPUT)
+            {
+                StopReadingSession(Server, Id);
+                break;
+            }
+
+            Session->Inputs |= Message.Inputs;
+            Session->Sequence = Message.Sequence;
+        }
+    }
+
+    if( (Session->Live == NULL) && !Session->Closing )
+    {
+        WakeSession(Server, Id);
+    }
+}
+
+/*
+ * Ticks
+ */
+
+void StepSession(ServerSession* Session, unsigned int Tick, unsigned int HibernateTicks, unsigned long long* Updates,
+                 unsigned long long* Dropped)
+{
+    if(Session->Closing)
+    {
+        return;
+    }
+
+    unsigned int Inputs = Session->Inputs;
+    bool Acknowledge = (Session->Ack != Session->Sequence);
+
+    Session->Inputs = 0;
+    Session->Ack = Session->Sequence;
+
+    GameData* Game = &Session->Live->Game;
+
+    *Game = SimulateTick(*Game, UnpackClientInputs(Inputs));
+
+    if(Game->Quit)
+    {
+        Session->Closing = true;
+        return;
+    }
+
+    //Without input these never change, so once there's nothing left to send
+    //the session can be put away
+    bool Idle = !Inputs && !Acknowledge && !Game->Redraw && ((Game->State == PAUSED) || (Game->State == GAMEOVER));
+
+    Session->IdleTicks = Idle ? Session->IdleTicks + 1 : 0;
+
+    if( HibernateTicks && (Session->IdleTicks >= HibernateTicks) )
+    {
+        HibernateSession(Session);
+        return;
+    }
+
+    if( !Game->Redraw && !Acknowledge )
+    {
+        return;
+    }
+
+    Game->Redraw = 0;
+
+    ServerUpdate Update;
+    EncodeServerUpdate(Game, Tick, Session->Ack, &Update);
+
+    ssize_t Sent = send(Session->Socket, &Update, sizeof(Update), MSG_DONTWAIT | MSG_NOSIGNAL);
+
+    if(Sent == (ssize_t)sizeof(Update))
+    {
+        ++*Updates;
+    }
+    else if( (Sent < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)) )
+    {
+        //Every update stands alone, so a slow client just misses some
+        ++*Dropped;
+    }
+    else
+    {
+        //An error, or a partial write that would leave the stream misaligned
+        Session->Closing = true;
+    }
+}
+
+//Thread Index's share of the active sessions
+void StepSessionRun(GameServer* Server, unsigned int Index)
+{
+    unsigned int First = (unsigned int)(((unsigned long long)Server->ActiveCount*Index)/Server->ThreadCount);
+    unsigned int Last = (unsigned int)(((unsigned long long)Server->ActiveCount*(Index + 1))/Server->ThreadCount);
+
+    unsigned long long Updates = 0;
+    unsigned long long Dropped = 0;
+
+    for(unsigned int Active = First; Active < Last; ++Active)
+    {
+        StepSession(Server->Sessions + Server->Active[Active], Server->Tick, Server->HibernateTicks, &Updates, &Dropped);
+    }
+
+    Server->ThreadUpdates[Index] = Updates;
+    Server->ThreadDropped[Index] = Dropped;
+}
+
+void ServerWorkerLoop(GameServer* Server, ServerWorker* Worker)
+{
+    unsigned int Seen = 0;
+
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> Guard(Server->Lock);
+            Server->WorkReady.wait(Guard, [&]{ return Server->Quit || (Server->Generation != Seen); });
+
+            if(Server->Quit)
+            {
+                return;
+            }
+
+            Seen = Server->Generation;
+        }
+
+        StepSessionRun(Server, Worker->Index);
+
+        std::lock_guard<std::mutex> Guard(Server->Lock);
+
+        if(--Server->Remaining == 0)
+        {
+            Server->WorkDone.notify_one();
+        }
+    }
+}
+
+void RecordTickStats(ServerStats* Stats, unsigned long long Lateness, unsigned long long StepNs)
+{
+    unsigned int Bucket = (unsigned int)(Lateness/SERVER_JITTER_BUCKET_NS);
+    Bucket = (Bucket < SERVER_JITTER_BUCKETS) ? Bucket : SERVER_JITTER_BUCKETS;
+
+    Stats->Jitter[Bucket]++;
+    Stats->MaxJitterNs = (Lateness > Stats->MaxJitterNs) ? Lateness : Stats->MaxJitterNs;
+
+    Stats->StepNs += StepNs;
+    Stats->MaxStepNs = (StepNs > Stats->MaxStepNs) ? StepNs : Stats->MaxStepNs;
+    Stats->Ticks++;
+}
+
+//Lateness below which Fraction of the ticks started, in ms
+double GetJitterPercentile(const ServerStats* Stats, double Fraction)
+{
+    unsigned long long Wanted = (unsigned long long)(Stats->Ticks*Fraction);
+    unsigned long long Seen = 0;
+
+    for(unsigned int Bucket = 0; Bucket <= SERVER_JITTER_BUCKETS; ++Bucket)
+    {
+        Seen += Stats->Jitter[Bucket];
+
+        if(Seen > Wanted)
+        {
+            return (Bucket + 1)*(SERVER_JITTER_BUCKET_NS/1000000.0);
+        }
+    }
+
+    return SERVER_JITTER_BUCKETS*(SERVER_JITTER_BUCKET_NS/1000000.0);
+}
+
+void ReportServerStats(GameServer* Server, unsigned long long Now)
+{
+    ServerStats* Stats = &Server->Stats;
+
+    if( (Stats->Ticks == 0) || (Now - Stats->ReportTime < SERVER_REPORT_SECONDS*1000000000ull) )
+    {
+        return;
+    }
+
+    double Seconds = (Now - Stats->ReportTime)/1e9;
+
+    printf("%u sessions: %.0f steps/s, %.0f updates/s (%llu dropped), tick %.3fms avg %.3fms max, "
+           "start late p50 %.2fms p99 %.2fms max %.2fms, %llu missed ticks, +%llu -%llu clients\n",
+           Server->ActiveCount, Stats->Steps/Seconds, Stats->Updates/Seconds, Stats->DroppedUpdates,
+           (Stats->StepNs/1e6)/Stats->Ticks, Stats->MaxStepNs/1e6,
+           GetJitterPercentile(Stats, 0.5), GetJitterPercentile(Stats, 0.99), Stats->MaxJitterNs/1e6,
+           Stats->MissedTicks, Stats->Accepted, Stats->Closed);
+
+    if(Server->HibernatingCount || Stats->Hibernated || Stats->Woken)
+    {
+        printf("%u hibernating in %.1f bytes each on average, +%llu -%llu\n", Server->HibernatingCount,
+               Server->HibernatingCount ? (double)Server->HibernatedBytes/Server->HibernatingCount : 0.0,
+               Stats->Hibernated, Stats->Woken);
+    }
+
+    fflush(stdout);
+
+    memset(Stats, 0, sizeof(*Stats));
+    Stats->ReportTime = Now;
+}
+
+void RunServerTick(GameServer* Server, unsigned long long Expirations)
+{
+    unsigned long long Now = GetNanoseconds();
+
+    Server->Tick += (unsigned int)Expirations;
+    Server->Stats.MissedTicks += Expirations - 1;
+
+    unsigned long long Due = Server->Start + (unsigned long long)Server->Tick*Server->TickLength;
+    unsigned long long Lateness = (Now > Due) ? Now - Due : 0;
+
+    if(Server->ThreadCount > 1)
+    {
+        std::lock_guard<std::mutex> Guard(Server->Lock);
+        Server->Remaining = Server->ThreadCount - 1;
+        ++Server->Generation;
+    }
+
+    Server->WorkReady.notify_all();
+
+    StepSessionRun(Server, 0);
+
+    if(Server->ThreadCount > 1)
+    {
+        std::unique_lock<std::mutex> Guard(Server->Lock);
+        Server->WorkDone.wait(Guard, [&]{ return Server->Remaining == 0; });
+    }
+
+    for(unsigned int Index = 0; Index < Server->ThreadCount; ++Index)
+    {
+        Server->Stats.Updates += Server->ThreadUpdates[Index];
+        Server->Stats.DroppedUpdates += Server->ThreadDropped[Index];
+    }
+
+    Server->Stats.Steps += Server->ActiveCount;
+
+    CloseSessions(Server);
+
+    unsigned long long Finished = GetNanoseconds();
+    RecordTickStats(&Server->Stats, Lateness, Finished - Now);
+    ReportServerStats(Server, Finished);
+}
+
+/*
+ * Setup
+ */
+
+bool InitialiseServer(GameServer* Server, unsigned int MaxSessions, unsigned int Threads)
+{
+    //ShutdownServer runs however far this got, and only closes what was opened
+    Server->Epoll = -1;
+    Server->Timer = -1;
+
+    size_t ArenaSize = MaxSessions*(sizeof(ServerSession) + 2*sizeof(unsigned int)) +
+                       Threads*(2*sizeof(unsigned long long)) + 4*ARENA_ALIGNMENT;
+
+    Server->Arena = GenerateArena(ArenaSize);
+    Server->Sessions = PushArray(&Server->Arena, ServerSession, MaxSessions);
+    Server->FreeSessions = PushArray(&Server->Arena, unsigned int, MaxSessions);
+    Server->Active = PushArray(&Server->Arena, unsigned int, MaxSessions);
+    Server->ThreadUpdates = PushArray(&Server->Arena, unsigned long long, Threads);
+    Server->ThreadDropped = PushArray(&Server->Arena, unsigned long long, Threads);
+
+    if( (Server->Sessions == NULL) || (Server->ThreadDropped == NULL) )
+    {
+        printf("Could not allocate server memory!\n");
+        return false;
+    }
+
+    Server->MaxSessions = MaxSessions;
+
+    //Handed out lowest first
+    for(unsigned int Index = 0; Index < MaxSessions; ++Index)
+    {
+        Server->FreeSessions[Index] = MaxSessions - 1 - Index;
+    }
+
+    Server->FreeCount = MaxSessions;
+    Server->ActiveCount = 0;
+
+    Server->Epoll = epoll_create1(EPOLL_CLOEXEC);
+    Server->Timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    if( (Server->Epoll < 0) || (Server->Timer < 0) )
+    {
+        printf("Unable to create epoll or timer: %s\n", strerror(errno));
+        return false;
+    }
+
+    epoll_event Event;
+    Event.events = EPOLLIN;
+    Event.data.u32 = SERVER_TIMER_ID;
+    epoll_ctl(Server->Epoll, EPOLL_CTL_ADD, Server->Timer, &Event);
+
+    for(unsigned int Index = 0; Index < Server->ListenerCount; ++Index)
+    {
+        Event.events = EPOLLIN;
+        Event.data.u32 = SERVER_LISTENER_ID + Index;
+        epoll_ctl(Server->Epoll, EPOLL_CTL_ADD, Server->Listeners[Index], &Event);
+    }
+
+    Server->ThreadCount = Threads;
+    Server->Workers = new ServerWorker[Threads - 1];
+
+    for(unsigned int Index = 0; Index + 1 < Threads; ++Index)
+    {
+        Server->Workers[Index].Index = Index + 1;
+        Server->Workers[Index].Thread = std::thread(ServerWorkerLoop, Server, Server->Workers + Index);
+    }
+
+    return true;
+}
+
+void ShutdownServer(GameServer* Server)
+{
+    {
+        std::lock_guard<std::mutex> Guard(Server->Lock);
+        Server->Quit = true;
+    }
+
+    Server->WorkReady.notify_all();
+
+    for(unsigned int Index = 0; Index + 1 < Server->ThreadCount; ++Index)
+    {
+        Server->Workers[Index].Thread.join();
+    }
+
+    delete[] Server->Workers;
+
+    for(unsigned int Index = 0; Index < Server->ActiveCount; ++Index)
+    {
+        Server->Sessions[Server->Active[Index]].Closing = true;
+    }
+
+    CloseSessions(Server);
+
+    //Hibernating sessions are on no list, they're whichever slots aren't free.
+    //Slots never handed out are never touched, so they aren't read here either.
+    if(Server->HibernatingCount)
+    {
+        bool* Free = (bool*)HeapAllocate(Server->MaxSessions*sizeof(bool));
+
+        if(Free)
+        {
+            memset(Free, 0, Server->MaxSessions*sizeof(bool));
+
+            for(unsigned int Index = 0; Index < Server->FreeCount; ++Index)
+            {
+                Free[Server->FreeSessions[Index]] = true;
+            }
+
+            for(unsigned int Id = 0; Id < Server->MaxSessions; ++Id)
+            {
+                if(!Free[Id])
+                {
+                    CloseSession(Server, Id);
+                }
+            }
+
+            HeapFree(Free);
+        }
+    }
+
+    for(unsigned int Index = 0; Index < Server->ListenerCount; ++Index)
+    {
+        close(Server->Listeners[Index]);
+    }
+
+    if(Server->Timer >= 0)
+    {
+        close(Server->Timer);
+    }
+
+    if(Server->Epoll >= 0)
+    {
+        close(Server->Epoll);
+    }
+
+    DestroyArena(Server->Arena);
+}
+
+void RunServer(GameServer* Server)
+{
+    Server->TickLength = 1000000000ull/SERVER_TICK_RATE;
+    Server->Start = GetNanoseconds();
+    Server->Tick = 0;
+    Server->Stats.ReportTime = Server->Start;
+
+    //Absolute, so ticks stay on the grid however long each one takes
+    itimerspec Interval;
+    Interval.it_interval.tv_sec = 0;
+    Interval.it_interval.tv_nsec = Server->TickLength;
+    Interval.it_value.tv_sec = (Server->Start + Server->TickLength)/1000000000ull;
+    Interval.it_value.tv_nsec = (Server->Start + Server->TickLength)%1000000000ull;
+
+    timerfd_settime(Server->Timer, TFD_TIMER_ABSTIME, &Interval, NULL);
+
+    epoll_event Events[SERVER_EVENT_BATCH];
+
+    while(!ServerInterrupted)
+    {
+        int Count = epoll_wait(Server->Epoll, Events, SERVER_EVENT_BATCH, -1);
+
+        if(Count < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+
+            printf("epoll_wait failed: %s\n", strerror(errno));
+            break;
+        }
+
+        unsigned long long Expirations = 0;
+
+        for(int Index = 0; Index < Count; ++Index)
+        {
+            unsigned int Id = Events[Index].data.u32;
+
+            if(Id == SERVER_TIMER_ID)
+            {
+                //Inputs from this batch still go in, the tick runs after them
+                if(read(Server->Timer, &Expirations, sizeof(Expirations)) != sizeof(Expirations))
+                {
+                    Expirations = 0;
+                }
+            }
+            else if(Id >= SERVER_LISTENER_ID)
+            {
+                AcceptClients(Server, Server->Listeners[Id - SERVER_LISTENER_ID]);
+            }
+            else if(Events[Index].events & (EPOLLERR | EPOLLHUP))
+            {
+                StopReadingSession(Server, Id);
+            }
+            else
+            {
+                ReadClient(Server, Id);
+            }
+        }
+
+        if(Expirations)
+        {
+            RunServerTick(Server, Expirations);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* Addresses[SERVER_MAX_LISTENERS];
+    unsigned int AddressCount = 0;
+    unsigned int MaxSessions = SERVER_DEFAULT_SESSIONS;
+    unsigned int Threads = std::thread::hardware_concurrency();
+    unsigned int HibernateSeconds = SERVER_HIBERNATE_SECONDS;
+
+    for(int Arg = 1; Arg < argc; ++Arg)
+    {
+        if( (strcmp(argv[Arg], "--listen") == 0) && (Arg + 1 < argc) && (AddressCount < SERVER_MAX_LISTENERS) )
+        {
+            Addresses[AddressCount++] = argv[++Arg];
+        }
+        else if( (strcmp(argv[Arg], "--threads") == 0) && (Arg + 1 < argc) )
+        {
+            Threads = atoi(argv[++Arg]);
+        }
+        else if( (strcmp(argv[Arg], "--max-sessions") == 0) && (Arg + 1 < argc) )
+        {
+            MaxSessions = atoi(argv[++Arg]);
+        }
+        else if( (strcmp(argv[Arg], "--hibernate") == 0) && (Arg + 1 < argc) )
+        {
+            HibernateSeconds = atoi(argv[++Arg]);
+        }
+        else
+        {
+            printf("Usage: %s [--listen path|host:port]... [--threads n] [--max-sessions n] [--hibernate seconds]\n",
+                   argv[0]);
+            return 1;
+        }
+    }
+
+    if(AddressCount == 0)
+    {
+        Addresses[AddressCount++] = DEFAULT_SERVER_SOCKET;
+    }
+
+    Threads = Threads ? Threads : 1;
+    MaxSessions = MaxSessions ? MaxSessions : 1;
+
+    RaiseFileLimit();
+    signal(SIGINT, HandleServerSignal);
+    signal(SIGTERM, HandleServerSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    GameServer* Server = new GameServer();
+    Server->HibernateTicks = HibernateSeconds*SERVER_TICK_RATE;
+
+    for(unsigned int Index = 0; Index < AddressCount; ++Index)
+    {
+        int Listener = OpenListenSocket(Addresses[Index]);
+
+        if(Listener < 0)
+        {
+            delete Server;
+            return 1;
+        }
+
+        Server->Listeners[Server->ListenerCount++] = Listener;
+        printf("Listening on %s\n", Addresses[Index]);
+    }
+
+    if(InitialiseServer(Server, MaxSessions, Threads))
+    {
+        printf("Up to %u sessions on %u threads at %d ticks/s\n", MaxSessions, Threads, SERVER_TICK_RATE);
+
+        if(HibernateSeconds)
+        {
+            printf("Sessions paused or over for %us hibernate\n", HibernateSeconds);
+        }
+
+        fflush(stdout);
+
+        RunServer(Server);
+    }
+
+    ShutdownServer(Server);
+
+    for(unsigned int Index = 0; Index < AddressCount; ++Index)
+    {
+        if(!IsTcpAddress(Addresses[Index]))
+        {
+            unlink(Addresses[Index]);
+        }
+    }
+
+    delete Server;
+
+    return 0;
+}
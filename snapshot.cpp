@@ -0,0 +1,409 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "snapshot.h"
+#include "pieces.h"
+
+/*
+ * Tetromino Packing
+ */
+
+SnapshotTetromino PackTetromino(Tetromino Tetro)
+{
+    SnapshotTetromino Result;
+    memset(&Result, 0, sizeof(Result));
+
+    Result.Type     = (unsigned char)Tetro.Type;
+    Result.GridSize = (unsigned char)Tetro.GridSize;
+    Result.Rotation = (unsigned char)Tetro.Rotation;
+    Result.Row      = (short)Tetro.Row;
+    Result.Col      = (short)Tetro.Col;
+
+    memcpy(Result.Blocks, Tetro.Grid.Blocks, sizeof(Block)*Tetro.GridSize*Tetro.GridSize);
+
+    return Result;
+}
+
+//Rewrites the tetromino's existing grid in place, which always has room for
+//TETROMINO_MAX_SIZE squared blocks (see GenerateTetrominoGrid)
+Tetromino UnpackTetromino(const SnapshotTetromino* Packed, Tetromino Tetro)
+{
+    Tetromino Result = Tetro;
+
+    Result.Type      = (TetrominoType)Packed->Type;
+    Result.GridSize  = Packed->GridSize;
+    Result.Rotation  = Packed->Rotation;
+    Result.Row       = Packed->Row;
+    Result.Col       = Packed->Col;
+    Result.Grid.Rows = Packed->GridSize;
+    Result.Grid.Cols = Packed->GridSize;
+
+    memcpy(Result.Grid.Blocks, Packed->Blocks, sizeof(Block)*Result.GridSize*Result.GridSize);
+
+    return Result;
+}
+
+/*
+ * Save/Load
+ */
+
+void SaveGameSnapshot(const GameData* Game, GameSnapshot* Snapshot)
+{
+    //Zero the header so unused bits never differ between equal states, the
+    //rest is overwritten below
+    memset(Snapshot, 0, offsetof(GameSnapshot, Grid));
+    memset(Snapshot->Reserved, 0, sizeof(Snapshot->Reserved));
+
+    Snapshot->Version       = SNAPSHOT_VERSION;
+    Snapshot->State         = (unsigned char)Game->State;
+    Snapshot->RandomState   = Game->Random.State;
+    Snapshot->Score         = Game->Score;
+    Snapshot->LinesRemoved  = Game->LinesRemoved;
+    Snapshot->FallingTimer  = Game->FallingTimer;
+
+    unsigned short Flags = 0;
+
+    if(Game->Quit)          Flags |= SNAPSHOT_QUIT;
+    if(Game->MoveLeft)      Flags |= SNAPSHOT_MOVE_LEFT;
+    if(Game->MoveRight)     Flags |= SNAPSHOT_MOVE_RIGHT;
+    if(Game->Rotate)        Flags |= SNAPSHOT_ROTATE;
+    if(Game->MoveDown)      Flags |= SNAPSHOT_MOVE_DOWN;
+    if(Game->Pause)         Flags |= SNAPSHOT_PAUSE;
+    if(Game->Redraw)        Flags |= SNAPSHOT_REDRAW;
+    if(Game->RenderScore)   Flags |= SNAPSHOT_RENDER_SCORE;
+    if(Game->Restart)       Flags |= SNAPSHOT_RESTART;
+
+    Snapshot->Flags = Flags;
+
+    Snapshot->FallingTetro  = PackTetromino(Game->FallingTetro);
+    Snapshot->NextTetro     = PackTetromino(Game->NextTetro);
+
+    memcpy(Snapshot->Grid, Game->MainGrid.Blocks, sizeof(Snapshot->Grid));
+}
+
+//The game must already own a GRID_ROWS x GRID_COLS grid and two tetrominoes,
+//as any initialised game (or one from GenerateGameFromSnapshot) does
+void LoadGameSnapshot(const GameSnapshot* Snapshot, GameData* Game)
+{
+    unsigned short Flags = Snapshot->Flags;
+
+    Game->State         = (GameState)Snapshot->State;
+    Game->Random.State  = Snapshot->RandomState;
+    Game->Score         = Snapshot->Score;
+    Game->LinesRemoved  = Snapshot->LinesRemoved;
+    Game->FallingTimer  = Snapshot->FallingTimer;
+
+    Game->Quit          = (Flags & SNAPSHOT_QUIT) != 0;
+    Game->MoveLeft      = (Flags & SNAPSHOT_MOVE_LEFT) != 0;
+    Game->MoveRight     = (Flags & SNAPSHOT_MOVE_RIGHT) != 0;
+    Game->Rotate        = (Flags & SNAPSHOT_ROTATE) != 0;
+    Game->MoveDown      = (Flags & SNAPSHOT_MOVE_DOWN) != 0;
+    Game->Pause         = (Flags & SNAPSHOT_PAUSE) != 0;
+    Game->Redraw        = (Flags & SNAPSHOT_REDRAW) != 0;
+    Game->RenderScore   = (Flags & SNAPSHOT_RENDER_SCORE) != 0;
+    Game->Restart       = (Flags & SNAPSHOT_RESTART) != 0;
+
+    Game->FallingTetro  = UnpackTetromino(&Snapshot->FallingTetro, Game->FallingTetro);
+    Game->NextTetro     = UnpackTetromino(&Snapshot->NextTetro, Game->NextTetro);
+
+    //Older snapshots didn't say, so it's worked out from the blocks
+    if(Snapshot->Version < 3)
+    {
+        Game->FallingTetro.Rotation = FindPieceRotation(Game->FallingTetro.Type, Game->FallingTetro.Grid.Blocks,
+                                                        Game->FallingTetro.GridSize);
+        Game->NextTetro.Rotation    = FindPieceRotation(Game->NextTetro.Type, Game->NextTetro.Grid.Blocks,
+                                                        Game->NextTetro.GridSize);
+    }
+
+    memcpy(Game->MainGrid.Blocks, Snapshot->Grid, sizeof(Snapshot->Grid));
+}
+
+/*
+ * Validation
+ */
+
+//Whether Packed is a piece of the set in use that the rules can index with.
+//A falling piece also has to lie wholly within the grid, as storing it
+//doesn't check.
+bool ValidSnapshotTetromino(const SnapshotTetromino* Packed, unsigned int Version, bool Falling)
+{
+    const PieceTable* Pieces = GetActivePieces();
+
+    if( (Packed->GridSize > TETROMINO_MAX_SIZE) || (Packed->Type >= Pieces->Count) )
+    {
+        return false;
+    }
+
+    const PieceType* Piece = Pieces->Types + Packed->Type;
+
+    if(Packed->GridSize != Piece->GridSize)
+    {
+        return false;
+    }
+
+    //Older snapshots didn't say, and loading works it out from the blocks
+    unsigned int Rotation = (Version >= 3) ? Packed->Rotation :
+                            FindPieceRotation(Packed->Type, Packed->Blocks, Packed->GridSize);
+
+    if(Rotation >= Piece->RotationCount)
+    {
+        return false;
+    }
+
+    if(Falling)
+    {
+        const PieceRotation* Shape = Piece->Rotations + Rotation;
+
+        for(unsigned int Cell = 0; Cell < Shape->CellCount; ++Cell)
+        {
+            int Row = Packed->Row + Shape->CellRows[Cell];
+            int Col = Packed->Col + Shape->CellCols[Cell];
+
+            if( (Row < 0) || (Row >= GRID_ROWS) || (Col < 0) || (Col >= GRID_COLS) )
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool ValidGameSnapshot(const GameSnapshot* Snapshot)
+{
+    if( (Snapshot->Version < 1) || (Snapshot->Version > SNAPSHOT_VERSION) || (Snapshot->State > GAMEOVER) )
+    {
+        return false;
+    }
+
+    return ValidSnapshotTetromino(&Snapshot->FallingTetro, Snapshot->Version, true) &&
+           ValidSnapshotTetromino(&Snapshot->NextTetro, Snapshot->Version, false);
+}
+
+//Allocates a fresh game for the snapshot, free it with DestroyGame
+GameData GenerateGameFromSnapshot(const GameSnapshot* Snapshot)
+{
+    return GenerateGameFromSnapshotInMemory(Snapshot, NULL);
+}
+
+//The same, but allocating from Memory, which is reset first, unless it's
+//NULL. A game in Memory is freed by resetting or destroying that instead.
+GameData GenerateGameFromSnapshotInMemory(const GameSnapshot* Snapshot, GameMemory* Memory)
+{
+    GameData Result;
+    memset(&Result, 0, sizeof(Result));
+
+    BlockPool* Pool = NULL;
+
+    if(Memory)
+    {
+        ResetGameMemory(Memory);
+        Pool = &Memory->Tetrominoes;
+
+        Result.Memory   = Memory;
+        Result.MainGrid = PushGrid(&Memory->Session, GRID_ROWS, GRID_COLS);
+    }
+    else
+    {
+        Result.MainGrid = GenerateGrid(GRID_ROWS, GRID_COLS);
+    }
+
+    Result.FallingTetro.Pool    = Pool;
+    Result.NextTetro.Pool       = Pool;
+    Result.FallingTetro.Grid    = GenerateTetrominoGrid(Pool, TETROMINO_MAX_SIZE);
+    Result.NextTetro.Grid       = GenerateTetrominoGrid(Pool, TETROMINO_MAX_SIZE);
+
+    LoadGameSnapshot(Snapshot, &Result);
+
+    return Result;
+}
+
+/*
+ * Compression
+ */
+
+unsigned int CompressGameSnapshot(const GameSnapshot* Snapshot, unsigned char* Out)
+{
+    const unsigned char* Bytes = (const unsigned char*)Snapshot;
+
+    unsigned char* WordMask = Out;
+    unsigned char* Next = Out + (SNAPSHOT_WORDS + 7)/8;
+
+    memset(WordMask, 0, (SNAPSHOT_WORDS + 7)/8);
+
+    for(unsigned int Word = 0; Word < SNAPSHOT_WORDS; ++Word)
+    {
+        const unsigned char* WordBytes = Bytes + 8*Word;
+        unsigned char ByteMask = 0;
+
+        for(unsigned int Byte = 0; Byte < 8; ++Byte)
+        {
+            ByteMask |= (WordBytes[Byte] != 0) << Byte;
+        }
+
+        if(ByteMask == 0)
+        {
+            continue;
+        }
+
+        WordMask[Word/8] |= 1 << (Word%8);
+        *Next++ = ByteMask;
+
+        for(unsigned int Byte = 0; Byte < 8; ++Byte)
+        {
+            if(ByteMask & (1 << Byte))
+            {
+                *Next++ = WordBytes[Byte];
+            }
+        }
+    }
+
+    return (unsigned int)(Next - Out);
+}
+
+bool DecompressGameSnapshot(const unsigned char* In, unsigned int Size, GameSnapshot* Snapshot)
+{
+    unsigned char* Bytes = (unsigned char*)Snapshot;
+    const unsigned char* End = In + Size;
+    const unsigned char* Next = In + (SNAPSHOT_WORDS + 7)/8;
+
+    if(Size < (SNAPSHOT_WORDS + 7)/8)
+    {
+        return false;
+    }
+
+    memset(Snapshot, 0, sizeof(*Snapshot));
+
+    for(unsigned int Word = 0; Word < SNAPSHOT_WORDS; ++Word)
+    {
+        if( !(In[Word/8] & (1 << (Word%8))) )
+        {
+            continue;
+        }
+
+        if(Next == End)
+        {
+            return false;
+        }
+
+        unsigned char ByteMask = *Next++;
+
+        for(unsigned int Byte = 0; Byte < 8; ++Byte)
+        {
+            if(ByteMask & (1 << Byte))
+            {
+                if(Next == End)
+                {
+                    return false;
+                }
+
+                Bytes[8*Word + Byte] = *Next++;
+            }
+        }
+    }
+
+    return Next == End;
+}
+
+/*
+ * Comparison
+ */
+
+//FNV-1a style over 8 byte words, four independent streams so the multiplies
+//overlap, folded together at the end
+unsigned long long HashGameSnapshot(const GameSnapshot* Snapshot)
+{
+    const unsigned char* Bytes = (const unsigned char*)Snapshot;
+    const unsigned int WordCount = sizeof(*Snapshot)/8;
+    const unsigned long long Prime = 0x100000001B3ull;
+
+    unsigned long long Hash[4] = {0xCBF29CE484222325ull, 0x84222325CBF29CE4ull,
+                                  0x9E3779B97F4A7C15ull, 0xC2B2AE3D27D4EB4Full};
+
+    unsigned int Index = 0;
+    unsigned long long Word;
+
+    for(; Index + 4 <= WordCount; Index += 4)
+    {
+        for(unsigned int Stream = 0; Stream < 4; ++Stream)
+        {
+            memcpy(&Word, Bytes + 8*(Index + Stream), 8);
+            Hash[Stream] = (Hash[Stream] ^ Word)*Prime;
+        }
+    }
+
+    for(; Index < WordCount; ++Index)
+    {
+        memcpy(&Word, Bytes + 8*Index, 8);
+        Hash[0] = (Hash[0] ^ Word)*Prime;
+    }
+
+    unsigned long long Result = Hash[0];
+
+    for(unsigned int Stream = 1; Stream < 4; ++Stream)
+    {
+        Result = (Result ^ (Hash[Stream] >> 29) ^ Hash[Stream])*Prime;
+    }
+
+    //Final avalanche so nearby states spread across the whole range
+    Result ^= Result >> 33;
+    Result *= 0xFF51AFD7ED558CCDull;
+    Result ^= Result >> 33;
+
+    return Result;
+}
+
+bool GameSnapshotsEqual(const GameSnapshot* A, const GameSnapshot* B)
+{
+    return memcmp(A, B, sizeof(*A)) == 0;
+}
+
+/*
+ * Snapshot Triple Buffer
+ */
+
+void InitialiseSnapshotBuffer(SnapshotTripleBuffer* Buffer)
+{
+    memset(Buffer->Slots, 0, sizeof(Buffer->Slots));
+
+    Buffer->Front = 0;
+    Buffer->Middle.store(1);
+    Buffer->Back = 2;
+    Buffer->Published = 0;
+}
+
+//The slot to fill, which only the writer touches until PublishSnapshot
+PublishedSnapshot* BeginSnapshotWrite(SnapshotTripleBuffer* Buffer)
+{
+    return Buffer->Slots + Buffer->Back;
+}
+
+void PublishSnapshot(SnapshotTripleBuffer* Buffer)
+{
+    Buffer->Slots[Buffer->Back].Sequence = ++Buffer->Published;
+
+    //Release the filled slot as the fresh middle, take back whichever slot was
+    //there (stale, or one the reader has just let go of)
+    unsigned int Previous = Buffer->Middle.exchange(Buffer->Back | SNAPSHOT_BUFFER_FRESH, std::memory_order_acq_rel);
+    Buffer->Back = Previous & SNAPSHOT_BUFFER_INDEX;
+}
+
+//The newest published snapshot. It stays valid, and unchanged, until the
+//next call. Sequence is 0 until the writer has published anything.
+const PublishedSnapshot* AcquireSnapshot(SnapshotTripleBuffer* Buffer, bool* New)
+{
+    bool Fresh = (Buffer->Middle.load(std::memory_order_relaxed) & SNAPSHOT_BUFFER_FRESH) != 0;
+
+    if(Fresh)
+    {
+        unsigned int Previous = Buffer->Middle.exchange(Buffer->Front, std::memory_order_acq_rel);
+        Buffer->Front = Previous & SNAPSHOT_BUFFER_INDEX;
+    }
+
+    if(New)
+    {
+        *New = Fresh;
+    }
+
+    return Buffer->Slots + Buffer->Front;
+}
@@ -0,0 +1,143 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <atomic>
+
+#include "game.h"
+
+/*
+ * Game Snapshots
+ *
+ * A complete copy of a game's state in one fixed size block with no pointers,
+ * so it can be memcpy'd, written to disk in bulk or mapped back in anywhere.
+ * Blocks are stored exactly as the grids hold them, so saving and loading are
+ * a handful of memcpys and never allocate: loading writes into the grids a
+ * GameData already owns.
+ *
+ * Every field is a fixed width integer laid out without padding, and saving
+ * zeroes the unused parts, so equal game states give byte identical
+ * snapshots. That makes memcmp and HashGameSnapshot usable for deduplication.
+ *
+ * StartTick and EndTick are wall clock times for the platform layer and
+ * aren't part of the game's state, so they're not saved.
+ */
+
+enum SnapshotConstants{
+    SNAPSHOT_VERSION = 3,   //3 added SnapshotTetromino::Rotation
+
+    //Triple buffer slot index, and the bit marking the middle slot as unread
+    SNAPSHOT_BUFFER_INDEX = 3,
+    SNAPSHOT_BUFFER_FRESH = 4
+};
+
+//Bits in GameSnapshot::Flags, one per GameData bool
+enum SnapshotFlags{
+    SNAPSHOT_QUIT           = 1 << 0,
+    SNAPSHOT_MOVE_LEFT      = 1 << 1,
+    SNAPSHOT_MOVE_RIGHT     = 1 << 2,
+    SNAPSHOT_ROTATE         = 1 << 3,
+    SNAPSHOT_MOVE_DOWN      = 1 << 4,
+    SNAPSHOT_PAUSE          = 1 << 5,
+    SNAPSHOT_REDRAW         = 1 << 6,
+    SNAPSHOT_RENDER_SCORE   = 1 << 7,
+    SNAPSHOT_RESTART        = 1 << 8
+};
+
+struct SnapshotTetromino{
+    Block Blocks[TETROMINO_MAX_SIZE*TETROMINO_MAX_SIZE]; //GridSize x GridSize, rest zeroed
+    short Row;
+    short Col;
+    unsigned char Type;
+    unsigned char GridSize;
+    unsigned char Rotation;
+    unsigned char Reserved;
+};
+
+struct GameSnapshot{
+    unsigned int RandomState;
+    unsigned int Score;
+    unsigned int LinesRemoved;
+    unsigned int FallingTimer;
+    unsigned short Flags;
+    unsigned char State;
+    unsigned char Version;
+
+    SnapshotTetromino FallingTetro;
+    SnapshotTetromino NextTetro;
+
+    //Same layout as the main grid, so it's copied in one go
+    Block Grid[GRID_ROWS*GRID_COLS];
+
+    //Rounds the size up to whole 8 byte words for HashGameSnapshot
+    unsigned char Reserved[4];
+};
+
+/*
+ * Compressed Snapshots
+ *
+ * Most of a snapshot is zeros: the empty rows of the grid and the unused
+ * parts of the piece grids. Compressed, it's a bit per 8 byte word saying
+ * whether the word has anything in it, then for each word that does a byte
+ * with a bit per nonzero byte, followed by those bytes. A game that has just
+ * started takes tens of bytes, a full board a few hundred.
+ */
+
+enum SnapshotCompressionConstants{
+    SNAPSHOT_WORDS          = sizeof(GameSnapshot)/8,
+    SNAPSHOT_COMPRESSED_MAX = (SNAPSHOT_WORDS + 7)/8 + SNAPSHOT_WORDS + sizeof(GameSnapshot)
+};
+
+/*
+ * Snapshot Triple Buffer
+ *
+ * Hands snapshots from one writer thread to one reader thread without locks.
+ * The writer always has a slot of its own to fill and the reader a slot of
+ * its own to read, and publishing or acquiring swaps your slot with the
+ * middle one in a single atomic exchange. Neither side ever waits: the writer
+ * overwrites snapshots the reader never got round to, and the reader keeps
+ * the last one it had until a newer one is published.
+ */
+
+struct alignas(64) PublishedSnapshot{
+    GameSnapshot Snapshot;
+    unsigned long long Sequence;    //Counts up from 1 with every publish
+    unsigned long long PublishTime; //In whatever clock the writer uses
+    unsigned int Version;           //Free for the writer, e.g. to mark visible changes
+};
+
+struct SnapshotTripleBuffer{
+    PublishedSnapshot Slots[3];
+
+    std::atomic<unsigned int> Middle;
+    alignas(64) unsigned int Back;  //Writer only
+    alignas(64) unsigned int Front; //Reader only
+    unsigned long long Published;   //Writer only
+};
+
+void                        InitialiseSnapshotBuffer(SnapshotTripleBuffer* Buffer);
+PublishedSnapshot*          BeginSnapshotWrite(SnapshotTripleBuffer* Buffer);
+void                        PublishSnapshot(SnapshotTripleBuffer* Buffer);
+const PublishedSnapshot*    AcquireSnapshot(SnapshotTripleBuffer* Buffer, bool* New);
+
+void                SaveGameSnapshot(const GameData* Game, GameSnapshot* Snapshot);
+void                LoadGameSnapshot(const GameSnapshot* Snapshot, GameData* Game);
+//False if loading the snapshot would leave a game the rules can't run: an
+//unknown version or state, or a piece that isn't one of the set in use, in
+//a rotation it doesn't have, or falling outside the grid. Anything read from
+//outside the process should be checked before it's loaded.
+bool                ValidGameSnapshot(const GameSnapshot* Snapshot);
+GameData            GenerateGameFromSnapshot(const GameSnapshot* Snapshot);
+GameData            GenerateGameFromSnapshotInMemory(const GameSnapshot* Snapshot, GameMemory* Memory);
+
+//Out needs SNAPSHOT_COMPRESSED_MAX bytes, the size used is returned
+unsigned int        CompressGameSnapshot(const GameSnapshot* Snapshot, unsigned char* Out);
+//False if the data isn't a whole compressed snapshot
+bool                DecompressGameSnapshot(const unsigned char* In, unsigned int Size, GameSnapshot* Snapshot);
+
+unsigned long long  HashGameSnapshot(const GameSnapshot* Snapshot);
+bool                GameSnapshotsEqual(const GameSnapshot* A, const GameSnapshot* B);
+
+//The hash reads whole words and the raw copies rely on Block being plain bytes
+typedef char SnapshotSizeCheck[(sizeof(GameSnapshot)%8 == 0 && sizeof(Block) == 2) ? 1 : -1];
+
+#endif
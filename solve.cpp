@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "arena.cpp"
+#include "jobs.cpp"
+#include "game.cpp"
+#include "pieces.cpp"
+#include "lockstep.cpp"
+#include "bot.cpp"
+#include "solver.cpp"
+
+/*
+ * Perfect Clear Tool
+ *
+ *   agafb_solve seed <seed> [--pieces n] [--height h] [--threads n] [--pin]
+ *   agafb_solve bench [--positions n] [--pieces n] [--height h] [--threads n] [--pin] [--seed s]
+ *
+ * seed looks for a perfect clear from the start of the game that seed begins,
+ * and draws each placement of the one it finds. bench does the same for a run
+ * of seeds, every search to the end, as a fixed workload for the collision and
+ * line clear code: the solutions don't change with the thread count or the
+ * machine, so their checksum shouldn't either.
+ */
+
+enum SolveConstants{
+    SOLVE_DEFAULT_POSITIONS = 10
+};
+
+double GetSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//The board and pieces a fresh game from Seed starts with, as the first
+//InitialiseGame leaves them
+void GetStartPosition(unsigned int Seed, unsigned int* RowMasks, unsigned int* Types, unsigned int PieceCount)
+{
+    unsigned int RandomState = SeedRandomSeries(Seed).State;
+
+    for(unsigned int Row = 0; Row < LOCKSTEP_ROWS; ++Row)
+    {
+        RowMasks[Row] = (Row < GRID_ROWS) ? LOCKSTEP_EMPTY_ROW : LOCKSTEP_SOLID_ROW;
+    }
+
+    for(unsigned int Index = 0; Index < PieceCount; ++Index)
+    {
+        Types[Index] = LockstepGenerateType(&RandomState);
+    }
+}
+
+void PrintSolverBoard(const unsigned int* RowMasks, unsigned int MaxHeight)
+{
+    for(unsigned int Row = GRID_ROWS - MaxHeight; Row < GRID_ROWS; ++Row)
+    {
+        printf("  |");
+
+        for(unsigned int Col = 0; Col < GRID_COLS; ++Col)
+        {
+            printf("%c", (RowMasks[Row] & (1u << (Col + LOCKSTEP_WALL))) ? '#' : '.');
+        }
+
+        printf("|\n");
+    }
+}
+
+int SolveSeed(unsigned int Seed, unsigned int PieceCount, unsigned int MaxHeight, JobSystem* System)
+{
+    static const char ShapeNames[LOCKSTEP_SHAPES + 1] = "ITOZSJL";
+
+    SolverMemo Memo;
+    OpenSolverMemo(&Memo, SOLVER_DEFAULT_MEMO_BITS);
+
+    unsigned int RowMasks[LOCKSTEP_ROWS];
+    unsigned int Types[SOLVER_MAX_PIECES];
+
+    GetStartPosition(Seed, RowMasks, Types, PieceCount);
+
+    printf("Seed %u:", Seed);
+    for(unsigned int Index = 0; Index < PieceCount; ++Index)
+    {
+        printf(" %c", ShapeNames[Types[Index]]);
+    }
+    printf("\n");
+
+    double Start = GetSeconds();
+    PerfectClear Solution = SolvePerfectClear(RowMasks, Types, PieceCount, 0, 0, 0, MaxHeight, 0, System, &Memo);
+    double Elapsed = GetSeconds() - Start;
+
+    printf("%s in %.3fs, %llu nodes, %llu memo hits\n",
+           Solution.Found ? "Perfect clear" : "No perfect clear", Elapsed, Solution.Nodes, Solution.MemoHits);
+
+    for(unsigned int Index = 0; Index < Solution.PieceCount; ++Index)
+    {
+        BotPlacement Placement = Solution.Placements[Index];
+
+        unsigned int Placed[LOCKSTEP_ROWS];
+        PlaceSolverPiece(RowMasks, Types[Index], Placement, GRID_ROWS - MaxHeight, Placed);
+        memcpy(RowMasks, Placed, sizeof(RowMasks));
+
+        printf("%c rotation %u, column %d\n", ShapeNames[Types[Index]], Placement.Rotation, Placement.Col);
+        PrintSolverBoard(RowMasks, MaxHeight);
+    }
+
+    CloseSolverMemo(&Memo);
+
+    return 0;
+}
+
+int BenchmarkSolver(unsigned int PositionCount, unsigned int PieceCount, unsigned int MaxHeight, JobSystem* System,
+                    unsigned int Seed)
+{
+    SolverMemo Memo;
+    OpenSolverMemo(&Memo, SOLVER_DEFAULT_MEMO_BITS);
+
+    unsigned long long Nodes = 0;
+    unsigned long long MemoHits = 0;
+    unsigned int Found = 0;
+    unsigned int Checksum = 2166136261u;
+    double Elapsed = 0.0;
+
+    printf("%u positions, %u pieces within %u rows, %u threads\n", PositionCount, PieceCount, MaxHeight, System->WorkerCount);
+
+    ResetJobStats(System);
+
+    for(unsigned int Position = 0; Position < PositionCount; ++Position)
+    {
+        unsigned int RowMasks[LOCKSTEP_ROWS];
+        unsigned int Types[SOLVER_MAX_PIECES];
+
+        GetStartPosition(Seed + Position, RowMasks, Types, PieceCount);
+
+        double Start = GetSeconds();
+        PerfectClear Solution = SolvePerfectClear(RowMasks, Types, PieceCount, 0, 0, 0, MaxHeight, 0, System, &Memo);
+        double Time = GetSeconds() - Start;
+
+        Elapsed += Time;
+        Nodes += Solution.Nodes;
+        MemoHits += Solution.MemoHits;
+        Found += Solution.Found;
+
+        //FNV-1a over what was found
+        unsigned int Values[1 + 3*SOLVER_MAX_PIECES];
+        unsigned int ValueCount = 0;
+
+        Values[ValueCount++] = Solution.Found ? Solution.PieceCount : 0;
+
+        for(unsigned int Index = 0; Index < Solution.PieceCount; ++Index)
+        {
+            Values[ValueCount++] = Solution.Placements[Index].Rotation;
+            Values[ValueCount++] = (unsigned int)Solution.Placements[Index].Col;
+            Values[ValueCount++] = (unsigned int)Solution.Placements[Index].Row;
+        }
+
+        for(unsigned int Index = 0; Index < ValueCount; ++Index)
+        {
+            Checksum = (Checksum ^ Values[Index])*16777619u;
+        }
+
+        printf("  seed %6u: %-16s %10llu nodes %9.3fs\n", Seed + Position,
+               Solution.Found ? "perfect clear" : "none", Solution.Nodes, Time);
+    }
+
+    printf("%u of %u cleared, %llu nodes (%llu memo hits) in %.2fs: %.0f nodes/s, checksum %08x\n",
+           Found, PositionCount, Nodes, MemoHits, Elapsed, Nodes/Elapsed, Checksum);
+    PrintJobStats(System);
+
+    CloseSolverMemo(&Memo);
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 2)
+    {
+        printf("Usage: %s seed <seed> [--pieces n] [--height h] [--threads n] [--pin]\n"
+               "       %s bench [--positions n] [--pieces n] [--height h] [--threads n] [--pin] [--seed s]\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    const char* Command = argv[1];
+
+    unsigned int PositionCount = SOLVE_DEFAULT_POSITIONS;
+    unsigned int PieceCount = SOLVER_DEFAULT_PIECES;
+    unsigned int MaxHeight = SOLVER_DEFAULT_HEIGHT;
+    unsigned int ThreadCount = std::thread::hardware_concurrency();
+    unsigned int Seed = 1;
+    bool Pin = false;
+    int FirstPositional = 0;
+
+    for(int Arg = 2; Arg < argc; ++Arg)
+    {
+        bool HasValue = (Arg + 1 < argc);
+
+        if( HasValue && (strcmp(argv[Arg], "--positions") == 0) )
+        {
+            PositionCount = atoi(argv[++Arg]);
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--pieces") == 0) )
+        {
+            PieceCount = atoi(argv[++Arg]);
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--height") == 0) )
+        {
+            MaxHeight = atoi(argv[++Arg]);
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--threads") == 0) )
+        {
+            ThreadCount = atoi(argv[++Arg]);
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--seed") == 0) )
+        {
+            Seed = atoi(argv[++Arg]);
+        }
+        else if(strcmp(argv[Arg], "--pin") == 0)
+        {
+            Pin = true;
+        }
+        else if(!FirstPositional)
+        {
+            FirstPositional = Arg;
+        }
+    }
+
+    ThreadCount = ThreadCount ? ThreadCount : 1;
+    PieceCount = (PieceCount < 1) ? 1 : (PieceCount > SOLVER_MAX_PIECES) ? (unsigned int)SOLVER_MAX_PIECES : PieceCount;
+    MaxHeight = (MaxHeight < 1) ? 1 : (MaxHeight > SOLVER_MAX_HEIGHT) ? (unsigned int)SOLVER_MAX_HEIGHT : MaxHeight;
+
+    BuildLockstepShapes();
+
+    bool Seeded = (strcmp(Command, "seed") == 0) && FirstPositional;
+
+    if( !Seeded && (strcmp(Command, "bench") != 0) )
+    {
+        printf("Unknown command %s\n", Command);
+        return 1;
+    }
+
+    JobSystem* System = CreateJobSystem(ThreadCount, Pin);
+
+    if(System == NULL)
+    {
+        return 1;
+    }
+
+    int Result = Seeded ? SolveSeed((unsigned int)strtoul(argv[FirstPositional], NULL, 10), PieceCount, MaxHeight, System)
+                        : BenchmarkSolver(PositionCount, PieceCount, MaxHeight, System, Seed);
+
+    DestroyJobSystem(System);
+
+    return Result;
+}
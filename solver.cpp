@@ -0,0 +1,593 @@
+#include <string.h>
+
+#include "solver.h"
+
+//Blocks in every piece
+#define SOLVER_PIECE_BLOCKS 4
+
+/*
+ * Memo
+ */
+
+bool OpenSolverMemo(SolverMemo* Memo, unsigned int Bits)
+{
+    Memo->Bits = Bits;
+    Memo->Keys = new std::atomic<unsigned long long>[1ull << Bits];
+
+    ClearSolverMemo(Memo);
+
+    return true;
+}
+
+void ClearSolverMemo(SolverMemo* Memo)
+{
+    unsigned long long Size = 1ull << Memo->Bits;
+
+    for(unsigned long long Slot = 0; Slot < Size; ++Slot)
+    {
+        Memo->Keys[Slot].store(0, std::memory_order_relaxed);
+    }
+}
+
+void CloseSolverMemo(SolverMemo* Memo)
+{
+    delete[] Memo->Keys;
+    Memo->Keys = NULL;
+}
+
+inline unsigned long long GetSolverSlot(const SolverMemo* Memo, unsigned long long Key)
+{
+    return (Key*0x9E3779B97F4A7C15ull) >> (64 - Memo->Bits);
+}
+
+bool FindSolverMemo(const SolverMemo* Memo, unsigned long long Key)
+{
+    unsigned long long Mask = (1ull << Memo->Bits) - 1;
+    unsigned long long Slot = GetSolverSlot(Memo, Key);
+
+    for(unsigned int Probe = 0; Probe < SOLVER_MEMO_PROBES; ++Probe)
+    {
+        unsigned long long Stored = Memo->Keys[(Slot + Probe) & Mask].load(std::memory_order_relaxed);
+
+        if(Stored == Key)
+        {
+            return true;
+        }
+
+        if(Stored == 0)
+        {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+//A full neighbourhood just means the key isn't remembered
+void InsertSolverMemo(SolverMemo* Memo, unsigned long long Key)
+{
+    unsigned long long Mask = (1ull << Memo->Bits) - 1;
+    unsigned long long Slot = GetSolverSlot(Memo, Key);
+
+    for(unsigned int Probe = 0; Probe < SOLVER_MEMO_PROBES; ++Probe)
+    {
+        unsigned long long Expected = 0;
+        std::atomic<unsigned long long>* Entry = Memo->Keys + ((Slot + Probe) & Mask);
+
+        if( Entry->compare_exchange_strong(Expected, Key, std::memory_order_relaxed) || (Expected == Key) )
+        {
+            return;
+        }
+    }
+}
+
+/*
+ * Search
+ */
+
+struct SolverJob{
+    const unsigned int* Types;
+    unsigned int PieceCount;
+    unsigned int TopRow;        //Highest row blocks may be in
+    unsigned long long NodeLimit;
+    SolverMemo* Memo;
+
+    //The falling piece's placements, each a branch the searchers share out
+    unsigned int BranchCount;
+    BotPlacement Branches[BOT_MAX_PLACEMENTS];
+    unsigned int BranchBoards[BOT_MAX_PLACEMENTS][LOCKSTEP_ROWS];
+
+    BotPlacement Solutions[BOT_MAX_PLACEMENTS][SOLVER_MAX_PIECES];
+    unsigned int SolutionLengths[BOT_MAX_PLACEMENTS];
+
+    std::atomic<unsigned int> NextBranch;
+    std::atomic<unsigned int> Solved;       //Earliest branch with a solution so far, BranchCount for none
+    std::atomic<unsigned long long> Nodes;
+    std::atomic<unsigned long long> MemoHits;
+    std::atomic<bool> OutOfNodes;
+};
+
+struct SolverSearch{
+    SolverJob* Job;
+    unsigned int Branch;
+    unsigned int Length;
+    BotPlacement Path[SOLVER_MAX_PIECES];
+    unsigned long long MemoHits;
+};
+
+//The rows from TopRow down, GRID_COLS bits each with the bottom row lowest
+unsigned long long PackSolverBoard(const unsigned int* RowMasks, unsigned int TopRow)
+{
+    const unsigned int Columns = (1u << GRID_COLS) - 1;
+    unsigned long long Result = 0;
+
+    for(unsigned int Row = TopRow; Row < GRID_ROWS; ++Row)
+    {
+        Result |= (unsigned long long)((RowMasks[Row] >> LOCKSTEP_WALL) & Columns) << ((GRID_ROWS - 1 - Row)*GRID_COLS);
+    }
+
+    return Result;
+}
+
+//A perfect clear has to fill every row up to the top of the stack, so the
+//blocks there plus four a piece have to come to a multiple of GRID_COLS at
+//least that high within the pieces left
+bool CanStillClear(unsigned long long Board, unsigned int PiecesLeft)
+{
+    const unsigned long long Columns = (1u << GRID_COLS) - 1;
+
+    unsigned int Blocks = 0;
+    unsigned int Height = 0;
+
+    for(unsigned int Row = 0; Row < SOLVER_MAX_HEIGHT; ++Row)
+    {
+        unsigned long long Cells = (Board >> (Row*GRID_COLS)) & Columns;
+
+        Blocks += PopCount((unsigned int)Cells);
+        Height = Cells ? Row + 1 : Height;
+    }
+
+    for(unsigned int Pieces = 1; Pieces <= PiecesLeft; ++Pieces)
+    {
+        unsigned int Total = Blocks + Pieces*SOLVER_PIECE_BLOCKS;
+
+        if( ((Total % GRID_COLS) == 0) && (Total >= Height*GRID_COLS) )
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//Drops the piece into To and clears any lines, false if it reaches above TopRow
+bool PlaceSolverPiece(const unsigned int* From, unsigned int Type, BotPlacement Placement, unsigned int TopRow,
+                      unsigned int* To)
+{
+    const unsigned int* Shape = LockstepShapes.Rows[Type][Placement.Rotation];
+
+    for(unsigned int Row = 0; Row < TETROMINO_MAX_SIZE; ++Row)
+    {
+        if( Shape[Row] && (Placement.Row + (int)Row < (int)TopRow) )
+        {
+            return false;
+        }
+    }
+
+    memcpy(To, From, sizeof(unsigned int)*LOCKSTEP_ROWS);
+
+    for(unsigned int Row = 0; Row < TETROMINO_MAX_SIZE; ++Row)
+    {
+        To[Placement.Row + Row] |= Shape[Row] << (Placement.Col + LOCKSTEP_WALL);
+    }
+
+    ClearBotRows(To);
+
+    return true;
+}
+
+//Another branch already has an earlier solution, or the nodes ran out
+inline bool AbandonSolverSearch(const SolverSearch* Search)
+{
+    return (Search->Job->Solved.load(std::memory_order_relaxed) < Search->Branch) ||
+           Search->Job->OutOfNodes.load(std::memory_order_relaxed);
+}
+
+//True if the pieces from Depth on can clear RowMasks, with their placements
+//in Search->Path
+bool SearchPerfectClear(SolverSearch* Search, const unsigned int* RowMasks, unsigned int Depth)
+{
+    SolverJob* Job = Search->Job;
+
+    if(Depth == Job->PieceCount)
+    {
+        return false;
+    }
+
+    unsigned long long Board = PackSolverBoard(RowMasks, Job->TopRow);
+
+    if(!CanStillClear(Board, Job->PieceCount - Depth))
+    {
+        return false;
+    }
+
+    unsigned long long Key = Board | ((unsigned long long)Depth << (SOLVER_MAX_HEIGHT*GRID_COLS));
+
+    if(FindSolverMemo(Job->Memo, Key))
+    {
+        Search->MemoHits++;
+        return false;
+    }
+
+    if(AbandonSolverSearch(Search))
+    {
+        return false;
+    }
+
+    unsigned long long Node = Job->Nodes.fetch_add(1, std::memory_order_relaxed);
+
+    if( Job->NodeLimit && (Node >= Job->NodeLimit) )
+    {
+        Job->OutOfNodes.store(true);
+        return false;
+    }
+
+    unsigned int Type = Job->Types[Depth];
+
+    //Pieces after the falling one start where LockLockstepLane spawns them
+    BotPlacement Placements[BOT_MAX_PLACEMENTS];
+    unsigned int Count = ListBotPlacements(RowMasks, Type, 0, 1, 1, Placements);
+
+    unsigned long long Seen[BOT_MAX_PLACEMENTS];
+    unsigned int SeenCount = 0;
+    unsigned int Next[LOCKSTEP_ROWS];
+
+    for(unsigned int Index = 0; Index < Count; ++Index)
+    {
+        if(!PlaceSolverPiece(RowMasks, Type, Placements[Index], Job->TopRow, Next))
+        {
+            continue;
+        }
+
+        unsigned long long Child = PackSolverBoard(Next, Job->TopRow);
+
+        if(Child == 0)
+        {
+            Search->Path[Depth] = Placements[Index];
+            Search->Length = Depth + 1;
+            return true;
+        }
+
+        //Different rotations of the same shape often land identically
+        bool Repeat = false;
+
+        for(unsigned int Other = 0; (Other < SeenCount) && !Repeat; ++Other)
+        {
+            Repeat = (Seen[Other] == Child);
+        }
+
+        if(Repeat)
+        {
+            continue;
+        }
+
+        Seen[SeenCount++] = Child;
+
+        if(SearchPerfectClear(Search, Next, Depth + 1))
+        {
+            Search->Path[Depth] = Placements[Index];
+            return true;
+        }
+
+        //A cut short search hasn't shown anything
+        if(AbandonSolverSearch(Search))
+        {
+            return false;
+        }
+    }
+
+    InsertSolverMemo(Job->Memo, Key);
+
+    return false;
+}
+
+//Claims branches in order until there are none left worth searching
+void RunSolverSearcher(void* Data, unsigned long long, unsigned long long, unsigned int)
+{
+    SolverJob* Job = (SolverJob*)Data;
+
+    SolverSearch Search;
+    memset(&Search, 0, sizeof(Search));
+    Search.Job = Job;
+
+    for(;;)
+    {
+        unsigned int Branch = Job->NextBranch.fetch_add(1);
+
+        //Branches are handed out in order, so once one is solved nothing
+        //after it can do better
+        if( (Branch >= Job->BranchCount) || (Branch > Job->Solved.load()) || Job->OutOfNodes.load() )
+        {
+            break;
+        }
+
+        Search.Branch = Branch;
+
+        if(SearchPerfectClear(&Search, Job->BranchBoards[Branch], 1))
+        {
+            memcpy(Job->Solutions[Branch], Search.Path, sizeof(Search.Path));
+            Job->Solutions[Branch][0] = Job->Branches[Branch];
+            Job->SolutionLengths[Branch] = Search.Length;
+
+            unsigned int Solved = Job->Solved.load();
+
+            while( (Branch < Solved) && !Job->Solved.compare_exchange_weak(Solved, Branch) )
+            {
+            }
+        }
+    }
+
+    Job->MemoHits += Search.MemoHits;
+}
+
+PerfectClear SolvePerfectClear(const unsigned int* RowMasks, const unsigned int* Types, unsigned int PieceCount,
+                               unsigned int Rotation, int Row, int Col, unsigned int MaxHeight,
+                               unsigned long long NodeLimit, JobSystem* System, SolverMemo* Memo)
+{
+    PerfectClear Result;
+    memset(&Result, 0, sizeof(Result));
+
+    MaxHeight = (MaxHeight > SOLVER_MAX_HEIGHT) ? (unsigned int)SOLVER_MAX_HEIGHT : MaxHeight;
+    PieceCount = (PieceCount > SOLVER_MAX_PIECES) ? (unsigned int)SOLVER_MAX_PIECES : PieceCount;
+
+    unsigned int TopRow = GRID_ROWS - MaxHeight;
+
+    //Blocks already above the limit can never be cleared within it
+    for(unsigned int Check = 0; Check < TopRow; ++Check)
+    {
+        if(RowMasks[Check] != LOCKSTEP_EMPTY_ROW)
+        {
+            return Result;
+        }
+    }
+
+    if(PieceCount == 0)
+    {
+        return Result;
+    }
+
+    memcpy(Result.Types, Types, sizeof(unsigned int)*PieceCount);
+
+    SolverJob* Job = new SolverJob;
+
+    Job->Types = Types;
+    Job->PieceCount = PieceCount;
+    Job->TopRow = TopRow;
+    Job->NodeLimit = NodeLimit;
+    Job->Memo = Memo;
+    Job->BranchCount = 0;
+
+    ClearSolverMemo(Memo);
+
+    //The falling piece's placements, minus repeats, make the branches
+    BotPlacement Placements[BOT_MAX_PLACEMENTS];
+    unsigned int Count = ListBotPlacements(RowMasks, Types[0], Rotation, Row, Col, Placements);
+    unsigned long long Seen[BOT_MAX_PLACEMENTS];
+
+    for(unsigned int Index = 0; (Index < Count) && !Result.Found; ++Index)
+    {
+        unsigned int* Board = Job->BranchBoards[Job->BranchCount];
+
+        if(!PlaceSolverPiece(RowMasks, Types[0], Placements[Index], TopRow, Board))
+        {
+            continue;
+        }
+
+        unsigned long long Child = PackSolverBoard(Board, TopRow);
+        bool Repeat = false;
+
+        for(unsigned int Other = 0; (Other < Job->BranchCount) && !Repeat; ++Other)
+        {
+            Repeat = (Seen[Other] == Child);
+        }
+
+        if(Child == 0)
+        {
+            Result.Found = true;
+            Result.PieceCount = 1;
+            Result.Placements[0] = Placements[Index];
+        }
+        else if(!Repeat)
+        {
+            Seen[Job->BranchCount] = Child;
+            Job->Branches[Job->BranchCount++] = Placements[Index];
+        }
+    }
+
+    if(Result.Found)
+    {
+        delete Job;
+        return Result;
+    }
+
+    Job->NextBranch.store(0);
+    Job->Solved.store(Job->BranchCount);
+    Job->Nodes.store(0);
+    Job->MemoHits.store(0);
+    Job->OutOfNodes.store(false);
+
+    if(System)
+    {
+        //A searcher per worker rather than a job per branch: branches are
+        //worth searching in order, which stealing from the far end wouldn't do
+        unsigned int Searchers = (System->WorkerCount < Job->BranchCount) ? System->WorkerCount : Job->BranchCount;
+
+        JobGroup Group;
+        Group.Remaining.store(0);
+
+        for(unsigned int Searcher = 0; Searcher < Searchers; ++Searcher)
+        {
+            ForkJob(System, &Group, RunSolverSearcher, Job, Searcher, Searcher + 1);
+        }
+
+        JoinJobs(System, &Group);
+    }
+    else
+    {
+        RunSolverSearcher(Job, 0, 1, 0);
+    }
+
+    unsigned int Solved = Job->Solved.load();
+
+    if(Solved < Job->BranchCount)
+    {
+        Result.Found = true;
+        Result.PieceCount = Job->SolutionLengths[Solved];
+        memcpy(Result.Placements, Job->Solutions[Solved], sizeof(Result.Placements));
+    }
+
+    Result.Exhausted = !Result.Found && Job->OutOfNodes.load();
+    Result.Nodes = Job->Nodes.load();
+    Result.Nodes = (NodeLimit && (Result.Nodes > NodeLimit)) ? NodeLimit : Result.Nodes;
+    Result.MemoHits = Job->MemoHits.load();
+
+    delete Job;
+
+    return Result;
+}
+
+void GetUpcomingTypes(GameData Game, unsigned int* Types, unsigned int Count)
+{
+    unsigned int RandomState = Game.Random.State;
+
+    for(unsigned int Index = 0; Index < Count; ++Index)
+    {
+        if(Index == 0)
+        {
+            Types[Index] = Game.FallingTetro.Type;
+        }
+        else if(Index == 1)
+        {
+            Types[Index] = Game.NextTetro.Type;
+        }
+        else
+        {
+            Types[Index] = LockstepGenerateType(&RandomState);
+        }
+    }
+}
+
+//Only meaningful while the game is RUNNING on a standard sized grid
+PerfectClear SolvePerfectClearGame(GameData Game, unsigned int PieceCount, unsigned int MaxHeight,
+                                   unsigned long long NodeLimit, JobSystem* System, SolverMemo* Memo)
+{
+    unsigned int RowMasks[LOCKSTEP_ROWS];
+    unsigned int Rotation = 0;
+    unsigned int Types[SOLVER_MAX_PIECES];
+
+    PieceCount = (PieceCount > SOLVER_MAX_PIECES) ? (unsigned int)SOLVER_MAX_PIECES : PieceCount;
+
+    GetBotBoard(Game, RowMasks, &Rotation);
+    GetUpcomingTypes(Game, Types, PieceCount);
+
+    return SolvePerfectClear(RowMasks, Types, PieceCount, Rotation, Game.FallingTetro.Row, Game.FallingTetro.Col,
+                             MaxHeight, NodeLimit, System, Memo);
+}
+
+/*
+ * Perfect Clear Bot
+ */
+
+PerfectClearBot GeneratePerfectClearBot(unsigned int PiecesAhead, unsigned long long NodeLimit)
+{
+    PerfectClearBot Result;
+    memset(&Result, 0, sizeof(Result));
+
+    Result.PiecesAhead = PiecesAhead;
+    Result.NodeLimit = NodeLimit;
+
+    return Result;
+}
+
+InputState GetPerfectClearBotInputs(GameData Game, BotWeights Weights, PerfectClearBot* Bot, SolverMemo* Memo)
+{
+    unsigned int RowMasks[LOCKSTEP_ROWS];
+    unsigned int Rotation = 0;
+
+    GetBotBoard(Game, RowMasks, &Rotation);
+
+    //The random state moves on when a piece locks, and with a new game
+    if(Game.Random.State != Bot->RandomState)
+    {
+        Bot->RandomState = Game.Random.State;
+        Bot->Tried = false;
+
+        if( Bot->Plan.Found && (++Bot->Step == Bot->Plan.PieceCount) )
+        {
+            bool Empty = true;
+
+            for(unsigned int Row = 0; Row < GRID_ROWS; ++Row)
+            {
+                Empty &= (RowMasks[Row] == LOCKSTEP_EMPTY_ROW);
+            }
+
+            Bot->Plan.Found = false;
+            Bot->PerfectClears += Empty;
+        }
+    }
+
+    if( !Bot->Plan.Found && !Bot->Tried )
+    {
+        Bot->Tried = true;
+        Bot->Plan = SolvePerfectClearGame(Game, Bot->PiecesAhead, SOLVER_DEFAULT_HEIGHT, Bot->NodeLimit, NULL, Memo);
+        Bot->Step = 0;
+        Bot->PlansFound += Bot->Plan.Found;
+    }
+
+    //A new game, say, can leave the plan for pieces that aren't coming
+    if( Bot->Plan.Found && (Bot->Plan.Types[Bot->Step] != (unsigned int)Game.FallingTetro.Type) )
+    {
+        Bot->Plan.Found = false;
+    }
+
+    if(Bot->Plan.Found)
+    {
+        //Follow the plan for as long as its next placement can be reached
+        BotPlacement Planned = Bot->Plan.Placements[Bot->Step];
+        BotPlacement Placements[BOT_MAX_PLACEMENTS];
+        unsigned int Count = ListBotPlacements(RowMasks, Game.FallingTetro.Type, Rotation,
+                                               Game.FallingTetro.Row, Game.FallingTetro.Col, Placements);
+        bool Reachable = false;
+
+        for(unsigned int Index = 0; (Index < Count) && !Reachable; ++Index)
+        {
+            Reachable = (Placements[Index].Rotation == Planned.Rotation) && (Placements[Index].Col == Planned.Col) &&
+                        (Placements[Index].Row == Planned.Row);
+        }
+
+        if(Reachable)
+        {
+            BotMove Move;
+            Move.Valid = true;
+            Move.Rotation = Planned.Rotation;
+            Move.Col = Planned.Col;
+            Move.Score = 0.0f;
+
+            unsigned int Input = SteerBotMove(Move, Rotation, Game.FallingTetro.Col);
+
+            InputState Result;
+            memset(&Result, 0, sizeof(Result));
+
+            Result.Up       = (Input & LOCKSTEP_ROTATE) != 0;
+            Result.Down     = (Input & LOCKSTEP_DOWN) != 0;
+            Result.Left     = (Input & LOCKSTEP_LEFT) != 0;
+            Result.Right    = (Input & LOCKSTEP_RIGHT) != 0;
+
+            return Result;
+        }
+
+        Bot->Plan.Found = false;
+    }
+
+    return GetBotInputs(Game, Weights);
+}
@@ -0,0 +1,102 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <atomic>
+
+#include "bot.h"
+#include "jobs.h"
+
+/*
+ * Perfect Clear Solver
+ *
+ * Given a board, the falling piece and the pieces after it, finds placements
+ * for them, in order, that leave the board completely empty - or shows there
+ * aren't any within that many pieces. Placements are the ones the bot can
+ * steer to (ListBotPlacements), the falling piece from where it is and every
+ * piece after it from where it spawns, and every block has to stay within the
+ * bottom MaxHeight rows.
+ *
+ * The search is depth first over the placements of each piece in turn. Every
+ * board within MaxHeight rows packs into 60 bits, and with the depth on top
+ * that's the key for a memo table of states already shown to fail, shared by
+ * every searcher. Placements that leave the same board as one tried before them
+ * are skipped, and so is any board whose block count can't reach an exact
+ * multiple of its width in the pieces left.
+ *
+ * The falling piece's placements are shared out across a job system's workers,
+ * a searcher job on each taking them in order. The solution is always the one
+ * under the earliest of those that has one, so the answer doesn't depend on
+ * the number of workers or how they're scheduled - only the node and memo
+ * counts do.
+ */
+
+enum SolverConstants{
+    SOLVER_MAX_PIECES       = 15,   //Depth has 4 bits of the memo key
+    SOLVER_MAX_HEIGHT       = 6,    //Rows of GRID_COLS in the other 60
+    SOLVER_DEFAULT_HEIGHT   = 4,
+    SOLVER_DEFAULT_PIECES   = 10,
+
+    SOLVER_DEFAULT_MEMO_BITS = 22,  //Entries, as a power of two
+    SOLVER_MEMO_PROBES      = 8     //Slots looked at before giving up on a key
+};
+
+struct PerfectClear{
+    bool Found;
+    bool Exhausted;             //Ran out of nodes first, so not finding one proves nothing
+    unsigned int PieceCount;    //Used by the solution
+    unsigned int Types[SOLVER_MAX_PIECES];
+    BotPlacement Placements[SOLVER_MAX_PIECES];
+
+    unsigned long long Nodes;   //Boards expanded
+    unsigned long long MemoHits;
+};
+
+//Keys of failed states, 0 for an empty slot. The empty board never fails, so
+//its key (0 at depth 0) never needs storing.
+struct SolverMemo{
+    std::atomic<unsigned long long>* Keys;
+    unsigned int Bits;
+};
+
+bool            OpenSolverMemo(SolverMemo* Memo, unsigned int Bits);
+void            ClearSolverMemo(SolverMemo* Memo);
+void            CloseSolverMemo(SolverMemo* Memo);
+
+//Types holds the falling piece then the PieceCount - 1 after it. NodeLimit 0
+//searches until it has an answer. Clears the memo first. A NULL System
+//searches on the calling thread alone.
+PerfectClear    SolvePerfectClear(const unsigned int* RowMasks, const unsigned int* Types, unsigned int PieceCount,
+                                  unsigned int Rotation, int Row, int Col, unsigned int MaxHeight,
+                                  unsigned long long NodeLimit, JobSystem* System, SolverMemo* Memo);
+
+//The pieces after the next one come from a copy of the game's random series
+void            GetUpcomingTypes(GameData Game, unsigned int* Types, unsigned int Count);
+PerfectClear    SolvePerfectClearGame(GameData Game, unsigned int PieceCount, unsigned int MaxHeight,
+                                      unsigned long long NodeLimit, JobSystem* System, SolverMemo* Memo);
+
+/*
+ * Perfect Clear Bot
+ *
+ * Plays like the heuristic bot, but each time a piece spawns on a low enough
+ * board it looks for a perfect clear, and follows one while it has it. If
+ * gravity or anything else takes the next planned placement out of reach, it
+ * drops the plan and goes back to the heuristic.
+ */
+
+struct PerfectClearBot{
+    PerfectClear Plan;
+    unsigned int Step;          //Plan placement for the falling piece
+    unsigned int RandomState;   //Moves on when a piece locks
+    bool Tried;                 //Already searched for this piece
+
+    unsigned int PiecesAhead;
+    unsigned long long NodeLimit;
+
+    unsigned int PlansFound;
+    unsigned int PerfectClears;
+};
+
+PerfectClearBot GeneratePerfectClearBot(unsigned int PiecesAhead, unsigned long long NodeLimit);
+InputState      GetPerfectClearBotInputs(GameData Game, BotWeights Weights, PerfectClearBot* Bot, SolverMemo* Memo);
+
+#endif
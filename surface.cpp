@@ -0,0 +1,580 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "surface.h"
+
+/*
+ * Placements
+ */
+
+struct SurfacePlacementTable{
+    BotPlacement Placements[LOCKSTEP_SHAPES][SURFACE_MAX_PLACEMENTS];
+    unsigned int Counts[LOCKSTEP_SHAPES];
+
+    //Per placement and column of the shape's grid, the shape rows of the
+    //lowest and highest block in it, -1 for an empty column
+    signed char Lowest[LOCKSTEP_SHAPES][SURFACE_MAX_PLACEMENTS][TETROMINO_MAX_SIZE];
+    signed char Highest[LOCKSTEP_SHAPES][SURFACE_MAX_PLACEMENTS][TETROMINO_MAX_SIZE];
+};
+
+SurfacePlacementTable BuildSurfacePlacements()
+{
+    BuildLockstepShapes();
+
+    SurfacePlacementTable Result;
+    memset(&Result, 0, sizeof(Result));
+
+    unsigned int Empty[LOCKSTEP_ROWS];
+
+    for(unsigned int Row = 0; Row < LOCKSTEP_ROWS; ++Row)
+    {
+        Empty[Row] = (Row < GRID_ROWS) ? LOCKSTEP_EMPTY_ROW : LOCKSTEP_SOLID_ROW;
+    }
+
+    for(unsigned int Type = 0; Type < LOCKSTEP_SHAPES; ++Type)
+    {
+        //The O shape is the same every way round
+        unsigned int Rotations = (Type == O_SHAPE) ? 1 : (unsigned int)LOCKSTEP_ROTATIONS;
+
+        for(unsigned int Rotation = 0; Rotation < Rotations; ++Rotation)
+        {
+            const unsigned int* Shape = LockstepShapes.Rows[Type][Rotation];
+
+            for(int Col = -(int)LOCKSTEP_WALL; Col < GRID_COLS; ++Col)
+            {
+                if(BotCollides(Empty, Shape, 0, Col))
+                {
+                    continue;
+                }
+
+                unsigned int Index = Result.Counts[Type]++;
+
+                Result.Placements[Type][Index].Rotation = Rotation;
+                Result.Placements[Type][Index].Col = Col;
+                Result.Placements[Type][Index].Row = 0;
+
+                for(unsigned int ShapeCol = 0; ShapeCol < TETROMINO_MAX_SIZE; ++ShapeCol)
+                {
+                    Result.Lowest[Type][Index][ShapeCol] = -1;
+                    Result.Highest[Type][Index][ShapeCol] = -1;
+
+                    for(int ShapeRow = 0; ShapeRow < TETROMINO_MAX_SIZE; ++ShapeRow)
+                    {
+                        if(Shape[ShapeRow] & (1u << ShapeCol))
+                        {
+                            Result.Lowest[Type][Index][ShapeCol] = (signed char)ShapeRow;
+
+                            if(Result.Highest[Type][Index][ShapeCol] < 0)
+                            {
+                                Result.Highest[Type][Index][ShapeCol] = (signed char)ShapeRow;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return Result;
+}
+
+//Built the first time any thread asks
+const SurfacePlacementTable* GetSurfacePlacementTable()
+{
+    static const SurfacePlacementTable Table = BuildSurfacePlacements();
+
+    return &Table;
+}
+
+unsigned int GetSurfacePlacements(unsigned int Type, BotPlacement* Placements)
+{
+    const SurfacePlacementTable* Table = GetSurfacePlacementTable();
+
+    memcpy(Placements, Table->Placements[Type], Table->Counts[Type]*sizeof(BotPlacement));
+
+    return Table->Counts[Type];
+}
+
+/*
+ * Generating
+ *
+ * Each surface is built as column heights from its differences, and every
+ * placement is dropped onto it and scored in height terms: the lowest block
+ * in each column lands one above the column, the column's new height is the
+ * highest block, and the gap between the old height and the lowest block is
+ * holes. The score leaves out what every placement has in common - the
+ * height of the floor and the holes already there - so it's only good for
+ * comparing placements on the same surface.
+ */
+
+struct SurfaceJob{
+    unsigned int Bumpiness;
+    unsigned int SurfaceCount;
+    BotWeights Weights;
+    unsigned char* Moves;
+};
+
+void GenerateSurfaceMoves(void* Data, unsigned long long First, unsigned long long Last, unsigned int)
+{
+    SurfaceJob* Job = (SurfaceJob*)Data;
+    const SurfacePlacementTable* Table = GetSurfacePlacementTable();
+
+    unsigned int Base = 2*Job->Bumpiness + 1;
+
+    for(unsigned int Surface = (unsigned int)First; Surface < Last; ++Surface)
+    {
+        int Heights[GRID_COLS];
+        int Lowest = 0;
+
+        Heights[0] = 0;
+
+        for(unsigned int Col = 1, Digits = Surface; Col < GRID_COLS; ++Col, Digits /= Base)
+        {
+            Heights[Col] = Heights[Col-1] + (int)(Digits % Base) - (int)Job->Bumpiness;
+            Lowest = (Heights[Col] < Lowest) ? Heights[Col] : Lowest;
+        }
+
+        for(unsigned int Col = 0; Col < GRID_COLS; ++Col)
+        {
+            Heights[Col] -= Lowest;
+        }
+
+        for(unsigned int Type = 0; Type < LOCKSTEP_SHAPES; ++Type)
+        {
+            unsigned int Best = 0;
+            float BestScore = 0.0f;
+
+            for(unsigned int Index = 0; Index < Table->Counts[Type]; ++Index)
+            {
+                const signed char* LowestRows = Table->Lowest[Type][Index];
+                const signed char* HighestRows = Table->Highest[Type][Index];
+                int Col = Table->Placements[Type][Index].Col;
+
+                //Height of the bottom of the shape's grid where it comes to rest
+                int Bottom = -1000;
+
+                for(int ShapeCol = 0; ShapeCol < TETROMINO_MAX_SIZE; ++ShapeCol)
+                {
+                    if(LowestRows[ShapeCol] >= 0)
+                    {
+                        int Rest = Heights[Col + ShapeCol] - (TETROMINO_MAX_SIZE - 1 - LowestRows[ShapeCol]);
+                        Bottom = (Rest > Bottom) ? Rest : Bottom;
+                    }
+                }
+
+                int NewHeights[GRID_COLS];
+                int Holes = 0;
+                int TotalHeight = 0;
+
+                memcpy(NewHeights, Heights, sizeof(NewHeights));
+
+                for(int ShapeCol = 0; ShapeCol < TETROMINO_MAX_SIZE; ++ShapeCol)
+                {
+                    if(LowestRows[ShapeCol] >= 0)
+                    {
+                        int LowestBlock = Bottom + (TETROMINO_MAX_SIZE - LowestRows[ShapeCol]);
+
+                        Holes += LowestBlock - 1 - Heights[Col + ShapeCol];
+                        NewHeights[Col + ShapeCol] = Bottom + (TETROMINO_MAX_SIZE - HighestRows[ShapeCol]);
+                    }
+                }
+
+                int Bumpiness = 0;
+
+                for(unsigned int Col2 = 0; Col2 < GRID_COLS; ++Col2)
+                {
+                    TotalHeight += NewHeights[Col2];
+
+                    if(Col2)
+                    {
+                        int Step = NewHeights[Col2] - NewHeights[Col2-1];
+                        Bumpiness += (Step < 0) ? -Step : Step;
+                    }
+                }
+
+                float Score = Job->Weights.Height*TotalHeight + Job->Weights.Holes*Holes + Job->Weights.Bumpiness*Bumpiness;
+
+                if( (Index == 0) || (Score > BestScore) )
+                {
+                    Best = Index;
+                    BestScore = Score;
+                }
+            }
+
+            Job->Moves[(size_t)Type*Job->SurfaceCount + Surface] = (unsigned char)Best;
+        }
+    }
+}
+
+bool GenerateSurfaceTable(const char* Path, unsigned int Bumpiness, BotWeights Weights, JobSystem* System)
+{
+    if( (Bumpiness < 1) || (Bumpiness > SURFACE_MAX_BUMPINESS) )
+    {
+        printf("Bumpiness has to be between 1 and %u\n", SURFACE_MAX_BUMPINESS);
+        return false;
+    }
+
+    SurfaceJob* Job = new SurfaceJob;
+
+    Job->Bumpiness = Bumpiness;
+    Job->SurfaceCount = 1;
+    Job->Weights = Weights;
+
+    for(unsigned int Col = 1; Col < GRID_COLS; ++Col)
+    {
+        Job->SurfaceCount *= 2*Bumpiness + 1;
+    }
+
+    size_t MovesSize = (size_t)LOCKSTEP_SHAPES*Job->SurfaceCount;
+    Job->Moves = (unsigned char*)malloc(MovesSize);
+
+    FILE* File = Job->Moves ? fopen(Path, "wb") : NULL;
+
+    if(File == NULL)
+    {
+        printf(Job->Moves ? "Could not open %s\n" : "Could not allocate a table for %s\n", Path);
+        free(Job->Moves);
+        delete Job;
+        return false;
+    }
+
+    //Built before there are jobs to race for it
+    GetSurfacePlacementTable();
+
+    ParallelFor(System, Job->SurfaceCount, SURFACE_BATCH, GenerateSurfaceMoves, Job);
+
+    SurfaceTableHeader Header;
+    memset(&Header, 0, sizeof(Header));
+
+    Header.Magic = SURFACE_MAGIC;
+    Header.Version = SURFACE_VERSION;
+    Header.Bumpiness = Bumpiness;
+    Header.SurfaceCount = Job->SurfaceCount;
+    Header.Weights = Weights;
+    Header.TypeCount = LOCKSTEP_SHAPES;
+
+    bool Written = (fwrite(&Header, sizeof(Header), 1, File) == 1) && (fwrite(Job->Moves, 1, MovesSize, File) == MovesSize);
+    Written = (fclose(File) == 0) && Written;
+
+    if(!Written)
+    {
+        printf("Could not write %s\n", Path);
+    }
+
+    free(Job->Moves);
+    delete Job;
+
+    return Written;
+}
+
+/*
+ * Reading
+ */
+
+bool MapSurfaceFile(const char* Path, SurfaceTable* Table)
+{
+#if defined(_WIN32)
+    HANDLE File = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if(File == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER Size;
+    HANDLE Mapping = NULL;
+    void* Memory = NULL;
+
+    if( GetFileSizeEx(File, &Size) && (Size.QuadPart > 0) )
+    {
+        Mapping = CreateFileMappingA(File, NULL, PAGE_READONLY, 0, 0, NULL);
+    }
+
+    if(Mapping)
+    {
+        Memory = MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+
+    //The mapping keeps the file open
+    CloseHandle(File);
+
+    if(Memory == NULL)
+    {
+        if(Mapping)
+        {
+            CloseHandle(Mapping);
+        }
+
+        return false;
+    }
+
+    Table->Base = (const unsigned char*)Memory;
+    Table->Size = (size_t)Size.QuadPart;
+    Table->Handle = Mapping;
+#else
+    int File = open(Path, O_RDONLY);
+
+    if(File < 0)
+    {
+        return false;
+    }
+
+    struct stat Info;
+    void* Memory = MAP_FAILED;
+
+    if( (fstat(File, &Info) == 0) && (Info.st_size > 0) )
+    {
+        Memory = mmap(NULL, Info.st_size, PROT_READ, MAP_SHARED, File, 0);
+    }
+
+    close(File);
+
+    if(Memory == MAP_FAILED)
+    {
+        return false;
+    }
+
+    Table->Base = (const unsigned char*)Memory;
+    Table->Size = Info.st_size;
+#endif
+
+    return true;
+}
+
+void UnmapSurfaceFile(SurfaceTable* Table)
+{
+#if defined(_WIN32)
+    UnmapViewOfFile(Table->Base);
+    CloseHandle((HANDLE)Table->Handle);
+#else
+    munmap((void*)Table->Base, Table->Size);
+#endif
+}
+
+SurfaceTable OpenSurfaceTable(const char* Path)
+{
+    SurfaceTable Result;
+    memset(&Result, 0, sizeof(Result));
+
+    if( !MapSurfaceFile(Path, &Result) )
+    {
+        printf("Could not open surface table %s!\n", Path);
+        return Result;
+    }
+
+    const SurfaceTableHeader* Header = (const SurfaceTableHeader*)Result.Base;
+
+    bool Valid = (Result.Size >= sizeof(SurfaceTableHeader)) &&
+                 (Header->Magic == SURFACE_MAGIC) && (Header->Version == SURFACE_VERSION) &&
+                 (Header->Bumpiness >= 1) && (Header->Bumpiness <= SURFACE_MAX_BUMPINESS) &&
+                 (Header->TypeCount == LOCKSTEP_SHAPES) &&
+                 ((Result.Size - sizeof(SurfaceTableHeader))/LOCKSTEP_SHAPES >= Header->SurfaceCount);
+
+    unsigned int SurfaceCount = 1;
+
+    for(unsigned int Col = 1; Valid && (Col < GRID_COLS); ++Col)
+    {
+        SurfaceCount *= 2*Header->Bumpiness + 1;
+    }
+
+    if( !Valid || (SurfaceCount != Header->SurfaceCount) )
+    {
+        printf("%s is not a surface table, or is damaged!\n", Path);
+        UnmapSurfaceFile(&Result);
+        memset(&Result, 0, sizeof(Result));
+        return Result;
+    }
+
+    Result.Header = Header;
+    Result.Moves = Result.Base + sizeof(SurfaceTableHeader);
+    Result.Valid = true;
+
+    return Result;
+}
+
+void CloseSurfaceTable(SurfaceTable* Table)
+{
+    if(Table->Base)
+    {
+        UnmapSurfaceFile(Table);
+    }
+
+    memset(Table, 0, sizeof(*Table));
+}
+
+/*
+ * Lookups
+ */
+
+bool LookupSurfaceMove(const SurfaceTable* Table, const unsigned int* RowMasks, unsigned int Type, unsigned int Rotation,
+                       int Row, int Col, BotWeights Weights, BotMove* Move)
+{
+    const unsigned int Columns = (1u << GRID_COLS) - 1;
+
+    if( (Table == NULL) || !Table->Valid || (memcmp(&Table->Header->Weights, &Weights, sizeof(Weights)) != 0) )
+    {
+        return false;
+    }
+
+    //The piece has to be clear of the stack
+    if( (Row < 0) || (Row + TETROMINO_MAX_SIZE > GRID_ROWS) )
+    {
+        return false;
+    }
+
+    for(int Row2 = Row; Row2 < Row + TETROMINO_MAX_SIZE; ++Row2)
+    {
+        if(RowMasks[Row2] != LOCKSTEP_EMPTY_ROW)
+        {
+            return false;
+        }
+    }
+
+    int Heights[GRID_COLS] = {0};
+    unsigned int Seen = 0;
+
+    //Top down as ScoreBotBoard does. Seen is the columns whose top is at or
+    //above this row, so a row's gaps outside Seen are open to a piece; any
+    //gap inside it is a hole. A row with nothing but open gaps, four or
+    //fewer, could be finished by this piece.
+    for(unsigned int Row2 = 0; Row2 < GRID_ROWS; ++Row2)
+    {
+        unsigned int Cells = (RowMasks[Row2] >> LOCKSTEP_WALL) & Columns;
+        unsigned int Tops = Cells & ~Seen;
+
+        Seen |= Cells;
+
+        unsigned int Gaps = ~Cells & Columns;
+
+        if( !(Gaps & Seen) && (PopCount(Gaps) <= TETROMINO_MAX_SIZE) )
+        {
+            return false;
+        }
+
+        while(Tops)
+        {
+            unsigned int Column = CountTrailingZeros(Tops);
+            Heights[Column] = GRID_ROWS - Row2;
+            Tops &= Tops - 1;
+        }
+    }
+
+    unsigned int Bumpiness = Table->Header->Bumpiness;
+    unsigned int Surface = 0;
+
+    for(unsigned int Column = GRID_COLS - 1; Column >= 1; --Column)
+    {
+        int Step = Heights[Column] - Heights[Column-1];
+
+        if( (Step < -(int)Bumpiness) || (Step > (int)Bumpiness) )
+        {
+            return false;
+        }
+
+        Surface = Surface*(2*Bumpiness + 1) + (unsigned int)(Step + (int)Bumpiness);
+    }
+
+    const SurfacePlacementTable* Placements = GetSurfacePlacementTable();
+    unsigned int Index = Table->Moves[(size_t)Type*Table->Header->SurfaceCount + Surface];
+
+    if(Index >= Placements->Counts[Type])
+    {
+        return false;
+    }
+
+    BotPlacement Placement = Placements->Placements[Type][Index];
+
+    //Turning has to get past the walls where the piece is now, sliding and
+    //dropping can't be blocked with the rows clear
+    if(Type == O_SHAPE)
+    {
+        Placement.Rotation = Rotation;
+    }
+
+    for(unsigned int Turn = Rotation; Turn != Placement.Rotation; )
+    {
+        Turn = (Turn + 1) & (LOCKSTEP_ROTATIONS-1);
+
+        if(BotCollides(RowMasks, LockstepShapes.Rows[Type][Turn], Row, Col))
+        {
+            return false;
+        }
+    }
+
+    //Score it as the search would have, for the one placement
+    const unsigned int* Shape = LockstepShapes.Rows[Type][Placement.Rotation];
+    int LandingRow = Row;
+
+    while(!BotCollides(RowMasks, Shape, LandingRow + 1, Placement.Col))
+    {
+        ++LandingRow;
+    }
+
+    unsigned int Scratch[LOCKSTEP_ROWS];
+    memcpy(Scratch, RowMasks, sizeof(Scratch));
+
+    for(unsigned int Row2 = 0; Row2 < TETROMINO_MAX_SIZE; ++Row2)
+    {
+        Scratch[LandingRow + Row2] |= Shape[Row2] << (Placement.Col + LOCKSTEP_WALL);
+    }
+
+    Move->Valid = true;
+    Move->Rotation = Placement.Rotation;
+    Move->Col = Placement.Col;
+    Move->Score = ScoreBotBoard(Scratch, 0, Weights);
+
+    return true;
+}
+
+BotMove PlanSurfaceBotMove(const SurfaceTable* Table, const unsigned int* RowMasks, unsigned int Type,
+                           unsigned int Rotation, int Row, int Col, BotWeights Weights, SurfaceStats* Stats)
+{
+    BotMove Result;
+    bool Hit = LookupSurfaceMove(Table, RowMasks, Type, Rotation, Row, Col, Weights, &Result);
+
+    if(Stats)
+    {
+        Stats->Lookups++;
+        Stats->Hits += Hit ? 1 : 0;
+    }
+
+    if(!Hit)
+    {
+        Result = PlanBotMoveMasks(RowMasks, Type, Rotation, Row, Col, Weights);
+    }
+
+    return Result;
+}
+
+InputState GetSurfaceBotInputs(GameData Game, BotWeights Weights, const SurfaceTable* Table, SurfaceStats* Stats)
+{
+    unsigned int RowMasks[LOCKSTEP_ROWS];
+    unsigned int Rotation = 0;
+
+    GetBotBoard(Game, RowMasks, &Rotation);
+
+    BotMove Move = PlanSurfaceBotMove(Table, RowMasks, Game.FallingTetro.Type, Rotation,
+                                      Game.FallingTetro.Row, Game.FallingTetro.Col, Weights, Stats);
+    unsigned int Input = SteerBotMove(Move, Rotation, Game.FallingTetro.Col);
+
+    InputState Result;
+    memset(&Result, 0, sizeof(Result));
+
+    Result.Up       = (Input & LOCKSTEP_ROTATE) != 0;
+    Result.Down     = (Input & LOCKSTEP_DOWN) != 0;
+    Result.Left     = (Input & LOCKSTEP_LEFT) != 0;
+    Result.Right    = (Input & LOCKSTEP_RIGHT) != 0;
+
+    return Result;
+}
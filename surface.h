@@ -0,0 +1,103 @@
+#ifndef SURFACE_H
+#define SURFACE_H
+
+#include <stddef.h>
+
+#include "bot.h"
+#include "jobs.h"
+
+/*
+ * Surface Table
+ *
+ * The bot's best placement, precomputed for every stack surface whose
+ * neighbouring columns differ by at most Bumpiness, for every piece type.
+ *
+ * As long as no placement can clear a line, the bot's score for a placement
+ * only depends on the surface: every column height moves by the same amount
+ * wherever the stack's floor is, the holes a placement makes are the gaps
+ * under it, and the holes already there stay the same whatever happens. Nor
+ * does where the piece is matter, while the rows it's in are clear, since
+ * then it can reach every rotation and column. So when all that holds, the
+ * bot's choice is one lookup keyed by the height differences, and the board
+ * only has to be scored once, for the move the table gives.
+ *
+ * Anything else - a line in reach, a surface too rough, a piece already down
+ * among the blocks, other weights than the table was built for - goes to the
+ * search as before. Placements can tie, and the table and the search may pick
+ * different ones of those, but never a worse one.
+ *
+ * The file is meant to be memory mapped whole:
+ *
+ *   SurfaceTableHeader
+ *   Per piece type: SurfaceCount bytes, each an index into that type's
+ *   placements (GetSurfacePlacements)
+ *
+ * A surface's index has the height difference between columns i and i + 1,
+ * plus Bumpiness, as digit i in base 2*Bumpiness + 1. Fields are in host byte
+ * order.
+ */
+
+enum SurfaceConstants{
+    SURFACE_MAGIC       = 0x4C414741, //"AGAL"
+    SURFACE_VERSION     = 1,
+
+    SURFACE_MAX_BUMPINESS       = 3,
+    SURFACE_DEFAULT_BUMPINESS   = 2,
+
+    //Rotations and columns a piece fits on an empty board, as positioned by
+    //GetSurfacePlacements
+    SURFACE_MAX_PLACEMENTS = 48,
+
+    //Surfaces to a generating job
+    SURFACE_BATCH       = 4096
+};
+
+struct SurfaceTableHeader{
+    unsigned int Magic;
+    unsigned int Version;
+    unsigned int Bumpiness;
+    unsigned int SurfaceCount;
+    BotWeights Weights;         //Only valid for these
+    unsigned int TypeCount;
+    unsigned int Reserved;
+};
+
+struct SurfaceTable{
+    bool Valid;
+    const SurfaceTableHeader* Header;
+    const unsigned char* Moves;     //TypeCount*SurfaceCount
+
+    const unsigned char* Base;
+    size_t Size;
+    void* Handle;   //Windows only
+};
+
+//How the bot's decisions went, for whoever's asking for them
+struct SurfaceStats{
+    unsigned long long Lookups;
+    unsigned long long Hits;
+};
+
+//The table's placements for a type, in the order the table indexes them
+unsigned int    GetSurfacePlacements(unsigned int Type, BotPlacement* Placements);
+
+//Writes a table for Weights, shared out over System's workers. False, having
+//said why, if it couldn't.
+bool            GenerateSurfaceTable(const char* Path, unsigned int Bumpiness, BotWeights Weights, JobSystem* System);
+
+//Valid is false if the file is missing, truncated or not a surface table
+SurfaceTable    OpenSurfaceTable(const char* Path);
+void            CloseSurfaceTable(SurfaceTable* Table);
+
+//False, leaving Move alone, if the table doesn't answer for this board and
+//piece
+bool            LookupSurfaceMove(const SurfaceTable* Table, const unsigned int* RowMasks, unsigned int Type,
+                                  unsigned int Rotation, int Row, int Col, BotWeights Weights, BotMove* Move);
+
+//PlanBotMoveMasks, answered from the table when it can be. Table and Stats
+//can be NULL.
+BotMove         PlanSurfaceBotMove(const SurfaceTable* Table, const unsigned int* RowMasks, unsigned int Type,
+                                   unsigned int Rotation, int Row, int Col, BotWeights Weights, SurfaceStats* Stats);
+InputState      GetSurfaceBotInputs(GameData Game, BotWeights Weights, const SurfaceTable* Table, SurfaceStats* Stats);
+
+#endif
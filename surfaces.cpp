@@ -0,0 +1,406 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+#include "arena.cpp"
+#include "jobs.cpp"
+#include "game.cpp"
+#include "pieces.cpp"
+#include "lockstep.cpp"
+#include "bot.cpp"
+#include "surface.cpp"
+
+/*
+ * Surface Table Tool
+ *
+ *   agafb_surfaces generate <file> [--bumpiness b] [--threads n] [--pin]
+ *   agafb_surfaces info <file>
+ *   agafb_surfaces bench <file> [--games n] [--max-pieces n] [--seed s]
+ *
+ * Tables are built for the default bot weights. bench plays the same games
+ * twice, deciding every tick as the real time bots do: once searching every
+ * time, once asking the table first. It reports how often the table answered,
+ * the latency of each decision both ways, and whether the table's answers
+ * scored the same as the search's.
+ */
+
+enum SurfacesConstants{
+    SURFACES_LANES          = 8,
+    SURFACES_DEFAULT_GAMES  = 64,
+    SURFACES_DEFAULT_PIECES = 1000
+};
+
+double GetSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+unsigned long long GetNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int GenerateSurfaces(const char* Path, unsigned int Bumpiness, unsigned int ThreadCount, bool Pin)
+{
+    JobSystem* System = CreateJobSystem(ThreadCount, Pin);
+
+    if(System == NULL)
+    {
+        return 1;
+    }
+
+    double Start = GetSeconds();
+
+    if( !GenerateSurfaceTable(Path, Bumpiness, DefaultBotWeights(), System) )
+    {
+        DestroyJobSystem(System);
+        return 1;
+    }
+
+    double Elapsed = GetSeconds() - Start;
+    SurfaceTable Table = OpenSurfaceTable(Path);
+
+    if(Table.Valid)
+    {
+        printf("%u surfaces within %u of their neighbours, %u piece types, %.1f MB, in %.2fs on %u threads\n",
+               Table.Header->SurfaceCount, Bumpiness, Table.Header->TypeCount, Table.Size/(1024.0*1024.0),
+               Elapsed, System->WorkerCount);
+        PrintJobStats(System);
+    }
+
+    bool Valid = Table.Valid;
+
+    DestroyJobSystem(System);
+    CloseSurfaceTable(&Table);
+
+    return Valid ? 0 : 1;
+}
+
+int PrintSurfacesInfo(const SurfaceTable* Table)
+{
+    static const char ShapeNames[LOCKSTEP_SHAPES + 1] = "ITOZSJL";
+
+    const SurfaceTableHeader* Header = Table->Header;
+
+    printf("%u surfaces within %u of their neighbours, %u piece types\n", Header->SurfaceCount, Header->Bumpiness,
+           Header->TypeCount);
+    printf("Weights: height %.3f, lines %.3f, holes %.3f, bumpiness %.3f\n", Header->Weights.Height,
+           Header->Weights.Lines, Header->Weights.Holes, Header->Weights.Bumpiness);
+
+    //How spread out each type's answers are
+    for(unsigned int Type = 0; Type < Header->TypeCount; ++Type)
+    {
+        BotPlacement Placements[SURFACE_MAX_PLACEMENTS];
+        unsigned int Count = GetSurfacePlacements(Type, Placements);
+        unsigned int Uses[SURFACE_MAX_PLACEMENTS] = {0};
+
+        const unsigned char* Moves = Table->Moves + (size_t)Type*Header->SurfaceCount;
+
+        for(unsigned int Surface = 0; Surface < Header->SurfaceCount; ++Surface)
+        {
+            Uses[(Moves[Surface] < Count) ? Moves[Surface] : 0]++;
+        }
+
+        unsigned int Used = 0;
+        unsigned int Most = 0;
+
+        for(unsigned int Index = 0; Index < Count; ++Index)
+        {
+            Used += Uses[Index] ? 1 : 0;
+            Most = (Uses[Index] > Uses[Most]) ? Index : Most;
+        }
+
+        printf("  %c: %2u of %2u placements used, most often rotation %u column %d (%.1f%%)\n", ShapeNames[Type],
+               Used, Count, Placements[Most].Rotation, Placements[Most].Col,
+               100.0*Uses[Most]/Header->SurfaceCount);
+    }
+
+    return 0;
+}
+
+/*
+ * Benchmark
+ */
+
+struct DecisionTimes{
+    unsigned int* Nanoseconds;
+    unsigned long long Count;
+    unsigned long long Capacity;
+};
+
+void AddDecisionTime(DecisionTimes* Times, unsigned long long Nanoseconds)
+{
+    if(Times->Count == Times->Capacity)
+    {
+        Times->Capacity = Times->Capacity ? Times->Capacity*2 : 65536;
+        Times->Nanoseconds = (unsigned int*)realloc(Times->Nanoseconds, Times->Capacity*sizeof(unsigned int));
+    }
+
+    Times->Nanoseconds[Times->Count++] = (Nanoseconds > ~0u) ? ~0u : (unsigned int)Nanoseconds;
+}
+
+int CompareDecisionTimes(const void* A, const void* B)
+{
+    unsigned int X = *(const unsigned int*)A;
+    unsigned int Y = *(const unsigned int*)B;
+
+    return (X > Y) - (X < Y);
+}
+
+void PrintDecisionTimes(const char* Name, DecisionTimes* Times)
+{
+    if(!Times->Count)
+    {
+        return;
+    }
+
+    qsort(Times->Nanoseconds, Times->Count, sizeof(unsigned int), CompareDecisionTimes);
+
+    unsigned long long Total = 0;
+
+    for(unsigned long long Index = 0; Index < Times->Count; ++Index)
+    {
+        Total += Times->Nanoseconds[Index];
+    }
+
+    const unsigned int* Sorted = Times->Nanoseconds;
+    unsigned long long Last = Times->Count - 1;
+
+    printf("  %-8s %9llu decisions, mean %6.0fns  p50 %6uns  p99 %6uns  p99.9 %6uns  max %7uns\n", Name,
+           Times->Count, (double)Total/Times->Count, Sorted[Last/2], Sorted[Last*99/100], Sorted[Last*999/1000],
+           Sorted[Last]);
+}
+
+struct SurfacesBench{
+    DecisionTimes Times;
+    SurfaceStats Stats;
+    unsigned long long Checked;     //Table answers the search was also asked for
+    unsigned long long Agreed;      //Of those, scoring the same as the search's best
+    unsigned long long Score;
+    unsigned long long Pieces;
+};
+
+//Plays the games, a decision every tick, with Table (NULL to always search)
+void PlaySurfaceGames(const SurfaceTable* Table, unsigned int GameCount, unsigned int MaxPieces, unsigned int Seed,
+                      SurfacesBench* Bench)
+{
+    LockstepGames<SURFACES_LANES>* Games = (LockstepGames<SURFACES_LANES>*)malloc(sizeof(LockstepGames<SURFACES_LANES>));
+    BotWeights Weights = DefaultBotWeights();
+
+    for(unsigned int First = 0; First < GameCount; First += SURFACES_LANES)
+    {
+        unsigned int Running = 0;
+        unsigned int RandomStates[SURFACES_LANES];
+        unsigned int Pieces[SURFACES_LANES];
+
+        for(unsigned int Lane = 0; Lane < SURFACES_LANES; ++Lane)
+        {
+            SeedLockstepLane(Games, Lane, Seed + First + Lane);
+
+            RandomStates[Lane] = Games->Random[Lane];
+            Pieces[Lane] = 0;
+
+            if(First + Lane < GameCount)
+            {
+                Running |= 1u << Lane;
+            }
+            else
+            {
+                Games->State[Lane] = GAMEOVER;
+            }
+        }
+
+        unsigned int Inputs[SURFACES_LANES];
+        unsigned int Board[LOCKSTEP_ROWS];
+
+        while(Running)
+        {
+            for(unsigned int Lane = 0; Lane < SURFACES_LANES; ++Lane)
+            {
+                Inputs[Lane] = 0;
+
+                if( !(Running & (1u << Lane)) )
+                {
+                    continue;
+                }
+
+                for(unsigned int Row = 0; Row < LOCKSTEP_ROWS; ++Row)
+                {
+                    Board[Row] = Games->RowMasks[Row][Lane];
+                }
+
+                unsigned int Type = Games->Type[Lane];
+                unsigned int Rotation = Games->Rotation[Lane];
+                int Row = Games->Row[Lane];
+                int Col = Games->Col[Lane];
+
+                unsigned long long Hits = Bench->Stats.Hits;
+                unsigned long long Start = GetNanoseconds();
+
+                BotMove Move = Table ? PlanSurfaceBotMove(Table, Board, Type, Rotation, Row, Col, Weights, &Bench->Stats)
+                                     : PlanBotMoveMasks(Board, Type, Rotation, Row, Col, Weights);
+
+                AddDecisionTime(&Bench->Times, GetNanoseconds() - Start);
+
+                //Check the table against the search, off the clock
+                if(Bench->Stats.Hits != Hits)
+                {
+                    BotMove Searched = PlanBotMoveMasks(Board, Type, Rotation, Row, Col, Weights);
+                    float Tolerance = 1e-4f*(1.0f + ((Searched.Score < 0) ? -Searched.Score : Searched.Score));
+
+                    Bench->Checked++;
+                    Bench->Agreed += (Move.Score >= Searched.Score - Tolerance) ? 1 : 0;
+                }
+
+                Inputs[Lane] = SteerBotMove(Move, Rotation, Col);
+            }
+
+            unsigned int GameOver = StepLockstepGames(Games, Inputs);
+
+            for(unsigned int Active = Running; Active; Active &= Active - 1)
+            {
+                unsigned int Lane = CountTrailingZeros(Active);
+
+                if(Games->Random[Lane] != RandomStates[Lane])
+                {
+                    RandomStates[Lane] = Games->Random[Lane];
+                    Pieces[Lane]++;
+                }
+
+                if( (GameOver & (1u << Lane)) || (Pieces[Lane] >= MaxPieces) )
+                {
+                    Bench->Score += Games->Score[Lane];
+                    Bench->Pieces += Pieces[Lane];
+                    Running &= ~(1u << Lane);
+                }
+            }
+        }
+    }
+
+    free(Games);
+}
+
+int BenchmarkSurfaces(const SurfaceTable* Table, unsigned int GameCount, unsigned int MaxPieces, unsigned int Seed)
+{
+    BotWeights Weights = DefaultBotWeights();
+
+    if(memcmp(&Table->Header->Weights, &Weights, sizeof(Weights)) != 0)
+    {
+        printf("The table was built for other weights than the bot's, so it would never be used\n");
+        return 1;
+    }
+
+    SurfacesBench* Search = (SurfacesBench*)calloc(1, sizeof(SurfacesBench));
+    SurfacesBench* Lookup = (SurfacesBench*)calloc(1, sizeof(SurfacesBench));
+
+    printf("%u games of up to %u pieces from seed %u, a decision every tick\n", GameCount, MaxPieces, Seed);
+
+    PlaySurfaceGames(NULL, GameCount, MaxPieces, Seed, Search);
+    PlaySurfaceGames(Table, GameCount, MaxPieces, Seed, Lookup);
+
+    PrintDecisionTimes("search", &Search->Times);
+    PrintDecisionTimes("table", &Lookup->Times);
+
+    printf("Table answered %llu of %llu decisions (%.1f%%), %llu of them as well as the search (%.3f%%)\n",
+           Lookup->Stats.Hits, Lookup->Stats.Lookups, 100.0*Lookup->Stats.Hits/(Lookup->Stats.Lookups ? Lookup->Stats.Lookups : 1),
+           Lookup->Agreed, 100.0*Lookup->Agreed/(Lookup->Checked ? Lookup->Checked : 1));
+    printf("Mean score %.1f searching, %.1f with the table (%.1f and %.1f pieces a game)\n",
+           (double)Search->Score/GameCount, (double)Lookup->Score/GameCount,
+           (double)Search->Pieces/GameCount, (double)Lookup->Pieces/GameCount);
+
+    free(Search->Times.Nanoseconds);
+    free(Lookup->Times.Nanoseconds);
+    free(Search);
+    free(Lookup);
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 3)
+    {
+        printf("Usage: %s generate <file> [--bumpiness b] [--threads n] [--pin]\n"
+               "       %s info <file>\n"
+               "       %s bench <file> [--games n] [--max-pieces n] [--seed s]\n", argv[0], argv[0], argv[0]);
+        return 1;
+    }
+
+    const char* Command = argv[1];
+    const char* Path = argv[2];
+
+    unsigned int Bumpiness = SURFACE_DEFAULT_BUMPINESS;
+    unsigned int ThreadCount = std::thread::hardware_concurrency();
+    unsigned int GameCount = SURFACES_DEFAULT_GAMES;
+    unsigned int MaxPieces = SURFACES_DEFAULT_PIECES;
+    unsigned int Seed = 1;
+    bool Pin = false;
+
+    for(int Arg = 3; Arg < argc; ++Arg)
+    {
+        bool HasValue = (Arg + 1 < argc);
+
+        if( HasValue && (strcmp(argv[Arg], "--bumpiness") == 0) )
+        {
+            Bumpiness = atoi(argv[++Arg]);
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--threads") == 0) )
+        {
+            ThreadCount = atoi(argv[++Arg]);
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--games") == 0) )
+        {
+            GameCount = atoi(argv[++Arg]);
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--max-pieces") == 0) )
+        {
+            MaxPieces = atoi(argv[++Arg]);
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--seed") == 0) )
+        {
+            Seed = (unsigned int)strtoul(argv[++Arg], NULL, 10);
+        }
+        else if(strcmp(argv[Arg], "--pin") == 0)
+        {
+            Pin = true;
+        }
+    }
+
+    ThreadCount = ThreadCount ? ThreadCount : 1;
+    GameCount = GameCount ? GameCount : 1;
+
+    BuildLockstepShapes();
+
+    if(strcmp(Command, "generate") == 0)
+    {
+        return GenerateSurfaces(Path, Bumpiness, ThreadCount, Pin);
+    }
+
+    SurfaceTable Table = OpenSurfaceTable(Path);
+
+    if(!Table.Valid)
+    {
+        return 1;
+    }
+
+    int Result = 1;
+
+    if(strcmp(Command, "info") == 0)
+    {
+        Result = PrintSurfacesInfo(&Table);
+    }
+    else if(strcmp(Command, "bench") == 0)
+    {
+        Result = BenchmarkSurfaces(&Table, GameCount, MaxPieces, Seed);
+    }
+    else
+    {
+        printf("Unknown command %s\n", Command);
+    }
+
+    CloseSurfaceTable(&Table);
+
+    return Result;
+}
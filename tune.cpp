@@ -0,0 +1,719 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "arena.cpp"
+#include "jobs.cpp"
+#include "game.cpp"
+#include "pieces.cpp"
+#include "lockstep.cpp"
+#include "bot.cpp"
+
+/*
+ * Bot Weight Tuner
+ *
+ *   agafb_tune [--generations n] [--population n] [--games n] [--max-pieces n] [--threads n] [--pin] [--seed s] [--no-cull]
+ *   agafb_tune --scaling [--games n] [--max-pieces n] [--threads n] [--pin] [--seed s]
+ *
+ * Searches for BotWeights by self-play. Each generation samples candidates
+ * around a mean, plays every one of them through the same seeded games and
+ * moves the mean (and how far it samples from it, per weight) to the best
+ * quarter. A game's fitness is its score, and it ends at game over or after
+ * max-pieces pieces, so good weights are the ones that score fastest.
+ *
+ * The bot only compares placements, so weights are scaled to unit length -
+ * any other length plays identically.
+ *
+ * Games are played on the lockstep engine, TUNE_LANES to an engine, with each
+ * job worker keeping its engine for the whole run. A task is one candidate's
+ * share of TUNE_LANES games, and the task list is a ParallelFor on the job
+ * system (see jobs.h), so workers split it between them and steal from the
+ * far end of each other's share once their own runs out. --pin pins the
+ * workers to CPUs.
+ *
+ * A candidate is dropped, and its remaining tasks skipped, once the best it
+ * could plausibly average is below what the elite cutoff can plausibly
+ * average. That depends on which games finish first, so only a single thread
+ * run repeats exactly.
+ *
+ * --scaling plays the same workload on 1, 2, 4... up to --threads threads and
+ * reports games per second and efficiency against one thread.
+ */
+
+enum TuneConstants{
+    TUNE_LANES                  = 8,
+    TUNE_WEIGHTS                = 4,
+
+    TUNE_DEFAULT_GENERATIONS    = 10,
+    TUNE_DEFAULT_POPULATION     = 16,
+    TUNE_DEFAULT_GAMES          = 256,
+    TUNE_DEFAULT_MAX_PIECES     = 500,
+    TUNE_MAX_POPULATION         = 256,
+
+    //Games a candidate plays before it can be dropped
+    TUNE_MIN_CULL_GAMES         = 64,
+
+    //Candidates in --scaling runs
+    TUNE_SCALING_CANDIDATES     = 4
+};
+
+//Standard errors either side of a mean that count as plausible
+#define TUNE_CULL_SIGMAS 3.0
+
+//Starting spread, and the least it can shrink to
+#define TUNE_INITIAL_SIGMA  0.2
+#define TUNE_MIN_SIGMA      0.01
+
+//Share of the old spread kept each generation
+#define TUNE_SIGMA_MEMORY   0.3
+
+double GetSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ * Playing
+ */
+
+struct TuneEngine{
+    LockstepGames<TUNE_LANES> Games;
+    BotMove Moves[TUNE_LANES];
+    unsigned int RandomStates[TUNE_LANES];
+    unsigned int Pieces[TUNE_LANES];
+};
+
+struct TuneResult{
+    double Sum;
+    double SumSquares;
+    unsigned long long Pieces;
+    unsigned long long Ticks;
+};
+
+BotWeights GetTuneWeights(const float* Weights)
+{
+    BotWeights Result;
+
+    Result.Height       = Weights[0];
+    Result.Lines        = Weights[1];
+    Result.Holes        = Weights[2];
+    Result.Bumpiness    = Weights[3];
+
+    return Result;
+}
+
+//Plays seeds FirstSeed onwards, one per lane, to game over or MaxPieces. The
+//bot plans once a piece rather than every tick as GetBotInputMasks does, and
+//plans again if a move it steered with was blocked. Gravity only ever takes
+//placements away, so unless something blocked it the plan is still reachable.
+void PlayTuneGames(TuneEngine* Engine, BotWeights Weights, unsigned int FirstSeed, unsigned int MaxPieces,
+                   TuneResult* Result)
+{
+    LockstepGames<TUNE_LANES>* Games = &Engine->Games;
+    unsigned int Running = 0;
+
+    for(unsigned int Lane = 0; Lane < TUNE_LANES; ++Lane)
+    {
+        SeedLockstepLane(Games, Lane, FirstSeed + Lane);
+
+        Engine->Moves[Lane].Valid = false;
+        Engine->RandomStates[Lane] = Games->Random[Lane];
+        Engine->Pieces[Lane] = 0;
+        Running |= 1u << Lane;
+    }
+
+    unsigned int Inputs[TUNE_LANES];
+    int Cols[TUNE_LANES];
+    unsigned int Rotations[TUNE_LANES];
+    unsigned int Board[LOCKSTEP_ROWS];
+
+    while(Running)
+    {
+        for(unsigned int Lane = 0; Lane < TUNE_LANES; ++Lane)
+        {
+            Inputs[Lane] = 0;
+            Cols[Lane] = Games->Col[Lane];
+            Rotations[Lane] = Games->Rotation[Lane];
+
+            if( !(Running & (1u << Lane)) )
+            {
+                continue;
+            }
+
+            if(!Engine->Moves[Lane].Valid)
+            {
+                for(unsigned int Row = 0; Row < LOCKSTEP_ROWS; ++Row)
+                {
+                    Board[Row] = Games->RowMasks[Row][Lane];
+                }
+
+                Engine->Moves[Lane] = PlanBotMoveMasks(Board, Games->Type[Lane], Games->Rotation[Lane],
+                                                       Games->Row[Lane], Games->Col[Lane], Weights);
+            }
+
+            Inputs[Lane] = SteerBotMove(Engine->Moves[Lane], Games->Rotation[Lane], Games->Col[Lane]);
+        }
+
+        unsigned int GameOver = StepLockstepGames(Games, Inputs);
+
+        for(unsigned int Active = Running; Active; Active &= Active - 1)
+        {
+            unsigned int Lane = CountTrailingZeros(Active);
+            unsigned int Input = Inputs[Lane];
+
+            Result->Ticks++;
+
+            //The random state only moves on when a piece locks
+            if(Games->Random[Lane] != Engine->RandomStates[Lane])
+            {
+                Engine->RandomStates[Lane] = Games->Random[Lane];
+                Engine->Pieces[Lane]++;
+                Engine->Moves[Lane].Valid = false;
+            }
+            else if( ((Input & LOCKSTEP_ROTATE) && (Games->Rotation[Lane] == Rotations[Lane])) ||
+                     ((Input & (LOCKSTEP_LEFT | LOCKSTEP_RIGHT)) && (Games->Col[Lane] == Cols[Lane])) )
+            {
+                Engine->Moves[Lane].Valid = false;
+            }
+
+            if( (GameOver & (1u << Lane)) || (Engine->Pieces[Lane] >= MaxPieces) )
+            {
+                double Score = Games->Score[Lane];
+
+                Result->Sum += Score;
+                Result->SumSquares += Score*Score;
+                Result->Pieces += Engine->Pieces[Lane];
+                Running &= ~(1u << Lane);
+            }
+        }
+    }
+}
+
+/*
+ * Evaluation
+ */
+
+struct TuneCandidate{
+    float Weights[TUNE_WEIGHTS];
+
+    unsigned int Games;
+    double Sum;
+    double SumSquares;
+    bool Culled;
+};
+
+struct TuneTask{
+    unsigned int Candidate;
+    unsigned int FirstGame;
+};
+
+struct TuneJob{
+    TuneCandidate* Candidates;
+    unsigned int CandidateCount;
+    unsigned int EliteCount;
+    bool Cull;
+    unsigned int FirstSeed;
+    unsigned int MaxPieces;
+
+    TuneTask* Tasks;
+    JobSystem* System;
+    TuneEngine* Engines;    //One per job worker
+
+    std::mutex Lock;        //Candidates' results
+    std::atomic<unsigned long long> Games;
+    std::atomic<unsigned long long> Skipped;
+    std::atomic<unsigned long long> Pieces;
+    std::atomic<unsigned long long> Ticks;
+};
+
+double GetCandidateMean(const TuneCandidate* Candidate)
+{
+    return Candidate->Games ? Candidate->Sum/Candidate->Games : 0.0;
+}
+
+double GetCandidateError(const TuneCandidate* Candidate)
+{
+    if(Candidate->Games < 2)
+    {
+        return 0.0;
+    }
+
+    double Mean = GetCandidateMean(Candidate);
+    double Variance = (Candidate->SumSquares - Candidate->Sum*Mean)/(Candidate->Games - 1);
+
+    return (Variance > 0.0) ? sqrt(Variance/Candidate->Games) : 0.0;
+}
+
+//Call with the job locked. Drops a candidate whose upper bound is under the
+//lower bound of the EliteCount'th best candidate that has played enough.
+void CullTuneCandidate(TuneJob* Job, unsigned int Index)
+{
+    TuneCandidate* Candidate = Job->Candidates + Index;
+
+    if( !Job->Cull || Candidate->Culled || (Candidate->Games < TUNE_MIN_CULL_GAMES) )
+    {
+        return;
+    }
+
+    double Upper = GetCandidateMean(Candidate) + TUNE_CULL_SIGMAS*GetCandidateError(Candidate);
+    unsigned int Above = 0;
+
+    for(unsigned int Other = 0; Other < Job->CandidateCount; ++Other)
+    {
+        const TuneCandidate* Rival = Job->Candidates + Other;
+
+        if( (Other == Index) || Rival->Culled || (Rival->Games < TUNE_MIN_CULL_GAMES) )
+        {
+            continue;
+        }
+
+        Above += (GetCandidateMean(Rival) - TUNE_CULL_SIGMAS*GetCandidateError(Rival)) > Upper;
+    }
+
+    Candidate->Culled = (Above >= Job->EliteCount);
+}
+
+void RunTuneTasks(void* Data, unsigned long long Begin, unsigned long long End, unsigned int Worker)
+{
+    TuneJob* Job = (TuneJob*)Data;
+    TuneEngine* Engine = Job->Engines + Worker;
+
+    for(unsigned long long Index = Begin; Index < End; ++Index)
+    {
+        TuneTask Task = Job->Tasks[Index];
+        TuneCandidate* Candidate = Job->Candidates + Task.Candidate;
+        bool Culled;
+
+        {
+            std::lock_guard<std::mutex> Guard(Job->Lock);
+            Culled = Candidate->Culled;
+        }
+
+        if(Culled)
+        {
+            Job->Skipped += TUNE_LANES;
+            continue;
+        }
+
+        TuneResult Result;
+        memset(&Result, 0, sizeof(Result));
+
+        PlayTuneGames(Engine, GetTuneWeights(Candidate->Weights), Job->FirstSeed + Task.FirstGame, Job->MaxPieces, &Result);
+
+        Job->Games += TUNE_LANES;
+        Job->Pieces += Result.Pieces;
+        Job->Ticks += Result.Ticks;
+
+        std::lock_guard<std::mutex> Guard(Job->Lock);
+
+        Candidate->Games += TUNE_LANES;
+        Candidate->Sum += Result.Sum;
+        Candidate->SumSquares += Result.SumSquares;
+
+        CullTuneCandidate(Job, Task.Candidate);
+    }
+}
+
+//Plays GameCount games (a multiple of TUNE_LANES) from FirstSeed for every
+//candidate, returning the seconds it took
+double EvaluateTuneCandidates(TuneJob* Job, unsigned int GameCount)
+{
+    unsigned int Batches = GameCount/TUNE_LANES;
+    unsigned int TaskCount = Batches*Job->CandidateCount;
+
+    //Batch by batch, so every candidate has a few games in before any of them
+    //gets far ahead and culling has something to compare
+    for(unsigned int Batch = 0; Batch < Batches; ++Batch)
+    {
+        for(unsigned int Index = 0; Index < Job->CandidateCount; ++Index)
+        {
+            Job->Tasks[Batch*Job->CandidateCount + Index].Candidate = Index;
+            Job->Tasks[Batch*Job->CandidateCount + Index].FirstGame = Batch*TUNE_LANES;
+        }
+    }
+
+    for(unsigned int Index = 0; Index < Job->CandidateCount; ++Index)
+    {
+        Job->Candidates[Index].Games = 0;
+        Job->Candidates[Index].Sum = 0.0;
+        Job->Candidates[Index].SumSquares = 0.0;
+        Job->Candidates[Index].Culled = false;
+    }
+
+    Job->Games.store(0);
+    Job->Skipped.store(0);
+    Job->Pieces.store(0);
+    Job->Ticks.store(0);
+
+    //So the busy share and steals are this evaluation's
+    ResetJobStats(Job->System);
+
+    double Start = GetSeconds();
+
+    ParallelFor(Job->System, TaskCount, 1, RunTuneTasks, Job);
+
+    return GetSeconds() - Start;
+}
+
+/*
+ * Search
+ */
+
+double NextGaussian(RandomSeries* Series)
+{
+    double U1 = ((RandomNext(Series) >> 8) + 0.5)/16777216.0;
+    double U2 = ((RandomNext(Series) >> 8) + 0.5)/16777216.0;
+
+    return sqrt(-2.0*log(U1))*cos(6.283185307179586*U2);
+}
+
+void NormaliseTuneWeights(float* Weights)
+{
+    double Length = 0.0;
+
+    for(unsigned int Weight = 0; Weight < TUNE_WEIGHTS; ++Weight)
+    {
+        Length += (double)Weights[Weight]*Weights[Weight];
+    }
+
+    Length = sqrt(Length);
+
+    for(unsigned int Weight = 0; (Weight < TUNE_WEIGHTS) && (Length > 0.0); ++Weight)
+    {
+        Weights[Weight] = (float)(Weights[Weight]/Length);
+    }
+}
+
+void PrintTuneWeights(const char* Label, const float* Weights)
+{
+    printf("%sheight %.3f, lines %.3f, holes %.3f, bumpiness %.3f\n", Label, Weights[0], Weights[1], Weights[2], Weights[3]);
+}
+
+//Dropped candidates go last, the rest by mean score
+int CompareTuneCandidates(const void* A, const void* B)
+{
+    const TuneCandidate* First = (const TuneCandidate*)A;
+    const TuneCandidate* Second = (const TuneCandidate*)B;
+
+    if(First->Culled != Second->Culled)
+    {
+        return First->Culled ? 1 : -1;
+    }
+
+    double FirstMean = GetCandidateMean(First);
+    double SecondMean = GetCandidateMean(Second);
+
+    return (FirstMean > SecondMean) ? -1 : (FirstMean < SecondMean) ? 1 : 0;
+}
+
+TuneJob* CreateTuneJob(unsigned int CandidateCount, unsigned int GameCount, JobSystem* System, unsigned int MaxPieces)
+{
+    TuneJob* Job = new TuneJob;
+
+    Job->Candidates = (TuneCandidate*)calloc(CandidateCount, sizeof(TuneCandidate));
+    Job->CandidateCount = CandidateCount;
+    Job->EliteCount = (CandidateCount >= 4) ? CandidateCount/4 : 1;
+    Job->Cull = true;
+    Job->FirstSeed = 0;
+    Job->MaxPieces = MaxPieces;
+
+    Job->Tasks = (TuneTask*)malloc(sizeof(TuneTask)*CandidateCount*(GameCount/TUNE_LANES));
+    Job->System = System;
+    Job->Engines = (TuneEngine*)calloc(System->WorkerCount, sizeof(TuneEngine));
+
+    return Job;
+}
+
+void DestroyTuneJob(TuneJob* Job)
+{
+    free(Job->Candidates);
+    free(Job->Tasks);
+    free(Job->Engines);
+    delete Job;
+}
+
+int TuneBotWeights(unsigned int Generations, unsigned int Population, unsigned int GameCount, unsigned int MaxPieces,
+                   JobSystem* System, unsigned int Seed, bool Cull)
+{
+    TuneJob* Job = CreateTuneJob(Population, GameCount, System, MaxPieces);
+    unsigned int ThreadCount = System->WorkerCount;
+    Job->Cull = Cull;
+
+    RandomSeries Series = SeedRandomSeries(Seed ^ 0x9E3779B9);
+
+    BotWeights Default = DefaultBotWeights();
+    float Mean[TUNE_WEIGHTS] = {Default.Height, Default.Lines, Default.Holes, Default.Bumpiness};
+    double Sigma[TUNE_WEIGHTS];
+
+    NormaliseTuneWeights(Mean);
+
+    for(unsigned int Weight = 0; Weight < TUNE_WEIGHTS; ++Weight)
+    {
+        Sigma[Weight] = TUNE_INITIAL_SIGMA;
+    }
+
+    TuneCandidate Best;
+    memset(&Best, 0, sizeof(Best));
+
+    unsigned long long TotalGames = 0;
+    double TotalElapsed = 0.0;
+    double TotalBusy = 0.0;
+
+    printf("%u generations of %u candidates, %u games each of up to %u pieces, on %u threads\n",
+           Generations, Population, GameCount, MaxPieces, ThreadCount);
+
+    for(unsigned int Generation = 0; Generation < Generations; ++Generation)
+    {
+        //The mean itself is always in the running, so a generation can't lose
+        //what the last one found
+        for(unsigned int Index = 0; Index < Population; ++Index)
+        {
+            float* Weights = Job->Candidates[Index].Weights;
+
+            for(unsigned int Weight = 0; Weight < TUNE_WEIGHTS; ++Weight)
+            {
+                Weights[Weight] = Mean[Weight] + (Index ? (float)(Sigma[Weight]*NextGaussian(&Series)) : 0.0f);
+            }
+
+            NormaliseTuneWeights(Weights);
+        }
+
+        //Every candidate plays the same games, fresh ones each generation
+        Job->FirstSeed = Seed + Generation*GameCount;
+
+        double Elapsed = EvaluateTuneCandidates(Job, GameCount);
+        double Utilisation = GetJobUtilisation(System);
+        unsigned long long Games = Job->Games.load();
+
+        TotalGames += Games;
+        TotalElapsed += Elapsed;
+        TotalBusy += Utilisation*Elapsed;
+
+        if(Generation == 0)
+        {
+            printf("Default weights: %.1f per game\n", GetCandidateMean(Job->Candidates));
+        }
+
+        qsort(Job->Candidates, Population, sizeof(TuneCandidate), CompareTuneCandidates);
+
+        unsigned int Culled = 0;
+
+        for(unsigned int Index = 0; Index < Population; ++Index)
+        {
+            Culled += Job->Candidates[Index].Culled;
+        }
+
+        //Generations play different games, so this is only a rough comparison
+        TuneCandidate* Leader = Job->Candidates;
+
+        if( (Best.Games == 0) || (GetCandidateMean(Leader) > GetCandidateMean(&Best)) )
+        {
+            Best = *Leader;
+        }
+
+        //Move to the elite's average and spread
+        unsigned int EliteCount = Job->EliteCount;
+        double EliteScore = 0.0;
+
+        for(unsigned int Weight = 0; Weight < TUNE_WEIGHTS; ++Weight)
+        {
+            double Sum = 0.0;
+            double SumSquares = 0.0;
+
+            for(unsigned int Index = 0; Index < EliteCount; ++Index)
+            {
+                double Value = Job->Candidates[Index].Weights[Weight];
+
+                Sum += Value;
+                SumSquares += Value*Value;
+            }
+
+            double EliteMean = Sum/EliteCount;
+            double Spread = sqrt(fmax(SumSquares/EliteCount - EliteMean*EliteMean, 0.0));
+
+            Mean[Weight] = (float)EliteMean;
+            Sigma[Weight] = fmax(TUNE_SIGMA_MEMORY*Sigma[Weight] + (1.0 - TUNE_SIGMA_MEMORY)*Spread, TUNE_MIN_SIGMA);
+        }
+
+        for(unsigned int Index = 0; Index < EliteCount; ++Index)
+        {
+            EliteScore += GetCandidateMean(Job->Candidates + Index)/EliteCount;
+        }
+
+        NormaliseTuneWeights(Mean);
+
+        printf("Generation %2u: best %.1f +- %.1f, elite %.1f, %u of %u dropped, %llu games (%llu skipped) in %.2fs, "
+               "%.0f games/s, %.0f%% busy, %llu steals\n",
+               Generation, GetCandidateMean(Leader), GetCandidateError(Leader), EliteScore, Culled, Population,
+               Games, Job->Skipped.load(), Elapsed, Games/Elapsed, 100.0*Utilisation, GetTotalJobStats(System).Steals);
+        PrintTuneWeights("  mean ", Mean);
+    }
+
+    printf("%llu games in %.2fs: %.0f games/s, %.0f per thread, %.0f%% busy\n", TotalGames, TotalElapsed,
+           TotalGames/TotalElapsed, TotalGames/TotalElapsed/ThreadCount, 100.0*TotalBusy/TotalElapsed);
+    printf("Best: %.1f per game\n", GetCandidateMean(&Best));
+    PrintTuneWeights("  ", Best.Weights);
+    printf("As DefaultBotWeights: Height %.2ff, Lines %.2ff, Holes %.2ff, Bumpiness %.2ff\n",
+           Best.Weights[0], Best.Weights[1], Best.Weights[2], Best.Weights[3]);
+
+    DestroyTuneJob(Job);
+
+    return 0;
+}
+
+/*
+ * Scaling
+ */
+
+int MeasureTuneScaling(unsigned int GameCount, unsigned int MaxPieces, unsigned int MaxThreads, bool Pin, unsigned int Seed)
+{
+    RandomSeries Series = SeedRandomSeries(Seed ^ 0x9E3779B9);
+    BotWeights Default = DefaultBotWeights();
+    float Candidates[TUNE_SCALING_CANDIDATES][TUNE_WEIGHTS];
+
+    for(unsigned int Index = 0; Index < TUNE_SCALING_CANDIDATES; ++Index)
+    {
+        float Weights[TUNE_WEIGHTS] = {Default.Height, Default.Lines, Default.Holes, Default.Bumpiness};
+
+        for(unsigned int Weight = 0; Weight < TUNE_WEIGHTS; ++Weight)
+        {
+            Candidates[Index][Weight] = Weights[Weight] + (Index ? (float)(TUNE_INITIAL_SIGMA*NextGaussian(&Series)) : 0.0f);
+        }
+
+        NormaliseTuneWeights(Candidates[Index]);
+    }
+
+    printf("%u candidates, %u games each of up to %u pieces\n", TUNE_SCALING_CANDIDATES, GameCount, MaxPieces);
+
+    double Baseline = 0.0;
+
+    for(unsigned int ThreadCount = 1; ThreadCount; )
+    {
+        JobSystem* System = CreateJobSystem(ThreadCount, Pin);
+
+        if(System == NULL)
+        {
+            return 1;
+        }
+
+        //Every run plays every game so they all do the same work
+        TuneJob* Job = CreateTuneJob(TUNE_SCALING_CANDIDATES, GameCount, System, MaxPieces);
+        Job->Cull = false;
+        Job->FirstSeed = Seed;
+
+        for(unsigned int Index = 0; Index < TUNE_SCALING_CANDIDATES; ++Index)
+        {
+            memcpy(Job->Candidates[Index].Weights, Candidates[Index], sizeof(Candidates[Index]));
+        }
+
+        double Elapsed = EvaluateTuneCandidates(Job, GameCount);
+        double Rate = Job->Games.load()/Elapsed;
+
+        Baseline = (ThreadCount == 1) ? Rate : Baseline;
+
+        printf("%3u threads: %.2fs, %.0f games/s, %.2fx, %.0f%% efficiency, %.0f%% busy, %llu steals\n",
+               ThreadCount, Elapsed, Rate, Rate/Baseline, 100.0*Rate/(Baseline*ThreadCount),
+               100.0*GetJobUtilisation(System), GetTotalJobStats(System).Steals);
+
+        DestroyTuneJob(Job);
+        DestroyJobSystem(System);
+
+        //Finish on the thread count asked for even if it isn't a power of two
+        unsigned int Next = (ThreadCount*2 < MaxThreads) ? ThreadCount*2 : MaxThreads;
+        ThreadCount = (ThreadCount < MaxThreads) ? Next : 0;
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int Generations = TUNE_DEFAULT_GENERATIONS;
+    unsigned int Population = TUNE_DEFAULT_POPULATION;
+    unsigned int GameCount = TUNE_DEFAULT_GAMES;
+    unsigned int MaxPieces = TUNE_DEFAULT_MAX_PIECES;
+    unsigned int ThreadCount = std::thread::hardware_concurrency();
+    unsigned int Seed = 1;
+    bool Cull = true;
+    bool Scaling = false;
+    bool Pin = false;
+
+    for(int Arg = 1; Arg < argc; ++Arg)
+    {
+        bool HasValue = (Arg + 1 < argc);
+
+        if( HasValue && (strcmp(argv[Arg], "--generations") == 0) )
+        {
+            Generations = atoi(argv[++Arg]);
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--population") == 0) )
+        {
+            Population = atoi(argv[++Arg]);
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--games") == 0) )
+        {
+            GameCount = atoi(argv[++Arg]);
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--max-pieces") == 0) )
+        {
+            MaxPieces = atoi(argv[++Arg]);
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--threads") == 0) )
+        {
+            ThreadCount = atoi(argv[++Arg]);
+        }
+        else if( HasValue && (strcmp(argv[Arg], "--seed") == 0) )
+        {
+            Seed = atoi(argv[++Arg]);
+        }
+        else if(strcmp(argv[Arg], "--no-cull") == 0)
+        {
+            Cull = false;
+        }
+        else if(strcmp(argv[Arg], "--scaling") == 0)
+        {
+            Scaling = true;
+        }
+        else if(strcmp(argv[Arg], "--pin") == 0)
+        {
+            Pin = true;
+        }
+        else
+        {
+            printf("Usage: %s [--generations n] [--population n] [--games n] [--max-pieces n] [--threads n] [--pin] [--seed s] [--no-cull]\n"
+                   "       %s --scaling [--games n] [--max-pieces n] [--threads n] [--pin] [--seed s]\n", argv[0], argv[0]);
+            return 1;
+        }
+    }
+
+    ThreadCount = ThreadCount ? ThreadCount : 1;
+    Population = (Population < 2) ? 2 : (Population > TUNE_MAX_POPULATION) ? (unsigned int)TUNE_MAX_POPULATION : Population;
+    GameCount = ((GameCount + TUNE_LANES - 1)/TUNE_LANES)*TUNE_LANES;
+    GameCount = GameCount ? GameCount : (unsigned int)TUNE_LANES;
+    MaxPieces = MaxPieces ? MaxPieces : 1;
+
+    BuildLockstepShapes();
+
+    if(Scaling)
+    {
+        return MeasureTuneScaling(GameCount, MaxPieces, ThreadCount, Pin, Seed);
+    }
+
+    JobSystem* System = CreateJobSystem(ThreadCount, Pin);
+
+    if(System == NULL)
+    {
+        return 1;
+    }
+
+    int Result = TuneBotWeights(Generations, Population, GameCount, MaxPieces, System, Seed, Cull);
+
+    DestroyJobSystem(System);
+
+    return Result;
+}
@@ -0,0 +1,291 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <chrono>
+#include <thread>
+
+#include "arena.cpp"
+#include "game.cpp"
+#include "pieces.cpp"
+#include "snapshot.cpp"
+#include "broadcast.cpp"
+
+/*
+ * Spectator
+ *
+ * Follows a game started with agafb --broadcast and draws it in the terminal.
+ *
+ *   agafb_watch [name]
+ *   agafb_watch [name] --subscribers n [--seconds s]
+ *
+ * The second form draws nothing: it attaches n subscribers on their own
+ * threads, to check that fanning out to a crowd costs the game nothing and
+ * that every subscriber's decoded view agrees with each keyframe.
+ */
+
+enum WatchConstants{
+    WATCH_POLL_MS       = 5,
+    WATCH_RETRY_MS      = 500,
+    WATCH_MAX_THREADS   = 1024
+};
+
+volatile sig_atomic_t WatchInterrupted = 0;
+
+void HandleWatchSignal(int)
+{
+    WatchInterrupted = 1;
+}
+
+void SleepMilliseconds(unsigned int Milliseconds)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(Milliseconds));
+}
+
+//Waits for the game to start broadcasting
+BroadcastSubscriber WaitForBroadcast(const char* Name)
+{
+    BroadcastSubscriber Result = OpenBroadcastSubscriber(Name);
+    bool Told = false;
+
+    while( !Result.Valid && !WatchInterrupted )
+    {
+        if(!Told)
+        {
+            printf("Waiting for broadcast %s...\n", Name);
+            Told = true;
+        }
+
+        SleepMilliseconds(WATCH_RETRY_MS);
+        Result = OpenBroadcastSubscriber(Name);
+    }
+
+    return Result;
+}
+
+void PrintView(const BroadcastView* View, const BroadcastSubscriber* Subscriber)
+{
+    static const char* StateNames[] = {"Starting", "Running", "Paused", "Game Over"};
+
+    char Screen[4096];
+    char* Out = Screen;
+
+    //Home the cursor and redraw over the last frame
+    Out += sprintf(Out, "\x1b[H\x1b[2J");
+    Out += sprintf(Out, "Tick %u  Score %u  %s\n", View->Tick, View->Score,
+                   (View->State <= GAMEOVER) ? StateNames[View->State] : "?");
+
+    for(int Row = 0; Row < GRID_ROWS; ++Row)
+    {
+        *Out++ = '|';
+
+        for(int Col = 0; Col < GRID_COLS; ++Col)
+        {
+            int PieceRow = Row - View->PieceRow;
+            int PieceCol = Col - View->PieceCol;
+
+            bool Piece = (PieceRow >= 0) && (PieceRow < TETROMINO_MAX_SIZE) &&
+                         (PieceCol >= 0) && (PieceCol < TETROMINO_MAX_SIZE) &&
+                         (View->PieceShape & (1 << (PieceRow*TETROMINO_MAX_SIZE + PieceCol)));
+
+            if(Piece)
+            {
+                *Out++ = '@';
+                *Out++ = '@';
+            }
+            else if(View->Rows[Row] & (1 << Col))
+            {
+                *Out++ = '[';
+                *Out++ = ']';
+            }
+            else
+            {
+                *Out++ = ' ';
+                *Out++ = '.';
+            }
+        }
+
+        *Out++ = '|';
+        *Out++ = '\n';
+    }
+
+    Out += sprintf(Out, "%llu records, %llu keyframes, %llu resyncs\n",
+                   Subscriber->Records, Subscriber->Keyframes, Subscriber->Resyncs);
+
+    fwrite(Screen, 1, Out - Screen, stdout);
+    fflush(stdout);
+}
+
+int WatchBroadcast(const char* Name)
+{
+    BroadcastSubscriber Subscriber = WaitForBroadcast(Name);
+
+    while( Subscriber.Valid && !WatchInterrupted )
+    {
+        BroadcastReadResult Read = ReadBroadcast(&Subscriber);
+
+        if(Read == BROADCAST_READ_UPDATED)
+        {
+            PrintView(&Subscriber.View, &Subscriber);
+        }
+        else if(Read == BROADCAST_READ_CLOSED)
+        {
+            printf("The game has stopped broadcasting\n");
+            break;
+        }
+        else
+        {
+            SleepMilliseconds(WATCH_POLL_MS);
+        }
+    }
+
+    CloseBroadcastSubscriber(&Subscriber);
+
+    return 0;
+}
+
+/*
+ * Crowd Test
+ */
+
+struct CrowdMember{
+    BroadcastSubscriber Subscriber;
+    unsigned long long Updates;
+    bool Closed;
+};
+
+void RunCrowdMember(CrowdMember* Member, double Seconds)
+{
+    auto End = std::chrono::steady_clock::now() + std::chrono::duration<double>(Seconds);
+
+    while( !WatchInterrupted && (std::chrono::steady_clock::now() < End) )
+    {
+        BroadcastReadResult Read = ReadBroadcast(&Member->Subscriber);
+
+        if(Read == BROADCAST_READ_UPDATED)
+        {
+            Member->Updates++;
+        }
+        else if(Read == BROADCAST_READ_CLOSED)
+        {
+            Member->Closed = true;
+            break;
+        }
+        else
+        {
+            SleepMilliseconds(WATCH_POLL_MS);
+        }
+    }
+}
+
+int WatchCrowd(const char* Name, unsigned int Count, double Seconds)
+{
+    BroadcastSubscriber First = WaitForBroadcast(Name);
+
+    if(!First.Valid)
+    {
+        return 1;
+    }
+
+    CrowdMember* Members = (CrowdMember*)calloc(Count, sizeof(CrowdMember));
+    std::thread* Threads = new std::thread[Count];
+
+    Members[0].Subscriber = First;
+
+    for(unsigned int Index = 1; Index < Count; ++Index)
+    {
+        Members[Index].Subscriber = OpenBroadcastSubscriber(Name);
+    }
+
+    printf("%u subscribers on %s for %.0fs\n", Count, Name, Seconds);
+    fflush(stdout);
+
+    for(unsigned int Index = 0; Index < Count; ++Index)
+    {
+        Threads[Index] = std::thread(RunCrowdMember, Members + Index, Seconds);
+    }
+
+    for(unsigned int Index = 0; Index < Count; ++Index)
+    {
+        Threads[Index].join();
+    }
+
+    unsigned long long Records = 0;
+    unsigned long long Keyframes = 0;
+    unsigned long long Resyncs = 0;
+    unsigned long long Mismatches = 0;
+    unsigned int Closed = 0;
+    unsigned int Disagree = 0;
+
+    for(unsigned int Index = 0; Index < Count; ++Index)
+    {
+        BroadcastSubscriber* Subscriber = &Members[Index].Subscriber;
+
+        Records += Subscriber->Records;
+        Keyframes += Subscriber->Keyframes;
+        Resyncs += Subscriber->Resyncs;
+        Mismatches += Subscriber->KeyframeMismatches;
+        Closed += Members[Index].Closed;
+
+        //Everyone who read to the end of a finished game saw the same thing
+        if( Members[Index].Closed && Members[0].Closed &&
+            !BroadcastViewsEqual(&Subscriber->View, &Members[0].Subscriber.View) )
+        {
+            Disagree++;
+        }
+
+        CloseBroadcastSubscriber(Subscriber);
+    }
+
+    printf("%llu records read (%.0f per subscriber), %llu keyframes, %llu resyncs, %llu keyframe mismatches\n",
+           Records, (double)Records/Count, Keyframes, Resyncs, Mismatches);
+
+    if(Closed)
+    {
+        printf("%u saw the broadcast end, %u of them disagree on the final state\n", Closed, Disagree);
+    }
+
+    delete[] Threads;
+    free(Members);
+
+    return (Mismatches || Disagree) ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    const char* Name = DEFAULT_BROADCAST_NAME;
+    unsigned int Subscribers = 0;
+    double Seconds = 10.0;
+
+    for(int Arg = 1; Arg < argc; ++Arg)
+    {
+        if( (strcmp(argv[Arg], "--subscribers") == 0) && (Arg + 1 < argc) )
+        {
+            Subscribers = atoi(argv[++Arg]);
+        }
+        else if( (strcmp(argv[Arg], "--seconds") == 0) && (Arg + 1 < argc) )
+        {
+            Seconds = atof(argv[++Arg]);
+        }
+        else if(argv[Arg][0] != '-')
+        {
+            Name = argv[Arg];
+        }
+        else
+        {
+            printf("Usage: %s [name] [--subscribers n] [--seconds s]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    signal(SIGINT, HandleWatchSignal);
+
+    if(Subscribers)
+    {
+        Subscribers = (Subscribers > WATCH_MAX_THREADS) ? (unsigned int)WATCH_MAX_THREADS : Subscribers;
+
+        return WatchCrowd(Name, Subscribers, Seconds);
+    }
+
+    return WatchBroadcast(Name);
+}